@@ -0,0 +1,79 @@
+#include "hittop/concurrent/line_chunks.h"
+#include "hittop/concurrent/line_chunks.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ::hittop::concurrent::ForEachLineChunk;
+using ::hittop::concurrent::LineChunk;
+using ::hittop::concurrent::SplitLines;
+
+std::string MakeLines(std::size_t count) {
+  std::string text;
+  for (std::size_t i = 0; i < count; ++i) {
+    text += std::string(i % 13, 'x') + std::to_string(i) + "\n";
+  }
+  return text;
+}
+
+TEST(LineChunksTest, SplitLines) {
+  const std::string text = MakeLines(1000) + "unterminated";
+  const char *const first = text.data();
+  const char *const last = first + text.size();
+  for (std::size_t num_chunks : {1, 3, 16, 1000}) {
+    const std::vector<LineChunk> chunks =
+        SplitLines(first, last, num_chunks, 1);
+    ASSERT_FALSE(chunks.empty());
+    EXPECT_EQ(chunks.front().first, first);
+    EXPECT_EQ(chunks.back().second, last);
+    for (std::size_t i = 0; i + 1 < chunks.size(); ++i) {
+      EXPECT_EQ(chunks[i].second, chunks[i + 1].first);
+      EXPECT_EQ(chunks[i].second[-1], '\n');
+    }
+    EXPECT_LE(chunks.size(), num_chunks + 1);
+  }
+  EXPECT_EQ(SplitLines(first, last, 1000, 1 << 20).size(), 1u);
+  EXPECT_GE(SplitLines(first, last, 1, 1, 100).size(), text.size() / 120);
+  EXPECT_TRUE(SplitLines(first, first, 4, 1).empty());
+}
+
+struct LineCount {
+  std::size_t lines = 0;
+  std::string first_line;
+};
+
+TEST(LineChunksTest, MergesInOrder) {
+  const std::string text = MakeLines(20000);
+  const auto chunks =
+      SplitLines(text.data(), text.data() + text.size(), 64, 1);
+  for (unsigned threads : {1, 2, 8}) {
+    std::size_t total = 0;
+    std::vector<std::string> firsts;
+    ForEachLineChunk<LineCount>(
+        chunks, threads,
+        [](const char *first, const char *last, LineCount *count) {
+          count->lines = std::count(first, last, '\n');
+          count->first_line = std::string(first, std::find(first, last, '\n'));
+        },
+        [&](std::unique_ptr<LineCount> count) {
+          total += count->lines;
+          firsts.push_back(count->first_line);
+        });
+    EXPECT_EQ(total, 20000u);
+    ASSERT_EQ(firsts.size(), chunks.size());
+    for (std::size_t i = 0; i < chunks.size(); ++i) {
+      EXPECT_EQ(firsts[i], std::string(chunks[i].first,
+                                       std::find(chunks[i].first,
+                                                 chunks[i].second, '\n')));
+    }
+  }
+}
+
+} // namespace
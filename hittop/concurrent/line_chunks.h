@@ -0,0 +1,88 @@
+// Parallel processing of line-oriented text that is already in memory.
+//
+// SplitLines divides the text into ranges that end just after a newline, so
+// that each can be processed without looking at its neighbours.
+// ForEachLineChunk processes the ranges on a pool of threads, each into a
+// Result of its own, and hands the Results to a merge function one at a time
+// in the order of the text (through an OrderedActionSequence), so that the
+// outcome does not depend on thread scheduling.
+//
+#ifndef HITTOP_CONCURRENT_LINE_CHUNKS_H
+#define HITTOP_CONCURRENT_LINE_CHUNKS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/io_service.hpp"
+
+#include "hittop/concurrent/ordered_action_sequence.h"
+
+namespace hittop {
+namespace concurrent {
+
+using LineChunk = std::pair<const char *, const char *>;
+
+// Splits [first, last) into about num_chunks ranges of at least
+// min_chunk_size bytes, and (line lengths permitting) at most max_chunk_size,
+// that end just after a newline (or at last).
+inline std::vector<LineChunk>
+SplitLines(const char *first, const char *last, std::size_t num_chunks,
+           std::size_t min_chunk_size,
+           std::size_t max_chunk_size =
+               std::numeric_limits<std::size_t>::max()) {
+  const std::size_t size = last - first;
+  const std::size_t target = std::min(
+      std::max(min_chunk_size, size / std::max<std::size_t>(num_chunks, 1)),
+      max_chunk_size);
+  std::vector<LineChunk> chunks;
+  while (first != last) {
+    const char *end = first + std::min(target, std::size_t(last - first));
+    end = std::find(end, last, '\n');
+    if (end != last) {
+      ++end;
+    }
+    chunks.emplace_back(first, end);
+    first = end;
+  }
+  return chunks;
+}
+
+// Calls parse(first, last, Result *) for each chunk on num_threads threads,
+// each with a new, default-constructed Result; then merge(std::unique_ptr<
+// Result>) with each Result in the order of the chunks.  merge is called from
+// the worker threads, but never concurrently.  Returns once all are merged.
+template <typename Result, typename Parse, typename Merge>
+void ForEachLineChunk(const std::vector<LineChunk> &chunks,
+                      unsigned num_threads, Parse parse, Merge merge) {
+  std::vector<std::unique_ptr<Result>> results(chunks.size());
+  boost::asio::io_service io;
+  OrderedActionSequence sequence;
+  for (std::size_t i = 0; i < chunks.size(); ++i) {
+    // Each slot of results is written by one worker, and read by the merge
+    // that the sequence runs after it.
+    auto deliver = sequence.WrapNext(
+        [&results, &merge, i]() { merge(std::move(results[i])); });
+    io.post([&results, &chunks, &parse, i, deliver]() {
+      results[i] = std::make_unique<Result>();
+      parse(chunks[i].first, chunks[i].second, results[i].get());
+      deliver();
+    });
+  }
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < std::max(1u, num_threads); ++i) {
+    threads.emplace_back([&io]() { io.run(); });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+} // namespace concurrent
+} // namespace hittop
+
+#endif // HITTOP_CONCURRENT_LINE_CHUNKS_H
@@ -0,0 +1,107 @@
+#include "hittop/container/trie.h"
+
+#include "gtest/gtest.h"
+
+#include <map>
+#include <random>
+#include <string>
+
+namespace {
+
+using ::hittop::container::Trie;
+
+TEST(TrieTest, EmptyTrie) {
+  Trie<char, int> trie;
+  EXPECT_TRUE(trie.empty());
+  EXPECT_EQ(0u, trie.size());
+  EXPECT_EQ(nullptr, trie.find(""));
+  EXPECT_EQ(nullptr, trie.find("a"));
+}
+
+TEST(TrieTest, InsertAndFind) {
+  Trie<char, int> trie;
+  EXPECT_TRUE(trie.insert("romane", 1).second);
+  EXPECT_TRUE(trie.insert("romanus", 2).second);
+  EXPECT_TRUE(trie.insert("romulus", 3).second);
+  EXPECT_TRUE(trie.insert("rom", 4).second);
+  EXPECT_TRUE(trie.insert("", 5).second);
+  EXPECT_EQ(5u, trie.size());
+
+  ASSERT_NE(nullptr, trie.find("romane"));
+  EXPECT_EQ(1, *trie.find("romane"));
+  EXPECT_EQ(2, *trie.find("romanus"));
+  EXPECT_EQ(3, *trie.find("romulus"));
+  EXPECT_EQ(4, *trie.find("rom"));
+  EXPECT_EQ(5, *trie.find(""));
+
+  EXPECT_EQ(nullptr, trie.find("r"));
+  EXPECT_EQ(nullptr, trie.find("roman"));
+  EXPECT_EQ(nullptr, trie.find("romanes"));
+  EXPECT_EQ(nullptr, trie.find("romb"));
+}
+
+TEST(TrieTest, DuplicateInsertKeepsOriginal) {
+  Trie<char, int> trie;
+  auto first = trie.insert(std::string("key"), 1);
+  auto second = trie.insert(std::string("key"), 2);
+  EXPECT_TRUE(first.second);
+  EXPECT_FALSE(second.second);
+  EXPECT_EQ(1, *second.first);
+  EXPECT_EQ(1u, trie.size());
+
+  *trie.find("key") = 3;
+  EXPECT_EQ(3, *trie.find(std::string("key")));
+}
+
+TEST(TrieTest, ValuesMoveOnInsert) {
+  // Values live in the nodes, so inserting siblings moves them; only their
+  // keys, not pointers returned earlier, stay valid.
+  Trie<char, std::string> trie;
+  const std::string *const first = trie.insert("m", "first").first;
+  EXPECT_EQ("first", *first);
+  for (char ch = 'a'; ch <= 'z'; ++ch) {
+    trie.insert(std::string(1, ch), std::string(1, ch));
+  }
+  ASSERT_NE(nullptr, trie.find("m"));
+  EXPECT_EQ("first", *trie.find("m"));
+  EXPECT_EQ("a", *trie.find("a"));
+  EXPECT_EQ("z", *trie.find("z"));
+}
+
+TEST(TrieTest, NonAsciiCharacters) {
+  Trie<char, int> trie;
+  const std::string high = "\xff\x80\x01";
+  trie.insert(high, 1);
+  trie.insert(std::string("\x7f"), 2);
+  EXPECT_EQ(1, *trie.find(high));
+  EXPECT_EQ(2, *trie.find(std::string("\x7f")));
+  EXPECT_EQ(nullptr, trie.find(std::string("\xff")));
+}
+
+TEST(TrieTest, MatchesStdMap) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> length(0, 8);
+  std::uniform_int_distribution<int> letter('a', 'e');
+  std::map<std::string, int> expected;
+  Trie<char, int> trie;
+  for (int i = 0; i < 2000; ++i) {
+    std::string key(length(rng), ' ');
+    for (char &ch : key) {
+      ch = static_cast<char>(letter(rng));
+    }
+    const bool inserted = expected.emplace(key, i).second;
+    EXPECT_EQ(inserted, trie.insert(key, i).second) << key;
+  }
+  EXPECT_EQ(expected.size(), trie.size());
+  for (const auto &entry : expected) {
+    const int *value = trie.find(entry.first);
+    ASSERT_NE(nullptr, value) << entry.first;
+    EXPECT_EQ(entry.second, *value);
+  }
+
+  trie.clear();
+  EXPECT_TRUE(trie.empty());
+  EXPECT_EQ(nullptr, trie.find(expected.begin()->first));
+}
+
+} // namespace
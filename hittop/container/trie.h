@@ -1,69 +1,214 @@
+// A compressed (radix) trie keyed on character strings.
+//
+// Each node stores the run of characters shared by every key below it, plus a
+// 256-bit bitset of the characters that begin its children.  Children are kept
+// in character order in a dense vector, so the child for a given character is
+// located by counting the bits set below that character (popcount), and a node
+// only pays for the children it actually has.  Lookups are O(key length).
+//
+// Values are stored in the nodes, which move when a sibling is inserted before
+// them or their parent's children are reallocated.  So, as with std::vector,
+// a pointer returned by insert or find is only valid until the next insert
+// (or clear); look the key up again after that.
+//
 #ifndef HITTOP_CONTAINER_TRIE_H
 #define HITTOP_CONTAINER_TRIE_H
 
 #include <assert.h>
 
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/optional.hpp"
 
 namespace hittop {
 namespace container {
 
-template <typename T, typename Allocator> class Trie;
-
-template <typename Allocator> class Trie<char, Allocator> {
+template <typename T, typename Value,
+          typename Allocator = std::allocator<Value>>
+class Trie;
 
+template <typename Value, typename Allocator>
+class Trie<char, Value, Allocator> {
 private:
   using Bitset = std::array<std::uint64_t, 4>;
 
-  template <typename T> static constexpr std::size_t bit_size() {
-    return (sizeof(T) * 8);
+  static constexpr std::size_t kBitsPerWord = sizeof(Bitset::value_type) * 8;
+
+  static std::size_t popcount(Bitset::value_type bits) {
+    return __builtin_popcountll(bits);
   }
 
-  template <typename T> static constexpr std::size_t upper_bound() {
-    return 1 << bit_size<T>();
+  static bool Test(const Bitset &present, unsigned char ch) {
+    return (present[ch / kBitsPerWord] >> (ch % kBitsPerWord)) & 1;
   }
 
-  static std::size_t popcount(Bitset::value_type bits) {
-    return __builtin_popcountll(bits);
+  static void Set(Bitset &present, unsigned char ch) {
+    present[ch / kBitsPerWord] |= Bitset::value_type{1}
+                                  << (ch % kBitsPerWord);
+  }
+
+  // Returns the number of children whose first character is less than ch;
+  // i.e., the index of ch's child in Node::children_.
+  static std::size_t Rank(const Bitset &present, unsigned char ch) {
+    const std::size_t word = ch / kBitsPerWord;
+    const std::size_t bit = ch % kBitsPerWord;
+    std::size_t index = 0;
+    for (std::size_t i = 0; i < word; ++i) {
+      index += popcount(present[i]);
+    }
+    return index +
+           popcount(present[word] & ((Bitset::value_type{1} << bit) - 1));
   }
 
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using CharAllocator = typename AllocTraits::template rebind_alloc<char>;
+  using Label = std::basic_string<char, std::char_traits<char>, CharAllocator>;
+
   struct Node {
-    std::size_t GetIndex(std::size_t position) {
-      assert(position < upper_bound<T>());
-      constexpr auto mask0 = std::size_t{0x3} << 0;
-      constexpr auto mask1 = std::size_t{0x3} << 4;
-      constexpr auto mask2 = std::size_t{0x3} << 8;
-      constexpr auto mask3 = std::size_t{0x3} << 12;
-
-      if (position & mask3) {
-        return popcount(present_[0]) + popcount(present_[1]) +
-               popcount(present_[2]) +
-               popcount(((1 << (position - (256 - 64 * 1))) - 1) & present_[3]);
-      } else {
-        if (position & mask2) {
-          return popcount(present_[0]) + popcount(present_[1]) +
-                 popcount(((1 << (position - (256 - 64 * 2))) - 1) &
-                          present_[2]);
-        } else {
-          if (position & mask1) {
-            return popcount(present_[0]) +
-                   popcount(((1 << (position - (256 - 64 * 3))) - 1) &
-                            present_[1]);
-          } else {
-            return popcount(((1 << (position - (256 - 64 * 4))) - 1) &
-                            present_[0]);
-          }
+    using NodeAllocator = typename AllocTraits::template rebind_alloc<Node>;
+
+    explicit Node(const Allocator &alloc)
+        : label_(CharAllocator(alloc)), children_(NodeAllocator(alloc)) {}
+
+    // The characters following the one that selected this node in its parent.
+    Label label_;
+    Bitset present_{};
+    std::vector<Node, NodeAllocator> children_;
+    boost::optional<Value> value_;
+  };
+
+public:
+  using value_type = Value;
+  using allocator_type = Allocator;
+
+  Trie() : Trie(Allocator{}) {}
+
+  explicit Trie(const Allocator &alloc) : alloc_(alloc), root_(alloc) {}
+
+  std::size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  void clear() {
+    root_ = Node(alloc_);
+    size_ = 0;
+  }
+
+  // Inserts value under the key [first, last) if the key is not already
+  // present.  Returns a pointer to the value stored under the key, valid until
+  // the next insert, and whether the insertion took place.
+  template <typename Iterator>
+  std::pair<Value *, bool> insert(Iterator first, Iterator last, Value value) {
+    Node *node = &root_;
+    for (;;) {
+      if (first == last) {
+        if (node->value_) {
+          return {node->value_.get_ptr(), false};
+        }
+        node->value_ = std::move(value);
+        ++size_;
+        return {node->value_.get_ptr(), true};
+      }
+      const unsigned char ch = *first;
+      ++first;
+      if (!Test(node->present_, ch)) {
+        auto child = node->children_.emplace(
+            node->children_.begin() + Rank(node->present_, ch), alloc_);
+        Set(node->present_, ch);
+        child->label_.assign(first, last);
+        child->value_ = std::move(value);
+        ++size_;
+        return {child->value_.get_ptr(), true};
+      }
+      Node &child = node->children_[Rank(node->present_, ch)];
+      std::size_t matched = 0;
+      while (matched < child.label_.size() && first != last &&
+             child.label_[matched] == *first) {
+        ++matched;
+        ++first;
+      }
+      if (matched < child.label_.size()) {
+        // The key diverges from (or ends within) the child's label; split the
+        // child into a node holding the common part and a grandchild holding
+        // the rest of the original label.
+        Node rest = std::move(child);
+        child = Node(alloc_);
+        child.label_.assign(rest.label_, 0, matched);
+        const unsigned char rest_ch = rest.label_[matched];
+        rest.label_.erase(0, matched + 1);
+        Set(child.present_, rest_ch);
+        child.children_.emplace_back(std::move(rest));
+      }
+      node = &child;
+    }
+  }
+
+  template <typename Range>
+  std::pair<Value *, bool> insert(const Range &key, Value value) {
+    return insert(std::begin(key), std::end(key), std::move(value));
+  }
+
+  std::pair<Value *, bool> insert(const char *key, Value value) {
+    return insert(key, key + std::char_traits<char>::length(key),
+                  std::move(value));
+  }
+
+  // Returns a pointer to the value stored under the key [first, last), or
+  // nullptr if there is none.  The pointer is valid until the next insert.
+  template <typename Iterator>
+  const Value *find(Iterator first, Iterator last) const {
+    const Node *node = &root_;
+    for (;;) {
+      if (first == last) {
+        return node->value_.get_ptr();
+      }
+      const unsigned char ch = *first;
+      if (!Test(node->present_, ch)) {
+        return nullptr;
+      }
+      ++first;
+      node = &node->children_[Rank(node->present_, ch)];
+      for (const char label_ch : node->label_) {
+        if (first == last || *first != label_ch) {
+          return nullptr;
         }
+        ++first;
       }
     }
+  }
 
-    Bitset present_;
-    std::vector<Node> children_;
-  };
+  template <typename Iterator> Value *find(Iterator first, Iterator last) {
+    return const_cast<Value *>(
+        static_cast<const Trie *>(this)->find(first, last));
+  }
+
+  template <typename Range> const Value *find(const Range &key) const {
+    return find(std::begin(key), std::end(key));
+  }
+
+  template <typename Range> Value *find(const Range &key) {
+    return find(std::begin(key), std::end(key));
+  }
+
+  const Value *find(const char *key) const {
+    return find(key, key + std::char_traits<char>::length(key));
+  }
 
+  Value *find(const char *key) {
+    return find(key, key + std::char_traits<char>::length(key));
+  }
+
+private:
   Allocator alloc_;
   Node root_;
+  std::size_t size_ = 0;
 };
 
 } // namespace container
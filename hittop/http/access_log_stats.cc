@@ -0,0 +1,203 @@
+// Counts requests per URI path in an access log (Common or Combined Log
+// Format), e.g.:
+//
+//   127.0.0.1 - frank [10/Oct/2000:13:55:36 -0700] "GET /a.gif HTTP/1.0" 200 2
+//
+// The log is memory-mapped and split into line-aligned chunks, which are
+// parsed concurrently on a pool of threads; the request line of each entry is
+// parsed with the HTTP grammar directly out of the mapping, and the URI is
+// stored as a uri::CompactUri, so nothing is copied or allocated per line
+// except when a path is seen for the first time in a chunk.  Per-chunk counts
+// are merged in file order (see concurrent/line_chunks.h), so the output does
+// not depend on thread scheduling.
+//
+// Also reports the parsing throughput, which makes it a convenient benchmark
+// for the URI grammar on real-world inputs.
+//
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/concurrent/line_chunks.h"
+#include "hittop/http/grammar.h"
+#include "hittop/parser/parser.h"
+#include "hittop/uri/compact_uri.h"
+#include "hittop/uri/uri_parse_visitor.h"
+#include "hittop/util/first_match.h"
+#include "hittop/util/hash.h"
+#include "hittop/util/scope_exit.h"
+
+namespace {
+
+using namespace hittop;
+
+using Range = boost::iterator_range<const char *>;
+
+using PathCounts =
+    std::unordered_map<Range, std::size_t, util::RangeHash<Range>>;
+
+// The quoted request line of a log entry; the same as http::grammar's
+// Request_Line, but terminated by the closing quote instead of CRLF.
+using QuotedRequestLine =
+    parser::Concat<http::grammar::Method, http::grammar::SP,
+                   http::grammar::Request_URI, http::grammar::SP,
+                   http::grammar::HTTP_Version, parser::Literal<'"'>>;
+
+constexpr std::size_t kMinChunkSize = 1 << 20;
+
+const Range kNoPath(nullptr, nullptr);
+
+struct ChunkStats {
+  PathCounts paths;
+  std::size_t lines = 0;
+  std::size_t bad_lines = 0;
+};
+
+// Parses the request line of one log entry and returns its path, kNoPath if
+// the request URI has no path (e.g., "*"), or boost::none if the line is not
+// a valid entry.
+boost::optional<Range> ParseLogLine(const char *first, const char *last) {
+  first = std::find(first, last, '"');
+  if (first == last) {
+    return boost::none;
+  }
+  ++first;
+  using Uri = uri::CompactUri<const char *>;
+  Uri uri;
+  auto result = parser::Parse<QuotedRequestLine>(
+      Range(first, last),
+      util::FirstMatchRef(
+          [&uri](http::grammar::Request_URI, auto &&run_parser) {
+            run_parser(uri::UriFieldParseVisitor<Uri>(&uri));
+          }));
+  if (!result.ok()) {
+    return boost::none;
+  }
+  auto path = uri.path();
+  return path ? *path : kNoPath;
+}
+
+void ParseChunk(const char *first, const char *last, ChunkStats *stats) {
+  while (first != last) {
+    const char *eol = std::find(first, last, '\n');
+    if (eol != first) {
+      ++stats->lines;
+      auto path = ParseLogLine(first, eol);
+      if (path) {
+        ++stats->paths[*path];
+      } else {
+        ++stats->bad_lines;
+      }
+    }
+    first = (eol == last) ? eol : eol + 1;
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " LOG_FILE [THREADS [TOP_PATHS]]"
+              << std::endl;
+    return 1;
+  }
+  const char *const filename = argv[1];
+  const unsigned num_threads =
+      argc > 2 ? boost::lexical_cast<unsigned>(argv[2])
+               : std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t top_paths =
+      argc > 3 ? boost::lexical_cast<std::size_t>(argv[3]) : 20;
+
+  const int fd = ::open(filename, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open " << filename << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  util::ScopeExit close_fd([fd]() { ::close(fd); });
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    std::cerr << "Could not stat " << filename << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  const std::size_t size = st.st_size;
+  if (size == 0) {
+    std::cout << "Ok total: 0usec lines: 0 bad: 0" << std::endl;
+    return 0;
+  }
+  void *const mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Could not map " << filename << ": " << std::strerror(errno)
+              << std::endl;
+    return 1;
+  }
+  util::ScopeExit unmap([mapping, size]() { ::munmap(mapping, size); });
+  ::madvise(mapping, size, MADV_SEQUENTIAL);
+
+  const char *const data = static_cast<const char *>(mapping);
+  const auto chunks = concurrent::SplitLines(data, data + size,
+                                             num_threads * 4, kMinChunkSize);
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  ChunkStats total;
+  concurrent::ForEachLineChunk<ChunkStats>(
+      chunks, num_threads, ParseChunk,
+      [&total](std::unique_ptr<ChunkStats> stats) {
+        total.lines += stats->lines;
+        total.bad_lines += stats->bad_lines;
+        for (const auto &entry : stats->paths) {
+          total.paths[entry.first] += entry.second;
+        }
+      });
+
+  auto stop = std::chrono::high_resolution_clock::now();
+  double usec =
+      std::chrono::duration_cast<std::chrono::microseconds>(stop - start)
+          .count();
+
+  std::vector<std::pair<Range, std::size_t>> sorted(total.paths.begin(),
+                                                    total.paths.end());
+  const std::size_t shown = std::min(top_paths, sorted.size());
+  std::partial_sort(sorted.begin(), sorted.begin() + shown, sorted.end(),
+                    [](const auto &a, const auto &b) {
+                      return a.second > b.second ||
+                             (a.second == b.second && a.first < b.first);
+                    });
+  for (std::size_t i = 0; i < shown; ++i) {
+    const Range &path = sorted[i].first;
+    std::cout << sorted[i].second << "\t"
+              << (path.begin() == nullptr
+                      ? std::string("(none)")
+                      : std::string(path.begin(), path.end()))
+              << std::endl;
+  }
+  std::cout << "Ok "
+            << "total: " << usec << "usec "
+            << "lines: " << total.lines << " "
+            << "bad: " << total.bad_lines << " "
+            << "paths: " << total.paths.size() << " "
+            << "chunks: " << chunks.size() << " "
+            << "threads: " << num_threads << " "
+            << "GB/s: " << static_cast<double>(size) / 1000.0 / usec
+            << std::endl;
+  return 0;
+}
@@ -85,15 +85,16 @@ struct MethodNameVisitor : boost::static_visitor<Range> {
 template <typename Range, //
           typename SubRange = DefaultSubRange<Range>,
           template <typename> class Sequence = DefaultArenaVector,
-          typename InPlaceFactoryBuilder = DefaultInPlaceFactoryBuilder>
+          typename InPlaceFactoryBuilder = DefaultInPlaceFactoryBuilder,
+          typename UriType = uri::BasicUri<
+              SubRange, SubRange, DefaultArenaVector<SubRange>,
+              DefaultArenaMap<SubRange, SubRange>, InPlaceFactoryBuilder>>
 class BasicRequest {
 public:
   using FieldName = SubRange;
   using FieldValue = SubRange;
 
-  using Uri =
-      uri::BasicUri<SubRange, SubRange, DefaultArenaVector<SubRange>,
-                    DefaultArenaMap<SubRange, SubRange>, InPlaceFactoryBuilder>;
+  using Uri = UriType;
 
   template <typename... Args> void assign(Args &&... args) {
     range_ = builder_.template in_place<Range>(std::forward<Args>(args)...);
@@ -75,4 +75,24 @@ TEST(ParseRequestTest, ChromeRequest) {
   EXPECT_EQ(RangeToString(request.header(6).value), "en-US,en;q=0.8");
 }
 
+TEST(ParseRequestTest, CompactRequest) {
+  using CompactRequest =
+      ::hittop::http::CompactRequest<std::string::const_iterator>;
+  const std::string input = LoadTestData("/hittop/http/chrome_request2.bin");
+  CompactRequest request;
+  ::hittop::http::RequestParseVisitor<CompactRequest> v(&request);
+  auto result = Parse<http::Request>(input, v);
+  EXPECT_TRUE(result.ok());
+  EXPECT_LE(sizeof(request.uri()), 64u);
+  EXPECT_EQ(RangeToString(request.uri()), "/path/to/resource?foo=bar#myfrag");
+  EXPECT_FALSE(request.uri().scheme());
+  EXPECT_FALSE(request.uri().host());
+  EXPECT_FALSE(request.uri().port());
+  EXPECT_EQ(RangeToString(*request.uri().path()), "/path/to/resource");
+  EXPECT_EQ(request.uri().path_segments()->size(), 3U);
+  EXPECT_EQ(RangeToString(*request.uri().query()), "foo=bar");
+  EXPECT_EQ(RangeToString(*request.uri().fragment()), "myfrag");
+  EXPECT_EQ(request.headers().size(), 7U);
+}
+
 } // namespace
@@ -2,6 +2,7 @@
 #define HITTOP_HTTP_REQUEST_H
 
 #include "hittop/http/basic_request.h"
+#include "hittop/uri/compact_uri.h"
 
 namespace hittop {
 namespace http {
@@ -9,6 +10,14 @@ namespace http {
 template <typename Iterator>
 using ZeroCopyRequest = BasicRequest<boost::iterator_range<Iterator>>;
 
+// Like ZeroCopyRequest, but stores the request URI as a uri::CompactUri.
+template <typename Iterator>
+using CompactRequest =
+    BasicRequest<boost::iterator_range<Iterator>,
+                 DefaultSubRange<boost::iterator_range<Iterator>>,
+                 DefaultArenaVector, DefaultInPlaceFactoryBuilder,
+                 uri::CompactUri<Iterator>>;
+
 } // namespace http
 } // namespace hittop
 
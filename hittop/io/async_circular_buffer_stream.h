@@ -2,43 +2,50 @@
 #define HITTOP_IO_ASYNC_CIRCULAR_BUFFER_STREAM_H
 
 #include <assert.h>
-#include <functional>
 #include <mutex>
+#include <utility>
 
 #include "boost/asio/error.hpp"
 
 #include "hittop/io/async_const_buffer_stream.h"
 #include "hittop/io/async_mutable_buffer_stream.h"
 #include "hittop/io/circular_buffer.h"
+#include "hittop/io/small_handler.h"
 
 namespace hittop {
 namespace io {
 
-class AsyncCircularBufferStream
-    : public AsyncMutableBufferStream<AsyncCircularBufferStream>,
-      public AsyncConstBufferStream<AsyncCircularBufferStream> {
-
-  using Action = std::function<void()>;
-
+// A stream over a Buffer with the interface of CircularBuffer, guarded by a
+// mutex.  With a MirroredCircularBuffer (see mirrored_circular_buffer.h),
+// fetched data and prepared space are always a single contiguous buffer.
+template <typename Buffer = CircularBuffer>
+class BasicAsyncCircularBufferStream
+    : public AsyncMutableBufferStream<BasicAsyncCircularBufferStream<Buffer>>,
+      public AsyncConstBufferStream<BasicAsyncCircularBufferStream<Buffer>> {
 public:
-  using const_buffers_type = CircularBuffer::const_buffers_type;
+  using const_buffers_type = typename Buffer::const_buffers_type;
 
-  using mutable_buffers_type = CircularBuffer::mutable_buffers_type;
+  using mutable_buffers_type = typename Buffer::mutable_buffers_type;
 
+  // Parked handlers are kept in a SmallHandler, so any move-only callable is
+  // accepted, and small ones (or ones with allocation hooks) are kept without
+  // allocating.
   using FetchHandler =
-      std::function<void(const error_code &, const const_buffers_type &)>;
+      SmallHandler<void(const error_code &, const const_buffers_type &)>;
 
   using PrepareHandler =
-      std::function<void(const error_code &, const mutable_buffers_type &)>;
+      SmallHandler<void(const error_code &, const mutable_buffers_type &)>;
 
-  explicit AsyncCircularBufferStream(const int size_log_2 = 12)
+  explicit BasicAsyncCircularBufferStream(const int size_log_2 = 12)
       : buffer_(size_log_2) {}
 
   // Disable copying
-  AsyncCircularBufferStream(const CircularBuffer &) = delete;
-  AsyncCircularBufferStream &operator=(const CircularBuffer &) = delete;
+  BasicAsyncCircularBufferStream(const BasicAsyncCircularBufferStream &) =
+      delete;
+  BasicAsyncCircularBufferStream &
+  operator=(const BasicAsyncCircularBufferStream &) = delete;
 
-  ~AsyncCircularBufferStream() {
+  ~BasicAsyncCircularBufferStream() {
     close_for_read();
     close_for_write();
   }
@@ -53,102 +60,90 @@ public:
     return buffer_.space();
   }
 
-  void async_prepare(std::size_t minimum_size, const PrepareHandler &handler) {
+  template <typename Handler>
+  void async_prepare(std::size_t minimum_size, Handler &&handler) {
     namespace error = boost::asio::error;
 
     if (minimum_size > max_space()) {
       // The requested size is larger than the buffer.
-      handler(error::invalid_argument, {});
+      handler(error::invalid_argument, mutable_buffers_type{});
       return;
     }
 
-    with_mutex_locked([&]() -> Action {
+    error_code ec;
+    mutable_buffers_type buffers;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       if (closed_for_write_) {
         // Tried to write after closing for write.
-        return [&handler]() { handler(error::shut_down, {}); };
+        ec = error::shut_down;
       } else if (closed_for_read_) {
         // Tried to write, but the other side has shut down.
-        return [&handler]() { handler(error::broken_pipe, {}); };
+        ec = error::broken_pipe;
       } else if (write_in_progress_) {
         // There is already a write operation in progress.
-        return [&handler]() { handler(error::already_started, {}); };
+        ec = error::already_started;
       } else {
         write_in_progress_ = true;
         if (buffer_.space() < minimum_size) {
           // Not enough space in the buffer; wait for data to be read.
           minimum_to_prepare_ = minimum_size;
-          prepare_handler_ = handler;
-          return {};
-        } else {
-          // Success!
-          return [ buffers = buffer_.prepare(), &handler ]() {
-            handler({}, buffers);
-          };
+          prepare_handler_ = std::forward<Handler>(handler);
+          return;
         }
+        // Success!
+        buffers = buffer_.prepare();
       }
-    });
+    }
+    handler(ec, buffers);
   }
 
   void commit(const std::size_t byte_count) {
-    with_mutex_locked([&]() -> Action {
+    FetchHandler fetch_handler;
+    const_buffers_type buffers;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       assert(byte_count <= buffer_.space());
       assert(write_in_progress_);
       buffer_.commit(byte_count);
       write_in_progress_ = false;
       if (fetch_handler_ && buffer_.size() >= minimum_to_fetch_) {
-        auto action = [
-          handler = std::move(fetch_handler_), buffers = buffer_.data()
-        ]() {
-          handler({}, buffers);
-        };
-        fetch_handler_ = nullptr;
-        return std::move(action);
-      } else {
-        return {};
+        fetch_handler = std::move(fetch_handler_);
+        read_in_progress_ = true;
+        buffers = buffer_.data();
       }
-    });
+    }
+    if (fetch_handler) {
+      fetch_handler({}, buffers);
+    }
   }
 
   void close_for_write() {
     namespace error = boost::asio::error;
 
-    with_mutex_locked([&]() -> Action {
+    PrepareHandler prepare_handler;
+    FetchHandler fetch_handler;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       if (closed_for_write_) {
-        return {};
+        return;
       }
       closed_for_write_ = true;
-      if (fetch_handler_) {
-        if (prepare_handler_) {
-          auto action = [
-            prepare_handler = std::move(prepare_handler_),
-            fetch_handler = std::move(fetch_handler_)
-          ]() {
-            prepare_handler(error::shut_down, {});
-            fetch_handler(error::eof, {});
-          };
-          prepare_handler_ = nullptr;
-          fetch_handler_ = nullptr;
-          read_in_progress_ = write_in_progress_ = false;
-          return std::move(action);
-        } else {
-          auto action = [fetch_handler = std::move(fetch_handler_)]() {
-            fetch_handler(error::eof, {});
-          };
-          fetch_handler_ = nullptr;
-          read_in_progress_ = false;
-          return std::move(action);
-        }
-      } else if (prepare_handler_) {
-        auto action = [prepare_handler = std::move(prepare_handler_)]() {
-          prepare_handler(error::shut_down, {});
-        };
-        prepare_handler_ = nullptr;
+      if (prepare_handler_) {
+        prepare_handler = std::move(prepare_handler_);
         write_in_progress_ = false;
-        return action;
-      } else {
-        return {};
       }
-    });
+      if (fetch_handler_) {
+        fetch_handler = std::move(fetch_handler_);
+        read_in_progress_ = false;
+      }
+    }
+    if (prepare_handler) {
+      prepare_handler(error::shut_down, {});
+    }
+    if (fetch_handler) {
+      fetch_handler(error::eof, {});
+    }
   }
 
   std::size_t max_size() const {
@@ -161,117 +156,90 @@ public:
     return buffer_.size();
   }
 
-  void async_fetch(std::size_t minimum_size, const FetchHandler &handler) {
+  template <typename Handler>
+  void async_fetch(std::size_t minimum_size, Handler &&handler) {
     namespace error = boost::asio::error;
 
     if (minimum_size > max_size()) {
       // The requested size is larger than the buffer.
-      handler(error::invalid_argument, {});
+      handler(error::invalid_argument, const_buffers_type{});
       return;
     }
 
-    with_mutex_locked([&]() -> Action {
+    error_code ec;
+    const_buffers_type buffers;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       if (closed_for_read_) {
         // Tried to read after closing for read.
-        return [&handler]() { handler(error::shut_down, {}); };
+        ec = error::shut_down;
       } else if (read_in_progress_) {
         // There is already a fetch operation in progress.
-        return [&handler]() { handler(error::already_started, {}); };
+        ec = error::already_started;
       } else if (minimum_size > buffer_.size()) {
         if (closed_for_write_) {
           // Not enough data and closed for write; this operation can never
           // succeed.
-          return [&handler]() { handler(error::eof, {}); };
+          ec = error::eof;
         } else {
           // Not enough data; have to wait.
           read_in_progress_ = true;
           minimum_to_fetch_ = minimum_size;
-          fetch_handler_ = handler;
-          return {};
+          fetch_handler_ = std::forward<Handler>(handler);
+          return;
         }
       } else {
         // Success!
         read_in_progress_ = true;
-        return [ buffers = buffer_.data(), &handler ]() {
-          handler({}, buffers);
-        };
+        buffers = buffer_.data();
       }
-    });
+    }
+    handler(ec, buffers);
   }
 
   void consume(std::size_t byte_count) {
-    with_mutex_locked([&]() -> Action {
+    PrepareHandler prepare_handler;
+    mutable_buffers_type buffers;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       assert(byte_count <= buffer_.size());
       assert(read_in_progress_);
       buffer_.consume(byte_count);
       read_in_progress_ = false;
       if (prepare_handler_ && minimum_to_prepare_ <= buffer_.space()) {
-        auto action = [
-          handler = std::move(prepare_handler_), buffers = buffer_.prepare()
-        ]() {
-          handler({}, buffers);
-        };
-        prepare_handler_ = nullptr;
-        return std::move(action);
-      } else {
-        return {};
+        prepare_handler = std::move(prepare_handler_);
+        buffers = buffer_.prepare();
       }
-    });
+    }
+    if (prepare_handler) {
+      prepare_handler({}, buffers);
+    }
   }
 
   void close_for_read() {
     namespace error = boost::asio::error;
 
-    with_mutex_locked([&]() -> Action {
+    FetchHandler fetch_handler;
+    PrepareHandler prepare_handler;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
       if (closed_for_read_) {
-        return {};
+        return;
       }
-
       closed_for_read_ = true;
-      if (fetch_handler_) {
-        if (prepare_handler_) {
-          auto action = [
-            fetch_handler = std::move(fetch_handler_),
-            prepare_handler = std::move(prepare_handler_)
-          ]() {
-            fetch_handler(error::shut_down, {});
-            prepare_handler(error::broken_pipe, {});
-          };
-          fetch_handler_ = nullptr;
-          prepare_handler_ = nullptr;
-          return std::move(action);
-        } else {
-          auto action = [fetch_handler = std::move(fetch_handler_)]() {
-            fetch_handler(error::shut_down, {});
-          };
-          fetch_handler_ = nullptr;
-          return std::move(action);
-        }
-      } else if (prepare_handler_) {
-        auto action = [prepare_handler = std::move(prepare_handler_)]() {
-          prepare_handler(error::broken_pipe, {});
-        };
-        prepare_handler_ = nullptr;
-        return std::move(action);
-      } else {
-        return {};
-      }
-    });
-  }
-
-private:
-  template <typename F> void with_mutex_locked(F &&f) {
-    decltype(f()) action;
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      action = std::forward<F>(f)();
+      fetch_handler = std::move(fetch_handler_);
+      prepare_handler = std::move(prepare_handler_);
     }
-    if (action) {
-      action();
+    if (fetch_handler) {
+      fetch_handler(error::shut_down, {});
+    }
+    if (prepare_handler) {
+      prepare_handler(error::broken_pipe, {});
     }
   }
 
-  CircularBuffer buffer_;
+private:
+  Buffer buffer_;
   mutable std::mutex mutex_;
   bool write_in_progress_ = false;
   bool read_in_progress_ = false;
@@ -283,6 +251,8 @@ private:
   PrepareHandler prepare_handler_;
 };
 
+using AsyncCircularBufferStream = BasicAsyncCircularBufferStream<>;
+
 } // namespace io
 } // namespace hittop
 
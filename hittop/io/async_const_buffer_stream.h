@@ -14,6 +14,8 @@ namespace io {
 // Requirements:
 //
 //  void async_fetch(std::size_t minimum_size, ConstBuffersHandler);
+//    (Implementations may accept any move-constructible callable, e.g. with
+//    a template, so that handlers need not be copyable.)
 //
 //  std::size_t max_size() const;
 //
@@ -12,6 +12,27 @@
 
 namespace hittop {
 namespace io {
+namespace internal {
+
+// Returns the count bytes of storage starting at offset, as one segment or,
+// if they wrap around the end of storage, two.
+template <typename Buffer, typename Storage>
+boost::container::static_vector<Buffer, 2>
+GetCircularRange(std::size_t offset, std::size_t count, Storage &storage) {
+  assert(count <= storage.size());
+  // When the end of the returned range is before the end of the buffer, just
+  // return a single segment.
+  if (offset + count <= storage.size()) {
+    return {boost::asio::buffer(&storage[offset], count)};
+  } else {
+    // When the end of the returned range is after the physical end of the
+    // buffer, then we must wrap around by returning two segments.
+    return {boost::asio::buffer(&storage[offset], storage.size() - offset),
+            boost::asio::buffer(&storage[0], offset + count - storage.size())};
+  }
+}
+
+} // namespace internal
 
 class CircularBuffer {
 public:
@@ -44,12 +65,14 @@ public:
 
   const_buffers_type data() const {
     assert(write_head_ - read_head_ <= storage_.size());
-    return GetRange<const_buffer>(read_head_ & mask_, size(), storage_);
+    return internal::GetCircularRange<const_buffer>(read_head_ & mask_, size(),
+                                                    storage_);
   }
 
   mutable_buffers_type prepare() {
     assert(write_head_ - read_head_ <= storage_.size());
-    return GetRange<mutable_buffer>(write_head_ & mask_, space(), storage_);
+    return internal::GetCircularRange<mutable_buffer>(write_head_ & mask_,
+                                                      space(), storage_);
   }
 
   bool empty() const { return read_head_ == write_head_; }
@@ -62,23 +85,6 @@ public:
   }
 
 private:
-  template <typename Buffer, typename Storage>
-  static boost::container::static_vector<Buffer, 2>
-  GetRange(std::size_t offset, std::size_t count, Storage &storage) {
-    assert(count <= storage.size());
-    // When the end of the returned range is before the end of the buffer, just
-    // return a single segment.
-    if (offset + count <= storage.size()) {
-      return {boost::asio::buffer(&storage[offset], count)};
-    } else {
-      // When the end of the returned range is after the physical end of the
-      // buffer, then we must wrap around by returning two segments.
-      return {
-          boost::asio::buffer(&storage[offset], storage.size() - offset),
-          boost::asio::buffer(&storage[0], offset + count - storage.size())};
-    }
-  }
-
   std::vector<char> storage_;
   std::size_t mask_ = storage_.size() - 1;
   std::size_t read_head_ = 0;
@@ -0,0 +1,148 @@
+// Compares AsyncCircularBufferStream (a mutex) with SpscCircularBufferStream
+// (atomic heads) between two threads:
+//
+//   ping_pong  one thread sends a small message through one stream, and the
+//              other echoes it back through a second stream; reports the
+//              time per round trip.
+//   stream     one thread writes as fast as it can and the other reads;
+//              reports MB/s.
+//
+// Each thread waits for its handlers by spinning, so that the cost measured
+// is that of the streams rather than of waking threads.
+//
+// usage: circular_buffer_stream_bench [ITERATIONS]
+//
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/io/async_circular_buffer_stream.h"
+#include "hittop/io/spsc_circular_buffer_stream.h"
+#include "hittop/util/bench_util.h"
+
+namespace io = hittop::io;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+constexpr std::size_t kMessageSize = 64;
+constexpr std::size_t kChunkSize = 1 << 20;
+
+// Waits for space to write at least minimum bytes, and copies up to size
+// bytes of data into it.  Returns the number of bytes written.
+template <typename Stream>
+std::size_t Write(Stream *stream, std::size_t minimum, const char *data,
+                  std::size_t size) {
+  std::atomic<bool> done{false};
+  std::size_t written = 0;
+  stream->async_prepare(
+      minimum, [&](const io::error_code &ec,
+                   const typename Stream::mutable_buffers_type &buffers) {
+        if (!ec) {
+          written = boost::asio::buffer_copy(
+              buffers, boost::asio::buffer(data, size));
+        }
+        done.store(true, std::memory_order_release);
+      });
+  while (!done.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  stream->commit(written);
+  return written;
+}
+
+// Waits for at least minimum bytes, and consumes up to size of them into
+// out.  Returns the number of bytes read.
+template <typename Stream>
+std::size_t Read(Stream *stream, std::size_t minimum, char *out,
+                 std::size_t size) {
+  std::atomic<bool> done{false};
+  std::size_t read = 0;
+  stream->async_fetch(
+      minimum, [&](const io::error_code &ec,
+                   const typename Stream::const_buffers_type &buffers) {
+        if (!ec) {
+          read = boost::asio::buffer_copy(boost::asio::buffer(out, size),
+                                          buffers);
+        }
+        done.store(true, std::memory_order_release);
+      });
+  while (!done.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  stream->consume(read);
+  return read;
+}
+
+template <typename Stream>
+void PingPong(const std::string &name, unsigned count) {
+  Stream ping;
+  Stream pong;
+  std::thread echo([&]() {
+    char message[kMessageSize];
+    for (unsigned i = 0; i < count; ++i) {
+      Read(&ping, kMessageSize, message, kMessageSize);
+      Write(&pong, kMessageSize, message, kMessageSize);
+    }
+  });
+  char message[kMessageSize] = {};
+  const double usec = TimeUsec([&]() {
+    for (unsigned i = 0; i < count; ++i) {
+      Write(&ping, kMessageSize, message, kMessageSize);
+      Read(&pong, kMessageSize, message, kMessageSize);
+    }
+  });
+  echo.join();
+  Report(name + "/ping_pong", usec, count, 2 * kMessageSize);
+}
+
+template <typename Stream>
+void Throughput(const std::string &name, unsigned count) {
+  Stream stream;
+  const std::size_t total = std::size_t{count} * kChunkSize;
+  std::thread reader([&]() {
+    static char out[kChunkSize];
+    for (std::size_t received = 0; received < total;) {
+      received += Read(&stream, 1, out, sizeof(out));
+    }
+  });
+  static const std::string data(kChunkSize, 'x');
+  const double usec = TimeUsec([&]() {
+    for (std::size_t sent = 0; sent < total;) {
+      sent += Write(&stream, 1, data.data(),
+                    std::min(data.size(), total - sent));
+    }
+    reader.join();
+  });
+  Report(name + "/stream", usec, count, kChunkSize);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100000;
+
+  const int kRuns = 3;
+  for (int j = 0; j < kRuns; ++j) {
+    PingPong<io::AsyncCircularBufferStream>("mutex", count);
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    PingPong<io::SpscCircularBufferStream>("spsc", count);
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    Throughput<io::AsyncCircularBufferStream>("mutex", count / 1000 + 1);
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    Throughput<io::SpscCircularBufferStream>("spsc", count / 1000 + 1);
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include "hittop/io/mirrored_circular_buffer.h"
+#include "hittop/io/mirrored_circular_buffer.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <string>
+
+#include "boost/asio/buffer.hpp"
+
+#include "hittop/io/async_circular_buffer_stream.h"
+
+namespace {
+
+using ::hittop::io::BasicAsyncCircularBufferStream;
+using ::hittop::io::MirroredCircularBuffer;
+using ::hittop::io::error_code;
+
+void Write(MirroredCircularBuffer *buffer, const std::string &bytes) {
+  ASSERT_LE(bytes.size(), buffer->space());
+  std::memcpy(buffer->write_pointer(), bytes.data(), bytes.size());
+  buffer->commit(bytes.size());
+}
+
+std::string Data(const MirroredCircularBuffer &buffer) {
+  return std::string(buffer.read_pointer(), buffer.size());
+}
+
+TEST(MirroredCircularBufferTest, RoundsUpToPage) {
+  MirroredCircularBuffer buffer(3);
+  EXPECT_GE(buffer.max_size(), 4096u);
+  EXPECT_EQ(buffer.space(), buffer.max_size());
+  EXPECT_TRUE(buffer.empty());
+}
+
+TEST(MirroredCircularBufferTest, WrappedDataIsContiguous) {
+  MirroredCircularBuffer buffer(16);
+  const std::size_t capacity = buffer.max_size();
+  ASSERT_EQ(capacity, 1u << 16);
+
+  // Move the heads to just before the end of the storage.
+  buffer.commit(capacity - 10);
+  buffer.consume(capacity - 10);
+  EXPECT_TRUE(buffer.empty());
+
+  std::string bytes;
+  for (int i = 0; i < 1000; ++i) {
+    bytes += static_cast<char>('a' + i % 26);
+  }
+  Write(&buffer, bytes);
+  EXPECT_EQ(Data(buffer), bytes);
+  EXPECT_EQ(boost::asio::buffer_size(buffer.data()), bytes.size());
+  EXPECT_EQ(boost::asio::buffer_cast<const char *>(buffer.data()[0]),
+            buffer.read_pointer());
+
+  // The bytes past the end of the storage are at its start as well.
+  const char *const p = buffer.read_pointer();
+  EXPECT_EQ(std::string(p + 10 - capacity, 990), bytes.substr(10));
+  buffer.consume(10);
+  EXPECT_EQ(buffer.read_pointer(), p + 10 - capacity);
+  EXPECT_EQ(Data(buffer), bytes.substr(10));
+
+  // Fill it completely, across the end again.
+  Write(&buffer, std::string(buffer.space(), 'z'));
+  EXPECT_TRUE(buffer.full());
+  EXPECT_EQ(boost::asio::buffer_size(buffer.prepare()), 0u);
+  const std::string all = Data(buffer);
+  EXPECT_EQ(all.size(), capacity);
+  EXPECT_EQ(all.substr(0, 990), bytes.substr(10));
+  EXPECT_EQ(all.substr(990), std::string(capacity - 990, 'z'));
+}
+
+TEST(MirroredCircularBufferTest, PreparedSpaceIsContiguous) {
+  MirroredCircularBuffer buffer(12);
+  const std::size_t capacity = buffer.max_size();
+  buffer.commit(capacity / 2);
+  buffer.consume(capacity / 2);
+
+  auto space = buffer.prepare();
+  EXPECT_EQ(boost::asio::buffer_size(space), capacity);
+  char *const first = boost::asio::buffer_cast<char *>(space[0]);
+  EXPECT_EQ(first, buffer.write_pointer());
+  std::memset(first, 'x', capacity);
+  buffer.commit(capacity);
+  EXPECT_EQ(Data(buffer), std::string(capacity, 'x'));
+}
+
+TEST(MirroredCircularBufferTest, StreamDataIsContiguous) {
+  using Stream = BasicAsyncCircularBufferStream<MirroredCircularBuffer>;
+  Stream stream(12);
+  const std::size_t capacity = stream.max_size();
+  const std::string bytes(capacity - 10, 'a');
+
+  // Fill, then consume, most of the buffer, so the next write wraps around.
+  for (int i = 0; i < 2; ++i) {
+    stream.async_prepare(
+        bytes.size(),
+        [&stream, &bytes](const error_code &ec,
+                          const Stream::mutable_buffers_type &space) {
+          ASSERT_FALSE(ec);
+          EXPECT_EQ(boost::asio::buffer_size(space), stream.max_size() -
+                                                         stream.size());
+          stream.commit(
+              boost::asio::buffer_copy(space, boost::asio::buffer(bytes)));
+        });
+    bool fetched = false;
+    stream.async_fetch(
+        bytes.size(), [&stream, &bytes, &fetched](
+                          const error_code &ec,
+                          const Stream::const_buffers_type &data) {
+          ASSERT_FALSE(ec);
+          // One buffer, even once the data wraps around the end.
+          ASSERT_EQ(boost::asio::buffer_size(data), bytes.size());
+          EXPECT_EQ(std::string(boost::asio::buffer_cast<const char *>(data[0]),
+                                bytes.size()),
+                    bytes);
+          stream.consume(bytes.size());
+          fetched = true;
+        });
+    EXPECT_TRUE(fetched);
+  }
+  EXPECT_EQ(stream.size(), 0u);
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+// A circular buffer whose contents are always contiguous in memory.
+//
+// MirroredCircularBuffer maps the same physical pages twice, back to back, so
+// that the byte at offset max_size() + i is the byte at offset i.  Any window
+// of up to max_size() bytes starting within the first mapping is therefore
+// contiguous, and data() and prepare() always return exactly one buffer where
+// CircularBuffer returns two once the region wraps around.  A parser can be
+// handed [read_pointer(), read_pointer() + size()) directly, without copying
+// or handling segmented input.
+//
+// BasicAsyncCircularBufferStream<MirroredCircularBuffer> is a stream over it.
+// SpscCircularBufferStream keeps its own storage and atomic heads, and always
+// works on a plain circular region.
+//
+// The storage is a memfd (on Linux; a POSIX shared memory object elsewhere),
+// and its size is rounded up to a multiple of the page size.
+//
+#ifndef HITTOP_IO_MIRRORED_CIRCULAR_BUFFER_H
+#define HITTOP_IO_MIRRORED_CIRCULAR_BUFFER_H
+
+#include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/container/static_vector.hpp"
+
+#include "hittop/io/types.h"
+
+namespace hittop {
+namespace io {
+
+class MirroredCircularBuffer {
+public:
+  // Always a single buffer, but default-constructible (unlike
+  // mutable_buffers_1), as the buffer streams need.
+  using mutable_buffers_type = //
+      boost::container::static_vector<mutable_buffer, 1>;
+
+  using const_buffers_type = //
+      boost::container::static_vector<const_buffer, 1>;
+
+  // The size is 2^size_log_2 bytes, or one page if that is larger.  Throws
+  // std::system_error if the memory cannot be mapped.
+  explicit MirroredCircularBuffer(const int size_log_2)
+      : size_(RoundUpToPage(std::size_t{1} << size_log_2)) {
+    const int fd = CreateFile(size_);
+    // Reserve twice the address space, then map the file over each half.
+    void *const base =
+        mmap(nullptr, 2 * size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+      const int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category(), "mmap");
+    }
+    storage_ = static_cast<char *>(base);
+    for (int i = 0; i < 2; ++i) {
+      if (mmap(storage_ + i * size_, size_, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        const int error = errno;
+        close(fd);
+        munmap(storage_, 2 * size_);
+        throw std::system_error(error, std::system_category(), "mmap");
+      }
+    }
+    // The mappings keep the pages alive.
+    close(fd);
+  }
+
+  MirroredCircularBuffer(const MirroredCircularBuffer &) = delete;
+  MirroredCircularBuffer &operator=(const MirroredCircularBuffer &) = delete;
+
+  ~MirroredCircularBuffer() { munmap(storage_, 2 * size_); }
+
+  void commit(const std::size_t byte_count) {
+    assert(byte_count <= space());
+    write_head_ += byte_count;
+  }
+
+  void consume(const std::size_t byte_count) {
+    assert(byte_count <= size());
+    read_head_ += byte_count;
+  }
+
+  std::size_t max_size() const { return size_; }
+
+  std::size_t size() const { return write_head_ - read_head_; }
+
+  std::size_t space() const { return max_size() - size(); }
+
+  // The first of the size() bytes of data, which are contiguous.
+  const char *read_pointer() const {
+    return storage_ + (read_head_ & (size_ - 1));
+  }
+
+  // The first of the space() bytes free for writing, which are contiguous.
+  char *write_pointer() { return storage_ + (write_head_ & (size_ - 1)); }
+
+  const_buffers_type data() const {
+    return {const_buffer(read_pointer(), size())};
+  }
+
+  mutable_buffers_type prepare() {
+    return {mutable_buffer(write_pointer(), space())};
+  }
+
+  bool empty() const { return read_head_ == write_head_; }
+
+  bool full() const { return size() == size_; }
+
+private:
+  static std::size_t RoundUpToPage(std::size_t size) {
+    const std::size_t page = sysconf(_SC_PAGESIZE);
+    return size < page ? page : size;
+  }
+
+  // Returns a descriptor for a new, unnamed file of the given size.
+  static int CreateFile(std::size_t size) {
+#if defined(__linux__)
+    const int fd = memfd_create("hittop-circular-buffer", MFD_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::system_category(), "memfd_create");
+    }
+#else
+    static std::atomic<unsigned> counter{0};
+    const std::string name = "/hittop-circular-buffer-" +
+                             std::to_string(getpid()) + "-" +
+                             std::to_string(counter++);
+    const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+      throw std::system_error(errno, std::system_category(), "shm_open");
+    }
+    shm_unlink(name.c_str());
+#endif
+    if (ftruncate(fd, size) != 0) {
+      const int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category(), "ftruncate");
+    }
+    return fd;
+  }
+
+  const std::size_t size_;
+  char *storage_;
+  std::size_t read_head_ = 0;
+  std::size_t write_head_ = 0;
+};
+
+} // namespace io
+} // namespace hittop
+
+#endif // HITTOP_IO_MIRRORED_CIRCULAR_BUFFER_H
@@ -0,0 +1,206 @@
+#include "hittop/io/small_handler.h"
+#include "hittop/io/small_handler.h"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+
+#include "hittop/io/async_circular_buffer_stream.h"
+#include "hittop/io/spsc_circular_buffer_stream.h"
+
+namespace {
+
+using ::hittop::io::AsyncCircularBufferStream;
+using ::hittop::io::SmallHandler;
+using ::hittop::io::SpscCircularBufferStream;
+using ::hittop::io::error_code;
+
+// Memory for one handler at a time, which counts its uses.
+struct Arena {
+  alignas(std::max_align_t) char bytes[256];
+  bool in_use = false;
+  int allocations = 0;
+};
+
+// A handler too large to be stored inline, which draws its memory from an
+// Arena through the allocation hooks.
+struct BigHandler {
+  Arena *arena;
+  int *calls;
+  char payload[128];
+
+  void operator()(int n) { *calls += n; }
+};
+
+void *hittop_handler_allocate(std::size_t size, BigHandler *handler) {
+  Arena *const arena = handler->arena;
+  EXPECT_FALSE(arena->in_use);
+  EXPECT_LE(size, sizeof(arena->bytes));
+  arena->in_use = true;
+  ++arena->allocations;
+  return arena->bytes;
+}
+
+void hittop_handler_deallocate(void *p, std::size_t, BigHandler *handler) {
+  Arena *const arena = handler->arena;
+  EXPECT_EQ(p, arena->bytes);
+  arena->in_use = false;
+}
+
+TEST(SmallHandlerTest, Empty) {
+  SmallHandler<void(int)> handler;
+  EXPECT_FALSE(handler);
+  handler = nullptr;
+  EXPECT_FALSE(handler);
+}
+
+TEST(SmallHandlerTest, InvokesOnce) {
+  int total = 0;
+  SmallHandler<void(int)> handler = [&total](int n) { total += n; };
+  ASSERT_TRUE(handler);
+  handler(3);
+  EXPECT_EQ(total, 3);
+  EXPECT_FALSE(handler);
+}
+
+TEST(SmallHandlerTest, MoveOnly) {
+  std::unique_ptr<int> value(new int(7));
+  int *const raw = value.get();
+  int seen = 0;
+  SmallHandler<void(int)> handler = [ value = std::move(value), &seen ](
+      int n) { seen = *value + n; };
+  EXPECT_FALSE(value);
+
+  SmallHandler<void(int)> moved = std::move(handler);
+  EXPECT_FALSE(handler);
+  ASSERT_TRUE(moved);
+  EXPECT_EQ(*raw, 7);
+  moved(1);
+  EXPECT_EQ(seen, 8);
+}
+
+TEST(SmallHandlerTest, DestroysWithoutInvoking) {
+  std::shared_ptr<int> value = std::make_shared<int>(0);
+  {
+    SmallHandler<void()> handler = [value]() {};
+    EXPECT_EQ(value.use_count(), 2);
+    handler.reset();
+    EXPECT_EQ(value.use_count(), 1);
+    handler = [value]() {};
+    EXPECT_EQ(value.use_count(), 2);
+  }
+  EXPECT_EQ(value.use_count(), 1);
+}
+
+TEST(SmallHandlerTest, LargeHandlerUsesHooks) {
+  Arena arena;
+  int calls = 0;
+  SmallHandler<void(int)> handler = BigHandler{&arena, &calls, {}};
+  EXPECT_EQ(arena.allocations, 1);
+  EXPECT_TRUE(arena.in_use);
+
+  // Moving a handler that is not inline moves only the pointer.
+  SmallHandler<void(int)> moved = std::move(handler);
+  EXPECT_EQ(arena.allocations, 1);
+  EXPECT_TRUE(arena.in_use);
+
+  moved(2);
+  EXPECT_EQ(calls, 2);
+  EXPECT_FALSE(arena.in_use);
+
+  SmallHandler<void(int)> dropped = BigHandler{&arena, &calls, {}};
+  EXPECT_EQ(arena.allocations, 2);
+  dropped.reset();
+  EXPECT_FALSE(arena.in_use);
+}
+
+// Reads a stream until eof, issuing each fetch from the handler of the last;
+// large enough to be stored through the hooks.
+struct ChainedReader {
+  AsyncCircularBufferStream *stream;
+  Arena *arena;
+  std::string *out;
+  char padding[96];
+
+  void operator()(const error_code &ec,
+                  const AsyncCircularBufferStream::const_buffers_type &data) {
+    if (ec) {
+      return;
+    }
+    const std::size_t size = boost::asio::buffer_size(data);
+    for (const auto &buffer : data) {
+      out->append(boost::asio::buffer_cast<const char *>(buffer),
+                  boost::asio::buffer_size(buffer));
+    }
+    stream->consume(size);
+    stream->async_fetch(1, std::move(*this));
+  }
+};
+
+void *hittop_handler_allocate(std::size_t, ChainedReader *handler) {
+  EXPECT_FALSE(handler->arena->in_use);
+  handler->arena->in_use = true;
+  ++handler->arena->allocations;
+  return handler->arena->bytes;
+}
+
+void hittop_handler_deallocate(void *, std::size_t, ChainedReader *handler) {
+  handler->arena->in_use = false;
+}
+
+TEST(SmallHandlerTest, SteadyStateReadReusesMemory) {
+  AsyncCircularBufferStream stream(4);
+  Arena arena;
+  std::string out;
+  stream.async_fetch(1, ChainedReader{&stream, &arena, &out, {}});
+  for (int i = 0; i < 100; ++i) {
+    stream.async_prepare(
+        1, [&stream](const error_code &ec,
+                     const AsyncCircularBufferStream::mutable_buffers_type &b) {
+          ASSERT_FALSE(ec);
+          stream.commit(
+              boost::asio::buffer_copy(b, boost::asio::buffer("abc", 3)));
+        });
+  }
+  // Each parked fetch used the arena, and released it before the next.
+  EXPECT_EQ(arena.allocations, 100 + 1);
+  EXPECT_TRUE(arena.in_use);
+  stream.close_for_write();
+  EXPECT_FALSE(arena.in_use);
+  EXPECT_EQ(out.size(), 300u);
+}
+
+TEST(SmallHandlerTest, StreamsAcceptMoveOnlyHandlers) {
+  SpscCircularBufferStream stream(4);
+  std::unique_ptr<int> token(new int(1));
+  std::string out;
+  stream.async_fetch(
+      3, [ token = std::move(token), &stream, &out ](
+             const error_code &ec,
+             const SpscCircularBufferStream::const_buffers_type &data) {
+        ASSERT_FALSE(ec);
+        ASSERT_TRUE(token);
+        for (const auto &buffer : data) {
+          out.append(boost::asio::buffer_cast<const char *>(buffer),
+                     boost::asio::buffer_size(buffer));
+        }
+        stream.consume(boost::asio::buffer_size(data));
+      });
+  EXPECT_TRUE(out.empty());
+  stream.async_prepare(
+      3, [&stream](const error_code &ec,
+                   const SpscCircularBufferStream::mutable_buffers_type &b) {
+        ASSERT_FALSE(ec);
+        stream.commit(
+            boost::asio::buffer_copy(b, boost::asio::buffer("xyz", 3)));
+      });
+  EXPECT_EQ(out, "xyz");
+  EXPECT_EQ(stream.size(), 0u);
+}
+
+} // namespace
@@ -0,0 +1,233 @@
+// Move-only, allocation-free storage for completion handlers.
+//
+// A parked stream operation has to keep its handler until it completes.
+// std::function needs the handler to be copyable, and allocates whenever it
+// is larger than a couple of pointers.  SmallHandler<void(Args...)> instead
+// stores any move-constructible callable of up to kInlineSize bytes inside
+// itself, with a single indirect call to invoke it.
+//
+// Larger handlers are placed in memory obtained through a hook, as with the
+// Asio handler allocation hooks: the functions
+//
+//   void *hittop_handler_allocate(std::size_t size, Handler *handler);
+//   void hittop_handler_deallocate(void *p, std::size_t size,
+//                                  Handler *handler);
+//
+// are looked up by argument-dependent lookup, and default to operator new and
+// delete.  A handler can overload them to draw from memory that it owns (e.g.
+// a buffer that is reused by each read of a connection), so that even large
+// handlers do not allocate in a steady-state loop.  As in Asio, the memory is
+// released before the handler is invoked, so the handler may start the next
+// operation with the same memory.
+//
+// A handler that wraps another (e.g. the handler of a composed operation,
+// which calls the user's callback when it is done) should define hooks that
+// forward to the wrapped one through AllocateHandler and DeallocateHandler, so
+// that the user's hooks are used for the whole chain; see json::AsyncParse.
+//
+// Like an Asio completion handler, a SmallHandler is invoked at most once:
+// calling it leaves it empty.
+//
+#ifndef HITTOP_IO_SMALL_HANDLER_H
+#define HITTOP_IO_SMALL_HANDLER_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace hittop {
+namespace io {
+
+// The default allocation hooks.
+inline void *hittop_handler_allocate(std::size_t size, ...) {
+  return ::operator new(size);
+}
+
+inline void hittop_handler_deallocate(void *p, std::size_t, ...) {
+  ::operator delete(p);
+}
+
+// Call the hooks for handler: its own, found by argument-dependent lookup,
+// or else the defaults.
+template <typename Handler>
+void *AllocateHandler(std::size_t size, Handler *handler) {
+  using ::hittop::io::hittop_handler_allocate;
+  return hittop_handler_allocate(size, handler);
+}
+
+template <typename Handler>
+void DeallocateHandler(void *p, std::size_t size, Handler *handler) {
+  using ::hittop::io::hittop_handler_deallocate;
+  hittop_handler_deallocate(p, size, handler);
+}
+
+template <typename Signature, std::size_t kInlineSize = 4 * sizeof(void *)>
+class SmallHandler;
+
+template <typename... Args, std::size_t kInlineSize>
+class SmallHandler<void(Args...), kInlineSize> {
+public:
+  SmallHandler() = default;
+
+  SmallHandler(std::nullptr_t) {}
+
+  template <typename F,
+            typename = std::enable_if_t<
+                !std::is_same<std::decay_t<F>, SmallHandler>::value>>
+  SmallHandler(F &&f) {
+    using Stored = std::decay_t<F>;
+    Construct<Stored>(std::forward<F>(f),
+                      std::integral_constant<bool, IsInline<Stored>()>());
+  }
+
+  SmallHandler(SmallHandler &&other) noexcept { MoveFrom(&other); }
+
+  SmallHandler &operator=(SmallHandler &&other) noexcept {
+    if (this != &other) {
+      reset();
+      MoveFrom(&other);
+    }
+    return *this;
+  }
+
+  SmallHandler &operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  ~SmallHandler() { reset(); }
+
+  explicit operator bool() const { return ops_ != nullptr; }
+
+  // Invokes the handler, leaving this empty.  It must not be empty.
+  void operator()(Args... args) {
+    const Ops *const ops = ops_;
+    ops_ = nullptr;
+    ops->invoke(&storage_, std::forward<Args>(args)...);
+  }
+
+  void reset() {
+    if (ops_ != nullptr) {
+      ops_->destroy(&storage_);
+      ops_ = nullptr;
+    }
+  }
+
+private:
+  using Storage =
+      std::aligned_storage_t<kInlineSize, alignof(std::max_align_t)>;
+
+  // Each function leaves storage empty.
+  struct Ops {
+    void (*invoke)(Storage *storage, Args &&... args);
+    void (*move)(Storage *from, Storage *to);
+    void (*destroy)(Storage *storage);
+  };
+
+  template <typename F> static constexpr bool IsInline() {
+    return sizeof(F) <= sizeof(Storage) && alignof(F) <= alignof(Storage) &&
+           std::is_nothrow_move_constructible<F>::value;
+  }
+
+  template <typename Stored, typename F>
+  void Construct(F &&f, std::true_type /*inline*/) {
+    new (&storage_) Stored(std::forward<F>(f));
+    ops_ = &kInlineOps<Stored>;
+  }
+
+  template <typename Stored, typename F>
+  void Construct(F &&f, std::false_type /*inline*/) {
+    Stored *const hook = const_cast<Stored *>(std::addressof(f));
+    void *const p = AllocateHandler(sizeof(Stored), hook);
+    try {
+      HeapPointer() = new (p) Stored(std::forward<F>(f));
+    } catch (...) {
+      DeallocateHandler(p, sizeof(Stored), hook);
+      throw;
+    }
+    ops_ = &kHeapOps<Stored>;
+  }
+
+  template <typename F> static F &InlineObject(Storage *storage) {
+    return *reinterpret_cast<F *>(storage);
+  }
+
+  void *&HeapPointer() { return *reinterpret_cast<void **>(&storage_); }
+
+  template <typename F> static F *HeapObject(Storage *storage) {
+    return *reinterpret_cast<F **>(storage);
+  }
+
+  template <typename F> static void InlineInvoke(Storage *s, Args &&... args) {
+    // Move the handler out first, in case it reuses this storage.
+    F f(std::move(InlineObject<F>(s)));
+    InlineObject<F>(s).~F();
+    f(std::forward<Args>(args)...);
+  }
+
+  template <typename F> static void InlineMove(Storage *from, Storage *to) {
+    new (to) F(std::move(InlineObject<F>(from)));
+    InlineObject<F>(from).~F();
+  }
+
+  template <typename F> static void InlineDestroy(Storage *s) {
+    InlineObject<F>(s).~F();
+  }
+
+  template <typename F> static void HeapInvoke(Storage *s, Args &&... args) {
+    // Free the memory before the upcall, so the handler can reuse it.
+    F *const p = HeapObject<F>(s);
+    F f(std::move(*p));
+    p->~F();
+    DeallocateHandler(p, sizeof(F), &f);
+    f(std::forward<Args>(args)...);
+  }
+
+  template <typename F> static void HeapMove(Storage *from, Storage *to) {
+    *reinterpret_cast<F **>(to) = HeapObject<F>(from);
+  }
+
+  template <typename F> static void HeapDestroy(Storage *s) {
+    // The hook may refer to the handler, so keep it alive until afterwards.
+    F *const p = HeapObject<F>(s);
+    F f(std::move(*p));
+    p->~F();
+    DeallocateHandler(p, sizeof(F), &f);
+  }
+
+  template <typename F>
+  static constexpr Ops kInlineOps = {&InlineInvoke<F>, &InlineMove<F>,
+                                     &InlineDestroy<F>};
+
+  template <typename F>
+  static constexpr Ops kHeapOps = {&HeapInvoke<F>, &HeapMove<F>,
+                                   &HeapDestroy<F>};
+
+  void MoveFrom(SmallHandler *other) {
+    if (other->ops_ != nullptr) {
+      other->ops_->move(&other->storage_, &storage_);
+      ops_ = other->ops_;
+      other->ops_ = nullptr;
+    }
+  }
+
+  Storage storage_;
+  const Ops *ops_ = nullptr;
+};
+
+template <typename... Args, std::size_t kInlineSize>
+template <typename F>
+constexpr typename SmallHandler<void(Args...), kInlineSize>::Ops
+    SmallHandler<void(Args...), kInlineSize>::kInlineOps;
+
+template <typename... Args, std::size_t kInlineSize>
+template <typename F>
+constexpr typename SmallHandler<void(Args...), kInlineSize>::Ops
+    SmallHandler<void(Args...), kInlineSize>::kHeapOps;
+
+} // namespace io
+} // namespace hittop
+
+#endif // HITTOP_IO_SMALL_HANDLER_H
@@ -0,0 +1,309 @@
+#include "hittop/io/socket_pump.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/error.hpp"
+#include "boost/asio/io_service.hpp"
+#include "boost/asio/local/connect_pair.hpp"
+#include "boost/asio/local/stream_protocol.hpp"
+#include "boost/asio/write.hpp"
+
+#include "hittop/io/async_circular_buffer_stream.h"
+
+namespace {
+
+using ::hittop::io::AsyncCircularBufferStream;
+using ::hittop::io::error_code;
+
+using Socket = boost::asio::local::stream_protocol::socket;
+using ReadPump =
+    ::hittop::io::SocketReadPump<Socket, AsyncCircularBufferStream>;
+using WritePump =
+    ::hittop::io::SocketWritePump<Socket, AsyncCircularBufferStream>;
+
+std::string Pattern(std::size_t size) {
+  std::string text(size, '\0');
+  for (std::size_t i = 0; i < size; ++i) {
+    text[i] = static_cast<char>(i * 7 + i / 251);
+  }
+  return text;
+}
+
+// Writes text into stream, then closes it for write.
+class Producer {
+public:
+  Producer(AsyncCircularBufferStream *stream, const std::string &text)
+      : stream_(stream), text_(text) {}
+
+  void Start() {
+    if (sent_ == text_.size()) {
+      stream_->close_for_write();
+      return;
+    }
+    stream_->async_prepare(
+        1, [this](const error_code &ec,
+                  const AsyncCircularBufferStream::mutable_buffers_type &b) {
+          ASSERT_FALSE(ec);
+          const std::size_t n = boost::asio::buffer_copy(
+              b, boost::asio::buffer(text_.data() + sent_,
+                                     text_.size() - sent_));
+          sent_ += n;
+          stream_->commit(n);
+          Start();
+        });
+  }
+
+private:
+  AsyncCircularBufferStream *const stream_;
+  const std::string &text_;
+  std::size_t sent_ = 0;
+};
+
+// Reads stream until eof, appending to received().
+class Consumer {
+public:
+  explicit Consumer(AsyncCircularBufferStream *stream) : stream_(stream) {}
+
+  void Start() {
+    stream_->async_fetch(
+        1, [this](const error_code &ec,
+                  const AsyncCircularBufferStream::const_buffers_type &data) {
+          if (ec) {
+            EXPECT_EQ(ec, boost::asio::error::eof);
+            eof_ = true;
+            return;
+          }
+          for (const auto &buffer : data) {
+            received_.append(boost::asio::buffer_cast<const char *>(buffer),
+                             boost::asio::buffer_size(buffer));
+          }
+          stream_->consume(boost::asio::buffer_size(data));
+          Start();
+        });
+  }
+
+  const std::string &received() const { return received_; }
+
+  bool eof() const { return eof_; }
+
+private:
+  AsyncCircularBufferStream *const stream_;
+  std::string received_;
+  bool eof_ = false;
+};
+
+TEST(SocketPumpTest, RoundTrip) {
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+
+  // Small streams, so that both wrap around many times.
+  AsyncCircularBufferStream in(10);
+  AsyncCircularBufferStream out(11);
+  const std::string text = Pattern(1 << 20);
+  Producer producer(&in, text);
+  Consumer consumer(&out);
+  WritePump write_pump(&a, &in);
+  ReadPump read_pump(&b, &out, 64);
+
+  bool write_done = false;
+  bool read_done = false;
+  write_pump.Start([&write_done](const error_code &ec) {
+    EXPECT_FALSE(ec);
+    write_done = true;
+  });
+  read_pump.Start([&read_done](const error_code &ec) {
+    EXPECT_FALSE(ec);
+    read_done = true;
+  });
+  consumer.Start();
+  producer.Start();
+  io.run();
+
+  EXPECT_TRUE(write_done);
+  EXPECT_TRUE(read_done);
+  EXPECT_TRUE(consumer.eof());
+  EXPECT_EQ(write_pump.bytes_written(), text.size());
+  EXPECT_EQ(read_pump.bytes_read(), text.size());
+  EXPECT_TRUE(consumer.received() == text);
+}
+
+TEST(SocketPumpTest, ReadSizeAdapts) {
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+
+  // Everything is already in the socket, so reads are as large as allowed.
+  const std::string text = Pattern(1 << 16);
+  boost::asio::write(a, boost::asio::buffer(text));
+  a.close();
+
+  AsyncCircularBufferStream out(10);
+  Consumer consumer(&out);
+  ReadPump read_pump(&b, &out, 16);
+  read_pump.set_max_read_size(512);
+  EXPECT_EQ(read_pump.read_size(), 16u);
+
+  std::size_t max_seen = 0;
+  bool read_done = false;
+  read_pump.Start([&read_done](const error_code &ec) {
+    EXPECT_FALSE(ec);
+    read_done = true;
+  });
+  consumer.Start();
+  while (io.run_one()) {
+    max_seen = std::max(max_seen, read_pump.read_size());
+  }
+
+  EXPECT_TRUE(read_done);
+  EXPECT_EQ(max_seen, 512u);
+  EXPECT_TRUE(consumer.received() == text);
+}
+
+TEST(SocketPumpTest, ZeroReadSizesAreRaised) {
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+  const std::string text = Pattern(100);
+  boost::asio::write(a, boost::asio::buffer(text));
+  a.close();
+
+  AsyncCircularBufferStream out(10);
+  Consumer consumer(&out);
+  ReadPump read_pump(&b, &out, 0);
+  EXPECT_EQ(read_pump.min_read_size(), 1u);
+  EXPECT_EQ(read_pump.read_size(), 1u);
+  read_pump.set_max_read_size(0);
+  EXPECT_EQ(read_pump.max_read_size(), 1u);
+
+  // Every read asks for one byte, and the pump still reaches end-of-file.
+  bool read_done = false;
+  read_pump.Start([&read_done](const error_code &ec) {
+    EXPECT_FALSE(ec);
+    read_done = true;
+  });
+  consumer.Start();
+  io.run();
+
+  EXPECT_TRUE(read_done);
+  EXPECT_EQ(read_pump.bytes_read(), text.size());
+  EXPECT_EQ(read_pump.read_size(), 1u);
+  EXPECT_TRUE(consumer.received() == text);
+}
+
+TEST(SocketPumpTest, ReadLimitedBySpaceCountsAsFull) {
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+  const std::string text = Pattern(4096);
+  boost::asio::write(a, boost::asio::buffer(text));
+
+  // Leave only 100 bytes of space, less than the read size.
+  AsyncCircularBufferStream out(10);
+  out.async_prepare(
+      1, [&out](const error_code &ec,
+                const AsyncCircularBufferStream::mutable_buffers_type &) {
+        ASSERT_FALSE(ec);
+        out.commit(out.max_space() - 100);
+      });
+  ReadPump read_pump(&b, &out, 256);
+
+  // The one read fills the space it could ask for, so the read size grows.
+  bool read_done = false;
+  error_code read_ec;
+  read_pump.Start([&read_done, &read_ec](const error_code &ec) {
+    read_done = true;
+    read_ec = ec;
+  });
+  io.run();
+  EXPECT_FALSE(read_done);
+  EXPECT_EQ(read_pump.bytes_read(), 100u);
+  EXPECT_EQ(read_pump.read_size(), 512u);
+
+  out.close_for_read();
+  EXPECT_TRUE(read_done);
+  EXPECT_EQ(read_ec, boost::asio::error::broken_pipe);
+}
+
+// A consumer that waits for whole records, larger than the read size could
+// grow to allow, must not stall the pump while it holds a partial record.
+TEST(SocketPumpTest, ConsumerWaitsForRecords) {
+  const std::size_t kRecordSize = 3000;
+  const std::size_t kRecords = 10;
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+
+  const std::string text = Pattern(kRecords * kRecordSize);
+  boost::asio::write(a, boost::asio::buffer(text));
+  a.close();
+
+  AsyncCircularBufferStream out(12);
+  ReadPump read_pump(&b, &out);
+  bool read_done = false;
+  read_pump.Start([&read_done](const error_code &ec) {
+    EXPECT_FALSE(ec);
+    read_done = true;
+  });
+
+  std::size_t records = 0;
+  std::function<void(const error_code &,
+                      const AsyncCircularBufferStream::const_buffers_type &)>
+      on_record = [&](const error_code &ec,
+                      const AsyncCircularBufferStream::const_buffers_type &) {
+        if (ec) {
+          EXPECT_EQ(ec, boost::asio::error::eof);
+          return;
+        }
+        ++records;
+        out.consume(kRecordSize);
+        out.async_fetch(kRecordSize, on_record);
+      };
+  out.async_fetch(kRecordSize, on_record);
+  io.run();
+
+  EXPECT_TRUE(read_done);
+  EXPECT_EQ(read_pump.bytes_read(), text.size());
+  EXPECT_EQ(records, kRecords);
+}
+
+TEST(SocketPumpTest, StreamErrors) {
+  boost::asio::io_service io;
+  Socket a(io);
+  Socket b(io);
+  boost::asio::local::connect_pair(a, b);
+
+  // The reader of the stream has gone away.
+  AsyncCircularBufferStream out;
+  out.close_for_read();
+  ReadPump read_pump(&b, &out);
+  error_code read_error;
+  read_pump.Start([&read_error](const error_code &ec) { read_error = ec; });
+  EXPECT_EQ(read_error, boost::asio::error::broken_pipe);
+
+  // The socket has been closed under the write pump.
+  AsyncCircularBufferStream in;
+  const std::string text = Pattern(100);
+  Producer producer(&in, text);
+  a.close();
+  WritePump write_pump(&a, &in);
+  error_code write_error;
+  write_pump.Start([&write_error](const error_code &ec) { write_error = ec; });
+  producer.Start();
+  io.run();
+  EXPECT_TRUE(write_error);
+  EXPECT_EQ(write_pump.bytes_written(), 0u);
+}
+
+} // namespace
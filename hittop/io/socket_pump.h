@@ -0,0 +1,212 @@
+// Pumps that move bytes between a socket and a buffer stream.
+//
+// SocketReadPump reads from a socket into an AsyncMutableBufferStream, and
+// SocketWritePump writes the contents of an AsyncConstBufferStream to a
+// socket.  Neither copies: each read is a single scatter read (readv/recvmsg)
+// straight into the (up to two) segments that the stream's async_prepare
+// returns, and each write a single gather write from the segments of
+// async_fetch.  Together they connect a socket to a parser or writer that
+// works on the stream, e.g. AsyncParse and AsyncWrite.
+//
+// Socket is any Boost.Asio stream socket (tcp, local, ...).  The socket's
+// handlers run on its io_service; a pump's stream handlers run wherever the
+// stream completes them, which for a stream whose other side is driven by the
+// same io_service is that io_service too.
+//
+// A pump does not allocate per operation: its stream handlers refer only to
+// the pump, so SmallHandler stores them inline; the done callback is stored
+// with its own allocation hooks (see small_handler.h); and Asio reuses the
+// memory of each socket operation for the next one on the same thread.
+//
+// A read pump issues a read as soon as the stream has any space, since the
+// consumer may be waiting for more data before it frees any.  Each read asks
+// for at most read_size() bytes, which adapts between the minimum and maximum
+// read sizes: it doubles after a read that fills the request, and halves after
+// one of less than half of it.  A small read_size() keeps a connection that
+// sends little from claiming the whole buffer at once.
+//
+#ifndef HITTOP_IO_SOCKET_PUMP_H
+#define HITTOP_IO_SOCKET_PUMP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/error.hpp"
+#include "boost/asio/socket_base.hpp"
+#include "boost/container/small_vector.hpp"
+
+#include "hittop/io/small_handler.h"
+#include "hittop/io/types.h"
+
+namespace hittop {
+namespace io {
+
+template <typename Socket, typename Stream> class SocketReadPump {
+public:
+  using DoneHandler = SmallHandler<void(const error_code &)>;
+
+  // The pump refers to both socket and stream, which must outlive it.  A
+  // min_read_size of 0 is taken as 1, since a read of nothing would never see
+  // any data or end-of-file.
+  SocketReadPump(Socket *socket, Stream *stream,
+                 std::size_t min_read_size = 512)
+      : socket_(socket), stream_(stream),
+        min_read_size_(std::max<std::size_t>(min_read_size, 1)),
+        max_read_size_(std::max(stream->max_space(), min_read_size_)),
+        read_size_(min_read_size_) {}
+
+  SocketReadPump(const SocketReadPump &) = delete;
+  SocketReadPump &operator=(const SocketReadPump &) = delete;
+
+  std::size_t min_read_size() const { return min_read_size_; }
+
+  // The read size never grows past this; by default the stream's capacity.
+  std::size_t max_read_size() const { return max_read_size_; }
+
+  // Sizes below min_read_size() are taken as min_read_size().
+  void set_max_read_size(std::size_t size) {
+    max_read_size_ = std::max(size, min_read_size_);
+    read_size_ = std::min(read_size_, max_read_size_);
+  }
+
+  // The most that the next read asks for.
+  std::size_t read_size() const { return read_size_; }
+
+  // The total number of bytes read so far.
+  std::size_t bytes_read() const { return bytes_read_; }
+
+  // Reads until the socket reaches end-of-file, which closes the stream for
+  // write.  Then calls done with no error; or with the error of the socket
+  // (having closed the stream for write), or of the stream (e.g. broken_pipe
+  // once the reader has closed it), if either fails first.
+  template <typename Callback> void Start(Callback &&done) {
+    done_ = std::forward<Callback>(done);
+    Prepare();
+  }
+
+private:
+  void Prepare() {
+    stream_->async_prepare(
+        1, [this](const error_code &ec,
+                  const typename Stream::mutable_buffers_type &buffers) {
+          if (ec) {
+            done_(ec);
+            return;
+          }
+          Read(buffers);
+        });
+  }
+
+  void Read(const typename Stream::mutable_buffers_type &buffers) {
+    // The first read_size_ bytes of the stream's buffers, or all of them if
+    // the stream has less space than that.
+    boost::container::small_vector<mutable_buffer, 2> request;
+    std::size_t remaining = read_size_;
+    for (const mutable_buffer &segment : buffers) {
+      if (remaining == 0) {
+        break;
+      }
+      const mutable_buffer buffer = boost::asio::buffer(segment, remaining);
+      remaining -= boost::asio::buffer_size(buffer);
+      request.push_back(buffer);
+    }
+    const std::size_t requested = read_size_ - remaining;
+    socket_->async_read_some(
+        request, [this, requested](const error_code &ec, std::size_t n) {
+          stream_->commit(n);
+          bytes_read_ += n;
+          if (ec) {
+            stream_->close_for_write();
+            done_(ec == boost::asio::error::eof ? error_code{} : ec);
+            return;
+          }
+          Adapt(n, requested);
+          Prepare();
+        });
+  }
+
+  // Adapts the read size to a read of n bytes that asked for requested.
+  void Adapt(std::size_t n, std::size_t requested) {
+    if (n >= requested) {
+      read_size_ = std::min(2 * read_size_, max_read_size_);
+    } else if (n < requested / 2) {
+      read_size_ = std::max(read_size_ / 2, min_read_size_);
+    }
+  }
+
+  Socket *const socket_;
+  Stream *const stream_;
+  const std::size_t min_read_size_;
+  std::size_t max_read_size_;
+  std::size_t read_size_;
+  std::size_t bytes_read_ = 0;
+  DoneHandler done_;
+};
+
+template <typename Socket, typename Stream> class SocketWritePump {
+public:
+  using DoneHandler = SmallHandler<void(const error_code &)>;
+
+  // The pump refers to both socket and stream, which must outlive it.
+  SocketWritePump(Socket *socket, Stream *stream)
+      : socket_(socket), stream_(stream) {}
+
+  SocketWritePump(const SocketWritePump &) = delete;
+  SocketWritePump &operator=(const SocketWritePump &) = delete;
+
+  // The total number of bytes written so far.
+  std::size_t bytes_written() const { return bytes_written_; }
+
+  // Writes until the stream reaches end-of-file, which shuts down the sending
+  // side of the socket.  Then calls done with no error; or with the error of
+  // the socket (having closed the stream for read), or of the stream, if
+  // either fails first.
+  template <typename Callback> void Start(Callback &&done) {
+    done_ = std::forward<Callback>(done);
+    Fetch();
+  }
+
+private:
+  void Fetch() {
+    stream_->async_fetch(
+        1, [this](const error_code &ec,
+                  const typename Stream::const_buffers_type &buffers) {
+          if (ec == boost::asio::error::eof) {
+            error_code ignored;
+            socket_->shutdown(boost::asio::socket_base::shutdown_send,
+                              ignored);
+            done_(error_code{});
+          } else if (ec) {
+            done_(ec);
+          } else {
+            Write(buffers);
+          }
+        });
+  }
+
+  void Write(const typename Stream::const_buffers_type &buffers) {
+    socket_->async_write_some(
+        buffers, [this](const error_code &ec, std::size_t n) {
+          stream_->consume(n);
+          bytes_written_ += n;
+          if (ec) {
+            stream_->close_for_read();
+            done_(ec);
+            return;
+          }
+          Fetch();
+        });
+  }
+
+  Socket *const socket_;
+  Stream *const stream_;
+  std::size_t bytes_written_ = 0;
+  DoneHandler done_;
+};
+
+} // namespace io
+} // namespace hittop
+
+#endif // HITTOP_IO_SOCKET_PUMP_H
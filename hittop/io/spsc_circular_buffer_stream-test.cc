@@ -0,0 +1,241 @@
+#include "hittop/io/spsc_circular_buffer_stream.h"
+#include "hittop/io/spsc_circular_buffer_stream.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "boost/asio/buffers_iterator.hpp"
+
+#include "hittop/concurrent/latching_signal.h"
+
+namespace {
+
+using ::hittop::concurrent::LatchingSignal;
+using ::hittop::io::SpscCircularBufferStream;
+using ::hittop::io::error_code;
+
+using MockFetchHandler = LatchingSignal<void(
+    const error_code &, SpscCircularBufferStream::const_buffers_type)>;
+using MockPrepareHandler = LatchingSignal<void(
+    const error_code &, SpscCircularBufferStream::mutable_buffers_type)>;
+
+// Single-threaded cases, as for AsyncCircularBufferStream.
+class SpscCircularBufferStreamTest : public ::testing::Test {
+protected:
+  void Prepare(std::size_t minimum = 1) {
+    stream_.async_prepare(minimum, std::ref(handle_prepare_));
+  }
+
+  bool IsPrepareComplete() const { return handle_prepare_.is_latched(); }
+
+  error_code PrepareError() const { return *handle_prepare_.arg<0>(); }
+
+  void WriteAndCommit(const std::string &bytes) {
+    std::copy(bytes.begin(), bytes.end(),
+              boost::asio::buffers_begin(*handle_prepare_.arg<1>()));
+    stream_.commit(bytes.size());
+    handle_prepare_.reset();
+  }
+
+  void Fetch(std::size_t minimum = 1) {
+    stream_.async_fetch(minimum, std::ref(handle_fetch_));
+  }
+
+  bool IsFetchComplete() const { return handle_fetch_.is_latched(); }
+
+  error_code FetchError() const { return *handle_fetch_.arg<0>(); }
+
+  std::string Data() const {
+    auto &fetched_buffers = *handle_fetch_.arg<1>();
+    return std::string(boost::asio::buffers_begin(fetched_buffers),
+                       boost::asio::buffers_end(fetched_buffers));
+  }
+
+  void Consume(std::size_t count) {
+    stream_.consume(count);
+    handle_fetch_.reset();
+  }
+
+  MockPrepareHandler handle_prepare_;
+  MockFetchHandler handle_fetch_;
+  SpscCircularBufferStream stream_{3}; // 8 bytes
+};
+
+TEST_F(SpscCircularBufferStreamTest, WriteThenRead) {
+  Prepare();
+  EXPECT_TRUE(IsPrepareComplete());
+  EXPECT_EQ(PrepareError(), error_code{});
+  WriteAndCommit("123456");
+  EXPECT_EQ(stream_.size(), 6u);
+  EXPECT_EQ(stream_.space(), 2u);
+
+  Fetch();
+  EXPECT_TRUE(IsFetchComplete());
+  EXPECT_EQ(FetchError(), error_code{});
+  EXPECT_EQ(Data(), "123456");
+  Consume(4);
+
+  // The next write wraps around the end of the storage.
+  Prepare(6);
+  EXPECT_TRUE(IsPrepareComplete());
+  WriteAndCommit("abcdef");
+  Fetch(8);
+  EXPECT_TRUE(IsFetchComplete());
+  EXPECT_EQ(Data(), "56abcdef");
+}
+
+TEST_F(SpscCircularBufferStreamTest, ParkedHandlers) {
+  // A fetch waits for enough data to be committed.
+  Fetch(3);
+  EXPECT_FALSE(IsFetchComplete());
+  Prepare();
+  WriteAndCommit("12");
+  EXPECT_FALSE(IsFetchComplete());
+  Prepare();
+  WriteAndCommit("3456");
+  EXPECT_TRUE(IsFetchComplete());
+  EXPECT_EQ(Data(), "123456");
+
+  // A prepare waits for enough data to be consumed.
+  Prepare(4);
+  EXPECT_FALSE(IsPrepareComplete());
+  Consume(1);
+  EXPECT_FALSE(IsPrepareComplete());
+  Fetch();
+  Consume(1);
+  EXPECT_TRUE(IsPrepareComplete());
+  EXPECT_EQ(PrepareError(), error_code{});
+}
+
+TEST_F(SpscCircularBufferStreamTest, Errors) {
+  Prepare(9);
+  EXPECT_EQ(PrepareError(), error_code{boost::asio::error::invalid_argument});
+  handle_prepare_.reset();
+  Fetch(9);
+  EXPECT_EQ(FetchError(), error_code{boost::asio::error::invalid_argument});
+  handle_fetch_.reset();
+
+  Prepare();
+  MockPrepareHandler second_prepare;
+  stream_.async_prepare(1, std::ref(second_prepare));
+  EXPECT_EQ(*second_prepare.arg<0>(),
+            error_code{boost::asio::error::already_started});
+
+  Fetch();
+  MockFetchHandler second_fetch;
+  stream_.async_fetch(1, std::ref(second_fetch));
+  EXPECT_EQ(*second_fetch.arg<0>(),
+            error_code{boost::asio::error::already_started});
+}
+
+TEST_F(SpscCircularBufferStreamTest, CloseForWrite) {
+  Prepare();
+  WriteAndCommit("123");
+  Fetch(4);
+  Prepare(6);
+  EXPECT_FALSE(IsFetchComplete());
+  EXPECT_FALSE(IsPrepareComplete());
+
+  stream_.close_for_write();
+  EXPECT_EQ(PrepareError(), error_code{boost::asio::error::shut_down});
+  EXPECT_EQ(FetchError(), error_code{boost::asio::error::eof});
+
+  // The remaining data can still be read.
+  handle_fetch_.reset();
+  Fetch(3);
+  EXPECT_EQ(Data(), "123");
+  Consume(3);
+  Fetch(1);
+  EXPECT_EQ(FetchError(), error_code{boost::asio::error::eof});
+}
+
+TEST_F(SpscCircularBufferStreamTest, CloseForRead) {
+  Fetch(5);
+  Prepare(4);
+  WriteAndCommit("1234");
+  Prepare(5);
+  EXPECT_FALSE(IsFetchComplete());
+  EXPECT_FALSE(IsPrepareComplete());
+
+  stream_.close_for_read();
+  EXPECT_EQ(FetchError(), error_code{boost::asio::error::shut_down});
+  EXPECT_EQ(PrepareError(), error_code{boost::asio::error::broken_pipe});
+
+  handle_prepare_.reset();
+  Prepare();
+  EXPECT_EQ(PrepareError(), error_code{boost::asio::error::broken_pipe});
+}
+
+// Sends a pattern through a small buffer between two threads, with handlers
+// that issue the next operation themselves, as a socket pump would.
+TEST(SpscCircularBufferStreamThreadTest, Transfer) {
+  const std::size_t kTotal = 1 << 22;
+  SpscCircularBufferStream stream(6);
+  std::atomic<bool> done{false};
+  std::size_t received = 0;
+  bool in_order = true;
+
+  std::thread consumer([&]() {
+    // Copied into the stream for each fetch.
+    std::function<void(const error_code &,
+                       const SpscCircularBufferStream::const_buffers_type &)>
+        on_fetch;
+    on_fetch = [&](const error_code &ec,
+                   const SpscCircularBufferStream::const_buffers_type &data) {
+      if (ec) {
+        done = true;
+        return;
+      }
+      std::size_t count = 0;
+      for (auto it = boost::asio::buffers_begin(data),
+                end = boost::asio::buffers_end(data);
+           it != end; ++it, ++count) {
+        in_order = in_order && *it == static_cast<char>(received + count);
+      }
+      received += count;
+      stream.consume(count);
+      stream.async_fetch(1 + received % 7, on_fetch);
+    };
+    stream.async_fetch(1, on_fetch);
+    while (!done) {
+      std::this_thread::yield();
+    }
+  });
+
+  std::size_t sent = 0;
+  std::atomic<bool> prepared{false};
+  SpscCircularBufferStream::mutable_buffers_type space;
+  while (sent < kTotal) {
+    prepared = false;
+    stream.async_prepare(
+        1 + sent % 5,
+        [&](const error_code &ec,
+            const SpscCircularBufferStream::mutable_buffers_type &buffers) {
+          ASSERT_FALSE(ec);
+          space = buffers;
+          prepared = true;
+        });
+    while (!prepared) {
+      std::this_thread::yield();
+    }
+    std::size_t count = 0;
+    for (auto it = boost::asio::buffers_begin(space),
+              end = boost::asio::buffers_end(space);
+         it != end && sent + count < kTotal; ++it, ++count) {
+      *it = static_cast<char>(sent + count);
+    }
+    sent += count;
+    stream.commit(count);
+  }
+  stream.close_for_write();
+  consumer.join();
+
+  EXPECT_EQ(received, kTotal);
+  EXPECT_TRUE(in_order);
+}
+
+} // namespace
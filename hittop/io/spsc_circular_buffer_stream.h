@@ -0,0 +1,317 @@
+// A circular buffer stream for exactly one producer and one consumer thread.
+//
+// SpscCircularBufferStream has the interface and error behaviour of
+// AsyncCircularBufferStream, but takes no lock.  The producer owns the write
+// head and the consumer the read head; each stores only its own head, and
+// reads the other's with (at least) acquire ordering, so the bytes between
+// the heads are visible to whichever side is entitled to them.
+//
+// An operation that cannot complete immediately parks its handler in a slot
+// with an atomic state (idle, parked, claimed, active).  Whichever thread
+// completes it (the other side, when it moves its head, or a close) must
+// first move the slot from parked to claimed with a compare-and-swap, so the
+// handler runs exactly once even if both sides race to complete it.  The side
+// that parks the handler re-checks the heads after publishing the slot, and
+// the side that moves a head checks the slot after publishing the head.  The
+// head is stored and the slot loaded sequentially consistently, and a
+// sequentially consistent fence separates publishing the slot from loading the
+// heads (which are only acquire loads), so at least one side sees the other,
+// and a parked operation is never forgotten.
+//
+// As with AsyncCircularBufferStream, a parked handler runs on the thread
+// whose call completes it.  The producer may call only async_prepare, commit,
+// space and close_for_write, and the consumer only async_fetch, consume, size
+// and close_for_read.
+//
+#ifndef HITTOP_IO_SPSC_CIRCULAR_BUFFER_STREAM_H
+#define HITTOP_IO_SPSC_CIRCULAR_BUFFER_STREAM_H
+
+#include <assert.h>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "boost/asio/error.hpp"
+
+#include "hittop/io/async_const_buffer_stream.h"
+#include "hittop/io/async_mutable_buffer_stream.h"
+#include "hittop/io/circular_buffer.h"
+#include "hittop/io/small_handler.h"
+
+namespace hittop {
+namespace io {
+
+class SpscCircularBufferStream
+    : public AsyncMutableBufferStream<SpscCircularBufferStream>,
+      public AsyncConstBufferStream<SpscCircularBufferStream> {
+public:
+  using const_buffers_type = CircularBuffer::const_buffers_type;
+
+  using mutable_buffers_type = CircularBuffer::mutable_buffers_type;
+
+  using FetchHandler =
+      SmallHandler<void(const error_code &, const const_buffers_type &)>;
+
+  using PrepareHandler =
+      SmallHandler<void(const error_code &, const mutable_buffers_type &)>;
+
+  explicit SpscCircularBufferStream(const int size_log_2 = 12)
+      : storage_(std::size_t{1} << size_log_2) {}
+
+  SpscCircularBufferStream(const SpscCircularBufferStream &) = delete;
+  SpscCircularBufferStream &
+  operator=(const SpscCircularBufferStream &) = delete;
+
+  ~SpscCircularBufferStream() {
+    close_for_read();
+    close_for_write();
+  }
+
+  std::size_t max_space() const { return storage_.size(); }
+
+  std::size_t space() const { return max_space() - size(); }
+
+  template <typename Handler>
+  void async_prepare(std::size_t minimum_size, Handler &&handler) {
+    namespace error = boost::asio::error;
+
+    if (minimum_size > max_space()) {
+      // The requested size is larger than the buffer.
+      handler(error::invalid_argument, mutable_buffers_type{});
+    } else if (closed_for_write_.load(std::memory_order_relaxed)) {
+      // Tried to write after closing for write.
+      handler(error::shut_down, mutable_buffers_type{});
+    } else if (closed_for_read_.load(std::memory_order_acquire)) {
+      // Tried to write, but the other side has shut down.
+      handler(error::broken_pipe, mutable_buffers_type{});
+    } else if (!prepare_.idle()) {
+      // There is already a write operation in progress.
+      handler(error::already_started, mutable_buffers_type{});
+    } else if (space() >= minimum_size) {
+      // Success!
+      prepare_.Activate();
+      handler(error_code{}, prepare());
+    } else {
+      // Not enough space in the buffer; wait for data to be read, unless it
+      // was read (or the reader closed) just before the handler was parked.
+      prepare_.Park(minimum_size, std::forward<Handler>(handler));
+      WakePrepare();
+    }
+  }
+
+  void commit(const std::size_t byte_count) {
+    assert(byte_count <= space());
+    assert(prepare_.active());
+    prepare_.Release();
+    write_head_.store(write_head_.load(std::memory_order_relaxed) +
+                      byte_count);
+    if (fetch_.parked()) {
+      WakeFetch();
+    }
+  }
+
+  void close_for_write() {
+    namespace error = boost::asio::error;
+
+    if (closed_for_write_.exchange(true)) {
+      return;
+    }
+    if (prepare_.TryClaim()) {
+      prepare_.Take(false)(error::shut_down, {});
+    }
+    // A parked fetch now fails with eof.
+    WakeFetch();
+  }
+
+  std::size_t max_size() const { return storage_.size(); }
+
+  std::size_t size() const {
+    // Load the read head first: the write head only ever moves forward.
+    const std::size_t read_head = read_head_.load(std::memory_order_acquire);
+    return write_head_.load(std::memory_order_acquire) - read_head;
+  }
+
+  template <typename Handler>
+  void async_fetch(std::size_t minimum_size, Handler &&handler) {
+    namespace error = boost::asio::error;
+
+    if (minimum_size > max_size()) {
+      // The requested size is larger than the buffer.
+      handler(error::invalid_argument, const_buffers_type{});
+    } else if (closed_for_read_.load(std::memory_order_relaxed)) {
+      // Tried to read after closing for read.
+      handler(error::shut_down, const_buffers_type{});
+    } else if (!fetch_.idle()) {
+      // There is already a fetch operation in progress.
+      handler(error::already_started, const_buffers_type{});
+    } else if (size() >= minimum_size) {
+      // Success!
+      fetch_.Activate();
+      handler(error_code{}, data());
+    } else if (closed_for_write_.load(std::memory_order_acquire)) {
+      // Not enough data and closed for write; this operation can never
+      // succeed.
+      handler(error::eof, const_buffers_type{});
+    } else {
+      // Not enough data; wait for a commit, unless there was one (or the
+      // writer closed) just before the handler was parked.
+      fetch_.Park(minimum_size, std::forward<Handler>(handler));
+      WakeFetch();
+    }
+  }
+
+  void consume(std::size_t byte_count) {
+    assert(byte_count <= size());
+    assert(fetch_.active());
+    fetch_.Release();
+    read_head_.store(read_head_.load(std::memory_order_relaxed) + byte_count);
+    if (prepare_.parked()) {
+      WakePrepare();
+    }
+  }
+
+  void close_for_read() {
+    namespace error = boost::asio::error;
+
+    if (closed_for_read_.exchange(true)) {
+      return;
+    }
+    if (fetch_.TryClaim()) {
+      fetch_.Take(false)(error::shut_down, {});
+    }
+    // A parked prepare now fails with broken_pipe.
+    WakePrepare();
+  }
+
+private:
+  // A handler slot for one side's operation.
+  template <typename Stored> class Slot {
+  public:
+    bool idle() const { return state_.load() == kIdle; }
+
+    bool parked() const { return state_.load() == kParked; }
+
+    bool active() const { return state_.load() == kActive; }
+
+    std::size_t minimum() const { return minimum_; }
+
+    // The operation completed immediately, successfully.
+    void Activate() { state_.store(kActive, std::memory_order_relaxed); }
+
+    // The operation is finished (by commit or consume).
+    void Release() { state_.store(kIdle, std::memory_order_relaxed); }
+
+    template <typename Handler>
+    void Park(std::size_t minimum, Handler &&handler) {
+      minimum_ = minimum;
+      handler_ = std::forward<Handler>(handler);
+      state_.store(kParked);
+    }
+
+    // Takes ownership of the parked operation, if there is one and no other
+    // thread has taken it.  The minimum cannot change while it is claimed.
+    bool TryClaim() {
+      int expected = kParked;
+      return state_.compare_exchange_strong(expected, kClaimed);
+    }
+
+    // Puts back a claimed operation that cannot complete yet.
+    void Unclaim() { state_.store(kParked); }
+
+    // Takes the handler of a claimed operation, leaving the operation active
+    // if it is to succeed.
+    Stored Take(bool success) {
+      Stored handler = std::move(handler_);
+      state_.store(success ? kActive : kIdle, std::memory_order_release);
+      return handler;
+    }
+
+  private:
+    enum State { kIdle, kParked, kClaimed, kActive };
+
+    std::atomic<int> state_{kIdle};
+    std::size_t minimum_ = 0;
+    Stored handler_;
+  };
+
+  const_buffers_type data() const {
+    const std::size_t read_head = read_head_.load(std::memory_order_relaxed);
+    const std::size_t size =
+        write_head_.load(std::memory_order_acquire) - read_head;
+    return internal::GetCircularRange<const_buffer>(
+        read_head & (storage_.size() - 1), size, storage_);
+  }
+
+  mutable_buffers_type prepare() {
+    const std::size_t write_head = write_head_.load(std::memory_order_relaxed);
+    const std::size_t read_head = read_head_.load(std::memory_order_acquire);
+    const std::size_t space = storage_.size() - (write_head - read_head);
+    return internal::GetCircularRange<mutable_buffer>(
+        write_head & (storage_.size() - 1), space, storage_);
+  }
+
+  // Completes the parked fetch, if it can now complete and no other thread
+  // completes it first.
+  void WakeFetch() {
+    while (fetch_.TryClaim()) {
+      // Order the claim (after Park) before the loads of the heads.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const std::size_t minimum = fetch_.minimum();
+      const bool success = size() >= minimum;
+      if (success || closed_for_write_.load()) {
+        FetchHandler handler = fetch_.Take(success);
+        if (success) {
+          handler({}, data());
+        } else {
+          handler(boost::asio::error::eof, {});
+        }
+        return;
+      }
+      // The producer may have committed (or closed) while the fetch was
+      // claimed, and seen it as not parked; check again once it is.
+      fetch_.Unclaim();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (size() < minimum && !closed_for_write_.load()) {
+        return;
+      }
+    }
+  }
+
+  // Completes the parked prepare, like WakeFetch.
+  void WakePrepare() {
+    while (prepare_.TryClaim()) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const std::size_t minimum = prepare_.minimum();
+      const bool closed = closed_for_read_.load();
+      if (closed || space() >= minimum) {
+        PrepareHandler handler = prepare_.Take(!closed);
+        if (closed) {
+          handler(boost::asio::error::broken_pipe, {});
+        } else {
+          handler({}, prepare());
+        }
+        return;
+      }
+      prepare_.Unclaim();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (space() < minimum && !closed_for_read_.load()) {
+        return;
+      }
+    }
+  }
+
+  std::vector<char> storage_;
+  std::atomic<std::size_t> read_head_{0};
+  std::atomic<std::size_t> write_head_{0};
+  std::atomic<bool> closed_for_read_{false};
+  std::atomic<bool> closed_for_write_{false};
+  Slot<FetchHandler> fetch_;
+  Slot<PrepareHandler> prepare_;
+};
+
+} // namespace io
+} // namespace hittop
+
+#endif // HITTOP_IO_SPSC_CIRCULAR_BUFFER_STREAM_H
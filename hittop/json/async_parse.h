@@ -0,0 +1,97 @@
+// Drives a SaxParser from an AsyncConstBufferStream (see
+// hittop/io/async_const_buffer_stream.h).
+//
+// Each fetched buffer sequence is fed to the parser segment by segment and
+// consumed from the stream immediately, so the stream's buffer never needs to
+// hold more than one chunk and arbitrarily large values can be parsed.  Bytes
+// following the end of the value are left in the stream.
+//
+#ifndef HITTOP_JSON_ASYNC_PARSE_H
+#define HITTOP_JSON_ASYNC_PARSE_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/error.hpp"
+
+#include "hittop/io/small_handler.h"
+#include "hittop/io/types.h"
+#include "hittop/parser/parse_error.h"
+
+#include "hittop/json/sax_parser.h"
+
+namespace hittop {
+namespace json {
+
+template <typename Stream, typename Handler, typename Callback>
+void AsyncParse(Stream *stream, SaxParser<Handler> *parser, Callback done);
+
+namespace internal {
+
+// The handler of each fetch.  Its memory comes from the hooks of done, so that
+// a caller whose callback has hooks can parse without allocating.
+template <typename Stream, typename Handler, typename Callback>
+struct AsyncParseOp {
+  Stream *stream;
+  SaxParser<Handler> *parser;
+  Callback done;
+
+  void operator()(const io::error_code &ec,
+                  const typename Stream::const_buffers_type &buffers) {
+    if (ec) {
+      // A value at the very end of the stream, e.g. a number, is complete.
+      const parser::ParseError error = parser->Finish();
+      if (ec == boost::asio::error::eof && error == parser::ParseError::NONE) {
+        done(io::error_code{}, error);
+      } else {
+        done(ec, error);
+      }
+      return;
+    }
+    std::size_t consumed = 0;
+    for (const auto &buffer : buffers) {
+      const char *first = boost::asio::buffer_cast<const char *>(buffer);
+      const char *last = first + boost::asio::buffer_size(buffer);
+      auto result = parser->Feed(first, last);
+      consumed += result.get() - first;
+      if (!result.ok() || parser->done()) {
+        stream->consume(consumed);
+        done(io::error_code{}, result.error());
+        return;
+      }
+    }
+    stream->consume(consumed);
+    AsyncParse(stream, parser, std::move(done));
+  }
+
+  friend void *hittop_handler_allocate(std::size_t size, AsyncParseOp *op) {
+    return io::AllocateHandler(size, std::addressof(op->done));
+  }
+
+  friend void hittop_handler_deallocate(void *p, std::size_t size,
+                                        AsyncParseOp *op) {
+    io::DeallocateHandler(p, size, std::addressof(op->done));
+  }
+};
+
+} // namespace internal
+
+// Reads one JSON value from stream into parser, which must be freshly
+// constructed or Reset().  Calls done(ec, parse_error) when the value is
+// complete (both are then empty/NONE), when the parser reports an error, or
+// when the stream fails; an end-of-stream before the end of the value yields
+// ec == boost::asio::error::eof along with the parser's Finish() result.
+// done need only be move-constructible, and its allocation hooks (see
+// io/small_handler.h) are used for the handlers of the operation.
+template <typename Stream, typename Handler, typename Callback>
+void AsyncParse(Stream *stream, SaxParser<Handler> *parser, Callback done) {
+  stream->async_fetch(1, internal::AsyncParseOp<Stream, Handler, Callback>{
+                             stream, parser, std::move(done)});
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_ASYNC_PARSE_H
@@ -0,0 +1,90 @@
+// Copies serialized JSON into an AsyncMutableBufferStream (see
+// hittop/io/async_mutable_buffer_stream.h).
+//
+// The text is copied into whatever space the stream has prepared and committed
+// a buffer sequence at a time, so output larger than the stream's buffer is
+// written as the reader makes room for it.
+//
+#ifndef HITTOP_JSON_ASYNC_WRITE_H
+#define HITTOP_JSON_ASYNC_WRITE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+
+#include "hittop/io/small_handler.h"
+#include "hittop/io/types.h"
+
+#include "hittop/json/tape.h"
+
+namespace hittop {
+namespace json {
+
+template <typename Stream, typename Callback>
+void AsyncWrite(Stream *stream, StringView text, Callback done);
+
+namespace internal {
+
+// The handler of each prepare, which forwards the allocation hooks to done as
+// internal::AsyncParseOp does.
+template <typename Stream, typename Callback> struct AsyncWriteOp {
+  Stream *stream;
+  StringView text;
+  Callback done;
+
+  void operator()(const io::error_code &ec,
+                  const typename Stream::mutable_buffers_type &buffers) {
+    if (ec) {
+      done(ec);
+      return;
+    }
+    std::size_t written = 0;
+    for (const auto &buffer : buffers) {
+      const std::size_t size =
+          std::min(boost::asio::buffer_size(buffer), text.size() - written);
+      std::copy(text.data() + written, text.data() + written + size,
+                boost::asio::buffer_cast<char *>(buffer));
+      written += size;
+      if (written == text.size()) {
+        break;
+      }
+    }
+    stream->commit(written);
+    text.remove_prefix(written);
+    AsyncWrite(stream, text, std::move(done));
+  }
+
+  friend void *hittop_handler_allocate(std::size_t size, AsyncWriteOp *op) {
+    return io::AllocateHandler(size, std::addressof(op->done));
+  }
+
+  friend void hittop_handler_deallocate(void *p, std::size_t size,
+                                        AsyncWriteOp *op) {
+    io::DeallocateHandler(p, size, std::addressof(op->done));
+  }
+};
+
+} // namespace internal
+
+// Writes text to stream and calls done(ec) once all of it has been committed,
+// or when the stream fails.  The characters text refers to (typically the
+// string a Writer appended to) must remain valid until done is called.  done
+// need only be move-constructible, and its allocation hooks (see
+// io/small_handler.h) are used for the handlers of the operation.
+template <typename Stream, typename Callback>
+void AsyncWrite(Stream *stream, StringView text, Callback done) {
+  if (text.empty()) {
+    done(io::error_code{});
+    return;
+  }
+  stream->async_prepare(1, internal::AsyncWriteOp<Stream, Callback>{
+                               stream, text, std::move(done)});
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_ASYNC_WRITE_H
@@ -0,0 +1,37 @@
+// Input generation shared by the JSON benchmarks.
+//
+#ifndef HITTOP_JSON_BENCH_UTIL_H
+#define HITTOP_JSON_BENCH_UTIL_H
+
+#include <cstddef>
+#include <string>
+
+namespace hittop {
+namespace json {
+namespace bench {
+
+// Returns an array of at least target_size bytes of flat records with
+// strings (some with escapes), integers, doubles, booleans and a short array
+// each.
+inline std::string MakeItemsDocument(std::size_t target_size) {
+  std::string doc = "[";
+  for (std::size_t i = 0; doc.size() < target_size; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    const std::string n = std::to_string(i);
+    doc += "{\"index\": " + n + ", \"name\": \"item " + n +
+           " with a \\\"quoted\\\" word\", \"price\": " +
+           std::to_string(i * 0.37) + ", \"ratio\": " +
+           std::to_string(1.0 / (i + 3)) + ", \"active\": " +
+           (i % 2 ? "true" : "false") + ", \"tags\": [\"red\", \"green\"]}";
+  }
+  doc += "]";
+  return doc;
+}
+
+} // namespace bench
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_BENCH_UTIL_H
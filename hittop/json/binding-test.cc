@@ -0,0 +1,179 @@
+#include "hittop/json/binding.h"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "boost/optional.hpp"
+
+#include "hittop/json/parser.h"
+#include "hittop/json/types.h"
+
+namespace json = hittop::json;
+
+namespace {
+
+struct Point {
+  double x = 0;
+  double y = 0;
+  std::string label;
+};
+
+struct Shape {
+  std::int32_t id = 0;
+  bool closed = false;
+  std::vector<Point> points;
+  boost::optional<std::string> name;
+  std::vector<std::uint8_t> color;
+};
+
+} // namespace
+
+namespace hittop {
+namespace json {
+
+template <>
+struct Binding<Point>
+    : Fields<Field<decltype(&Point::x), &Point::x, 'x'>,
+             Field<decltype(&Point::y), &Point::y, 'y'>,
+             Field<decltype(&Point::label), &Point::label, 'l', 'a', 'b', 'e',
+                   'l'>> {};
+
+template <>
+struct Binding<Shape>
+    : Fields<Field<decltype(&Shape::id), &Shape::id, 'i', 'd'>,
+             Field<decltype(&Shape::closed), &Shape::closed, 'c', 'l', 'o',
+                   's', 'e', 'd'>,
+             Field<decltype(&Shape::points), &Shape::points, 'p', 'o', 'i',
+                   'n', 't', 's'>,
+             Field<decltype(&Shape::name), &Shape::name, 'n', 'a', 'm', 'e'>,
+             Field<decltype(&Shape::color), &Shape::color, 'c', 'o', 'l', 'o',
+                   'r'>> {};
+
+} // namespace json
+} // namespace hittop
+
+namespace {
+
+bool Read(const std::string &input, Shape *shape) {
+  return json::ReadStruct(input, shape).ok();
+}
+
+} // namespace
+
+TEST(BindingTest, ReadsStruct) {
+  Shape shape;
+  ASSERT_TRUE(Read(R"( {
+    "id": -7,
+    "extra": {"nested": [1, "two", null, {"x": 3}]},
+    "points": [{"x": 1.5, "y": -2, "label": "a\nb"}, {"y": 1e3, "z": true}],
+    "closed": true,
+    "name": "triangle",
+    "color": [255, 0, 10],
+    "closed": false
+  } )",
+                   &shape));
+  EXPECT_EQ(shape.id, -7);
+  EXPECT_FALSE(shape.closed);
+  ASSERT_EQ(shape.points.size(), 2u);
+  EXPECT_EQ(shape.points[0].x, 1.5);
+  EXPECT_EQ(shape.points[0].y, -2);
+  EXPECT_EQ(shape.points[0].label, "a\nb");
+  EXPECT_EQ(shape.points[1].x, 0);
+  EXPECT_EQ(shape.points[1].y, 1000);
+  ASSERT_TRUE(shape.name);
+  EXPECT_EQ(*shape.name, "triangle");
+  EXPECT_EQ(shape.color, (std::vector<std::uint8_t>{255, 0, 10}));
+
+  // Members that are not mentioned keep their values.
+  ASSERT_TRUE(Read(R"({"name": null})", &shape));
+  EXPECT_EQ(shape.id, -7);
+  EXPECT_FALSE(shape.name);
+
+  // -0 is an integer, even though it is parsed as a double.
+  ASSERT_TRUE(Read(R"({"id": -0, "color": [-0]})", &shape));
+  EXPECT_EQ(shape.id, 0);
+  EXPECT_EQ(shape.color, (std::vector<std::uint8_t>{0}));
+}
+
+TEST(BindingTest, Errors) {
+  Shape shape;
+  const std::string inputs[] = {
+      R"({"id": 1.5})",          R"({"id": 3000000000})",
+      R"({"color": [256]})",     R"({"color": [-1]})",
+      R"({"closed": 1})",        R"({"name": 7})",
+      R"({"extra": [1, 2,]})",   R"({"extra": "\q"})",
+      R"({"id": 1} x)",          R"({"id" 1})",
+      R"({"points": [{"x": 1)", R"({"id": 12a})",
+      R"({"id": -0.0})",         R"({"id": -00})",
+  };
+  for (const std::string &input : inputs) {
+    EXPECT_FALSE(Read(input, &shape)) << input;
+  }
+  const std::string truncated = R"({"points": [{"x": 1)";
+  EXPECT_EQ(json::ReadStruct(truncated, &shape).error(),
+            hittop::parser::ParseError::INCOMPLETE);
+}
+
+TEST(BindingTest, DeepUnknownMember) {
+  // Unknown members are skipped without recursion, however deep they are.
+  const std::size_t kDepth = 1000000;
+  const std::string nested =
+      std::string(kDepth, '[') + std::string(kDepth, ']');
+  Shape shape;
+  EXPECT_TRUE(Read(R"({"id": 1, "junk": )" + nested + R"(, "closed": true})",
+                   &shape));
+  EXPECT_EQ(shape.id, 1);
+  EXPECT_TRUE(shape.closed);
+
+  std::string objects;
+  for (std::size_t i = 0; i < kDepth; ++i) {
+    objects += R"({"a":)";
+  }
+  objects += "0" + std::string(kDepth, '}');
+  EXPECT_TRUE(Read(R"({"junk": )" + objects + "}", &shape));
+
+  // Still checked as it is skipped.
+  EXPECT_FALSE(Read(R"({"junk": )" + std::string(kDepth, '[') + "}", &shape));
+  EXPECT_FALSE(Read(R"({"junk": [{"a":1]}})", &shape));
+  EXPECT_FALSE(Read(R"({"junk": {"a":1,}})", &shape));
+}
+
+TEST(BindingTest, RoundTrip) {
+  Shape shape;
+  shape.id = 42;
+  shape.closed = true;
+  shape.points = {{0.1, -3, "\"q\""}, {1e300, 0, ""}};
+  shape.color = {1, 2, 3};
+  const std::string text = json::StructToJson(shape);
+  EXPECT_EQ(text, R"({"id":42,"closed":true,"points":[{"x":0.1,"y":-3.0,)"
+                  R"("label":"\"q\""},{"x":1e+300,"y":0.0,"label":""}],)"
+                  R"("name":null,"color":[1,2,3]})");
+
+  Shape copy;
+  ASSERT_TRUE(Read(text, &copy));
+  EXPECT_EQ(json::StructToJson(copy), text);
+
+  // The text is ordinary JSON.
+  auto result = json::ParseValue(json::StructToJson(shape, true));
+  EXPECT_TRUE(result.ok());
+}
+
+TEST(BindingTest, PerfectHash) {
+  using Table = json::Binding<Shape>;
+  const std::vector<std::string> names = {"id", "closed", "points", "name",
+                                          "color"};
+  for (const std::string &name : names) {
+    const auto *field = Table::Find(name.data(), name.data() + name.size());
+    ASSERT_TRUE(field != nullptr) << name;
+    EXPECT_EQ(std::string(field->name, field->size), name);
+  }
+  for (const std::string name : {"", "i", "ids", "nam", "colour", "x"}) {
+    EXPECT_TRUE(Table::Find(name.data(), name.data() + name.size()) ==
+                nullptr)
+        << name;
+  }
+}
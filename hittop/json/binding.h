@@ -0,0 +1,665 @@
+// Compile-time binding of JSON objects to C++ structs.
+//
+// A binding describes the JSON form of a struct as a list of Fields, each a
+// pointer to a member and the member's name in JSON, spelled as a character
+// pack like parser::Literal.  It is declared by specializing Binding:
+//
+//   struct Point {
+//     double x;
+//     double y;
+//     std::string label;
+//   };
+//
+//   namespace hittop {
+//   namespace json {
+//   template <>
+//   struct Binding<Point>
+//       : Fields<Field<decltype(&Point::x), &Point::x, 'x'>,
+//                Field<decltype(&Point::y), &Point::y, 'y'>,
+//                Field<decltype(&Point::label), &Point::label,
+//                      'l', 'a', 'b', 'e', 'l'>> {};
+//   } // namespace json
+//   } // namespace hittop
+//
+// ReadStruct parses JSON text straight into a struct in one pass, without
+// building a Value: numbers are converted with ParseNumber and strings are
+// unescaped directly into the members they belong to.  Keys are dispatched
+// through a perfect hash table over the field names, which is found at
+// compile time, so that each key costs one hash and one comparison.  Members
+// whose keys do not appear in the text keep their previous values, and
+// members with unknown keys are checked and skipped.
+//
+// WriteStruct writes a struct with a Writer, from the same description.
+//
+// Members may be bool, arithmetic types, std::string, std::vector and
+// boost::optional (null when empty) of member types, or structs that have a
+// Binding themselves.  A number read into an integer member must be an
+// integer in the member's range.
+//
+#ifndef HITTOP_JSON_BINDING_H
+#define HITTOP_JSON_BINDING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "boost/optional.hpp"
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/number.h"
+#include "hittop/json/on_demand.h"
+#include "hittop/json/parse_visitor.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/writer.h"
+
+namespace hittop {
+namespace json {
+
+// Specialized for each bound struct, deriving from Fields<...>.
+template <typename T> struct Binding;
+
+namespace internal {
+
+using BindingResult = parser::ParseResult<const char *>;
+
+// Field names are hashed with FNV-1a, starting from a seed chosen so that the
+// names of a binding land in distinct slots.
+constexpr std::uint32_t FieldHashStep(std::uint32_t hash, char ch) {
+  return (hash ^ static_cast<unsigned char>(ch)) * 16777619u;
+}
+
+inline std::uint32_t HashFieldName(std::uint32_t seed, const char *first,
+                                   const char *last) {
+  std::uint32_t hash = seed;
+  for (; first != last; ++first) {
+    hash = FieldHashStep(hash, *first);
+  }
+  return hash;
+}
+
+// Takes the top bits of the hash after a Fibonacci multiplication, so that
+// the slot depends on every bit of the hash.
+constexpr std::size_t FieldSlot(std::uint32_t hash, unsigned bits) {
+  return static_cast<std::uint32_t>(hash * 2654435769u) >> (32 - bits);
+}
+
+// The number of bits in a slot index, for at least four slots per field.
+constexpr unsigned FieldSlotBits(std::size_t num_fields) {
+  unsigned bits = 1;
+  while ((std::size_t(1) << bits) < 4 * num_fields) {
+    ++bits;
+  }
+  return bits;
+}
+
+constexpr std::uint32_t kMaxFieldSeed = 1 << 16;
+
+template <std::size_t kSlots> struct FieldTable {
+  // 0 if no seed was found, i.e. there are duplicate names.
+  std::uint32_t seed;
+  // The index of the field in each slot plus one, or 0 if the slot is empty.
+  std::uint16_t slots[kSlots];
+};
+
+template <unsigned kBits, typename... F>
+constexpr FieldTable<std::size_t(1) << kBits> BuildFieldTable() {
+  for (std::uint32_t seed = 1; seed < kMaxFieldSeed; ++seed) {
+    FieldTable<std::size_t(1) << kBits> table{seed, {}};
+    const std::uint32_t hashes[] = {F::Hash(seed)...};
+    bool ok = true;
+    for (std::size_t i = 0; ok && i < sizeof...(F); ++i) {
+      std::uint16_t &slot = table.slots[FieldSlot(hashes[i], kBits)];
+      ok = slot == 0;
+      slot = static_cast<std::uint16_t>(i + 1);
+    }
+    if (ok) {
+      return table;
+    }
+  }
+  return FieldTable<std::size_t(1) << kBits>{0, {}};
+}
+
+template <typename Class> struct FieldEntry {
+  const char *name;
+  std::size_t size;
+  BindingResult (*read)(const char *, const char *, Class *);
+};
+
+// Reads the elements of the array at first, calling read(p, last) with the
+// position of each element; read returns the position just past it.
+template <typename Callback>
+BindingResult ReadElements(const char *first, const char *last,
+                           Callback read) {
+  if (first == last) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  if (*first != '[') {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  const char *p = SkipWhitespace(first + 1, last);
+  if (p != last && *p == ']') {
+    return p + 1;
+  }
+  for (;;) {
+    const BindingResult result = read(p, last);
+    if (!result.ok()) {
+      return result;
+    }
+    p = SkipWhitespace(result.get(), last);
+    if (p == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*p == ']') {
+      return p + 1;
+    }
+    if (*p != ',') {
+      return {p, parser::ParseError::BAD_CHAR};
+    }
+    p = SkipWhitespace(p + 1, last);
+  }
+}
+
+// Reads the members of the object at first, calling
+// read(key_first, key_last, has_escapes, p, last) with the raw contents of
+// each key and the position of its value.
+template <typename Callback>
+BindingResult ReadMembers(const char *first, const char *last, Callback read) {
+  if (first == last) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  if (*first != '{') {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  const char *p = SkipWhitespace(first + 1, last);
+  if (p != last && *p == '}') {
+    return p + 1;
+  }
+  for (;;) {
+    if (p == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*p != '"') {
+      return {p, parser::ParseError::BAD_CHAR};
+    }
+    const char *const key_first = p + 1;
+    bool has_escapes;
+    const BindingResult key = ScanStringContents(key_first, last, &has_escapes);
+    if (!key.ok()) {
+      return key;
+    }
+    p = SkipWhitespace(key.get() + 1, last);
+    if (p == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*p != ':') {
+      return {p, parser::ParseError::BAD_CHAR};
+    }
+    p = SkipWhitespace(p + 1, last);
+    const BindingResult result =
+        read(key_first, key.get(), has_escapes, p, last);
+    if (!result.ok()) {
+      return result;
+    }
+    p = SkipWhitespace(result.get(), last);
+    if (p == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*p == '}') {
+      return p + 1;
+    }
+    if (*p != ',') {
+      return {p, parser::ParseError::BAD_CHAR};
+    }
+    p = SkipWhitespace(p + 1, last);
+  }
+}
+
+// Checks the scalar at first and returns the position just past it.
+inline BindingResult SkipScalar(const char *first, const char *last) {
+  switch (*first) {
+  case '"': {
+    bool has_escapes;
+    const BindingResult result =
+        ScanStringContents(first + 1, last, &has_escapes);
+    if (!result.ok()) {
+      return result;
+    }
+    return result.get() + 1;
+  }
+  case 't':
+    return ScanLiteral(first, last, "true", 4);
+  case 'f':
+    return ScanLiteral(first, last, "false", 5);
+  case 'n':
+    return ScanLiteral(first, last, "null", 4);
+  default:
+    return ScanNumber(first, last);
+  }
+}
+
+// Checks the key and colon at first and returns the position of the value.
+inline BindingResult SkipKey(const char *first, const char *last) {
+  if (first == last) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  if (*first != '"') {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  bool has_escapes;
+  const BindingResult key = ScanStringContents(first + 1, last, &has_escapes);
+  if (!key.ok()) {
+    return key;
+  }
+  const char *const p = SkipWhitespace(key.get() + 1, last);
+  if (p == last) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  if (*p != ':') {
+    return {p, parser::ParseError::BAD_CHAR};
+  }
+  return SkipWhitespace(p + 1, last);
+}
+
+// Checks the value at first and returns the position just past it.  The text
+// is untrusted, so containers are tracked with a stack of their closing
+// brackets rather than by recursion, so that any depth of nesting is allowed.
+inline BindingResult SkipBoundValue(const char *first, const char *last) {
+  std::vector<char> closers;
+  const char *p = first;
+  for (;;) {
+    // p is at a value.
+    if (p == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*p == '[' || *p == '{') {
+      const char closer = *p == '[' ? ']' : '}';
+      p = SkipWhitespace(p + 1, last);
+      if (p != last && *p == closer) {
+        ++p;
+      } else {
+        closers.push_back(closer);
+        if (closer == '}') {
+          const BindingResult key = SkipKey(p, last);
+          if (!key.ok()) {
+            return key;
+          }
+          p = key.get();
+        }
+        continue;
+      }
+    } else {
+      const BindingResult result = SkipScalar(p, last);
+      if (!result.ok()) {
+        return result;
+      }
+      p = result.get();
+    }
+    // p is just past a value: close containers until one has another.
+    for (;;) {
+      if (closers.empty()) {
+        return p;
+      }
+      p = SkipWhitespace(p, last);
+      if (p == last) {
+        return {last, parser::ParseError::INCOMPLETE};
+      }
+      if (*p == closers.back()) {
+        closers.pop_back();
+        ++p;
+        continue;
+      }
+      if (*p != ',') {
+        return {p, parser::ParseError::BAD_CHAR};
+      }
+      p = SkipWhitespace(p + 1, last);
+      if (closers.back() == '}') {
+        const BindingResult key = SkipKey(p, last);
+        if (!key.ok()) {
+          return key;
+        }
+        p = key.get();
+      }
+      break;
+    }
+  }
+}
+
+// Parses the number at first, which must be followed by the end of a value.
+inline BindingResult ReadNumber(const char *first, const char *last,
+                                NumberValue *number) {
+  const BindingResult result = ParseNumber(first, last, number);
+  if (result.ok() && result.get() != last && !IsScalarEnd(*result.get())) {
+    return {result.get(), parser::ParseError::BAD_CHAR};
+  }
+  return result;
+}
+
+// Reads and writes members of type T.  Types without a specialization are
+// structs with a Binding.
+template <typename T, typename Enable = void> struct Codec {
+  static BindingResult Read(const char *first, const char *last, T *out) {
+    return Binding<T>::Read(first, last, out);
+  }
+
+  static void Write(const T &value, Writer *writer) {
+    Binding<T>::Write(value, writer);
+  }
+};
+
+template <> struct Codec<bool> {
+  static BindingResult Read(const char *first, const char *last, bool *out) {
+    if (first != last && *first == 't') {
+      *out = true;
+      return ScanLiteral(first, last, "true", 4);
+    }
+    if (first != last && *first == 'f') {
+      *out = false;
+      return ScanLiteral(first, last, "false", 5);
+    }
+    return {first, first == last ? parser::ParseError::INCOMPLETE
+                                 : parser::ParseError::BAD_CHAR};
+  }
+
+  static void Write(bool value, Writer *writer) { writer->Bool(value); }
+};
+
+template <typename T>
+struct Codec<T, typename std::enable_if<std::is_integral<T>::value &&
+                                        !std::is_same<T, bool>::value>::type> {
+  static BindingResult Read(const char *first, const char *last, T *out) {
+    NumberValue number;
+    const BindingResult result = ReadNumber(first, last, &number);
+    if (!result.ok()) {
+      return result;
+    }
+    // ParseNumber reads "-0" as a double to keep its sign, but it is an
+    // integer all the same.
+    if (result.get() - first == 2 && first[0] == '-' && first[1] == '0') {
+      *out = 0;
+      return result;
+    }
+    if (!Fits(number)) {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    *out = number.kind == NumberValue::Kind::kInt64
+               ? static_cast<T>(number.int64)
+               : static_cast<T>(number.uint64);
+    return result;
+  }
+
+  static void Write(T value, Writer *writer) {
+    if (std::is_signed<T>::value) {
+      writer->Int64(value);
+    } else {
+      writer->Uint64(value);
+    }
+  }
+
+private:
+  static bool Fits(const NumberValue &number) {
+    switch (number.kind) {
+    case NumberValue::Kind::kInt64:
+      if (number.int64 < 0) {
+        return std::is_signed<T>::value &&
+               number.int64 >=
+                   static_cast<std::int64_t>(std::numeric_limits<T>::min());
+      }
+      return static_cast<std::uint64_t>(number.int64) <=
+             static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+    case NumberValue::Kind::kUint64:
+      return number.uint64 <=
+             static_cast<std::uint64_t>(std::numeric_limits<T>::max());
+    default:
+      return false;
+    }
+  }
+};
+
+template <typename T>
+struct Codec<T, typename std::enable_if<
+                    std::is_floating_point<T>::value>::type> {
+  static BindingResult Read(const char *first, const char *last, T *out) {
+    NumberValue number;
+    const BindingResult result = ReadNumber(first, last, &number);
+    if (result.ok()) {
+      *out = static_cast<T>(number.ToDouble());
+    }
+    return result;
+  }
+
+  static void Write(T value, Writer *writer) { writer->Double(value); }
+};
+
+template <> struct Codec<std::string> {
+  // Reuses the capacity of *out.
+  static BindingResult Read(const char *first, const char *last,
+                            std::string *out) {
+    if (first == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    if (*first != '"') {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    bool has_escapes;
+    const BindingResult result =
+        ScanStringContents(first + 1, last, &has_escapes);
+    if (!result.ok()) {
+      return result;
+    }
+    if (!has_escapes) {
+      out->assign(first + 1, result.get());
+    } else {
+      // Unescaping never makes a string longer.
+      out->resize(result.get() - (first + 1));
+      out->resize(UnescapeUnsafe(first + 1, result.get(), &(*out)[0]) -
+                  &(*out)[0]);
+    }
+    return result.get() + 1;
+  }
+
+  static void Write(const std::string &value, Writer *writer) {
+    writer->String(value);
+  }
+};
+
+template <typename T> struct Codec<std::vector<T>> {
+  static BindingResult Read(const char *first, const char *last,
+                            std::vector<T> *out) {
+    out->clear();
+    return ReadElements(first, last, [out](const char *p, const char *last) {
+      out->emplace_back();
+      return Codec<T>::Read(p, last, &out->back());
+    });
+  }
+
+  static void Write(const std::vector<T> &value, Writer *writer) {
+    writer->StartArray();
+    for (const T &element : value) {
+      Codec<T>::Write(element, writer);
+    }
+    writer->EndArray();
+  }
+};
+
+template <typename T> struct Codec<boost::optional<T>> {
+  static BindingResult Read(const char *first, const char *last,
+                            boost::optional<T> *out) {
+    if (first != last && *first == 'n') {
+      *out = boost::none;
+      return ScanLiteral(first, last, "null", 4);
+    }
+    if (!*out) {
+      out->emplace();
+    }
+    return Codec<T>::Read(first, last, out->get_ptr());
+  }
+
+  static void Write(const boost::optional<T> &value, Writer *writer) {
+    if (value) {
+      Codec<T>::Write(*value, writer);
+    } else {
+      writer->Null();
+    }
+  }
+};
+
+} // namespace internal
+
+// A member of Class with the JSON name Name...; MemberPointer is the type of
+// Member, e.g. decltype(&Point::x).
+template <typename MemberPointer, MemberPointer Member, char... Name>
+struct Field;
+
+template <typename Class, typename T, T Class::*Member, char... Name>
+struct Field<T Class::*, Member, Name...> {
+  using class_type = Class;
+  using member_type = T;
+
+  static constexpr std::uint32_t Hash(std::uint32_t seed) {
+    const char name[] = {Name..., '\0'};
+    std::uint32_t hash = seed;
+    for (std::size_t i = 0; i < sizeof...(Name); ++i) {
+      hash = internal::FieldHashStep(hash, name[i]);
+    }
+    return hash;
+  }
+
+  static StringView name() {
+    static constexpr char kName[] = {Name..., '\0'};
+    return StringView(kName, sizeof...(Name));
+  }
+
+  static internal::BindingResult Read(const char *first, const char *last,
+                                      Class *object) {
+    return internal::Codec<T>::Read(first, last, &(object->*Member));
+  }
+
+  static void Write(const Class &object, Writer *writer) {
+    writer->Key(name());
+    internal::Codec<T>::Write(object.*Member, writer);
+  }
+};
+
+// The fields of a binding; the names must be distinct.
+template <typename First, typename... Rest> class Fields {
+public:
+  using class_type = typename First::class_type;
+
+  // Reads the object at first into *object, and returns the position just
+  // past it.
+  static internal::BindingResult Read(const char *first, const char *last,
+                                      class_type *object) {
+    return internal::ReadMembers(
+        first, last,
+        [object](const char *key_first, const char *key_last, bool has_escapes,
+                 const char *p, const char *last) {
+          const internal::FieldEntry<class_type> *field;
+          if (!has_escapes) {
+            field = Find(key_first, key_last);
+          } else {
+            const std::string key =
+                internal::UnescapeUnsafe(boost::make_iterator_range(
+                    key_first, key_last));
+            field = Find(key.data(), key.data() + key.size());
+          }
+          if (field == nullptr) {
+            return internal::SkipBoundValue(p, last);
+          }
+          return field->read(p, last, object);
+        });
+  }
+
+  static void Write(const class_type &object, Writer *writer) {
+    writer->StartObject();
+    First::Write(object, writer);
+    // (Expands Rest::Write in order.)
+    const int expand[] = {0, (Rest::Write(object, writer), 0)...};
+    (void)expand;
+    writer->EndObject();
+  }
+
+  // Returns the field with the given (unescaped) name, or nullptr.
+  static const internal::FieldEntry<class_type> *Find(const char *first,
+                                                      const char *last) {
+    static const internal::FieldEntry<class_type> kEntries[] = {
+        {First::name().data(), First::name().size(), &First::Read},
+        {Rest::name().data(), Rest::name().size(), &Rest::Read}...};
+    const std::uint16_t slot = kTable.slots[internal::FieldSlot(
+        internal::HashFieldName(kTable.seed, first, last), kBits)];
+    if (slot == 0) {
+      return nullptr;
+    }
+    const internal::FieldEntry<class_type> &entry = kEntries[slot - 1];
+    if (entry.size != static_cast<std::size_t>(last - first) ||
+        std::memcmp(entry.name, first, entry.size) != 0) {
+      return nullptr;
+    }
+    return &entry;
+  }
+
+private:
+  static constexpr unsigned kBits =
+      internal::FieldSlotBits(1 + sizeof...(Rest));
+  static constexpr internal::FieldTable<std::size_t(1) << kBits> kTable =
+      internal::BuildFieldTable<kBits, First, Rest...>();
+  static_assert(kTable.seed != 0, "json field names must be distinct");
+};
+
+template <typename First, typename... Rest>
+constexpr unsigned Fields<First, Rest...>::kBits;
+
+template <typename First, typename... Rest>
+constexpr internal::FieldTable<std::size_t(1)
+                               << Fields<First, Rest...>::kBits>
+    Fields<First, Rest...>::kTable;
+
+// Parses the JSON text [first, last), a single value with optional
+// whitespace around it, into *out.  Returns last, or the position of an
+// invalid character with error BAD_CHAR (or INCOMPLETE if the text ends too
+// soon).  On error, *out may have been partly updated.
+template <typename T>
+parser::ParseResult<const char *> ReadStruct(const char *first,
+                                             const char *last, T *out) {
+  const char *p = internal::SkipWhitespace(first, last);
+  const internal::BindingResult result =
+      internal::Codec<T>::Read(p, last, out);
+  if (!result.ok()) {
+    return result;
+  }
+  p = internal::SkipWhitespace(result.get(), last);
+  if (p != last) {
+    return {p, parser::ParseError::BAD_CHAR};
+  }
+  return p;
+}
+
+template <typename T>
+parser::ParseResult<const char *> ReadStruct(const std::string &input,
+                                             T *out) {
+  return ReadStruct(input.data(), input.data() + input.size(), out);
+}
+
+template <typename T> void WriteStruct(const T &value, Writer *writer) {
+  internal::Codec<T>::Write(value, writer);
+}
+
+// Returns the JSON text of a bound struct (or vector, etc. of them).
+template <typename T>
+std::string StructToJson(const T &value, bool pretty = false) {
+  std::string out;
+  Writer writer(&out, pretty);
+  WriteStruct(value, &writer);
+  return out;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_BINDING_H
@@ -0,0 +1,116 @@
+// Compares reading a generated ~1MB document into structs with ReadStruct to
+// parsing it into a json::Value tree (which would still have to be converted
+// to structs) and into a tape, and measures writing the structs back with
+// WriteStruct.
+//
+// usage: binding_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/bench_util.h"
+#include "hittop/json/binding.h"
+#include "hittop/json/parser.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+struct Item {
+  std::int64_t index = 0;
+  std::string name;
+  double price = 0;
+  double ratio = 0;
+  bool active = false;
+  std::vector<std::string> tags;
+};
+
+} // namespace
+
+namespace hittop {
+namespace json {
+
+template <>
+struct Binding<Item>
+    : Fields<Field<decltype(&Item::index), &Item::index, 'i', 'n', 'd', 'e',
+                   'x'>,
+             Field<decltype(&Item::name), &Item::name, 'n', 'a', 'm', 'e'>,
+             Field<decltype(&Item::price), &Item::price, 'p', 'r', 'i', 'c',
+                   'e'>,
+             Field<decltype(&Item::ratio), &Item::ratio, 'r', 'a', 't', 'i',
+                   'o'>,
+             Field<decltype(&Item::active), &Item::active, 'a', 'c', 't', 'i',
+                   'v', 'e'>,
+             Field<decltype(&Item::tags), &Item::tags, 't', 'a', 'g', 's'>> {
+};
+
+} // namespace json
+} // namespace hittop
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100;
+  const std::string input = json::bench::MakeItemsDocument(1 << 20);
+
+  std::vector<Item> items;
+  if (!json::ReadStruct(input, &items).ok()) {
+    std::cerr << "Fail!" << std::endl;
+    return 1;
+  }
+
+  std::size_t checksum = 0;
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::ReadStruct(input, &items);
+      checksum += items.size();
+    });
+    Report("read_struct", usec, count, input.size());
+  }
+
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      auto result = json::ParseValue(input);
+      checksum += result.ok();
+    });
+    Report("parse_value", usec, count, input.size());
+  }
+
+  json::StructuralParser parser;
+  json::Document doc;
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      parser.Parse(input.data(), input.data() + input.size(), &doc);
+      checksum += doc.tape().size();
+    });
+    Report("parse_tape", usec, count, input.size());
+  }
+
+  std::string out;
+  for (int j = 0; j < 5; ++j) {
+    std::size_t size = 0;
+    const double usec = TimeUsec(count, [&]() {
+      out.clear();
+      json::Writer writer(&out);
+      json::WriteStruct(items, &writer);
+      size = out.size();
+    });
+    Report("write_struct", usec, count, size);
+    checksum += size;
+  }
+
+  std::cout << "doc size: " << input.size() << " checksum: " << checksum
+            << std::endl;
+  return 0;
+}
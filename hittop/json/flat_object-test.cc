@@ -0,0 +1,155 @@
+#include "hittop/json/flat_object.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/types.h"
+
+namespace json = hittop::json;
+
+namespace {
+
+std::vector<std::string> Keys(const json::Object &object) {
+  std::vector<std::string> keys;
+  for (const auto &member : object) {
+    keys.push_back(member.first.str());
+  }
+  return keys;
+}
+
+json::Value MustParse(const std::string &input, json::KeyTable *keys) {
+  auto result = json::ParseValue(input, keys);
+  EXPECT_TRUE(result.ok());
+  return std::get<0>(result.consume());
+}
+
+} // namespace
+
+TEST(FlatObjectTest, InsertionOrderAndLookup) {
+  json::Object object;
+  EXPECT_TRUE(object.emplace("b", json::Number(1)).second);
+  EXPECT_TRUE(object.emplace("a", json::Boolean(true)).second);
+  EXPECT_FALSE(object.emplace("b", json::Number(2)).second);
+  object["c"] = json::String("x");
+  EXPECT_EQ(Keys(object), (std::vector<std::string>{"b", "a", "c"}));
+  EXPECT_EQ(object.size(), 3u);
+  EXPECT_TRUE(object.at("b") == json::Number(1));
+  EXPECT_EQ(object.count("a"), 1u);
+  EXPECT_EQ(object.count("z"), 0u);
+  EXPECT_TRUE(object.find("z") == object.end());
+  EXPECT_THROW(object.at("z"), std::out_of_range);
+  EXPECT_EQ(object.erase("a"), 1u);
+  EXPECT_EQ(Keys(object), (std::vector<std::string>{"b", "c"}));
+
+  // Equality does not depend on order.
+  json::Object other = {{"c", json::String("x")}, {"b", json::Number(1)}};
+  EXPECT_TRUE(object == other);
+  other["d"];
+  EXPECT_FALSE(object == other);
+}
+
+TEST(FlatObjectTest, KeysAreConst) {
+  json::Object object = {{"a", json::Number(1)}, {"b", json::Number(2)}};
+  using MemberKey = decltype(object.begin()->first);
+  using ConstMemberKey =
+      decltype(static_cast<const json::Object &>(object).begin()->first);
+  static_assert(std::is_const<std::remove_reference<MemberKey>::type>::value,
+                "keys are const");
+  static_assert(
+      std::is_const<std::remove_reference<ConstMemberKey>::type>::value,
+      "keys are const");
+
+  // Values can still be changed through iterators.
+  object.find("a")->second = json::String("x");
+  for (auto &&member : object) {
+    if (member.first == json::Key("b")) {
+      member.second = json::Boolean(false);
+    }
+  }
+  json::Object::const_iterator it = object.begin();
+  EXPECT_TRUE(it->second == json::String("x"));
+  EXPECT_TRUE((*++it).second == json::Boolean(false));
+  EXPECT_EQ(it - object.begin(), 1);
+  EXPECT_TRUE(it + 1 == object.end());
+}
+
+TEST(FlatObjectTest, LookupByText) {
+  json::KeyTable keys;
+  const json::Key id = keys.Intern("id");
+  json::Object object;
+  object.emplace(id, json::Number(1));
+  const json::StringView text("id");
+  const std::string name = "name";
+  object[text] = json::Number(2);
+  object[name] = json::String("x");
+  EXPECT_EQ(Keys(object), (std::vector<std::string>{"id", "name"}));
+  EXPECT_TRUE(object.at("id") == json::Number(2));
+  EXPECT_TRUE(object.begin()->first.shares_string(id));
+
+  // Members added by text are indexed like any other.
+  for (int i = 0; i < 100; ++i) {
+    object["key" + std::to_string(i)] = json::Number(i);
+  }
+  EXPECT_EQ(object.size(), 102u);
+  EXPECT_TRUE(object["key50"] == json::Number(50));
+  EXPECT_EQ(object.size(), 102u);
+
+  // Empty keys share one string.
+  EXPECT_TRUE(json::Key().shares_string(json::Key()));
+  EXPECT_TRUE(json::Key() == json::Key(""));
+  EXPECT_EQ(json::Key().hash(), json::Key("").hash());
+}
+
+TEST(FlatObjectTest, LargeObjectsAreIndexed) {
+  json::Object object;
+  const std::size_t kSize = 1000;
+  for (std::size_t i = 0; i < kSize; ++i) {
+    object.emplace("key" + std::to_string(i), json::Number(i));
+  }
+  EXPECT_FALSE(object.emplace("key17", json::Number(0)).second);
+  for (std::size_t i = 0; i < kSize; ++i) {
+    EXPECT_TRUE(object.at("key" + std::to_string(i)) == json::Number(i));
+  }
+  EXPECT_EQ(object.count("key1000"), 0u);
+
+  // Copies and erasures keep the index consistent.
+  json::Object copy = object;
+  EXPECT_EQ(copy.erase("key500"), 1u);
+  EXPECT_EQ(copy.count("key500"), 0u);
+  EXPECT_TRUE(copy.at("key999") == json::Number(999));
+  EXPECT_EQ(object.count("key500"), 1u);
+  EXPECT_EQ(Keys(copy).back(), "key999");
+}
+
+TEST(FlatObjectTest, KeysAreInterned) {
+  json::KeyTable keys;
+  const json::Value value = MustParse(
+      R"([{"id": 1, "name": "a"}, {"id": 2, "name": "b"}, {"name": "c"}])",
+      &keys);
+  EXPECT_EQ(keys.size(), 2u);
+  const auto &array = static_cast<const json::Array &>(value);
+  const auto &first = static_cast<const json::Object &>(array[0]);
+  const auto &second = static_cast<const json::Object &>(array[1]);
+  EXPECT_TRUE(first.begin()->first.shares_string(second.begin()->first));
+
+  // Across documents parsed with the same table.
+  const json::Value other = MustParse(R"({"name": "d", "new": 0})", &keys);
+  EXPECT_EQ(keys.size(), 3u);
+  const auto &object = static_cast<const json::Object &>(other);
+  EXPECT_TRUE(object.begin()->first.shares_string(
+      std::next(first.begin())->first));
+
+  // Keys not from the same table are still equal by value.
+  EXPECT_TRUE(json::Key("id") == first.begin()->first);
+  EXPECT_FALSE(json::Key("id").shares_string(first.begin()->first));
+}
+
+TEST(FlatObjectTest, SmallerThanHashMap) {
+  EXPECT_LT(sizeof(json::Object), sizeof(std::unordered_map<int, int>));
+}
@@ -0,0 +1,416 @@
+// A compact representation of JSON objects.
+//
+// FlatObject keeps its members in a vector, in insertion order, which takes
+// far less memory and time to build than a node-based hash map for the small
+// objects that make up most documents.  Lookups scan the vector until an
+// object has more than FlatObject::kIndexThreshold members; larger objects
+// also get an open-addressing hash index over the members' positions.
+//
+// Keys are Key objects: immutable, reference-counted strings with a
+// precomputed hash.  A KeyTable interns keys, so that every object in a
+// document (or in all documents parsed with the same table) that has a member
+// "id" refers to the same string.  An array of objects that all have the same
+// keys therefore stores each key once, and comparing interned keys while
+// building an object is usually a pointer comparison.
+//
+#ifndef HITTOP_JSON_FLAT_OBJECT_H
+#define HITTOP_JSON_FLAT_OBJECT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "boost/iterator/iterator_adaptor.hpp"
+#include "boost/smart_ptr/intrusive_ptr.hpp"
+#include "boost/smart_ptr/intrusive_ref_counter.hpp"
+#include "boost/utility/string_ref.hpp"
+
+#include "hittop/util/hash.h"
+
+namespace hittop {
+namespace json {
+
+using StringView = boost::string_ref;
+
+namespace internal {
+
+inline std::uint64_t HashKey(StringView text) {
+  util::StreamingHash64 hash;
+  hash.update(text.data(), text.size());
+  return hash.digest();
+}
+
+struct KeyData
+    : boost::intrusive_ref_counter<KeyData, boost::thread_safe_counter> {
+  KeyData(StringView text, std::uint64_t hash)
+      : text(text.begin(), text.end()), hash(hash) {}
+
+  const std::string text;
+  const std::uint64_t hash;
+};
+
+} // namespace internal
+
+class Key {
+public:
+  // All empty keys made this way share one string, so this does not
+  // allocate.
+  Key() : data_(EmptyData()) {}
+
+  Key(StringView text)
+      : data_(new internal::KeyData(text, internal::HashKey(text))) {}
+
+  Key(const std::string &text) : Key(StringView(text)) {}
+
+  Key(const char *text) : Key(StringView(text)) {}
+
+  const std::string &str() const { return data_->text; }
+
+  operator StringView() const { return data_->text; }
+
+  std::uint64_t hash() const { return data_->hash; }
+
+  // True if both keys refer to the same string, e.g. because they were
+  // interned in the same KeyTable.
+  bool shares_string(const Key &that) const { return data_ == that.data_; }
+
+  friend bool operator==(const Key &lhs, const Key &rhs) {
+    return lhs.data_ == rhs.data_ ||
+           (lhs.hash() == rhs.hash() && lhs.str() == rhs.str());
+  }
+
+  friend bool operator!=(const Key &lhs, const Key &rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  friend class KeyTable;
+
+  explicit Key(boost::intrusive_ptr<internal::KeyData> data)
+      : data_(std::move(data)) {}
+
+  static const boost::intrusive_ptr<internal::KeyData> &EmptyData() {
+    static const boost::intrusive_ptr<internal::KeyData> empty(
+        new internal::KeyData(StringView(), internal::HashKey(StringView())));
+    return empty;
+  }
+
+  boost::intrusive_ptr<internal::KeyData> data_;
+};
+
+// Interns keys.  A KeyTable only grows; keys stay alive as long as the table
+// or any object using them does.  It is not thread-safe.
+class KeyTable {
+public:
+  KeyTable() = default;
+
+  KeyTable(const KeyTable &) = delete;
+  KeyTable &operator=(const KeyTable &) = delete;
+
+  // Returns the key with the given text, creating it the first time.
+  Key Intern(StringView text) {
+    const std::uint64_t hash = internal::HashKey(text);
+    auto range = keys_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.str() == text) {
+        return it->second;
+      }
+    }
+    Key key(boost::intrusive_ptr<internal::KeyData>(
+        new internal::KeyData(text, hash)));
+    keys_.emplace(hash, key);
+    return key;
+  }
+
+  std::size_t size() const { return keys_.size(); }
+
+private:
+  struct IdentityHash {
+    std::size_t operator()(std::uint64_t hash) const { return hash; }
+  };
+
+  std::unordered_multimap<std::uint64_t, Key, IdentityHash> keys_;
+};
+
+namespace internal {
+
+// Iterates over the (key, value) entries of a FlatObject, yielding pairs of
+// references in which the key is const, as in a std::unordered_map: a key
+// changed in place would leave the object's index stale.
+template <typename EntryIterator, typename Mapped>
+class FlatObjectIterator
+    : public boost::iterator_adaptor<
+          FlatObjectIterator<EntryIterator, Mapped>, EntryIterator,
+          std::pair<const Key, typename std::remove_const<Mapped>::type>,
+          boost::use_default, std::pair<const Key &, Mapped &>> {
+public:
+  FlatObjectIterator() = default;
+
+  explicit FlatObjectIterator(EntryIterator entry)
+      : FlatObjectIterator::iterator_adaptor_(entry) {}
+
+  // Converts an iterator to a const_iterator.
+  template <typename OtherIterator, typename OtherMapped>
+  FlatObjectIterator(
+      const FlatObjectIterator<OtherIterator, OtherMapped> &that,
+      typename std::enable_if<
+          std::is_convertible<OtherIterator, EntryIterator>::value>::type * =
+          nullptr)
+      : FlatObjectIterator::iterator_adaptor_(that.base()) {}
+
+private:
+  friend class boost::iterator_core_access;
+
+  std::pair<const Key &, Mapped &> dereference() const {
+    return {this->base()->first, this->base()->second};
+  }
+};
+
+} // namespace internal
+
+// ValueType is json::Value; FlatObject is a template only so that it can be
+// declared before Value is complete.
+template <typename ValueType> class FlatObject {
+private:
+  using Entry = std::pair<Key, ValueType>;
+
+public:
+  using key_type = Key;
+  using mapped_type = ValueType;
+  using value_type = std::pair<const Key, ValueType>;
+  using iterator = internal::FlatObjectIterator<
+      typename std::vector<Entry>::iterator, ValueType>;
+  using const_iterator = internal::FlatObjectIterator<
+      typename std::vector<Entry>::const_iterator, const ValueType>;
+
+  // Objects with more members than this have a hash index.
+  static constexpr std::size_t kIndexThreshold = 16;
+
+  FlatObject() = default;
+
+  FlatObject(std::initializer_list<value_type> members) {
+    for (const value_type &member : members) {
+      emplace(member.first, member.second);
+    }
+  }
+
+  FlatObject(const FlatObject &that) : entries_(that.entries_) {
+    if (that.index_) {
+      index_.reset(new std::vector<std::uint32_t>(*that.index_));
+    }
+  }
+
+  FlatObject(FlatObject &&) = default;
+
+  FlatObject &operator=(const FlatObject &that) {
+    if (this != &that) {
+      FlatObject copy(that);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  FlatObject &operator=(FlatObject &&) = default;
+
+  std::size_t size() const { return entries_.size(); }
+
+  bool empty() const { return entries_.empty(); }
+
+  void reserve(std::size_t size) { entries_.reserve(size); }
+
+  void clear() {
+    entries_.clear();
+    index_.reset();
+  }
+
+  iterator begin() { return iterator(entries_.begin()); }
+  iterator end() { return iterator(entries_.end()); }
+  const_iterator begin() const { return const_iterator(entries_.begin()); }
+  const_iterator end() const { return const_iterator(entries_.end()); }
+
+  iterator find(StringView key) { return begin() + Find(key); }
+
+  const_iterator find(StringView key) const { return begin() + Find(key); }
+
+  std::size_t count(StringView key) const { return Find(key) != size(); }
+
+  // Throws std::out_of_range if there is no member with the given key.
+  ValueType &at(StringView key) { return entries_[FindOrThrow(key)].second; }
+
+  const ValueType &at(StringView key) const {
+    return entries_[FindOrThrow(key)].second;
+  }
+
+  ValueType &operator[](const Key &key) {
+    return emplace(key).first->second;
+  }
+
+  // As above, but a Key is only made (and its string allocated) if the
+  // member has to be added.
+  ValueType &operator[](StringView key) {
+    const std::size_t pos = Find(key);
+    if (pos != size()) {
+      return entries_[pos].second;
+    }
+    return Append(Key(key))->second;
+  }
+
+  ValueType &operator[](const std::string &key) {
+    return (*this)[StringView(key)];
+  }
+
+  ValueType &operator[](const char *key) { return (*this)[StringView(key)]; }
+
+  // Adds a member unless one with the same key is already present, like
+  // std::unordered_map::emplace.
+  template <typename... A>
+  std::pair<iterator, bool> emplace(const Key &key, A &&... args) {
+    const std::size_t pos = Find(key);
+    if (pos != size()) {
+      return {begin() + pos, false};
+    }
+    return {Append(key, std::forward<A>(args)...), true};
+  }
+
+  std::size_t erase(StringView key) {
+    const std::size_t pos = Find(key);
+    if (pos == size()) {
+      return 0;
+    }
+    entries_.erase(entries_.begin() + pos);
+    if (index_) {
+      BuildIndex();
+    }
+    return 1;
+  }
+
+  // Objects are equal if they have the same members, in any order.
+  friend bool operator==(const FlatObject &lhs, const FlatObject &rhs) {
+    if (lhs.size() != rhs.size()) {
+      return false;
+    }
+    for (const auto &member : lhs) {
+      auto it = rhs.find(member.first);
+      if (it == rhs.end() || !(it->second == member.second)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const FlatObject &lhs, const FlatObject &rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  // Adds a member whose key is known not to be present.
+  template <typename... A> iterator Append(const Key &key, A &&... args) {
+    const std::size_t pos = size();
+    entries_.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(std::forward<A>(args)...));
+    if (index_) {
+      Insert(pos);
+    } else if (size() > kIndexThreshold) {
+      BuildIndex();
+    }
+    return begin() + pos;
+  }
+
+  std::size_t FindOrThrow(StringView key) const {
+    const std::size_t pos = Find(key);
+    if (pos == size()) {
+      throw std::out_of_range("json object has no member \"" +
+                              key.to_string() + "\"");
+    }
+    return pos;
+  }
+
+  // Returns the position of the member with the given key, or size().
+  std::size_t Find(StringView key) const {
+    if (!index_) {
+      for (std::size_t i = 0; i < size(); ++i) {
+        const std::string &text = entries_[i].first.str();
+        if (text.size() == key.size() && StringView(text) == key) {
+          return i;
+        }
+      }
+      return size();
+    }
+    return Lookup(key, internal::HashKey(key));
+  }
+
+  // As above, but with the precomputed hash of an existing key.
+  std::size_t Find(const Key &key) const {
+    if (!index_) {
+      for (std::size_t i = 0; i < size(); ++i) {
+        if (entries_[i].first == key) {
+          return i;
+        }
+      }
+      return size();
+    }
+    return Lookup(key, key.hash());
+  }
+
+  std::size_t Lookup(StringView key, std::uint64_t hash) const {
+    const std::vector<std::uint32_t> &slots = *index_;
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+      if (slots[i] == 0) {
+        return size();
+      }
+      const Key &candidate = entries_[slots[i] - 1].first;
+      if (candidate.hash() == hash && StringView(candidate) == key) {
+        return slots[i] - 1;
+      }
+    }
+  }
+
+  void Insert(std::size_t pos) {
+    std::vector<std::uint32_t> &slots = *index_;
+    if (size() * 2 > slots.size()) {
+      BuildIndex();
+      return;
+    }
+    const std::size_t mask = slots.size() - 1;
+    std::size_t i = entries_[pos].first.hash() & mask;
+    while (slots[i] != 0) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = static_cast<std::uint32_t>(pos + 1);
+  }
+
+  // (Re)builds the index with four slots per member; Insert rebuilds it when
+  // it becomes half full.
+  void BuildIndex() {
+    std::size_t capacity = 4 * kIndexThreshold;
+    while (capacity < size() * 4) {
+      capacity *= 2;
+    }
+    index_.reset(new std::vector<std::uint32_t>(capacity, 0));
+    const std::size_t mask = capacity - 1;
+    for (std::size_t pos = 0; pos < size(); ++pos) {
+      std::size_t i = entries_[pos].first.hash() & mask;
+      while ((*index_)[i] != 0) {
+        i = (i + 1) & mask;
+      }
+      (*index_)[i] = static_cast<std::uint32_t>(pos + 1);
+    }
+  }
+
+  std::vector<Entry> entries_;
+  // Slots hold a position + 1, or 0 if empty; null for small objects.
+  std::unique_ptr<std::vector<std::uint32_t>> index_;
+};
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_FLAT_OBJECT_H
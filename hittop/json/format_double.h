@@ -0,0 +1,381 @@
+// Shortest round-trip formatting of doubles (Grisu2).
+//
+// FormatDouble produces the decimal digits of a double with Florian Loitsch's
+// Grisu2 algorithm: the value and its rounding boundaries are scaled by a
+// cached power of ten into a fixed-point range where the digits can be
+// generated with 64-bit integer arithmetic, and as few digits are generated
+// as are needed to identify the value uniquely.  The output always reads back
+// as the same double, and is the shortest such string for nearly all values
+// (Grisu2 occasionally produces one digit more than necessary).  This follows
+// the implementation in the nlohmann/json library.
+//
+#ifndef HITTOP_JSON_FORMAT_DOUBLE_H
+#define HITTOP_JSON_FORMAT_DOUBLE_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace hittop {
+namespace json {
+namespace internal {
+
+// An unnormalized floating point number f * 2^e.
+struct DiyFp {
+  std::uint64_t f;
+  int e;
+
+  DiyFp(std::uint64_t f, int e) : f(f), e(e) {}
+
+  static DiyFp Sub(const DiyFp &x, const DiyFp &y) {
+    return DiyFp(x.f - y.f, x.e);
+  }
+
+  // The product, rounded to 64 bits.
+  static DiyFp Mul(const DiyFp &x, const DiyFp &y) {
+    const unsigned __int128 p = static_cast<unsigned __int128>(x.f) * y.f;
+    std::uint64_t h = static_cast<std::uint64_t>(p >> 64);
+    const std::uint64_t l = static_cast<std::uint64_t>(p);
+    h += l >> 63;
+    return DiyFp(h, x.e + y.e + 64);
+  }
+
+  static DiyFp Normalize(DiyFp x) {
+    while ((x.f >> 63) == 0) {
+      x.f <<= 1;
+      --x.e;
+    }
+    return x;
+  }
+
+  static DiyFp NormalizeTo(const DiyFp &x, int target_exponent) {
+    return DiyFp(x.f << (x.e - target_exponent), target_exponent);
+  }
+};
+
+// A positive double v and the midpoints to its neighbours, m- and m+, all
+// normalized to the same exponent.
+struct Boundaries {
+  DiyFp w;
+  DiyFp minus;
+  DiyFp plus;
+};
+
+inline Boundaries ComputeBoundaries(double value) {
+  constexpr int kBias = 1023 + 52;
+  constexpr int kMinExp = 1 - kBias;
+  constexpr std::uint64_t kHiddenBit = std::uint64_t{1} << 52;
+
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const std::uint64_t biased_e = bits >> 52;
+  const std::uint64_t fraction = bits & (kHiddenBit - 1);
+
+  const DiyFp v =
+      biased_e == 0
+          ? DiyFp(fraction, kMinExp)
+          : DiyFp(fraction + kHiddenBit, static_cast<int>(biased_e) - kBias);
+  // The lower neighbour is closer if v is a power of two (other than the
+  // smallest normal).
+  const bool lower_boundary_is_closer = fraction == 0 && biased_e > 1;
+  const DiyFp m_plus(2 * v.f + 1, v.e - 1);
+  const DiyFp m_minus = lower_boundary_is_closer
+                            ? DiyFp(4 * v.f - 1, v.e - 2)
+                            : DiyFp(2 * v.f - 1, v.e - 1);
+  const DiyFp w_plus = DiyFp::Normalize(m_plus);
+  return {DiyFp::Normalize(v), DiyFp::NormalizeTo(m_minus, w_plus.e), w_plus};
+}
+
+// The digits are generated from a product whose binary exponent lies in
+// [kAlpha, kGamma], so the integral part fits in 32 bits.
+constexpr int kAlpha = -60;
+constexpr int kGamma = -32;
+
+struct CachedPower {
+  std::uint64_t f;
+  int e;
+  int k;
+};
+
+// 10^k for k = -300, -292, ..., 324, normalized and rounded to 64 bits.
+constexpr CachedPower kCachedPowers[] = {
+    {0xAB70FE17C79AC6CAULL, -1060, -300},
+    {0xFF77B1FCBEBCDC4FULL, -1034, -292},
+    {0xBE5691EF416BD60CULL, -1007, -284},
+    {0x8DD01FAD907FFC3CULL, -980, -276},
+    {0xD3515C2831559A83ULL, -954, -268},
+    {0x9D71AC8FADA6C9B5ULL, -927, -260},
+    {0xEA9C227723EE8BCBULL, -901, -252},
+    {0xAECC49914078536DULL, -874, -244},
+    {0x823C12795DB6CE57ULL, -847, -236},
+    {0xC21094364DFB5637ULL, -821, -228},
+    {0x9096EA6F3848984FULL, -794, -220},
+    {0xD77485CB25823AC7ULL, -768, -212},
+    {0xA086CFCD97BF97F4ULL, -741, -204},
+    {0xEF340A98172AACE5ULL, -715, -196},
+    {0xB23867FB2A35B28EULL, -688, -188},
+    {0x84C8D4DFD2C63F3BULL, -661, -180},
+    {0xC5DD44271AD3CDBAULL, -635, -172},
+    {0x936B9FCEBB25C996ULL, -608, -164},
+    {0xDBAC6C247D62A584ULL, -582, -156},
+    {0xA3AB66580D5FDAF6ULL, -555, -148},
+    {0xF3E2F893DEC3F126ULL, -529, -140},
+    {0xB5B5ADA8AAFF80B8ULL, -502, -132},
+    {0x87625F056C7C4A8BULL, -475, -124},
+    {0xC9BCFF6034C13053ULL, -449, -116},
+    {0x964E858C91BA2655ULL, -422, -108},
+    {0xDFF9772470297EBDULL, -396, -100},
+    {0xA6DFBD9FB8E5B88FULL, -369, -92},
+    {0xF8A95FCF88747D94ULL, -343, -84},
+    {0xB94470938FA89BCFULL, -316, -76},
+    {0x8A08F0F8BF0F156BULL, -289, -68},
+    {0xCDB02555653131B6ULL, -263, -60},
+    {0x993FE2C6D07B7FACULL, -236, -52},
+    {0xE45C10C42A2B3B06ULL, -210, -44},
+    {0xAA242499697392D3ULL, -183, -36},
+    {0xFD87B5F28300CA0EULL, -157, -28},
+    {0xBCE5086492111AEBULL, -130, -20},
+    {0x8CBCCC096F5088CCULL, -103, -12},
+    {0xD1B71758E219652CULL, -77, -4},
+    {0x9C40000000000000ULL, -50, 4},
+    {0xE8D4A51000000000ULL, -24, 12},
+    {0xAD78EBC5AC620000ULL, 3, 20},
+    {0x813F3978F8940984ULL, 30, 28},
+    {0xC097CE7BC90715B3ULL, 56, 36},
+    {0x8F7E32CE7BEA5C70ULL, 83, 44},
+    {0xD5D238A4ABE98068ULL, 109, 52},
+    {0x9F4F2726179A2245ULL, 136, 60},
+    {0xED63A231D4C4FB27ULL, 162, 68},
+    {0xB0DE65388CC8ADA8ULL, 189, 76},
+    {0x83C7088E1AAB65DBULL, 216, 84},
+    {0xC45D1DF942711D9AULL, 242, 92},
+    {0x924D692CA61BE758ULL, 269, 100},
+    {0xDA01EE641A708DEAULL, 295, 108},
+    {0xA26DA3999AEF774AULL, 322, 116},
+    {0xF209787BB47D6B85ULL, 348, 124},
+    {0xB454E4A179DD1877ULL, 375, 132},
+    {0x865B86925B9BC5C2ULL, 402, 140},
+    {0xC83553C5C8965D3DULL, 428, 148},
+    {0x952AB45CFA97A0B3ULL, 455, 156},
+    {0xDE469FBD99A05FE3ULL, 481, 164},
+    {0xA59BC234DB398C25ULL, 508, 172},
+    {0xF6C69A72A3989F5CULL, 534, 180},
+    {0xB7DCBF5354E9BECEULL, 561, 188},
+    {0x88FCF317F22241E2ULL, 588, 196},
+    {0xCC20CE9BD35C78A5ULL, 614, 204},
+    {0x98165AF37B2153DFULL, 641, 212},
+    {0xE2A0B5DC971F303AULL, 667, 220},
+    {0xA8D9D1535CE3B396ULL, 694, 228},
+    {0xFB9B7CD9A4A7443CULL, 720, 236},
+    {0xBB764C4CA7A44410ULL, 747, 244},
+    {0x8BAB8EEFB6409C1AULL, 774, 252},
+    {0xD01FEF10A657842CULL, 800, 260},
+    {0x9B10A4E5E9913129ULL, 827, 268},
+    {0xE7109BFBA19C0C9DULL, 853, 276},
+    {0xAC2820D9623BF429ULL, 880, 284},
+    {0x80444B5E7AA7CF85ULL, 907, 292},
+    {0xBF21E44003ACDD2DULL, 933, 300},
+    {0x8E679C2F5E44FF8FULL, 960, 308},
+    {0xD433179D9C8CB841ULL, 986, 316},
+    {0x9E19DB92B4E31BA9ULL, 1013, 324},
+};
+
+constexpr int kCachedPowersMinDecExp = -300;
+constexpr int kCachedPowersDecStep = 8;
+
+// Returns a cached power of ten c such that a number with binary exponent e
+// times c has a binary exponent in [kAlpha, kGamma].
+inline CachedPower CachedPowerForBinaryExponent(int e) {
+  // k = ceil((kAlpha - e - 1) * log10(2)), with log10(2) ~= 78913 / 2^18.
+  const int f = kAlpha - e - 1;
+  const int k = (f * 78913) / (1 << 18) + (f > 0);
+  const int index = (-kCachedPowersMinDecExp + k + (kCachedPowersDecStep - 1)) /
+                    kCachedPowersDecStep;
+  return kCachedPowers[index];
+}
+
+// Returns the number of decimal digits of n, and sets *pow10 to
+// 10^(digits - 1).
+inline int FindLargestPow10(std::uint32_t n, std::uint32_t *pow10) {
+  static constexpr std::uint32_t kPowers[] = {
+      1,      10,      100,      1000,      10000,
+      100000, 1000000, 10000000, 100000000, 1000000000};
+  int digits = 10;
+  while (digits > 1 && n < kPowers[digits - 1]) {
+    --digits;
+  }
+  *pow10 = kPowers[digits - 1];
+  return digits;
+}
+
+// Moves the last digit of buf towards w while staying within the boundaries.
+inline void Grisu2Round(char *buf, int len, std::uint64_t dist,
+                        std::uint64_t delta, std::uint64_t rest,
+                        std::uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    --buf[len - 1];
+    rest += ten_k;
+  }
+}
+
+// Generates the digits of w, which lies in (m_minus, m_plus), into buffer.
+inline void Grisu2DigitGen(char *buffer, int *length, int *decimal_exponent,
+                           const DiyFp &m_minus, const DiyFp &w,
+                           const DiyFp &m_plus) {
+  std::uint64_t delta = DiyFp::Sub(m_plus, m_minus).f;
+  std::uint64_t dist = DiyFp::Sub(m_plus, w).f;
+
+  // Split m_plus into an integral part p1 and a fractional part p2.
+  const DiyFp one(std::uint64_t{1} << -m_plus.e, m_plus.e);
+  std::uint32_t p1 = static_cast<std::uint32_t>(m_plus.f >> -one.e);
+  std::uint64_t p2 = m_plus.f & (one.f - 1);
+
+  std::uint32_t pow10;
+  int n = FindLargestPow10(p1, &pow10);
+  while (n > 0) {
+    const std::uint32_t d = p1 / pow10;
+    p1 %= pow10;
+    buffer[(*length)++] = static_cast<char>('0' + d);
+    --n;
+    const std::uint64_t rest = (std::uint64_t{p1} << -one.e) + p2;
+    if (rest <= delta) {
+      *decimal_exponent += n;
+      Grisu2Round(buffer, *length, dist, delta, rest,
+                  std::uint64_t{pow10} << -one.e);
+      return;
+    }
+    pow10 /= 10;
+  }
+
+  int m = 0;
+  for (;;) {
+    p2 *= 10;
+    const std::uint64_t d = p2 >> -one.e;
+    p2 &= one.f - 1;
+    buffer[(*length)++] = static_cast<char>('0' + d);
+    ++m;
+    delta *= 10;
+    dist *= 10;
+    if (p2 <= delta) {
+      break;
+    }
+  }
+  *decimal_exponent -= m;
+  Grisu2Round(buffer, *length, dist, delta, p2, one.f);
+}
+
+// Writes the digits of a positive finite value to buffer (at least 17 bytes)
+// and returns their number; the value is digits * 10^*decimal_exponent.
+inline int Grisu2(char *buffer, int *decimal_exponent, double value) {
+  const Boundaries b = ComputeBoundaries(value);
+  const CachedPower cached = CachedPowerForBinaryExponent(b.plus.e);
+  const DiyFp c_minus_k(cached.f, cached.e);
+
+  const DiyFp w = DiyFp::Mul(b.w, c_minus_k);
+  const DiyFp w_minus = DiyFp::Mul(b.minus, c_minus_k);
+  const DiyFp w_plus = DiyFp::Mul(b.plus, c_minus_k);
+  // Shrink the interval by one unit in the last place on each side, to
+  // allow for the rounding in the multiplications.
+  const DiyFp m_minus(w_minus.f + 1, w_minus.e);
+  const DiyFp m_plus(w_plus.f - 1, w_plus.e);
+
+  int length = 0;
+  *decimal_exponent = -cached.k;
+  Grisu2DigitGen(buffer, &length, decimal_exponent, m_minus, w, m_plus);
+  return length;
+}
+
+// Writes the exponent e as "e+N" or "e-N".
+inline char *AppendExponent(char *out, int e) {
+  *out++ = 'e';
+  if (e < 0) {
+    *out++ = '-';
+    e = -e;
+  } else {
+    *out++ = '+';
+  }
+  if (e >= 100) {
+    *out++ = static_cast<char>('0' + e / 100);
+    e %= 100;
+    *out++ = static_cast<char>('0' + e / 10);
+  } else if (e >= 10) {
+    *out++ = static_cast<char>('0' + e / 10);
+  }
+  *out++ = static_cast<char>('0' + e % 10);
+  return out;
+}
+
+// Formats the digits buf[0, length) times 10^decimal_exponent in place: in
+// fixed notation if the decimal point falls between 4 places before the first
+// digit and 15 places after it, and otherwise in exponential notation.
+// Integral values get a trailing ".0" so that they read back as doubles.
+inline char *FormatBuffer(char *buf, int length, int decimal_exponent) {
+  constexpr int kMinExp = -4;
+  constexpr int kMaxExp = 15;
+  const int k = length;
+  // The position of the decimal point relative to the first digit.
+  const int n = length + decimal_exponent;
+
+  if (k <= n && n <= kMaxExp) {
+    // ddd000.0
+    std::memset(buf + k, '0', n - k);
+    buf[n] = '.';
+    buf[n + 1] = '0';
+    return buf + n + 2;
+  }
+  if (0 < n && n <= kMaxExp) {
+    // ddd.ddd
+    std::memmove(buf + n + 1, buf + n, k - n);
+    buf[n] = '.';
+    return buf + k + 1;
+  }
+  if (kMinExp < n && n <= 0) {
+    // 0.000ddd
+    std::memmove(buf + 2 - n, buf, k);
+    buf[0] = '0';
+    buf[1] = '.';
+    std::memset(buf + 2, '0', -n);
+    return buf + 2 - n + k;
+  }
+  if (k == 1) {
+    // de+N
+    return AppendExponent(buf + 1, n - 1);
+  }
+  // d.ddde+N
+  std::memmove(buf + 2, buf + 1, k - 1);
+  buf[1] = '.';
+  return AppendExponent(buf + k + 1, n - 1);
+}
+
+} // namespace internal
+
+// The most characters FormatDouble writes.
+constexpr int kMaxDoubleSize = 32;
+
+// Writes the shortest decimal representation of a finite value that reads
+// back as the same double to buf, which must have room for kMaxDoubleSize
+// characters, and returns the end of the output.  Non-finite values, which
+// JSON cannot represent, are written as "null".
+inline char *FormatDouble(double value, char *buf) {
+  if (!std::isfinite(value)) {
+    std::memcpy(buf, "null", 4);
+    return buf + 4;
+  }
+  if (std::signbit(value)) {
+    *buf++ = '-';
+    value = -value;
+  }
+  if (value == 0) {
+    std::memcpy(buf, "0.0", 3);
+    return buf + 3;
+  }
+  int decimal_exponent;
+  const int length = internal::Grisu2(buf, &decimal_exponent, value);
+  return internal::FormatBuffer(buf, length, decimal_exponent);
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_FORMAT_DOUBLE_H
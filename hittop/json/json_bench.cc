@@ -0,0 +1,272 @@
+// Measures parsing and serialization throughput on generated corpora shaped
+// like the usual reference documents:
+//
+//   twitter   string-heavy objects with escapes and non-ASCII text
+//   canada    a GeoJSON polygon, almost all floating point coordinates
+//   config    deeply nested objects of mixed values
+//   integers  a large array of integers of all magnitudes
+//
+// For each corpus it reports MB/s for validation only (the grammar without a
+// visitor), parsing into a json::Value with ParseValue and with
+// ParseValueIterative, parsing into a tape Document (with and without UTF-8
+// validation), and writing the Value back out.  The corpora are generated
+// from fixed seeds, so results are comparable across commits.
+//
+// usage: json_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/grammar.h"
+#include "hittop/json/parser.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+#include "hittop/json/value_builder.h"
+#include "hittop/json/writer.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+constexpr std::size_t kCorpusSize = 1 << 20;
+
+// Words for generated text, some with escapes or multi-byte UTF-8.
+const char *const kWords[] = {
+    "the",          "quick",        "brown",          "fox",
+    "jumps",        "over",         "lazy",           "dog",
+    "caf\\u00e9",   "na\\u00efve",  "\\ud83d\\ude00", "http://t.co/x",
+    "said",         "\\\"hi\\\"",   "line\\nbreak",   "tab\\there",
+    "日本語",       "ok",
+};
+
+std::string Words(std::mt19937 *rng, int count) {
+  std::uniform_int_distribution<std::size_t> word(
+      0, sizeof(kWords) / sizeof(kWords[0]) - 1);
+  std::string text;
+  for (int i = 0; i < count; ++i) {
+    if (i != 0) {
+      text += ' ';
+    }
+    text += kWords[word(*rng)];
+  }
+  return text;
+}
+
+std::string MakeTwitter() {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<std::uint64_t> id(1ull << 50, 1ull << 60);
+  std::uniform_int_distribution<int> small(0, 5000);
+  std::string doc = "{\"statuses\": [";
+  for (std::size_t i = 0; doc.size() < kCorpusSize; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    const std::string status_id = std::to_string(id(rng));
+    doc += "{\"id\": " + status_id + ", \"id_str\": \"" + status_id +
+           "\", \"text\": \"" + Words(&rng, 12) +
+           "\", \"user\": {\"id\": " + std::to_string(small(rng)) +
+           ", \"name\": \"" + Words(&rng, 2) + "\", \"screen_name\": \"" +
+           Words(&rng, 1) + "\", \"description\": \"" + Words(&rng, 8) +
+           "\", \"followers_count\": " + std::to_string(small(rng)) +
+           ", \"verified\": " + (small(rng) % 7 ? "false" : "true") +
+           "}, \"entities\": {\"hashtags\": [\"" + Words(&rng, 1) +
+           "\"], \"urls\": []}, \"retweet_count\": " +
+           std::to_string(small(rng)) +
+           ", \"favorited\": false, \"in_reply_to_status_id\": null, "
+           "\"lang\": \"en\"}";
+  }
+  doc += "]}";
+  return doc;
+}
+
+std::string MakeCanada() {
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<double> lon(-141.0, -52.0);
+  std::uniform_real_distribution<double> lat(41.0, 83.0);
+  std::string doc = "{\"type\": \"FeatureCollection\", \"features\": [{"
+                    "\"type\": \"Feature\", \"properties\": {\"name\": "
+                    "\"Canada\"}, \"geometry\": {\"type\": \"Polygon\", "
+                    "\"coordinates\": [";
+  char buf[64];
+  for (std::size_t ring = 0; doc.size() < kCorpusSize; ++ring) {
+    doc += ring == 0 ? "[" : ", [";
+    for (int i = 0; i < 1000; ++i) {
+      std::snprintf(buf, sizeof(buf), "%s[%.15g,%.15g]", i == 0 ? "" : ",",
+                    lon(rng), lat(rng));
+      doc += buf;
+    }
+    doc += "]";
+  }
+  doc += "]}}]}";
+  return doc;
+}
+
+void AppendConfig(std::mt19937 *rng, int depth, std::string *doc) {
+  std::uniform_int_distribution<int> kind(0, 5);
+  *doc += '{';
+  const int members = depth == 0 ? 3 : 4;
+  for (int i = 0; i < members; ++i) {
+    if (i != 0) {
+      *doc += ", ";
+    }
+    *doc += "\"key" + std::to_string(i) + "_" + std::to_string(depth) +
+            "\": ";
+    if (depth > 0 && i < 2) {
+      AppendConfig(rng, depth - 1, doc);
+      continue;
+    }
+    switch (kind(*rng)) {
+    case 0:
+      *doc += "true";
+      break;
+    case 1:
+      *doc += "null";
+      break;
+    case 2:
+      *doc += std::to_string((*rng)() % 100000);
+      break;
+    case 3:
+      *doc += "[1, 2.5, \"three\", [4]]";
+      break;
+    default:
+      *doc += "\"value " + std::to_string((*rng)() % 1000) + "\"";
+    }
+  }
+  *doc += '}';
+}
+
+std::string MakeConfig() {
+  std::mt19937 rng(3);
+  std::string doc = "[";
+  for (std::size_t i = 0; doc.size() < kCorpusSize; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    // Binary trees of objects 10 levels deep, with scalars and small arrays
+    // along the way, inside two arrays: 13 levels in all.
+    doc += "[[";
+    AppendConfig(&rng, 9, &doc);
+    doc += "]]";
+  }
+  doc += "]";
+  return doc;
+}
+
+std::string MakeIntegers() {
+  std::mt19937_64 rng(4);
+  std::uniform_int_distribution<int> digits(1, 18);
+  std::string doc = "[";
+  for (std::size_t i = 0; doc.size() < kCorpusSize; ++i) {
+    if (i != 0) {
+      doc += ',';
+    }
+    std::int64_t n = rng() % 1000000000000000000ll;
+    for (int d = digits(rng); d < 18; ++d) {
+      n /= 10;
+    }
+    doc += std::to_string(i % 3 ? n : -n);
+  }
+  doc += "]";
+  return doc;
+}
+
+// Returns false if the corpus does not parse.
+bool RunCorpus(const std::string &name, const std::string &input,
+               unsigned count, std::size_t *checksum) {
+  auto parsed = json::ParseValue(input);
+  if (!parsed.ok()) {
+    return false;
+  }
+  const json::Value value = std::get<0>(parsed.consume());
+
+  const int kRuns = 3;
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      *checksum += hittop::parser::Parse<json::grammar::Value>(input).ok();
+    });
+    Report(name + "/validate", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      auto result = json::ParseValue(input);
+      *checksum += result.ok();
+    });
+    Report(name + "/parse_value", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::Value out;
+      *checksum += json::ParseValueIterative(input, &out).ok();
+    });
+    Report(name + "/parse_iterative", usec, count, input.size());
+  }
+  json::StructuralParser parser;
+  json::Document doc;
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      parser.Parse(input, &doc);
+      *checksum += doc.tape().size();
+    });
+    Report(name + "/parse_tape", usec, count, input.size());
+  }
+  parser.set_validate_utf8(true);
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      parser.Parse(input, &doc);
+      *checksum += doc.tape().size();
+    });
+    Report(name + "/parse_tape_utf8", usec, count, input.size());
+  }
+  std::string out;
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      out.clear();
+      json::Writer writer(&out);
+      json::Write(value, &writer);
+    });
+    Report(name + "/write", usec, count, out.size());
+    *checksum += out.size();
+  }
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 10;
+
+  const std::pair<const char *, std::string> corpora[] = {
+      {"twitter", MakeTwitter()},
+      {"canada", MakeCanada()},
+      {"config", MakeConfig()},
+      {"integers", MakeIntegers()},
+  };
+
+  std::size_t checksum = 0;
+  for (const auto &corpus : corpora) {
+    if (!RunCorpus(corpus.first, corpus.second, count, &checksum)) {
+      std::cerr << "Fail! " << corpus.first << std::endl;
+      return 1;
+    }
+    std::cout << corpus.first << " size: " << corpus.second.size()
+              << std::endl;
+  }
+  std::cout << "checksum: " << checksum << std::endl;
+  return 0;
+}
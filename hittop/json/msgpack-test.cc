@@ -0,0 +1,142 @@
+#include "hittop/json/msgpack.h"
+#include "hittop/json/msgpack.h"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <tuple>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+#include "hittop/json/writer.h"
+#include "hittop/util/test_data.h"
+
+using hittop::parser::ParseError;
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+// Returns the bytes as lowercase hex.
+std::string Hex(const std::string &bytes) {
+  static const char kDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (unsigned char ch : bytes) {
+    hex += kDigits[ch >> 4];
+    hex += kDigits[ch & 0xf];
+  }
+  return hex;
+}
+
+std::string Encode(const std::string &text) {
+  json::Document doc;
+  EXPECT_TRUE(json::StructuralParser().Parse(text, &doc).ok());
+  std::string out;
+  json::EncodeMsgpack(doc.root(), &out);
+  return out;
+}
+
+// Decodes into a tape and returns it as JSON text.
+std::string Decode(const std::string &bytes) {
+  json::Document doc;
+  auto result =
+      json::DecodeMsgpack(bytes.data(), bytes.data() + bytes.size(), &doc);
+  EXPECT_TRUE(result.ok());
+  return result.ok() ? json::ToJson(doc.root()) : "";
+}
+
+} // namespace
+
+TEST(MsgpackTest, Encoding) {
+  EXPECT_EQ(Hex(Encode("null")), "c0");
+  EXPECT_EQ(Hex(Encode("[true, false]")), "92c3c2");
+  EXPECT_EQ(Hex(Encode("[0, 127, 128, 255, 256, 65536, 4294967296]")),
+            "97007fcc80ccffcd0100ce00010000cf0000000100000000");
+  EXPECT_EQ(Hex(Encode("[-1, -32, -33, -129, -32769, -2147483649]")),
+            "96ffe0d0dfd1ff7fd2ffff7fffd3ffffffff7fffffff");
+  EXPECT_EQ(Hex(Encode("[18446744073709551615, 1.5]")),
+            "92cfffffffffffffffffcb3ff8000000000000");
+  EXPECT_EQ(Hex(Encode(R"({"a": "bc"})")), "81a161a26263");
+  EXPECT_EQ(Encode('"' + std::string(40, 'x') + '"'),
+            "\xd9\x28" + std::string(40, 'x'));
+}
+
+TEST(MsgpackTest, RoundTrip) {
+  const std::string inputs[] = {
+      LoadTestData("/hittop/json/test-data.json"),
+      R"({"ints": [0, -1, 9223372036854775807, -9223372036854775808,
+                   18446744073709551615],
+          "reals": [0.1, -2.5e-300, 1e300, -0.0],
+          "strings": ["", "a\"b\\cé\n", "x\u0000y"],
+          "nested": [[], {}, [[{"k": null}]]]})",
+  };
+  for (const std::string &input : inputs) {
+    json::Document doc;
+    ASSERT_TRUE(json::StructuralParser().Parse(input, &doc).ok());
+    std::string bytes;
+    json::EncodeMsgpack(doc.root(), &bytes);
+    EXPECT_EQ(Decode(bytes), json::ToJson(doc.root()));
+
+    // Through a Value.
+    json::Value value;
+    ASSERT_TRUE(
+        json::DecodeMsgpack(bytes.data(), bytes.data() + bytes.size(), &value)
+            .ok());
+    EXPECT_TRUE(value == doc.root().ToValue());
+    std::string again;
+    json::EncodeMsgpack(value, &again);
+    json::Value decoded;
+    ASSERT_TRUE(
+        json::DecodeMsgpack(again.data(), again.data() + again.size(), &decoded)
+            .ok());
+    EXPECT_TRUE(decoded == value);
+  }
+}
+
+TEST(MsgpackTest, ZeroCopyStrings) {
+  const std::string bytes = Encode(R"(["hello", {"key": "value"}])");
+  json::Document doc;
+  ASSERT_TRUE(
+      json::DecodeMsgpack(bytes.data(), bytes.data() + bytes.size(), &doc)
+          .ok());
+  const json::StringView hello = doc.root()[0].get_string();
+  EXPECT_EQ(hello, "hello");
+  EXPECT_TRUE(hello.data() > bytes.data() &&
+              hello.data() < bytes.data() + bytes.size());
+
+  // Binary values are read as strings.
+  EXPECT_EQ(Decode(std::string("\xc4\x02hi", 4)), "\"hi\"");
+  EXPECT_EQ(Decode(std::string("\xca\x3f\xc0\x00\x00", 5)), "1.5");
+}
+
+TEST(MsgpackTest, Errors) {
+  auto decode = [](const std::string &bytes, std::size_t max_depth =
+                                                 json::kDefaultMaxDepth) {
+    json::Value value;
+    json::ValueBuilder builder(&value);
+    return json::DecodeMsgpack(bytes.data(), bytes.data() + bytes.size(),
+                               &builder, max_depth);
+  };
+  EXPECT_EQ(decode("").error(), ParseError::INCOMPLETE);
+  EXPECT_EQ(decode("\x92\xc3").error(), ParseError::INCOMPLETE);
+  EXPECT_EQ(decode("\xa3xy").error(), ParseError::INCOMPLETE);
+  EXPECT_EQ(decode("\xcd\x01").error(), ParseError::INCOMPLETE);
+  EXPECT_EQ(decode("\xdb\xff\xff\xff\xff").error(), ParseError::INCOMPLETE);
+  EXPECT_EQ(decode("\xc1").error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(decode("\xd4\x01\x02").error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(decode("\xc3\xc3").error(), ParseError::BAD_CHAR);
+  // Keys must be strings.
+  EXPECT_EQ(decode(std::string("\x81\x01\x02", 3)).error(),
+            ParseError::BAD_CHAR);
+
+  const std::string deep = std::string(10, '\x91') + '\xc0';
+  EXPECT_TRUE(decode(deep, 10).ok());
+  auto result = decode(deep, 9);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - deep.data(), 9);
+}
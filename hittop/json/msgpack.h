@@ -0,0 +1,604 @@
+// MessagePack encoding of JSON values.
+//
+// MessagePack (https://msgpack.org) stores the same kinds of values as JSON
+// in a binary form: numbers as fixed-size integers and IEEE doubles, strings
+// with a length prefix and no escapes, and containers with a count prefix.
+// Between services that already agree on it, this avoids formatting and
+// parsing numbers and scanning strings for quotes and escapes.
+//
+// MsgpackWriter appends the encoding of a value to a std::string in a single
+// pass; EncodeMsgpack writes a json::Value or a tape ValueRef with it.
+//
+// DecodeMsgpack reports an encoded value to a handler, without recursion and
+// with a limit on nesting depth.  The handler interface is that of
+// StructuralParser (see structural_parser.h), except that numbers are passed
+// as a NumberValue to
+//
+//   void Number(const NumberValue &value);
+//
+// String and Key receive the bytes of the string within the input, and
+// has_escapes is always false; binary values are reported as strings.  Both
+// ValueBuilder and TapeBuilder accept these events, and the overloads for a
+// Value and a Document use them; strings in a decoded Document refer to the
+// input, like those of StructuralParser::ParseZeroCopy.
+//
+// Map keys must be strings; extension types are not supported.
+//
+#ifndef HITTOP_JSON_MSGPACK_H
+#define HITTOP_JSON_MSGPACK_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/number.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+#include "hittop/json/value_builder.h"
+
+namespace hittop {
+namespace json {
+
+namespace msgpack {
+
+// Format bytes.  Positive (negative) fixints are 0x00-0x7f (0xe0-0xff),
+// fixmaps 0x80-0x8f, fixarrays 0x90-0x9f and fixstrs 0xa0-0xbf, with the size
+// or value in the low bits.
+enum Format : unsigned char {
+  kFixMap = 0x80,
+  kFixArray = 0x90,
+  kFixStr = 0xa0,
+  kNil = 0xc0,
+  kFalse = 0xc2,
+  kTrue = 0xc3,
+  kBin8 = 0xc4,
+  kBin16 = 0xc5,
+  kBin32 = 0xc6,
+  kFloat32 = 0xca,
+  kFloat64 = 0xcb,
+  kUint8 = 0xcc,
+  kUint16 = 0xcd,
+  kUint32 = 0xce,
+  kUint64 = 0xcf,
+  kInt8 = 0xd0,
+  kInt16 = 0xd1,
+  kInt32 = 0xd2,
+  kInt64 = 0xd3,
+  kStr8 = 0xd9,
+  kStr16 = 0xda,
+  kStr32 = 0xdb,
+  kArray16 = 0xdc,
+  kArray32 = 0xdd,
+  kMap16 = 0xde,
+  kMap32 = 0xdf,
+  kNegativeFixInt = 0xe0,
+};
+
+} // namespace msgpack
+
+class MsgpackWriter {
+public:
+  // Appends to *out.
+  explicit MsgpackWriter(std::string *out) : out_(out) {}
+
+  MsgpackWriter(const MsgpackWriter &) = delete;
+  MsgpackWriter &operator=(const MsgpackWriter &) = delete;
+
+  void Null() { out_->push_back(char(msgpack::kNil)); }
+
+  void Bool(bool value) {
+    out_->push_back(char(value ? msgpack::kTrue : msgpack::kFalse));
+  }
+
+  // Integers are written in the smallest format that holds them.
+  void Int64(std::int64_t value) {
+    if (value >= 0) {
+      Uint64(value);
+    } else if (value >= -32) {
+      out_->push_back(static_cast<char>(value));
+    } else if (value >= std::numeric_limits<std::int8_t>::min()) {
+      Put(msgpack::kInt8, static_cast<std::uint8_t>(value));
+    } else if (value >= std::numeric_limits<std::int16_t>::min()) {
+      Put(msgpack::kInt16, static_cast<std::uint16_t>(value));
+    } else if (value >= std::numeric_limits<std::int32_t>::min()) {
+      Put(msgpack::kInt32, static_cast<std::uint32_t>(value));
+    } else {
+      Put(msgpack::kInt64, static_cast<std::uint64_t>(value));
+    }
+  }
+
+  void Uint64(std::uint64_t value) {
+    if (value < 0x80) {
+      out_->push_back(static_cast<char>(value));
+    } else if (value <= 0xff) {
+      Put(msgpack::kUint8, static_cast<std::uint8_t>(value));
+    } else if (value <= 0xffff) {
+      Put(msgpack::kUint16, static_cast<std::uint16_t>(value));
+    } else if (value <= 0xffffffff) {
+      Put(msgpack::kUint32, static_cast<std::uint32_t>(value));
+    } else {
+      Put(msgpack::kUint64, value);
+    }
+  }
+
+  void Double(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Put(msgpack::kFloat64, bits);
+  }
+
+  void Number(const NumberValue &value) {
+    switch (value.kind) {
+    case NumberValue::Kind::kInt64:
+      Int64(value.int64);
+      break;
+    case NumberValue::Kind::kUint64:
+      Uint64(value.uint64);
+      break;
+    default:
+      Double(value.real);
+      break;
+    }
+  }
+
+  void String(StringView value) {
+    const std::size_t size = value.size();
+    if (size < 32) {
+      out_->push_back(static_cast<char>(msgpack::kFixStr | size));
+    } else if (size <= 0xff) {
+      Put(msgpack::kStr8, static_cast<std::uint8_t>(size));
+    } else if (size <= 0xffff) {
+      Put(msgpack::kStr16, static_cast<std::uint16_t>(size));
+    } else {
+      Put(msgpack::kStr32, static_cast<std::uint32_t>(size));
+    }
+    out_->append(value.data(), size);
+  }
+
+  void Key(StringView key) { String(key); }
+
+  // Unlike Writer, containers are given their sizes up front, and have no end
+  // marker; size is the number of elements, or of key/value pairs.
+  void StartArray(std::size_t size) {
+    if (size < 16) {
+      out_->push_back(static_cast<char>(msgpack::kFixArray | size));
+    } else if (size <= 0xffff) {
+      Put(msgpack::kArray16, static_cast<std::uint16_t>(size));
+    } else {
+      Put(msgpack::kArray32, static_cast<std::uint32_t>(size));
+    }
+  }
+
+  void StartObject(std::size_t size) {
+    if (size < 16) {
+      out_->push_back(static_cast<char>(msgpack::kFixMap | size));
+    } else if (size <= 0xffff) {
+      Put(msgpack::kMap16, static_cast<std::uint16_t>(size));
+    } else {
+      Put(msgpack::kMap32, static_cast<std::uint32_t>(size));
+    }
+  }
+
+private:
+  // Appends a format byte followed by value in big-endian order.
+  template <typename Unsigned> void Put(unsigned char format, Unsigned value) {
+    char buf[1 + sizeof(Unsigned)];
+    buf[0] = static_cast<char>(format);
+    for (std::size_t i = sizeof(Unsigned); i > 0; --i) {
+      buf[i] = static_cast<char>(value & 0xff);
+      value = static_cast<Unsigned>(value >> 8);
+    }
+    out_->append(buf, sizeof(buf));
+  }
+
+  std::string *const out_;
+};
+
+namespace internal {
+
+class MsgpackVisitor : public boost::static_visitor<> {
+public:
+  explicit MsgpackVisitor(MsgpackWriter *writer) : writer_(writer) {}
+
+  void operator()(const Null &) const { writer_->Null(); }
+
+  void operator()(const Boolean &value) const { writer_->Bool(value); }
+
+  // A Value stores numbers as doubles; those that are integers (other than
+  // -0) are written as integers, which is usually much shorter.
+  void operator()(const Number &value) const {
+    if (value >= -9.2e18 && value <= 9.2e18 && std::floor(value) == value &&
+        !(value == 0 && std::signbit(value))) {
+      writer_->Int64(static_cast<std::int64_t>(value));
+    } else {
+      writer_->Double(value);
+    }
+  }
+
+  void operator()(const String &value) const { writer_->String(value); }
+
+  void operator()(const Array &value) const {
+    writer_->StartArray(value.size());
+    for (const Value &element : value) {
+      element.Visit(*this);
+    }
+  }
+
+  void operator()(const Object &value) const {
+    writer_->StartObject(value.size());
+    for (const auto &member : value) {
+      writer_->Key(member.first);
+      member.second.Visit(*this);
+    }
+  }
+
+private:
+  MsgpackWriter *writer_;
+};
+
+template <typename Unsigned>
+inline Unsigned LoadBigEndian(const unsigned char *p) {
+  Unsigned value = 0;
+  for (std::size_t i = 0; i < sizeof(Unsigned); ++i) {
+    value = static_cast<Unsigned>((value << 8) | p[i]);
+  }
+  return value;
+}
+
+// The format byte of a value and the fixed-size field that follows it.
+struct MsgpackHeader {
+  enum struct Kind { kNull, kBool, kNumber, kString, kArray, kMap };
+
+  Kind kind;
+  // The number of bytes in the header.
+  std::size_t size;
+  bool boolean;
+  NumberValue number;
+  // The number of bytes of a string, elements of an array or pairs of a map.
+  std::uint64_t length;
+};
+
+// Reads the header at the start of [first, last).
+inline parser::ParseError ReadMsgpackHeader(const char *first,
+                                            const char *last,
+                                            MsgpackHeader *header) {
+  using Kind = MsgpackHeader::Kind;
+  if (first == last) {
+    return parser::ParseError::INCOMPLETE;
+  }
+  const unsigned char *const p = reinterpret_cast<const unsigned char *>(first);
+  const unsigned char format = p[0];
+  header->size = 1;
+  if (format < msgpack::kFixMap || format >= msgpack::kNegativeFixInt) {
+    header->kind = Kind::kNumber;
+    header->number.kind = NumberValue::Kind::kInt64;
+    header->number.int64 = static_cast<std::int8_t>(format);
+    return parser::ParseError::NONE;
+  }
+  if (format < msgpack::kNil) {
+    header->kind = format < msgpack::kFixArray
+                       ? Kind::kMap
+                       : format < msgpack::kFixStr ? Kind::kArray
+                                                   : Kind::kString;
+    header->length = format & (format < msgpack::kFixStr ? 0x0f : 0x1f);
+    return parser::ParseError::NONE;
+  }
+  switch (format) {
+  case msgpack::kNil:
+    header->kind = Kind::kNull;
+    return parser::ParseError::NONE;
+  case msgpack::kFalse:
+  case msgpack::kTrue:
+    header->kind = Kind::kBool;
+    header->boolean = format == msgpack::kTrue;
+    return parser::ParseError::NONE;
+  case msgpack::kUint8:
+  case msgpack::kInt8:
+  case msgpack::kStr8:
+  case msgpack::kBin8:
+    header->size = 2;
+    break;
+  case msgpack::kUint16:
+  case msgpack::kInt16:
+  case msgpack::kStr16:
+  case msgpack::kBin16:
+  case msgpack::kArray16:
+  case msgpack::kMap16:
+    header->size = 3;
+    break;
+  case msgpack::kUint32:
+  case msgpack::kInt32:
+  case msgpack::kFloat32:
+  case msgpack::kStr32:
+  case msgpack::kBin32:
+  case msgpack::kArray32:
+  case msgpack::kMap32:
+    header->size = 5;
+    break;
+  case msgpack::kUint64:
+  case msgpack::kInt64:
+  case msgpack::kFloat64:
+    header->size = 9;
+    break;
+  default:
+    // 0xc1 (never used) and extension types.
+    return parser::ParseError::BAD_CHAR;
+  }
+  if (std::size_t(last - first) < header->size) {
+    return parser::ParseError::INCOMPLETE;
+  }
+
+  // The field, zero-extended.
+  std::uint64_t field;
+  switch (header->size) {
+  case 2:
+    field = p[1];
+    break;
+  case 3:
+    field = LoadBigEndian<std::uint16_t>(p + 1);
+    break;
+  case 5:
+    field = LoadBigEndian<std::uint32_t>(p + 1);
+    break;
+  default:
+    field = LoadBigEndian<std::uint64_t>(p + 1);
+    break;
+  }
+  NumberValue &number = header->number;
+  header->kind = Kind::kNumber;
+  number.kind = NumberValue::Kind::kInt64;
+  switch (format) {
+  case msgpack::kStr8:
+  case msgpack::kStr16:
+  case msgpack::kStr32:
+  case msgpack::kBin8:
+  case msgpack::kBin16:
+  case msgpack::kBin32:
+    header->kind = Kind::kString;
+    header->length = field;
+    break;
+  case msgpack::kArray16:
+  case msgpack::kArray32:
+    header->kind = Kind::kArray;
+    header->length = field;
+    break;
+  case msgpack::kMap16:
+  case msgpack::kMap32:
+    header->kind = Kind::kMap;
+    header->length = field;
+    break;
+  case msgpack::kInt8:
+    number.int64 = static_cast<std::int8_t>(field);
+    break;
+  case msgpack::kInt16:
+    number.int64 = static_cast<std::int16_t>(field);
+    break;
+  case msgpack::kInt32:
+    number.int64 = static_cast<std::int32_t>(field);
+    break;
+  case msgpack::kInt64:
+    number.int64 = static_cast<std::int64_t>(field);
+    break;
+  case msgpack::kUint64:
+    if (field > std::uint64_t(std::numeric_limits<std::int64_t>::max())) {
+      number.kind = NumberValue::Kind::kUint64;
+      number.uint64 = field;
+      break;
+    }
+    number.int64 = static_cast<std::int64_t>(field);
+    break;
+  case msgpack::kFloat32: {
+    const std::uint32_t bits = static_cast<std::uint32_t>(field);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    number.kind = NumberValue::Kind::kDouble;
+    number.real = value;
+    break;
+  }
+  case msgpack::kFloat64:
+    number.kind = NumberValue::Kind::kDouble;
+    std::memcpy(&number.real, &field, sizeof(number.real));
+    break;
+  default:
+    // kUint8, kUint16 and kUint32.
+    number.int64 = static_cast<std::int64_t>(field);
+    break;
+  }
+  return parser::ParseError::NONE;
+}
+
+} // namespace internal
+
+inline void EncodeMsgpack(const Value &value, MsgpackWriter *writer) {
+  value.Visit(internal::MsgpackVisitor(writer));
+}
+
+// Integers in the tape are written exactly.
+inline void EncodeMsgpack(ValueRef value, MsgpackWriter *writer) {
+  switch (value.type()) {
+  case Value::Type::kNull:
+    writer->Null();
+    break;
+  case Value::Type::kBoolean:
+    writer->Bool(value.get_bool());
+    break;
+  case Value::Type::kNumber:
+    writer->Number(value.get_number_value());
+    break;
+  case Value::Type::kString:
+    writer->String(value.get_string());
+    break;
+  case Value::Type::kArray:
+    writer->StartArray(value.size());
+    for (ValueRef element : value.elements()) {
+      EncodeMsgpack(element, writer);
+    }
+    break;
+  case Value::Type::kObject:
+    writer->StartObject(value.size());
+    for (const auto &member : value.members()) {
+      writer->Key(member.first);
+      EncodeMsgpack(member.second, writer);
+    }
+    break;
+  }
+}
+
+// Appends the encoding of value to *out.
+template <typename T> void EncodeMsgpack(const T &value, std::string *out) {
+  MsgpackWriter writer(out);
+  EncodeMsgpack(value, &writer);
+}
+
+// Decodes the single MessagePack value [first, last) and reports it to
+// handler.  Returns last, or the position of an invalid byte (or of a
+// container nested deeper than max_depth, or of anything after the value)
+// with error BAD_CHAR, or INCOMPLETE if the input ends within the value.  On
+// failure, the handler may have received some events already.
+template <typename Handler>
+parser::ParseResult<const char *>
+DecodeMsgpack(const char *first, const char *last, Handler *handler,
+              std::size_t max_depth = kDefaultMaxDepth) {
+  using parser::ParseError;
+  using Kind = internal::MsgpackHeader::Kind;
+
+  struct Frame {
+    bool is_object;
+    std::size_t start;
+    std::size_t count;
+    // The number of elements or members still to come.
+    std::uint64_t remaining;
+  };
+  std::vector<Frame> stack;
+  internal::MsgpackHeader header;
+  const char *p = first;
+
+  for (;;) {
+    if (!stack.empty() && stack.back().is_object) {
+      // The key of the next member.
+      const ParseError error = internal::ReadMsgpackHeader(p, last, &header);
+      if (error != ParseError::NONE) {
+        return {error == ParseError::INCOMPLETE ? last : p, error};
+      }
+      if (header.kind != Kind::kString) {
+        return {p, ParseError::BAD_CHAR};
+      }
+      if (std::uint64_t(last - p) - header.size < header.length) {
+        return {last, ParseError::INCOMPLETE};
+      }
+      p += header.size;
+      handler->Key(p, p + header.length, false);
+      p += header.length;
+    }
+
+    const ParseError error = internal::ReadMsgpackHeader(p, last, &header);
+    if (error != ParseError::NONE) {
+      return {error == ParseError::INCOMPLETE ? last : p, error};
+    }
+    switch (header.kind) {
+    case Kind::kNull:
+      handler->Null();
+      break;
+    case Kind::kBool:
+      handler->Bool(header.boolean);
+      break;
+    case Kind::kNumber:
+      handler->Number(header.number);
+      break;
+    case Kind::kString:
+      if (std::uint64_t(last - p) - header.size < header.length) {
+        return {last, ParseError::INCOMPLETE};
+      }
+      handler->String(p + header.size, p + header.size + header.length,
+                      false);
+      p += header.length;
+      break;
+    case Kind::kArray:
+    case Kind::kMap: {
+      if (stack.size() >= max_depth) {
+        return {p, ParseError::BAD_CHAR};
+      }
+      const bool is_object = header.kind == Kind::kMap;
+      const std::size_t start =
+          is_object ? handler->StartObject() : handler->StartArray();
+      if (header.length != 0) {
+        stack.push_back({is_object, start, 0, header.length});
+        p += header.size;
+        continue;
+      }
+      if (is_object) {
+        handler->EndObject(start, 0);
+      } else {
+        handler->EndArray(start, 0);
+      }
+      break;
+    }
+    }
+    p += header.size;
+
+    // A value is complete; close the containers it completes.
+    for (;;) {
+      if (stack.empty()) {
+        if (p != last) {
+          return {p, ParseError::BAD_CHAR};
+        }
+        return last;
+      }
+      Frame &top = stack.back();
+      ++top.count;
+      if (--top.remaining != 0) {
+        break;
+      }
+      if (top.is_object) {
+        handler->EndObject(top.start, top.count);
+      } else {
+        handler->EndArray(top.start, top.count);
+      }
+      stack.pop_back();
+    }
+  }
+}
+
+// Decodes into *out; on failure, *out is null.
+inline parser::ParseResult<const char *>
+DecodeMsgpack(const char *first, const char *last, Value *out,
+              KeyTable *keys = nullptr) {
+  ValueBuilder builder(out, keys);
+  auto result = DecodeMsgpack(first, last, &builder);
+  if (!result.ok()) {
+    *out = Null{};
+  }
+  return result;
+}
+
+// Decodes into doc, replacing its previous contents.  Strings refer to
+// [first, last), which must outlive doc (or its next use); those that start
+// 4GB or more into the input are copied instead.  On failure, doc is left
+// empty.
+inline parser::ParseResult<const char *>
+DecodeMsgpack(const char *first, const char *last, Document *doc) {
+  doc->reserve(last - first);
+  TapeWriter writer(doc);
+  writer.set_source(first);
+  TapeBuilder builder(&writer);
+  auto result = DecodeMsgpack(first, last, &builder);
+  if (result.ok()) {
+    writer.Finish();
+  } else {
+    doc->clear();
+  }
+  return result;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_MSGPACK_H
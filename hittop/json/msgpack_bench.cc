@@ -0,0 +1,144 @@
+// Compares a round trip through MessagePack with one through JSON text, on a
+// generated array of records with integers, floating point numbers, strings
+// and small nested containers.
+//
+// It reports the cost of encoding the Value to MessagePack and to JSON, and
+// of decoding each back: into a json::Value (DecodeMsgpack, ParseValue and
+// ParseValueIterative) and into a tape Document (DecodeMsgpack, and
+// StructuralParser::ParseZeroCopy).  MB/s is relative to the size of the JSON
+// text in every case, so that the numbers are directly comparable.
+//
+// usage: msgpack_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/msgpack.h"
+#include "hittop/json/parser.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+#include "hittop/json/value_builder.h"
+#include "hittop/json/writer.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+constexpr std::size_t kCorpusSize = 1 << 20;
+
+std::string MakeRecords() {
+  std::mt19937_64 rng(5);
+  std::uniform_int_distribution<std::int64_t> id(0, 1ll << 50);
+  std::uniform_real_distribution<double> real(-1000, 1000);
+  const char *const kNames[] = {"alpha", "bravo", "charlie \\\"c\\\"",
+                                "delta", "echo\\necho", "foxtrot"};
+  std::string doc = "[";
+  for (std::size_t i = 0; doc.size() < kCorpusSize; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    doc += "{\"id\": " + std::to_string(id(rng)) + ", \"name\": \"" +
+           kNames[rng() % 6] + "\", \"score\": " + std::to_string(real(rng)) +
+           ", \"tags\": [\"" + kNames[rng() % 6] + "\", \"" +
+           kNames[rng() % 6] + "\"], \"active\": " +
+           (rng() % 2 ? "true" : "false") +
+           ", \"parent\": null, \"position\": {\"x\": " +
+           std::to_string(real(rng)) + ", \"y\": " +
+           std::to_string(real(rng)) + ", \"count\": " +
+           std::to_string(rng() % 100) + "}}";
+  }
+  doc += "]";
+  return doc;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 10;
+
+  const std::string input = MakeRecords();
+  auto parsed = json::ParseValue(input);
+  if (!parsed.ok()) {
+    std::cerr << "Fail! input does not parse" << std::endl;
+    return 1;
+  }
+  const json::Value value = std::get<0>(parsed.consume());
+  std::string bytes;
+  json::EncodeMsgpack(value, &bytes);
+  std::cout << "json size: " << input.size()
+            << " msgpack size: " << bytes.size() << std::endl;
+
+  const char *const first = bytes.data();
+  const char *const last = bytes.data() + bytes.size();
+  std::size_t checksum = 0;
+  const int kRuns = 3;
+  for (int j = 0; j < kRuns; ++j) {
+    std::string out;
+    const double usec = TimeUsec(count, [&]() {
+      out.clear();
+      json::EncodeMsgpack(value, &out);
+      checksum += out.size();
+    });
+    Report("encode_msgpack", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    std::string out;
+    const double usec = TimeUsec(count, [&]() {
+      out.clear();
+      json::Writer writer(&out);
+      json::Write(value, &writer);
+      checksum += out.size();
+    });
+    Report("encode_json", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::Value out;
+      checksum += json::DecodeMsgpack(first, last, &out).ok();
+    });
+    Report("decode_msgpack_value", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      checksum += json::ParseValue(input).ok();
+    });
+    Report("parse_value", usec, count, input.size());
+  }
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::Value out;
+      checksum += json::ParseValueIterative(input, &out).ok();
+    });
+    Report("parse_iterative", usec, count, input.size());
+  }
+  json::Document doc;
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::DecodeMsgpack(first, last, &doc);
+      checksum += doc.tape().size();
+    });
+    Report("decode_msgpack_tape", usec, count, input.size());
+  }
+  json::StructuralParser parser;
+  for (int j = 0; j < kRuns; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      parser.ParseZeroCopy(input.data(), input.data() + input.size(), &doc);
+      checksum += doc.tape().size();
+    });
+    Report("parse_tape", usec, count, input.size());
+  }
+  std::cout << "checksum: " << checksum << std::endl;
+  return 0;
+}
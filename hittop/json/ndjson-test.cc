@@ -0,0 +1,235 @@
+#include "hittop/json/ndjson.h"
+#include "hittop/json/ndjson.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "hittop/io/async_circular_buffer_stream.h"
+#include "hittop/json/writer.h"
+
+using hittop::parser::ParseError;
+
+namespace io = hittop::io;
+namespace json = hittop::json;
+
+namespace {
+
+// Records events as a compact string, with a '|' after each record.
+class RecordingHandler {
+public:
+  void Null() { events += "n"; }
+  void Bool(bool value) { events += value ? "t" : "f"; }
+  void Number(const char *first, const char *last) {
+    events += "#" + std::string(first, last);
+  }
+  void String(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "S" : "s") + std::string(first, last);
+  }
+  void Key(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "K" : "k") + std::string(first, last);
+  }
+  std::size_t StartArray() {
+    events += "[";
+    return 0;
+  }
+  void EndArray(std::size_t, std::size_t count) {
+    events += "]" + std::to_string(count);
+  }
+  std::size_t StartObject() {
+    events += "{";
+    return 0;
+  }
+  void EndObject(std::size_t, std::size_t count) {
+    events += "}" + std::to_string(count);
+  }
+  void EndRecord() { events += "|"; }
+
+  std::string events;
+};
+
+// Records of every kind, with blank lines and CRLF line endings mixed in.
+std::string MakeNdjson(std::size_t num_records) {
+  static const char *const kRecords[] = {
+      R"({"id": 1, "name": "a \"quoted\" name", "tags": ["x", "y"]})",
+      "[1, 2.5, -3e2, true, false, null]",
+      "\"a string\"",
+      "12345",
+      "{}",
+      "  {\"nested\": {\"a\": [[], {}]}}  ",
+      "true",
+  };
+  std::string text;
+  for (std::size_t i = 0; i < num_records; ++i) {
+    text += kRecords[i % 7];
+    text += i % 5 == 0 ? "\r\n" : "\n";
+    if (i % 11 == 0) {
+      text += "\n  \n";
+    }
+  }
+  return text;
+}
+
+std::string ChunkedEvents(const std::string &input, std::size_t chunk_size) {
+  RecordingHandler handler;
+  json::NdjsonParser<RecordingHandler> parser(&handler);
+  for (std::size_t i = 0; i < input.size(); i += chunk_size) {
+    const char *first = input.data() + i;
+    const char *last = first + std::min(chunk_size, input.size() - i);
+    EXPECT_TRUE(parser.Feed(first, last).ok()) << "chunk size " << chunk_size
+                                               << " offset " << i;
+  }
+  EXPECT_EQ(parser.Finish(), ParseError::NONE);
+  return handler.events;
+}
+
+std::pair<ParseError, long> ErrorAt(const std::string &input) {
+  RecordingHandler handler;
+  json::NdjsonParser<RecordingHandler> parser(&handler);
+  auto result = parser.Feed(input.data(), input.data() + input.size());
+  if (!result.ok()) {
+    return {result.error(), result.get() - input.data()};
+  }
+  return {parser.Finish(), -1};
+}
+
+} // namespace
+
+TEST(NdjsonTest, AnyChunkSize) {
+  const std::string input = MakeNdjson(50);
+  const std::string expected = ChunkedEvents(input, input.size());
+  EXPECT_EQ(std::count(expected.begin(), expected.end(), '|'), 50);
+  for (std::size_t chunk_size = 1; chunk_size < 40; ++chunk_size) {
+    EXPECT_EQ(ChunkedEvents(input, chunk_size), expected);
+  }
+
+  // The last record may be unterminated.
+  EXPECT_EQ(ChunkedEvents("1\n2", 1), "#1|#2|");
+  EXPECT_EQ(ChunkedEvents("", 1), "");
+}
+
+TEST(NdjsonTest, Errors) {
+  EXPECT_EQ(ErrorAt("1\n{} {}\n"), std::make_pair(ParseError::BAD_CHAR, 5L));
+  EXPECT_EQ(ErrorAt("[1,]\n"), std::make_pair(ParseError::BAD_CHAR, 3L));
+  EXPECT_EQ(ErrorAt("{\"a\": 1"), std::make_pair(ParseError::INCOMPLETE, -1L));
+  // A record may not continue past the end of its line.
+  EXPECT_EQ(ErrorAt("{\"a\": 1\n"), std::make_pair(ParseError::BAD_CHAR, 7L));
+  EXPECT_EQ(ErrorAt("1\n[1,\n2]\n"), std::make_pair(ParseError::BAD_CHAR, 5L));
+  EXPECT_EQ(ErrorAt("[\"a\nb\"]\n"), std::make_pair(ParseError::BAD_CHAR, 3L));
+  EXPECT_EQ(ErrorAt("1\n\n  \n2\n"), std::make_pair(ParseError::NONE, -1L));
+}
+
+TEST(NdjsonTest, SequentialAndParallelAgree) {
+  const std::string inputs[] = {"[1,\n2]\n", "1\n[1,\n2]\n", "1\n2\n3",
+                                "{\"a\":\n1}\n"};
+  for (const std::string &input : inputs) {
+    const std::pair<ParseError, long> sequential = ErrorAt(input);
+    auto parallel = json::ParseNdjsonParallel(
+        input.data(), input.data() + input.size(), 2, [](json::ValueRef) {});
+    EXPECT_EQ(parallel.error(), sequential.first) << input;
+    if (!parallel.ok()) {
+      EXPECT_EQ(parallel.get() - input.data(), sequential.second) << input;
+    }
+  }
+}
+
+TEST(NdjsonTest, AsyncParseFromStream) {
+  const std::string input = MakeNdjson(30);
+  const std::string expected = ChunkedEvents(input, input.size());
+
+  // A stream much smaller than a record, so that records straddle the end of
+  // its circular buffer.
+  io::AsyncCircularBufferStream stream(4);
+  RecordingHandler handler;
+  json::NdjsonParser<RecordingHandler> parser(&handler);
+  bool called = false;
+  json::AsyncParseNdjson(&stream, &parser, [&called](const io::error_code &ec,
+                                                     ParseError error) {
+    called = true;
+    EXPECT_FALSE(ec);
+    EXPECT_EQ(error, ParseError::NONE);
+  });
+
+  std::size_t written = 0;
+  for (std::size_t piece = 1; written < input.size(); piece = piece % 7 + 1) {
+    stream.async_prepare(
+        1, [&](const io::error_code &ec,
+               const io::AsyncCircularBufferStream::mutable_buffers_type
+                   &buffers) {
+          ASSERT_FALSE(ec);
+          std::size_t size = 0;
+          for (const auto &buffer : buffers) {
+            const std::size_t n =
+                std::min({piece - size, input.size() - written,
+                          boost::asio::buffer_size(buffer)});
+            std::copy(input.data() + written, input.data() + written + n,
+                      boost::asio::buffer_cast<char *>(buffer));
+            written += n;
+            size += n;
+          }
+          stream.commit(size);
+        });
+  }
+  EXPECT_FALSE(called);
+  stream.close_for_write();
+  EXPECT_TRUE(called);
+  EXPECT_EQ(parser.records(), 30u);
+  EXPECT_EQ(handler.events, expected);
+}
+
+TEST(NdjsonTest, ParallelPreservesOrder) {
+  const std::string input = MakeNdjson(20000);
+
+  std::vector<std::string> expected;
+  json::StructuralParser parser;
+  json::Document doc;
+  const char *first = input.data();
+  const char *const last = first + input.size();
+  while (first != last) {
+    const char *eol = std::find(first, last, '\n');
+    if (!json::internal::IsBlank(first, eol)) {
+      ASSERT_TRUE(parser.Parse(first, eol, &doc).ok());
+      expected.push_back(json::ToJson(doc.root()));
+    }
+    first = eol == last ? eol : eol + 1;
+  }
+  ASSERT_EQ(expected.size(), 20000u);
+
+  for (unsigned threads : {1, 2, 4, 8}) {
+    std::vector<std::string> records;
+    auto result = json::ParseNdjsonParallel(
+        input.data(), input.data() + input.size(), threads,
+        [&records](json::ValueRef record) {
+          records.push_back(json::ToJson(record));
+        },
+        4096);
+    EXPECT_TRUE(result.ok());
+    EXPECT_EQ(result.get(), input.data() + input.size());
+    EXPECT_EQ(records, expected) << threads << " threads";
+  }
+}
+
+TEST(NdjsonTest, ParallelStopsAtFirstError) {
+  std::string input = MakeNdjson(10000);
+  // Break a record in the middle, and another later on.
+  const std::size_t bad = input.find("\n12345", input.size() / 2) + 1;
+  input[bad + 2] = 'x';
+  input[input.find("\n12345", bad + 1) + 3] = 'x';
+
+  std::size_t count = 0;
+  std::size_t count_before = 0;
+  {
+    RecordingHandler handler;
+    json::NdjsonParser<RecordingHandler> sequential(&handler);
+    ASSERT_TRUE(sequential.Feed(input.data(), input.data() + bad).ok());
+    count_before = sequential.records();
+  }
+  auto result = json::ParseNdjsonParallel(
+      input.data(), input.data() + input.size(), 4,
+      [&count](json::ValueRef) { ++count; }, 4096);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get(), input.data() + bad + 2);
+  EXPECT_EQ(count, count_before);
+}
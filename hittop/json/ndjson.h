@@ -0,0 +1,298 @@
+// Newline-delimited JSON (NDJSON): a sequence of JSON values ("records"), one
+// per line.
+//
+// NdjsonParser reads records incrementally from chunks of any size, reporting
+// each to a SAX handler (see sax_parser.h) followed by a call to EndRecord().
+// A record split across chunks -- including the two halves of a CircularBuffer
+// that has wrapped around -- is parsed as it arrives, without rescanning.
+// AsyncParseNdjson drives an NdjsonParser from an AsyncConstBufferStream until
+// the end of the stream.
+//
+// ParseNdjsonParallel parses text that is already in memory (e.g. a mapped
+// file) on a pool of threads: the text is split at newlines into chunks, each
+// chunk is parsed into its own tape Document independently, and the records
+// are handed to a callback in input order (see concurrent/line_chunks.h).
+//
+// Blank lines are ignored; a line holding more than one value, or a newline
+// within a value, is an error.
+//
+#ifndef HITTOP_JSON_NDJSON_H
+#define HITTOP_JSON_NDJSON_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "boost/asio/buffer.hpp"
+#include "boost/asio/error.hpp"
+
+#include "hittop/concurrent/line_chunks.h"
+#include "hittop/io/small_handler.h"
+#include "hittop/io/types.h"
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/sax_parser.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+
+namespace hittop {
+namespace json {
+
+// Handler is a SaxParser handler that also has a method
+//
+//   void EndRecord();
+//
+// which is called after the events of each record.
+template <typename Handler> class NdjsonParser {
+public:
+  explicit NdjsonParser(Handler *handler)
+      : handler_(handler), record_parser_(handler) {}
+
+  NdjsonParser(const NdjsonParser &) = delete;
+  NdjsonParser &operator=(const NdjsonParser &) = delete;
+
+  // Parses the next chunk of input.  Returns last, or the position of an
+  // invalid character with error BAD_CHAR; once an error has been reported,
+  // the parser must not be fed again.
+  parser::ParseResult<const char *> Feed(const char *first, const char *last) {
+    if (error_ != parser::ParseError::NONE) {
+      return {first, error_};
+    }
+    const char *p = first;
+    while (p != last) {
+      if (in_record_) {
+        // A record ends with its line at the latest.
+        const char *const eol =
+            static_cast<const char *>(std::memchr(p, '\n', last - p));
+        auto result = record_parser_.Feed(p, eol != nullptr ? eol : last);
+        if (!result.ok()) {
+          error_ = result.error();
+          return result;
+        }
+        if (record_parser_.done()) {
+          p = result.get();
+        } else if (eol == nullptr) {
+          return last;
+        } else if (record_parser_.Finish() == parser::ParseError::NONE) {
+          // A number, ended by the newline.
+          p = eol;
+        } else {
+          error_ = parser::ParseError::BAD_CHAR;
+          return {eol, error_};
+        }
+        EndRecord();
+        continue;
+      }
+      switch (*p) {
+      case '\n':
+        after_record_ = false;
+        // Fall through.
+      case ' ':
+      case '\t':
+      case '\r':
+        ++p;
+        continue;
+      default:
+        if (after_record_) {
+          error_ = parser::ParseError::BAD_CHAR;
+          return {p, error_};
+        }
+        in_record_ = true;
+      }
+    }
+    return last;
+  }
+
+  // Signals the end of the input.  Returns NONE if the input ended between
+  // records, and otherwise the error from the incomplete record.
+  parser::ParseError Finish() {
+    if (error_ != parser::ParseError::NONE || !in_record_) {
+      return error_;
+    }
+    // A record at the very end of the input, e.g. a number, may be complete.
+    error_ = record_parser_.Finish();
+    if (error_ == parser::ParseError::NONE) {
+      EndRecord();
+    }
+    return error_;
+  }
+
+  // The number of complete records parsed so far.
+  std::size_t records() const { return records_; }
+
+private:
+  void EndRecord() {
+    handler_->EndRecord();
+    ++records_;
+    record_parser_.Reset();
+    in_record_ = false;
+    after_record_ = true;
+  }
+
+  Handler *const handler_;
+  SaxParser<Handler> record_parser_;
+  parser::ParseError error_ = parser::ParseError::NONE;
+  // True while the characters of a record are being fed to record_parser_.
+  bool in_record_ = false;
+  // True between the end of a record and the end of its line.
+  bool after_record_ = false;
+  std::size_t records_ = 0;
+};
+
+template <typename Stream, typename Handler, typename Callback>
+void AsyncParseNdjson(Stream *stream, NdjsonParser<Handler> *parser,
+                      Callback done);
+
+namespace internal {
+
+// The handler of each fetch, which forwards the allocation hooks to done as
+// internal::AsyncParseOp does.
+template <typename Stream, typename Handler, typename Callback>
+struct AsyncParseNdjsonOp {
+  Stream *stream;
+  NdjsonParser<Handler> *parser;
+  Callback done;
+
+  void operator()(const io::error_code &ec,
+                  const typename Stream::const_buffers_type &buffers) {
+    if (ec) {
+      const parser::ParseError error = parser->Finish();
+      if (ec == boost::asio::error::eof) {
+        done(io::error_code{}, error);
+      } else {
+        done(ec, error);
+      }
+      return;
+    }
+    std::size_t consumed = 0;
+    for (const auto &buffer : buffers) {
+      const char *first = boost::asio::buffer_cast<const char *>(buffer);
+      const char *last = first + boost::asio::buffer_size(buffer);
+      auto result = parser->Feed(first, last);
+      consumed += result.get() - first;
+      if (!result.ok()) {
+        stream->consume(consumed);
+        done(io::error_code{}, result.error());
+        return;
+      }
+    }
+    stream->consume(consumed);
+    AsyncParseNdjson(stream, parser, std::move(done));
+  }
+
+  friend void *hittop_handler_allocate(std::size_t size,
+                                       AsyncParseNdjsonOp *op) {
+    return io::AllocateHandler(size, std::addressof(op->done));
+  }
+
+  friend void hittop_handler_deallocate(void *p, std::size_t size,
+                                        AsyncParseNdjsonOp *op) {
+    io::DeallocateHandler(p, size, std::addressof(op->done));
+  }
+};
+
+} // namespace internal
+
+// Reads records from stream into parser until the end of the stream.  Calls
+// done(ec, parse_error) when the stream ends (both are then empty/NONE unless
+// it ended within a record), when the parser reports an error, or when the
+// stream fails.  done's allocation hooks are used as by AsyncParse.
+template <typename Stream, typename Handler, typename Callback>
+void AsyncParseNdjson(Stream *stream, NdjsonParser<Handler> *parser,
+                      Callback done) {
+  stream->async_fetch(
+      1, internal::AsyncParseNdjsonOp<Stream, Handler, Callback>{
+             stream, parser, std::move(done)});
+}
+
+namespace internal {
+
+// The records of one chunk of NDJSON text, and where parsing it stopped.
+struct NdjsonChunk {
+  // An array of the records.
+  Document records;
+  parser::ParseResult<const char *> result{nullptr};
+};
+
+inline bool IsBlank(const char *first, const char *last) {
+  return std::all_of(first, last, [](char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r';
+  });
+}
+
+// Parses the lines of [first, last) into chunk->records.  The records share
+// one tape, so a chunk costs a handful of allocations however many records
+// it holds; strings without escapes refer to the input text.
+inline void ParseNdjsonChunk(const char *first, const char *last,
+                             NdjsonChunk *chunk) {
+  chunk->records.reserve(last - first);
+  TapeWriter writer(&chunk->records);
+  writer.set_source(first);
+  TapeBuilder builder(&writer);
+  StructuralParser parser;
+  const std::size_t start = builder.StartArray();
+  std::size_t count = 0;
+  chunk->result = last;
+  while (first != last) {
+    const char *eol = std::find(first, last, '\n');
+    if (!IsBlank(first, eol)) {
+      const TapeWriter::Mark mark = writer.mark();
+      auto result = parser.Parse(first, eol, &builder);
+      if (!result.ok()) {
+        writer.rollback(mark);
+        chunk->result = result;
+        if (result.error() == parser::ParseError::INCOMPLETE && eol != last) {
+          // The record would continue past the end of its line.
+          chunk->result = {eol, parser::ParseError::BAD_CHAR};
+        }
+        break;
+      }
+      ++count;
+    }
+    first = (eol == last) ? eol : eol + 1;
+  }
+  builder.EndArray(start, count);
+  writer.Finish();
+}
+
+} // namespace internal
+
+// Parses the NDJSON text [first, last) on num_threads threads, calling
+// on_record(ValueRef) for each record in input order.  on_record is called
+// from the worker threads, but never concurrently; the ValueRef is valid only
+// for the duration of the call, and its strings may refer to [first, last).
+// Returns last, or the position of the first invalid record along with its
+// error, in which case only the records before it are reported.
+template <typename Callback>
+parser::ParseResult<const char *>
+ParseNdjsonParallel(const char *first, const char *last, unsigned num_threads,
+                    Callback on_record, std::size_t min_chunk_size = 1 << 20) {
+  num_threads = std::max(1u, num_threads);
+  // Chunks are kept well below 4GB so that their records can refer to their
+  // text.
+  const auto chunks = concurrent::SplitLines(first, last, num_threads * 4,
+                                             min_chunk_size, 1 << 30);
+  parser::ParseResult<const char *> result = last;
+  concurrent::ForEachLineChunk<internal::NdjsonChunk>(
+      chunks, num_threads, internal::ParseNdjsonChunk,
+      [&result, &on_record](std::unique_ptr<internal::NdjsonChunk> chunk) {
+        if (!result.ok()) {
+          return;
+        }
+        for (ValueRef record : chunk->records.root().elements()) {
+          on_record(record);
+        }
+        if (!chunk->result.ok()) {
+          result = chunk->result;
+        }
+      });
+  return result;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_NDJSON_H
@@ -0,0 +1,90 @@
+// Measures NDJSON parsing throughput on a generated ~64MB input: sequentially
+// with NdjsonParser, and with ParseNdjsonParallel on 1, 2, 4, ... threads up
+// to the number of cores (or THREADS).
+//
+// usage: ndjson_bench [THREADS]
+//
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/ndjson.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+std::string MakeNdjson(std::size_t target_size) {
+  std::string text;
+  for (std::size_t i = 0; text.size() < target_size; ++i) {
+    const std::string n = std::to_string(i);
+    text += "{\"index\": " + n + ", \"name\": \"item " + n +
+            "\", \"price\": " + n + ".25, \"active\": " +
+            (i % 2 ? "true" : "false") +
+            ", \"tags\": [\"a\", \"b\"], \"attributes\": {\"color\": "
+            "\"red\", \"size\": null}}\n";
+  }
+  return text;
+}
+
+// Counts records.
+class CountingHandler {
+public:
+  void Null() {}
+  void Bool(bool) {}
+  void Number(const char *, const char *) {}
+  void String(const char *, const char *, bool) {}
+  void Key(const char *, const char *, bool) {}
+  std::size_t StartArray() { return 0; }
+  void EndArray(std::size_t, std::size_t) {}
+  std::size_t StartObject() { return 0; }
+  void EndObject(std::size_t, std::size_t) {}
+  void EndRecord() { ++records; }
+
+  std::size_t records = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned max_threads =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1])
+               : std::max(1u, std::thread::hardware_concurrency());
+  const std::string text = MakeNdjson(64 << 20);
+  const char *const first = text.data();
+  const char *const last = first + text.size();
+
+  CountingHandler handler;
+  const double usec = TimeUsec([&]() {
+    json::NdjsonParser<CountingHandler> parser(&handler);
+    parser.Feed(first, last);
+    parser.Finish();
+  });
+  Report("sequential_sax", usec, 1, text.size());
+
+  for (unsigned threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    std::size_t records = 0;
+    const double usec = TimeUsec([&]() {
+      json::ParseNdjsonParallel(first, last, threads,
+                                [&records](json::ValueRef) { ++records; });
+    });
+    Report("parallel_" + std::to_string(threads), usec, 1, text.size());
+    if (records != handler.records) {
+      std::cerr << "Fail!" << std::endl;
+      return 1;
+    }
+    if (threads == max_threads) {
+      break;
+    }
+  }
+  std::cout << "records: " << handler.records << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include "hittop/json/number.h"
+#include "hittop/json/number.h"
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <clocale>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+using hittop::parser::ParseError;
+
+namespace json = hittop::json;
+
+namespace {
+
+json::NumberValue MustParse(const std::string &text) {
+  json::NumberValue value;
+  auto result = json::ParseNumber(text.data(), text.data() + text.size(),
+                                  &value);
+  EXPECT_TRUE(result.ok()) << text;
+  EXPECT_EQ(result.get(), text.data() + text.size()) << text;
+  return value;
+}
+
+// Checks that text converts to exactly the same double as strtod gives.
+void ExpectSameAsStrtod(const std::string &text) {
+  const json::NumberValue value = MustParse(text);
+  const double expected = std::strtod(text.c_str(), nullptr);
+  const double actual = value.ToDouble();
+  EXPECT_EQ(std::memcmp(&expected, &actual, sizeof(double)), 0)
+      << text << ": " << actual << " != " << expected;
+}
+
+} // namespace
+
+TEST(JsonNumberTest, Integers) {
+  auto int64 = [](const std::string &text) {
+    const json::NumberValue value = MustParse(text);
+    EXPECT_TRUE(value.kind == json::NumberValue::Kind::kInt64) << text;
+    return value.int64;
+  };
+  EXPECT_EQ(int64("0"), 0);
+  EXPECT_EQ(int64("7"), 7);
+  EXPECT_EQ(int64("-7"), -7);
+  EXPECT_EQ(int64("12345678"), 12345678);
+  EXPECT_EQ(int64("1234567890123456789"), 1234567890123456789LL);
+  EXPECT_EQ(int64("9223372036854775807"),
+            std::numeric_limits<std::int64_t>::max());
+  EXPECT_EQ(int64("-9223372036854775808"),
+            std::numeric_limits<std::int64_t>::min());
+
+  json::NumberValue value = MustParse("9223372036854775808");
+  EXPECT_TRUE(value.kind == json::NumberValue::Kind::kUint64);
+  EXPECT_EQ(value.uint64, 9223372036854775808ULL);
+  value = MustParse("18446744073709551615");
+  EXPECT_TRUE(value.kind == json::NumberValue::Kind::kUint64);
+  EXPECT_EQ(value.uint64, std::numeric_limits<std::uint64_t>::max());
+
+  // Out of range integers, and -0, become doubles.
+  for (const char *text : {"18446744073709551616", "-9223372036854775809",
+                           "123456789012345678901234567890", "-0"}) {
+    value = MustParse(text);
+    EXPECT_TRUE(value.kind == json::NumberValue::Kind::kDouble) << text;
+    ExpectSameAsStrtod(text);
+  }
+  EXPECT_TRUE(std::signbit(MustParse("-0").real));
+}
+
+TEST(JsonNumberTest, Doubles) {
+  for (const char *text :
+       {"0.0", "1.5", "-1.5", "0.1", "0.3", "1e10", "1E-10", "1e+10",
+        "3.141592653589793", "2.2250738585072014e-308", "4.9e-324",
+        "1.7976931348623157e308", "1.7976931348623159e308", "1e309",
+        "-1e400", "1e-400", "0.000000000000000000000000000001",
+        "9007199254740993", "9007199254740993.0", "9007199254740992.5",
+        "123456789012345678901234567890e-10", "0.1e-2", "100000000000000e-5",
+        "12345678.87654321", "0.12345678901234567", "7.3177701707893310e+15",
+        "2.4703282292062328e-324", "8.98846567431158e307"}) {
+    ExpectSameAsStrtod(text);
+  }
+}
+
+TEST(JsonNumberTest, MatchesStrtodOnRandomInputs) {
+  std::mt19937_64 rng(12345);
+  char buffer[64];
+  for (int i = 0; i < 200000; ++i) {
+    const std::uint64_t bits = rng();
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    if (!std::isfinite(d)) {
+      continue;
+    }
+    // Shortest, long and short representations of random doubles.
+    std::snprintf(buffer, sizeof(buffer), "%.17g", d);
+    ExpectSameAsStrtod(buffer);
+    std::snprintf(buffer, sizeof(buffer), "%.*e", int(rng() % 20), d);
+    ExpectSameAsStrtod(buffer);
+    // Random decimal significands with random exponents.
+    std::snprintf(buffer, sizeof(buffer), "%llu.%llue%d",
+                  static_cast<unsigned long long>(rng() % 100000000000ULL),
+                  static_cast<unsigned long long>(rng() % 1000000000ULL),
+                  int(rng() % 700) - 350);
+    ExpectSameAsStrtod(buffer);
+  }
+}
+
+// The slow paths must not depend on the decimal point of the global locale.
+TEST(JsonNumberTest, IgnoresLocale) {
+  const char *const texts[] = {"1234567890.12345678901234567890",
+                               "4.9e-324", "2.2250738585072011e-308"};
+  double expected[3];
+  for (int i = 0; i < 3; ++i) {
+    expected[i] = std::strtod(texts[i], nullptr);
+  }
+  // Use a locale with a decimal comma, where one is installed.
+  for (const char *name : {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8",
+                           "fr_FR.utf8", "ru_RU.UTF-8", "ru_RU.utf8"}) {
+    if (std::setlocale(LC_NUMERIC, name) != nullptr) {
+      break;
+    }
+  }
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(MustParse(texts[i]).ToDouble(), expected[i]) << texts[i];
+  }
+  std::setlocale(LC_NUMERIC, "C");
+}
+
+TEST(JsonNumberTest, Errors) {
+  auto error_at = [](const std::string &text) {
+    json::NumberValue value;
+    auto result =
+        json::ParseNumber(text.data(), text.data() + text.size(), &value);
+    return std::make_pair(result.error(), result.get() - text.data());
+  };
+  EXPECT_EQ(error_at(""), std::make_pair(ParseError::INCOMPLETE, 0L));
+  EXPECT_EQ(error_at("-"), std::make_pair(ParseError::INCOMPLETE, 1L));
+  EXPECT_EQ(error_at("1."), std::make_pair(ParseError::INCOMPLETE, 2L));
+  EXPECT_EQ(error_at("1e"), std::make_pair(ParseError::INCOMPLETE, 2L));
+  EXPECT_EQ(error_at("-x"), std::make_pair(ParseError::BAD_CHAR, 1L));
+  EXPECT_EQ(error_at("1.e5"), std::make_pair(ParseError::BAD_CHAR, 2L));
+  EXPECT_EQ(error_at("1e+x"), std::make_pair(ParseError::BAD_CHAR, 3L));
+  // Trailing characters are left to the caller.
+  EXPECT_EQ(error_at("01"), std::make_pair(ParseError::NONE, 1L));
+  EXPECT_EQ(error_at("12,"), std::make_pair(ParseError::NONE, 2L));
+}
@@ -0,0 +1,385 @@
+// Allocation-free conversion of JSON number text.
+//
+// Integers without a fraction or exponent that fit in 64 bits are returned
+// exactly, as int64 or (if too large for int64) uint64.  Everything else is
+// converted to the nearest double:
+//
+//  - Digits are accumulated eight at a time with the SWAR routines in
+//    util/swar.h.
+//  - If the significand and the power of ten are both exactly representable
+//    as doubles, a single multiplication or division is correctly rounded
+//    (Clinger's fast path).
+//  - Otherwise the Eisel-Lemire algorithm multiplies the significand by a
+//    128-bit approximation of the power of ten (powers_of_five.h), which
+//    gives the correctly rounded result except in rare cases it detects.
+//  - Those cases (and numbers with more than 19 significant digits, or
+//    subnormal results) fall back to strtod_l in the "C" locale, since the
+//    decimal point of JSON does not depend on the global locale.
+//
+#ifndef HITTOP_JSON_NUMBER_H
+#define HITTOP_JSON_NUMBER_H
+
+#include <locale.h>
+#include <stdlib.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <string>
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+#include "hittop/util/swar.h"
+
+#include "hittop/json/powers_of_five.h"
+
+namespace hittop {
+namespace json {
+
+// The value of a JSON number.
+struct NumberValue {
+  enum struct Kind { kInt64, kUint64, kDouble };
+
+  Kind kind = Kind::kInt64;
+  union {
+    std::int64_t int64;
+    std::uint64_t uint64;
+    double real;
+  };
+
+  NumberValue() : int64(0) {}
+
+  double ToDouble() const {
+    switch (kind) {
+    case Kind::kInt64:
+      return static_cast<double>(int64);
+    case Kind::kUint64:
+      return static_cast<double>(uint64);
+    default:
+      return real;
+    }
+  }
+};
+
+namespace internal {
+
+inline bool IsNumberDigit(char ch) { return '0' <= ch && ch <= '9'; }
+
+// Loads eight bytes with the first in the most significant byte, as expected
+// by util::ParseDigits8.
+inline std::uint64_t LoadBigEndian8(const char *p) {
+  std::uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  word = __builtin_bswap64(word);
+#endif
+  return word;
+}
+
+// Accumulates decimal digits starting at p into *w, eight at a time where
+// possible, stopping at the first non-digit.  Digits beyond the 19th
+// significant one are counted in *extra_digits instead of being accumulated.
+// *significant counts the significant digits seen so far (leading zeros are
+// not significant).
+inline const char *AccumulateDigits(const char *p, const char *last,
+                                    std::uint64_t *w, int *significant,
+                                    int *extra_digits) {
+  while (last - p >= 8 && *significant + 8 <= 19) {
+    const std::uint64_t word = LoadBigEndian8(p);
+    if (!util::AllDigits8(word)) {
+      break;
+    }
+    *w = *w * 100000000 + util::ParseDigits8(word);
+    if (*w != 0) {
+      // Leading zeros within the chunk are harmless; count conservatively
+      // as if all eight digits were significant once any is.
+      *significant += 8;
+    }
+    p += 8;
+  }
+  for (; p != last && IsNumberDigit(*p); ++p) {
+    if (*significant < 19) {
+      *w = *w * 10 + (*p - '0');
+      if (*w != 0) {
+        ++*significant;
+      }
+    } else {
+      ++*extra_digits;
+    }
+  }
+  return p;
+}
+
+inline int LeadingZeros64(std::uint64_t x) { return __builtin_clzll(x); }
+
+// Full 64x64 -> 128 bit multiplication.
+inline void Multiply128(std::uint64_t a, std::uint64_t b, std::uint64_t *high,
+                        std::uint64_t *low) {
+  const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+  *high = static_cast<std::uint64_t>(product >> 64);
+  *low = static_cast<std::uint64_t>(product);
+}
+
+// Computes w * 10^q correctly rounded to a double with the Eisel-Lemire
+// algorithm.  Returns false if the result cannot be determined this way.
+inline bool EiselLemire(std::uint64_t w, int q, bool negative, double *out) {
+  constexpr int kMantissaBits = 52;
+  constexpr int kMinimumExponent = -1023;
+  constexpr int kInfinitePower = 0x7FF;
+
+  std::uint64_t bits;
+  if (w == 0 || q < kSmallestPowerOfFive) {
+    bits = 0;
+  } else if (q > kLargestPowerOfFive) {
+    bits = std::uint64_t{kInfinitePower} << kMantissaBits;
+  } else {
+    const int lz = LeadingZeros64(w);
+    w <<= lz;
+
+    // Multiply by the 128-bit power of five; the second word is only needed
+    // if the bits below the 55 that matter might carry.
+    const int index = 2 * (q - kSmallestPowerOfFive);
+    std::uint64_t high, low;
+    Multiply128(w, kPowersOfFive128[index], &high, &low);
+    constexpr std::uint64_t kPrecisionMask =
+        ~std::uint64_t{0} >> (kMantissaBits + 3);
+    if ((high & kPrecisionMask) == kPrecisionMask) {
+      std::uint64_t high2, low2;
+      Multiply128(w, kPowersOfFive128[index + 1], &high2, &low2);
+      low += high2;
+      if (high2 > low) {
+        ++high;
+      }
+    }
+    if (low == ~std::uint64_t{0} && (q < -27 || q > 55)) {
+      return false;
+    }
+
+    const int upper_bit = static_cast<int>(high >> 63);
+    std::uint64_t mantissa = high >> (upper_bit + 64 - kMantissaBits - 3);
+    // floor(log2(10^q)) + 63, computed as in fast_float.
+    const int power_of_two = (((152170 + 65536) * q) >> 16) + 63;
+    int exponent = power_of_two + upper_bit - lz - kMinimumExponent;
+    if (exponent <= 0) {
+      // Subnormal (or zero); leave it to strtod.
+      return false;
+    }
+    // Round to nearest, ties to even: a tie is only possible for small q,
+    // where the product is exact.
+    if (low <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << (upper_bit + 64 - kMantissaBits - 3)) == high) {
+      mantissa &= ~std::uint64_t{1};
+    }
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (std::uint64_t{2} << kMantissaBits)) {
+      mantissa = std::uint64_t{1} << kMantissaBits;
+      ++exponent;
+    }
+    mantissa &= ~(std::uint64_t{1} << kMantissaBits);
+    if (exponent >= kInfinitePower) {
+      bits = std::uint64_t{kInfinitePower} << kMantissaBits;
+    } else {
+      bits = mantissa | (std::uint64_t(exponent) << kMantissaBits);
+    }
+  }
+  if (negative) {
+    bits |= std::uint64_t{1} << 63;
+  }
+  std::memcpy(out, &bits, sizeof(*out));
+  return true;
+}
+
+// strtod in the "C" locale, whatever the locale of the program.
+inline double StrtodC(const char *text) {
+  static const locale_t c_locale = newlocale(LC_ALL_MASK, "C", locale_t(0));
+  return strtod_l(text, nullptr, c_locale);
+}
+
+// Converts with StrtodC, which needs a NUL-terminated copy.
+inline double StrtodFallback(const char *first, const char *last) {
+  char buffer[64];
+  const std::size_t size = last - first;
+  if (size < sizeof(buffer)) {
+    std::memcpy(buffer, first, size);
+    buffer[size] = '\0';
+    return StrtodC(buffer);
+  }
+  const std::string number(first, last);
+  return StrtodC(number.c_str());
+}
+
+} // namespace internal
+
+// Parses the JSON number at the start of [first, last) into *value, and
+// returns the position just past it.  Fails with BAD_CHAR (or INCOMPLETE, at
+// the end of the input) if the text is not a valid number; what follows the
+// number is not checked.
+inline parser::ParseResult<const char *>
+ParseNumber(const char *first, const char *last, NumberValue *value) {
+  using parser::ParseError;
+  const char *const start = first;
+  auto fail = [&first, last]() -> parser::ParseResult<const char *> {
+    if (first == last) {
+      return {last, ParseError::INCOMPLETE};
+    }
+    return {first, ParseError::BAD_CHAR};
+  };
+
+  const bool negative = first != last && *first == '-';
+  if (negative) {
+    ++first;
+  }
+  std::uint64_t w = 0;
+  int significant = 0;
+  int extra_digits = 0;
+  const char *const int_first = first;
+  if (first != last && *first == '0') {
+    ++first;
+  } else {
+    first = internal::AccumulateDigits(first, last, &w, &significant,
+                                       &extra_digits);
+    if (first == int_first) {
+      return fail();
+    }
+  }
+  const bool integer =
+      first == last || (*first != '.' && *first != 'e' && *first != 'E');
+
+  // (-0 is left to the floating point path, which keeps its sign.)
+  if (integer && extra_digits <= 1 && !(negative && w == 0)) {
+    // At most 20 digits; check whether they fit.
+    std::uint64_t magnitude = w;
+    bool fits = true;
+    if (extra_digits == 1) {
+      const std::uint64_t last_digit = first[-1] - '0';
+      fits = magnitude <= (std::numeric_limits<std::uint64_t>::max() -
+                           last_digit) /
+                              10;
+      magnitude = magnitude * 10 + last_digit;
+    }
+    if (fits) {
+      if (!negative) {
+        if (magnitude <=
+            std::uint64_t(std::numeric_limits<std::int64_t>::max())) {
+          value->kind = NumberValue::Kind::kInt64;
+          value->int64 = static_cast<std::int64_t>(magnitude);
+        } else {
+          value->kind = NumberValue::Kind::kUint64;
+          value->uint64 = magnitude;
+        }
+        return first;
+      }
+      if (magnitude <=
+          std::uint64_t(std::numeric_limits<std::int64_t>::max()) + 1) {
+        value->kind = NumberValue::Kind::kInt64;
+        value->int64 = static_cast<std::int64_t>(0 - magnitude);
+        return first;
+      }
+    }
+  }
+
+  // The significand is w * 10^extra_digits, times 10^exponent.
+  long exponent = extra_digits;
+  if (first != last && *first == '.') {
+    ++first;
+    const int extra_before = extra_digits;
+    const char *const fraction_first = first;
+    first = internal::AccumulateDigits(first, last, &w, &significant,
+                                       &extra_digits);
+    if (first == fraction_first) {
+      return fail();
+    }
+    // Fraction digits that were accumulated (including leading zeros, which
+    // scale w as well) lower the exponent.
+    const long fraction_digits = first - fraction_first;
+    exponent -= fraction_digits - (extra_digits - extra_before);
+  }
+  if (first != last && (*first == 'e' || *first == 'E')) {
+    ++first;
+    bool negative_exponent = false;
+    if (first != last && (*first == '+' || *first == '-')) {
+      negative_exponent = *first == '-';
+      ++first;
+    }
+    const char *const exponent_first = first;
+    long e = 0;
+    for (; first != last && internal::IsNumberDigit(*first); ++first) {
+      // Saturate: anything this large over- or underflows anyway.
+      if (e < 100000) {
+        e = e * 10 + (*first - '0');
+      }
+    }
+    if (first == exponent_first) {
+      return fail();
+    }
+    exponent += negative_exponent ? -e : e;
+  }
+
+  value->kind = NumberValue::Kind::kDouble;
+  if (extra_digits == 0) {
+    // Clinger's fast path: both w and 10^|exponent| are exact doubles.
+    static constexpr double kPowersOf10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    if (w <= (std::uint64_t{1} << 53) && exponent >= -22 && exponent <= 22) {
+      double d = static_cast<double>(w);
+      d = exponent < 0 ? d / kPowersOf10[-exponent] : d * kPowersOf10[exponent];
+      value->real = negative ? -d : d;
+      return first;
+    }
+    if (exponent >= std::numeric_limits<int>::min() / 2 &&
+        exponent <= std::numeric_limits<int>::max() / 2 &&
+        internal::EiselLemire(w, static_cast<int>(exponent), negative,
+                              &value->real)) {
+      return first;
+    }
+  }
+  value->real = internal::StrtodFallback(start, first);
+  return first;
+}
+
+// Converts the text of a valid JSON number to the nearest double.
+inline double NumberTextToDouble(const char *first, const char *last) {
+  NumberValue value;
+  ParseNumber(first, last, &value);
+  return value.ToDouble();
+}
+
+namespace internal {
+
+// Converts the text of a grammar::Number (which may be surrounded by
+// whitespace) to a NumberValue.
+template <typename Range> NumberValue RangeToNumber(const Range &in) {
+  char buffer[64];
+  std::size_t size = 0;
+  for (char ch : in) {
+    if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r') {
+      if (size == sizeof(buffer)) {
+        const std::string number(std::begin(in), std::end(in));
+        NumberValue value;
+        value.kind = NumberValue::Kind::kDouble;
+        value.real = StrtodC(number.c_str());
+        return value;
+      }
+      buffer[size++] = ch;
+    }
+  }
+  NumberValue value;
+  ParseNumber(buffer, buffer + size, &value);
+  return value;
+}
+
+// As RangeToNumber, converted to double.
+template <typename Range> double NumberToDouble(const Range &in) {
+  return RangeToNumber(in).ToDouble();
+}
+
+} // namespace internal
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_NUMBER_H
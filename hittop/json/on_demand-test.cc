@@ -0,0 +1,115 @@
+#include "hittop/json/on_demand.h"
+#include "hittop/json/on_demand.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "hittop/json/parser.h"
+#include "hittop/util/test_data.h"
+
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+TEST(JsonOnDemandTest, Scalars) {
+  EXPECT_TRUE(json::OnDemandValue(" null").is_null());
+  EXPECT_TRUE(json::OnDemandValue("true").get_bool());
+  EXPECT_FALSE(json::OnDemandValue("false ").get_bool());
+  EXPECT_EQ(json::OnDemandValue("-12.5e1").get_number(), -125.0);
+  EXPECT_EQ(json::OnDemandValue("[12345678901234567]")[0].get_int64(),
+            12345678901234567LL);
+  EXPECT_EQ(json::OnDemandValue("\"a\\nb\"").get_string(), "a\nb");
+  EXPECT_EQ(json::OnDemandValue("\"a\\nb\"").get_raw_string(), "a\\nb");
+  EXPECT_THROW(json::OnDemandValue("\"abc\"").get_number(),
+               std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("tru").get_bool(), std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("01").get_number(), std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("  "), std::runtime_error);
+}
+
+TEST(JsonOnDemandTest, Navigation) {
+  const std::string input =
+      R"({"skip": {"a": [1, "]}\"", {"b": "}"}]}, "x\\y": [10, [], {}, 20],)"
+      R"( "target": {"name": "hittop"}})";
+  json::OnDemandValue root(input);
+  EXPECT_EQ(root["target"]["name"].get_string(), "hittop");
+  EXPECT_EQ(root["x\\y"][0].get_number(), 10.0);
+  EXPECT_EQ(root["x\\y"][3].get_number(), 20.0);
+  EXPECT_TRUE(root["x\\y"][1].elements().empty());
+  EXPECT_TRUE(root["x\\y"][2].members().empty());
+  EXPECT_EQ(root["skip"].raw(), R"({"a": [1, "]}\"", {"b": "}"}]})");
+  EXPECT_FALSE(root.find("missing"));
+  EXPECT_THROW(root["missing"], std::out_of_range);
+  EXPECT_THROW(root["x\\y"][4], std::out_of_range);
+  EXPECT_THROW(root[0], std::runtime_error);
+
+  std::vector<std::string> keys;
+  for (const auto &member : root.members()) {
+    keys.emplace_back(member.first.begin(), member.first.end());
+  }
+  EXPECT_EQ(keys, (std::vector<std::string>{"skip", "x\\\\y", "target"}));
+}
+
+TEST(JsonOnDemandTest, SkipsAcrossBlocks) {
+  // Escapes, quotes and brackets at every offset relative to 64-byte blocks.
+  std::string skipped = "[";
+  for (int i = 0; i < 200; ++i) {
+    skipped += std::string(i % 7, ' ') +
+               R"({"k\\": "]}\"[{\\", "v": [)" + std::to_string(i) + "]},";
+  }
+  skipped += "\"\\\\\"]";
+  const std::string input = "{\"skip\": " + skipped + ", \"b\": 7}";
+  json::OnDemandValue root(input);
+  EXPECT_EQ(root["b"].get_number(), 7.0);
+  EXPECT_EQ(root["skip"].raw(), skipped);
+  EXPECT_EQ(root["skip"][199]["v"][0].get_number(), 199.0);
+}
+
+TEST(JsonOnDemandTest, Malformed) {
+  EXPECT_THROW(json::OnDemandValue("[1, 2")[2], std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("[1,]")[1], std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("[1 2]")[1], std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("{\"a\" 1}")["a"], std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("{\"a\": [}")["b"], std::runtime_error);
+  EXPECT_THROW(json::OnDemandValue("{\"a\": \"}")["b"], std::runtime_error);
+  // Skipped contents are not validated.
+  EXPECT_EQ(json::OnDemandValue("{\"a\": [nope], \"b\": 1}")["b"].get_number(),
+            1.0);
+}
+
+TEST(JsonOnDemandTest, ToValueMatchesParseValue) {
+  const std::string input = LoadTestData("/hittop/json/test-data.json");
+  auto result = json::ParseValue(input);
+  ASSERT_TRUE(result.ok());
+  const json::Value &expected = std::get<0>(result.get());
+  EXPECT_TRUE(json::OnDemandValue(input).ToValue() == expected);
+
+  json::OnDemandValue servlet =
+      json::OnDemandValue(input)["web-app"]["servlet"];
+  EXPECT_EQ(servlet[0]["servlet-name"].get_string(), "cofaxCDS");
+  EXPECT_TRUE(servlet[0]["init-param"]["useJSP"].is_bool());
+  const json::Object &web_app = static_cast<const json::Object &>(
+      static_cast<const json::Object &>(expected).at("web-app"));
+  EXPECT_TRUE(servlet.ToValue() == web_app.at("servlet"));
+
+  // Scalars, including a number at the very end of the input, and empty
+  // containers with whitespace inside.
+  const std::string members =
+      R"({"n": 50, "t": true, "z": null, "s": "a\nb", "a": [ ], "o": { }})";
+  const json::OnDemandValue doc(members);
+  EXPECT_TRUE(doc["n"].ToValue() == json::Value(json::Number(50)));
+  EXPECT_TRUE(doc["t"].ToValue() == json::Value(json::Boolean(true)));
+  EXPECT_TRUE(doc["z"].ToValue() == json::Value(json::Null{}));
+  EXPECT_TRUE(doc["s"].ToValue() == json::Value(json::String("a\nb")));
+  EXPECT_TRUE(doc["a"].ToValue() == json::Value(json::Array{}));
+  EXPECT_TRUE(doc["o"].ToValue() == json::Value(json::Object{}));
+  EXPECT_TRUE(json::OnDemandValue("{\"a\":50}")["a"].ToValue() ==
+              json::Value(json::Number(50)));
+  EXPECT_TRUE(json::OnDemandValue("50").ToValue() ==
+              json::Value(json::Number(50)));
+  EXPECT_TRUE(json::OnDemandValue("-1.5e3 ").ToValue() ==
+              json::Value(json::Number(-1500)));
+  EXPECT_THROW(json::OnDemandValue("[1, ]").ToValue(), std::runtime_error);
+}
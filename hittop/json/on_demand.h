@@ -0,0 +1,572 @@
+// On-demand access to JSON text.
+//
+// An OnDemandValue is a cursor into unparsed JSON text.  Nothing is parsed
+// until the caller asks for it: looking up a key scans the object's members
+// one by one, and each member that is passed over (and any array element
+// before the requested index) is skipped by a scan that only tracks quotes,
+// escapes and bracket depth, without validating or converting the contents.
+// Nested arrays and objects are skipped 64 bytes at a time with the same
+// bitmask technique as StructuralIndex, so reading a few fields from a large
+// document costs little more than one pass over its bytes, and allocates
+// nothing until a string is unescaped or a subtree is converted with
+// ToValue().
+//
+// Because skipped text is not validated, a document with errors inside a
+// subtree that is never accessed is not rejected.  Errors found in the parts
+// that are accessed cause std::runtime_error to be thrown.  The text must
+// outlive every OnDemandValue referring to it.
+//
+#ifndef HITTOP_JSON_ON_DEMAND_H
+#define HITTOP_JSON_ON_DEMAND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "boost/iterator/iterator_facade.hpp"
+#include "boost/optional.hpp"
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/util/find_any_of.h"
+
+#include "hittop/json/number.h"
+#include "hittop/json/parse_visitor.h"
+#include "hittop/json/structural_index.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+#include "hittop/json/value_builder.h"
+
+namespace hittop {
+namespace json {
+
+namespace internal {
+
+[[noreturn]] inline void ThrowMalformed() {
+  throw std::runtime_error("malformed json");
+}
+
+inline const char *SkipWhitespace(const char *first, const char *last) {
+  while (first != last && (*first == ' ' || *first == '\t' ||
+                           *first == '\n' || *first == '\r')) {
+    ++first;
+  }
+  return first;
+}
+
+// Given the position just after an opening quote, returns the position just
+// after the closing quote.
+inline const char *SkipString(const char *first, const char *last) {
+  for (;;) {
+    first = util::FindAnyOf<'"', '\\'>(first, last);
+    if (first == last) {
+      ThrowMalformed();
+    }
+    if (*first == '"') {
+      return first + 1;
+    }
+    // Skip the backslash and the character it escapes.
+    if (last - first < 2) {
+      ThrowMalformed();
+    }
+    first += 2;
+  }
+}
+
+// Quotes, backslashes and brackets in one 64-byte block.
+struct BracketMasks {
+  std::uint64_t backslash;
+  std::uint64_t quote;
+  std::uint64_t open;
+  std::uint64_t close;
+};
+
+#if defined(__SSE2__)
+
+inline BracketMasks ClassifyBrackets(const char *block) {
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i quote = _mm_set1_epi8('"');
+  // As in ClassifyBlock, setting bit 5 folds '[' onto '{' and ']' onto '}'.
+  const __m128i bit5 = _mm_set1_epi8(0x20);
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+
+  BracketMasks masks = {0, 0, 0, 0};
+  for (int i = 0; i < 4; ++i) {
+    const __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(block + 16 * i));
+    const __m128i folded = _mm_or_si128(v, bit5);
+    const int shift = 16 * i;
+    masks.backslash |=
+        std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))
+        << shift;
+    masks.quote |= std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))
+                   << shift;
+    masks.open |=
+        std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, open)))
+        << shift;
+    masks.close |=
+        std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(folded, close)))
+        << shift;
+  }
+  return masks;
+}
+
+#else // !defined(__SSE2__)
+
+inline BracketMasks ClassifyBrackets(const char *block) {
+  BracketMasks masks = {0, 0, 0, 0};
+  for (int i = 0; i < 64; ++i) {
+    const std::uint64_t bit = std::uint64_t{1} << i;
+    switch (block[i]) {
+    case '\\':
+      masks.backslash |= bit;
+      break;
+    case '"':
+      masks.quote |= bit;
+      break;
+    case '[':
+    case '{':
+      masks.open |= bit;
+      break;
+    case ']':
+    case '}':
+      masks.close |= bit;
+      break;
+    default:
+      break;
+    }
+  }
+  return masks;
+}
+
+#endif // defined(__SSE2__)
+
+// Given the position of a '[' or '{', returns the position just after the
+// matching ']' or '}'.  The input is classified 64 bytes at a time as in
+// StructuralIndex::Build, and only brackets outside strings are looked at
+// one by one; blocks without a closing bracket need no per-byte work at all.
+inline const char *SkipContainer(const char *first, const char *last) {
+  const std::size_t input_size = last - first;
+  std::uint64_t next_is_escaped = 0;
+  std::uint64_t prev_in_string = 0;
+  std::size_t depth = 0;
+
+  for (std::size_t offset = 0; offset < input_size; offset += 64) {
+    const char *block = first + offset;
+    char padded[64];
+    if (input_size - offset < 64) {
+      std::memset(padded, ' ', sizeof(padded));
+      std::memcpy(padded, block, input_size - offset);
+      block = padded;
+    }
+    const BracketMasks masks = ClassifyBrackets(block);
+    const std::uint64_t quote =
+        masks.quote & ~EscapedMask(masks.backslash, &next_is_escaped);
+    const std::uint64_t in_string = PrefixXor(quote) ^ prev_in_string;
+    prev_in_string = 0 - (in_string >> 63);
+
+    const std::uint64_t open = masks.open & ~in_string;
+    const std::uint64_t close = masks.close & ~in_string;
+    if (close == 0) {
+      depth += __builtin_popcountll(open);
+      continue;
+    }
+    std::uint64_t brackets = open | close;
+    while (brackets != 0) {
+      const int i = CountTrailingZeros(brackets);
+      const std::uint64_t bit = std::uint64_t{1} << i;
+      if (open & bit) {
+        ++depth;
+      } else if (--depth == 0) {
+        return first + offset + i + 1;
+      }
+      brackets &= brackets - 1;
+    }
+  }
+  ThrowMalformed();
+}
+
+// Given the position of the first character of a value, returns the position
+// just past it.
+inline const char *SkipValue(const char *first, const char *last) {
+  if (first == last) {
+    ThrowMalformed();
+  }
+  switch (*first) {
+  case '[':
+  case '{':
+    return SkipContainer(first, last);
+  case '"':
+    return SkipString(first + 1, last);
+  default:
+    while (first != last && !IsScalarEnd(*first)) {
+      ++first;
+    }
+    return first;
+  }
+}
+
+// Returns true if the raw (still escaped) string contents equal key.  Escapes
+// are decoded one at a time, so nothing is allocated.
+inline bool RawStringEquals(const char *first, const char *last,
+                            StringView key) {
+  const char *k = key.begin();
+  for (;;) {
+    const char *const backslash = util::FindAnyOf<'\\'>(first, last);
+    const std::size_t size = backslash - first;
+    if (std::size_t(key.end() - k) < size ||
+        (size != 0 && std::memcmp(first, k, size) != 0)) {
+      return false;
+    }
+    k += size;
+    if (backslash == last) {
+      return k == key.end();
+    }
+    first = backslash + 1;
+    char decoded[4];
+    const std::size_t decoded_size =
+        DecodeEscape(first, last, decoded) - decoded;
+    if (std::size_t(key.end() - k) < decoded_size ||
+        std::memcmp(decoded, k, decoded_size) != 0) {
+      return false;
+    }
+    k += decoded_size;
+  }
+}
+
+} // namespace internal
+
+class OnDemandValue {
+public:
+  class ArrayIterator;
+  class ObjectIterator;
+
+  // Refers to the value at the start of [first, last), after any whitespace.
+  OnDemandValue(const char *first, const char *last)
+      : first_(internal::SkipWhitespace(first, last)), last_(last) {
+    if (first_ == last_) {
+      internal::ThrowMalformed();
+    }
+  }
+
+  explicit OnDemandValue(const std::string &input)
+      : OnDemandValue(input.data(), input.data() + input.size()) {}
+
+  // Determined from the first character only.
+  Value::Type type() const {
+    switch (*first_) {
+    case 'n':
+      return Value::Type::kNull;
+    case 't':
+    case 'f':
+      return Value::Type::kBoolean;
+    case '"':
+      return Value::Type::kString;
+    case '[':
+      return Value::Type::kArray;
+    case '{':
+      return Value::Type::kObject;
+    default:
+      if (*first_ != '-' && !internal::IsDigit(*first_)) {
+        internal::ThrowMalformed();
+      }
+      return Value::Type::kNumber;
+    }
+  }
+
+  bool is_null() const { return type() == Value::Type::kNull; }
+
+  bool is_bool() const { return type() == Value::Type::kBoolean; }
+
+  bool is_number() const { return type() == Value::Type::kNumber; }
+
+  bool is_string() const { return type() == Value::Type::kString; }
+
+  bool is_array() const { return type() == Value::Type::kArray; }
+
+  bool is_object() const { return type() == Value::Type::kObject; }
+
+  // The accessors below validate the value they read, and throw
+  // std::runtime_error if it does not have the requested type or is
+  // malformed.
+
+  bool get_bool() const {
+    Check(is_bool(), "json value is not a boolean");
+    const bool value = *first_ == 't';
+    Check(internal::ScanLiteral(first_, last_, value ? "true" : "false",
+                                value ? 4 : 5)
+              .ok(),
+          "malformed json");
+    return value;
+  }
+
+  double get_number() const { return get_number_value().ToDouble(); }
+
+  std::int64_t get_int64() const {
+    const NumberValue value = get_number_value();
+    Check(value.kind == NumberValue::Kind::kInt64,
+          "json number is not an int64");
+    return value.int64;
+  }
+
+  std::uint64_t get_uint64() const {
+    const NumberValue value = get_number_value();
+    Check(value.kind == NumberValue::Kind::kUint64 ||
+              (value.kind == NumberValue::Kind::kInt64 && value.int64 >= 0),
+          "json number is not a uint64");
+    return value.uint64;
+  }
+
+  NumberValue get_number_value() const {
+    Check(is_number(), "json value is not a number");
+    auto result = internal::ScanNumber(first_, last_);
+    Check(result.ok(), "malformed json");
+    NumberValue value;
+    ParseNumber(first_, result.get(), &value);
+    return value;
+  }
+
+  // Returns the unescaped string.
+  std::string get_string() const {
+    const StringView raw = get_raw_string();
+    return internal::UnescapeUnsafe(
+        boost::make_iterator_range(raw.begin(), raw.end()));
+  }
+
+  // Returns the contents of the string as they appear in the input, without
+  // unescaping (and so without allocating).
+  StringView get_raw_string() const {
+    Check(is_string(), "json value is not a string");
+    bool has_escapes;
+    auto result =
+        internal::ScanStringContents(first_ + 1, last_, &has_escapes);
+    Check(result.ok(), "malformed json");
+    return StringView(first_ + 1, result.get() - (first_ + 1));
+  }
+
+  boost::iterator_range<ArrayIterator> elements() const;
+
+  // Keys are the raw contents of the key strings (see get_raw_string()).
+  boost::iterator_range<ObjectIterator> members() const;
+
+  // Throws std::out_of_range if the array has no such element.
+  OnDemandValue operator[](std::size_t index) const;
+
+  // Throws std::out_of_range if the object has no such member.
+  OnDemandValue operator[](StringView key) const {
+    auto value = find(key);
+    if (!value) {
+      throw std::out_of_range("json object has no such member");
+    }
+    return *value;
+  }
+
+  // Returns the value of the first member named key (compared after
+  // unescaping), if any.
+  boost::optional<OnDemandValue> find(StringView key) const;
+
+  // The text of the value, found by skipping it.
+  StringView raw() const {
+    return StringView(first_, internal::SkipValue(first_, last_) - first_);
+  }
+
+  // Fully parses (and validates) the value, with ParseValueIterative.
+  Value ToValue() const {
+    const StringView text = raw();
+    Value output;
+    KeyTable keys;
+    auto result = ParseValueIterative(text.begin(), text.end(), &output,
+                                      kDefaultMaxDepth, &keys);
+    Check(result.ok(), "malformed json");
+    return output;
+  }
+
+private:
+  static void Check(bool condition, const char *message) {
+    if (!condition) {
+      throw std::runtime_error(message);
+    }
+  }
+
+  const char *first_;
+  const char *last_;
+};
+
+// Iterates over the elements of an array.  The end iterator has a null
+// position; an iterator reaches it by finding the closing ']'.
+class OnDemandValue::ArrayIterator
+    : public boost::iterator_facade<ArrayIterator, OnDemandValue,
+                                    std::forward_iterator_tag,
+                                    OnDemandValue> {
+public:
+  ArrayIterator() = default;
+
+  // pos is just after the '[' or after a ','.
+  ArrayIterator(const char *pos, const char *last, bool first_element)
+      : last_(last) {
+    Seek(pos, first_element);
+  }
+
+private:
+  friend class boost::iterator_core_access;
+
+  void Seek(const char *pos, bool first_element) {
+    pos = internal::SkipWhitespace(pos, last_);
+    if (pos == last_) {
+      internal::ThrowMalformed();
+    }
+    if (*pos == ']') {
+      if (!first_element) {
+        internal::ThrowMalformed();
+      }
+      pos_ = nullptr;
+      return;
+    }
+    pos_ = pos;
+  }
+
+  OnDemandValue dereference() const { return OnDemandValue(pos_, last_); }
+
+  bool equal(const ArrayIterator &that) const { return pos_ == that.pos_; }
+
+  void increment() {
+    const char *pos = internal::SkipWhitespace(
+        internal::SkipValue(pos_, last_), last_);
+    if (pos == last_) {
+      internal::ThrowMalformed();
+    }
+    if (*pos == ']') {
+      pos_ = nullptr;
+    } else if (*pos == ',') {
+      Seek(pos + 1, false);
+    } else {
+      internal::ThrowMalformed();
+    }
+  }
+
+  const char *pos_ = nullptr;
+  const char *last_ = nullptr;
+};
+
+// Iterates over the members of an object.  As with ArrayIterator, the end
+// iterator has a null position.
+class OnDemandValue::ObjectIterator
+    : public boost::iterator_facade<ObjectIterator,
+                                    std::pair<StringView, OnDemandValue>,
+                                    std::forward_iterator_tag,
+                                    std::pair<StringView, OnDemandValue>> {
+public:
+  ObjectIterator() = default;
+
+  // pos is just after the '{' or after a ','.
+  ObjectIterator(const char *pos, const char *last, bool first_member)
+      : last_(last) {
+    Seek(pos, first_member);
+  }
+
+  // The raw contents of the key.
+  StringView key() const { return key_; }
+
+  OnDemandValue value() const { return OnDemandValue(value_, last_); }
+
+private:
+  friend class boost::iterator_core_access;
+
+  void Seek(const char *pos, bool first_member) {
+    pos = internal::SkipWhitespace(pos, last_);
+    if (pos == last_) {
+      internal::ThrowMalformed();
+    }
+    if (*pos == '}' && first_member) {
+      value_ = nullptr;
+      return;
+    }
+    if (*pos != '"') {
+      internal::ThrowMalformed();
+    }
+    const char *const key_last = internal::SkipString(pos + 1, last_) - 1;
+    key_ = StringView(pos + 1, key_last - (pos + 1));
+    pos = internal::SkipWhitespace(key_last + 1, last_);
+    if (pos == last_ || *pos != ':') {
+      internal::ThrowMalformed();
+    }
+    value_ = internal::SkipWhitespace(pos + 1, last_);
+    if (value_ == last_) {
+      internal::ThrowMalformed();
+    }
+  }
+
+  std::pair<StringView, OnDemandValue> dereference() const {
+    return {key(), value()};
+  }
+
+  bool equal(const ObjectIterator &that) const {
+    return value_ == that.value_;
+  }
+
+  void increment() {
+    const char *pos = internal::SkipWhitespace(
+        internal::SkipValue(value_, last_), last_);
+    if (pos == last_) {
+      internal::ThrowMalformed();
+    }
+    if (*pos == '}') {
+      value_ = nullptr;
+    } else if (*pos == ',') {
+      Seek(pos + 1, false);
+    } else {
+      internal::ThrowMalformed();
+    }
+  }
+
+  StringView key_;
+  const char *value_ = nullptr;
+  const char *last_ = nullptr;
+};
+
+inline boost::iterator_range<OnDemandValue::ArrayIterator>
+OnDemandValue::elements() const {
+  Check(is_array(), "json value is not an array");
+  return {ArrayIterator(first_ + 1, last_, true), ArrayIterator()};
+}
+
+inline boost::iterator_range<OnDemandValue::ObjectIterator>
+OnDemandValue::members() const {
+  Check(is_object(), "json value is not an object");
+  return {ObjectIterator(first_ + 1, last_, true), ObjectIterator()};
+}
+
+inline OnDemandValue OnDemandValue::operator[](std::size_t index) const {
+  auto elements = this->elements();
+  for (auto it = elements.begin(); it != elements.end(); ++it, --index) {
+    if (index == 0) {
+      return *it;
+    }
+  }
+  throw std::out_of_range("json array index out of range");
+}
+
+inline boost::optional<OnDemandValue>
+OnDemandValue::find(StringView key) const {
+  auto members = this->members();
+  for (auto it = members.begin(); it != members.end(); ++it) {
+    if (internal::RawStringEquals(it.key().begin(), it.key().end(), key)) {
+      return it.value();
+    }
+  }
+  return boost::none;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_ON_DEMAND_H
@@ -0,0 +1,93 @@
+// Compares reading three fields from a generated ~1MB document with
+// OnDemandValue against fully parsing it with ParseValue.
+//
+// usage: on_demand_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/on_demand.h"
+#include "hittop/json/parser.h"
+#include "hittop/json/types.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+// An object whose first field is small, followed by a large array of
+// records, a nested object and a field at the very end.
+std::string MakeDocument(std::size_t target_size) {
+  std::string doc = "{\"id\": 1234567, \"items\": [";
+  for (std::size_t i = 0; doc.size() < target_size; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    const std::string n = std::to_string(i);
+    doc += "{\"index\": " + n + ", \"name\": \"item " + n +
+           "\", \"tags\": [\"a\", \"b\\\"]\", \"c\"], \"price\": " + n +
+           ".25, \"active\": " + (i % 2 ? "true" : "false") +
+           ", \"attributes\": {\"color\": \"red\", \"size\": null}}";
+  }
+  doc += "], \"user\": {\"name\": \"hittop\", \"email\": \"x@example.com\"},"
+         " \"status\": \"ok\"}";
+  return doc;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100;
+  const std::string doc = MakeDocument(1 << 20);
+
+  double checksum = 0;
+  for (int j = 0; j < 5; ++j) {
+    Report("on_demand", TimeUsec(count,
+                                 [&doc, &checksum]() {
+                                   json::OnDemandValue root(doc);
+                                   checksum += root["id"].get_number();
+                                   checksum +=
+                                       root["user"]["name"].get_raw_string()
+                                           .size();
+                                   checksum +=
+                                       root["status"].get_raw_string().size();
+                                 }),
+           count, doc.size());
+  }
+  const unsigned parse_count = count / 10 + 1;
+  for (int j = 0; j < 5; ++j) {
+    Report("parse_value",
+           TimeUsec(parse_count,
+                    [&doc, &checksum]() {
+                      auto result = json::ParseValue(doc);
+                      if (!result.ok()) {
+                        std::cerr << "Fail!" << std::endl;
+                        std::exit(1);
+                      }
+                      const auto &root = static_cast<const json::Object &>(
+                          std::get<0>(result.get()));
+                      checksum += static_cast<const json::Number &>(
+                          root.at("id"));
+                      checksum += static_cast<const json::String &>(
+                                      static_cast<const json::Object &>(
+                                          root.at("user"))
+                                          .at("name"))
+                                      .size();
+                      checksum += static_cast<const json::String &>(
+                                      root.at("status"))
+                                      .size();
+                    }),
+           parse_count, doc.size());
+  }
+  std::cout << "doc size: " << doc.size() << " checksum: " << checksum
+            << std::endl;
+  return 0;
+}
@@ -1,14 +1,17 @@
 #ifndef HITTOP_JSON_PARSE_VISITOR_H
 #define HITTOP_JSON_PARSE_VISITOR_H
 
+#include <cstring>
 #include <iterator>
-#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 
+#include "hittop/util/find_any_of.h"
 #include "hittop/util/first_match.h"
-#include "hittop/util/range_to_string.h"
 
 #include "hittop/json/grammar.h"
+#include "hittop/json/number.h"
 #include "hittop/json/types.h"
 
 namespace hittop {
@@ -26,73 +29,187 @@ inline unsigned long HexValue(int x) {
   }
 }
 
-/* Returns the given character range as a string with all JSON escaped chars
- * replaced by their UTF-8 equivalent.  This function is unsafe to call on
- * ranges that are not valid JSON string content sequences (e.g., it does not
- * make sure that the character after a '\' is inside the range).
+// Returns the value of the four hex digits starting at next, and advances
+// next past them.
+template <typename Iterator> inline unsigned long ReadHex4(Iterator &next) {
+  unsigned long value = 0;
+  for (int i = 0; i < 4; ++i, ++next) {
+    value = (value << 4) | HexValue(*next);
+  }
+  return value;
+}
+
+inline bool IsHighSurrogate(unsigned long u16) {
+  return 0xd800 <= u16 && u16 < 0xdc00;
+}
+
+inline bool IsLowSurrogate(unsigned long u16) {
+  return 0xdc00 <= u16 && u16 < 0xe000;
+}
+
+// Writes the UTF-8 encoding of the code point cp to out.  (Unpaired
+// surrogates are encoded like any other code point.)
+template <typename OutputIterator>
+inline OutputIterator EncodeUtf8(unsigned long cp, OutputIterator out) {
+  if (cp < 0x80) {
+    *out++ = char(cp);
+  } else if (cp < 0x800) {
+    *out++ = char(0xc0 | (cp >> 6));
+    *out++ = char(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    *out++ = char(0xe0 | (cp >> 12));
+    *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+    *out++ = char(0x80 | (cp & 0x3f));
+  } else {
+    *out++ = char(0xf0 | (cp >> 18));
+    *out++ = char(0x80 | ((cp >> 12) & 0x3f));
+    *out++ = char(0x80 | ((cp >> 6) & 0x3f));
+    *out++ = char(0x80 | (cp & 0x3f));
+  }
+  return out;
+}
+
+// Decodes the escape sequence whose first character (after the '\') is at
+// next, writes its UTF-8 encoding to out and advances next past it.  A \u
+// escape of a high surrogate that is immediately followed by a \u escape of a
+// low surrogate is decoded as the pair.
+template <typename Iterator, typename OutputIterator>
+inline OutputIterator DecodeEscape(Iterator &next, Iterator last,
+                                   OutputIterator out) {
+  switch (*next++) {
+  case '"':
+    *out++ = '"';
+    break;
+  case '\\':
+    *out++ = '\\';
+    break;
+  case '/':
+    *out++ = '/';
+    break;
+  case 'b':
+    *out++ = '\b';
+    break;
+  case 'f':
+    *out++ = '\f';
+    break;
+  case 'n':
+    *out++ = '\n';
+    break;
+  case 'r':
+    *out++ = '\r';
+    break;
+  case 't':
+    *out++ = '\t';
+    break;
+  case 'u': {
+    unsigned long cp = ReadHex4(next);
+    if (IsHighSurrogate(cp)) {
+      // Look ahead for "\uXXXX" without reading past last.
+      Iterator ahead = next;
+      int i = 0;
+      for (; i < 6 && ahead != last; ++i, ++ahead) {
+        if ((i == 0 && *ahead != '\\') || (i == 1 && *ahead != 'u')) {
+          break;
+        }
+      }
+      if (i == 6) {
+        Iterator low_digits = std::next(next, 2);
+        const unsigned long low = ReadHex4(low_digits);
+        if (IsLowSurrogate(low)) {
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+          next = low_digits;
+        }
+      }
+    }
+    out = EncodeUtf8(cp, out);
+    break;
+  }
+  default:
+    throw std::runtime_error("bad json escape sequence");
+  }
+  return out;
+}
+
+/* Writes [first, last) to out with all JSON escape sequences replaced by their
+ * UTF-8 equivalent, and returns the end of the output.  Runs of characters
+ * between escapes are found with a SIMD search for '\' and copied with
+ * memcpy.  The output is never longer than the input, so out may point to a
+ * buffer of last - first bytes.
  */
-template <typename Range> inline std::string UnescapeUnsafe(const Range &in) {
-  std::ostringstream out;
+inline char *UnescapeUnsafe(const char *first, const char *last, char *out) {
+  for (;;) {
+    const char *const backslash = util::FindAnyOf<'\\'>(first, last);
+    std::memcpy(out, first, backslash - first);
+    out += backslash - first;
+    if (backslash == last) {
+      return out;
+    }
+    first = backslash + 1;
+    out = DecodeEscape(first, last, out);
+  }
+}
+
+// True for iterators over contiguous chars, which can be handed to the
+// pointer version of UnescapeUnsafe.
+template <typename Iterator> struct IsContiguousChars : std::false_type {};
+template <> struct IsContiguousChars<const char *> : std::true_type {};
+template <> struct IsContiguousChars<char *> : std::true_type {};
+template <>
+struct IsContiguousChars<std::string::const_iterator> : std::true_type {};
+template <> struct IsContiguousChars<std::string::iterator> : std::true_type {};
+
+template <typename Range, typename OutputIterator>
+inline OutputIterator UnescapeUnsafe(const Range &in, OutputIterator out,
+                                     std::false_type) {
   auto next = std::begin(in);
   auto last = std::end(in);
-  for (; next != last; ++next) {
-    switch (*next) {
-    case '\\':
+  while (next != last) {
+    if (*next == '\\') {
       ++next;
-      switch (*next) {
-      case '"':
-        out << char('"');
-        break;
-      case '\\':
-        out << char('\\');
-        break;
-      case '/':
-        out << char('/');
-        break;
-      case 'b':
-        out << char('\b');
-        break;
-      case 'f':
-        out << char('\f');
-        break;
-      case 'n':
-        out << char('\n');
-        break;
-      case 'r':
-        out << char('\r');
-        break;
-      case 't':
-        out << char('\t');
-        break;
-      case 'u': {
-        const unsigned int u16 = (HexValue(*std::next(next, 1)) << 12) | //
-                                 (HexValue(*std::next(next, 2)) << 8) |  //
-                                 (HexValue(*std::next(next, 3)) << 4) |  //
-                                 (HexValue(*std::next(next, 4)));
-        std::advance(next, 3);
-        if (u16 < 0x80) {
-          out << char(u16);
-        } else {
-          if (u16 < 0x800) {
-            out << char(0xc0 | ((u16 >> 6) & 0x1f))
-                << char(0x80 | ((u16 >> 0) & 0x3f));
-          } else {
-            out << char(0xe0 | ((u16 >> 12) & 0x0f))
-                << char(0x80 | ((u16 >> 6) & 0x3f))
-                << char(0x80 | ((u16 >> 0) & 0x3f));
-          }
-        }
-        break;
-      }
-      default:
-        throw std::runtime_error("bad json escape sequence");
-      }
-      break;
-    default:
-      out << char(*next);
+      out = DecodeEscape(next, last, out);
+    } else {
+      *out++ = char(*next++);
     }
   }
-  return out.str();
+  return out;
+}
+
+template <typename Range>
+inline char *UnescapeUnsafe(const Range &in, char *out, std::true_type) {
+  if (std::begin(in) == std::end(in)) {
+    return out;
+  }
+  const char *const first = &*std::begin(in);
+  return UnescapeUnsafe(first, first + std::distance(std::begin(in),
+                                                     std::end(in)),
+                        out);
+}
+
+/* Writes the given character range to out with all JSON escaped chars
+ * replaced by their UTF-8 equivalent, and returns the end of the output.  The
+ * output is never longer than the input.  This function is unsafe to call on
+ * ranges that are not valid JSON string content sequences (e.g., it does not
+ * make sure that the character after a '\' is inside the range).
+ */
+template <typename Range, typename OutputIterator>
+inline OutputIterator UnescapeUnsafe(const Range &in, OutputIterator out) {
+  using Iterator = typename std::decay<decltype(std::begin(in))>::type;
+  return UnescapeUnsafe(
+      in, out,
+      std::integral_constant<bool, IsContiguousChars<Iterator>::value &&
+                                       std::is_same<OutputIterator,
+                                                    char *>::value>());
+}
+
+/* Returns the given character range as a string with all JSON escaped chars
+ * replaced by their UTF-8 equivalent.  See above.  Allocates at most once.
+ */
+template <typename Range> inline std::string UnescapeUnsafe(const Range &in) {
+  std::string out(std::distance(std::begin(in), std::end(in)), '\0');
+  if (!out.empty()) {
+    out.resize(UnescapeUnsafe(in, &out[0]) - &out[0]);
+  }
+  return out;
 }
 
 } // namespace internal
@@ -100,9 +217,12 @@ template <typename Range> inline std::string UnescapeUnsafe(const Range &in) {
 class ValueParseVisitor {
 private:
   Value *const output_;
+  KeyTable *const keys_;
 
 public:
-  explicit ValueParseVisitor(Value *output) : output_(output) {}
+  // Object keys are interned in keys, if it is not null.
+  explicit ValueParseVisitor(Value *output, KeyTable *keys = nullptr)
+      : output_(output), keys_(keys) {}
 
   ValueParseVisitor(const ValueParseVisitor &) = delete;
   ValueParseVisitor &operator=(const ValueParseVisitor &) = delete;
@@ -126,7 +246,7 @@ public:
   template <typename F> void operator()(grammar::Number, F &&run_parser) const {
     auto result = run_parser();
     if (result.ok()) {
-      *output_ = std::stod(util::RangeToString(result.get()));
+      *output_ = internal::NumberToDouble(result.get());
     }
   }
 
@@ -139,9 +259,11 @@ public:
 
   template <typename F> void operator()(grammar::Array, F &&run_parser) const {
     Array items;
-    auto result = run_parser([&items](grammar::Value, auto get_item_result) {
+    KeyTable *const keys = keys_;
+    auto result = run_parser([&items, keys](grammar::Value,
+                                            auto get_item_result) {
       Value next_item;
-      ValueParseVisitor item_visitor{&next_item};
+      ValueParseVisitor item_visitor{&next_item, keys};
       auto item_result = get_item_result(item_visitor);
       if (item_result.ok()) {
         items.emplace_back(std::move(next_item));
@@ -154,8 +276,9 @@ public:
 
   template <typename F> void operator()(grammar::Object, F &&run_parser) const {
     Object object;
-    auto result =
-        run_parser([&object](grammar::Property, auto get_property_result) {
+    KeyTable *const keys = keys_;
+    auto result = run_parser(
+        [&object, keys](grammar::Property, auto get_property_result) {
           std::string name;
           get_property_result(util::FirstMatch(
               [&name](grammar::StringContents, auto get_name_result) {
@@ -164,13 +287,13 @@ public:
                   name = internal::UnescapeUnsafe(name_result.get());
                 }
               },
-              [&object, &name](grammar::Value, auto get_value_result) {
+              [&object, &name, keys](grammar::Value, auto get_value_result) {
                 Value property;
-                ValueParseVisitor property_visitor{&property};
+                ValueParseVisitor property_visitor{&property, keys};
                 auto value_result = get_value_result(property_visitor);
                 if (value_result.ok()) {
-                  object.emplace(
-                      std::make_pair(std::move(name), std::move(property)));
+                  object.emplace(keys ? keys->Intern(name) : Key(name),
+                                 std::move(property));
                 }
               }));
         });
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include <iostream>
+#include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -92,3 +93,38 @@ TEST(ParseJson, ParseComplexObject) {
 
   EXPECT_EQ(servlet.size(), 5);
 }
+
+TEST(ParseJson, UnicodeEscape) {
+  std::string input = "\"a\\u00e9b\\u0041\"";
+  auto result = json::ParseValue(input);
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(static_cast<const json::String &>(std::get<0>(result.get())),
+            "a\xc3\xa9" "bA");
+}
+
+TEST(ParseJson, SurrogatePairs) {
+  // U+1F600 as a surrogate pair, then an unpaired high surrogate.
+  std::string input = "\"\\ud83d\\ude00 \\ud83dx\"";
+  auto result = json::ParseValue(input);
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(static_cast<const json::String &>(std::get<0>(result.get())),
+            "\xf0\x9f\x98\x80 \xed\xa0\xbdx");
+}
+
+TEST(ParseJson, UnescapeLongRuns) {
+  for (std::size_t pad = 0; pad < 40; ++pad) {
+    const std::string run(pad, 'x');
+    const std::string raw = run + "\\n" + run + "\\\\" + run + "\\u0041";
+    const std::string expected = run + "\n" + run + "\\" + run + "A";
+    EXPECT_EQ(json::internal::UnescapeUnsafe(raw), expected);
+
+    std::vector<char> out(raw.size());
+    char *end = json::internal::UnescapeUnsafe(
+        raw.data(), raw.data() + raw.size(), out.data());
+    EXPECT_EQ(std::string(out.data(), end), expected);
+
+    // The generic path, for non-contiguous input.
+    std::list<char> list(raw.begin(), raw.end());
+    EXPECT_EQ(json::internal::UnescapeUnsafe(list), expected);
+  }
+}
@@ -15,15 +15,25 @@ namespace json {
 template <typename Iterator>
 using ParseResult = parser::ParseResult<std::tuple<Value, Iterator>>;
 
+// Parses a JSON value, interning object keys in keys: sharing a KeyTable
+// between documents lets them share their keys too.
 template <typename Range>
-auto ParseValue(const Range &input)
+auto ParseValue(const Range &input, KeyTable *keys)
     -> ParseResult<decltype(std::begin(input))> {
   Value output;
   auto result =
-      parser::Parse<grammar::Value>(input, ValueParseVisitor{&output});
+      parser::Parse<grammar::Value>(input, ValueParseVisitor{&output, keys});
   return {std::make_tuple(std::move(output), result.consume()), result.error()};
 }
 
+// Parses a JSON value; the keys of its objects are interned per document.
+template <typename Range>
+auto ParseValue(const Range &input)
+    -> ParseResult<decltype(std::begin(input))> {
+  KeyTable keys;
+  return ParseValue(input, &keys);
+}
+
 } // namespace json
 } // namespace hittop
 
@@ -0,0 +1,125 @@
+#include "hittop/json/path_query.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hittop/json/structural_parser.h"
+#include "hittop/util/test_data.h"
+
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+// Returns "path=text" for each match, in the order reported.
+std::vector<std::string> Matches(const json::PathQuery &query,
+                                 const std::string &input) {
+  std::vector<std::string> matches;
+  query.Run(input, [&matches](std::size_t path, json::StringView span) {
+    matches.push_back(std::to_string(path) + "=" + span.to_string());
+  });
+  return matches;
+}
+
+} // namespace
+
+TEST(PathQueryTest, Paths) {
+  const std::string input = R"( {
+    "user": {"id": 42, "name": "x"},
+    "events": [{"type": "a", "n": 1}, {"n": 2}, {"type": ["b"]}],
+    "a/b": {"~c": true},
+    "": null
+  } )";
+  EXPECT_EQ(Matches({"/user/id", "/events/*/type", "/events/1/n"}, input),
+            (std::vector<std::string>{"0=42", "1=\"a\"", "2=2", "1=[\"b\"]"}));
+  EXPECT_EQ(Matches({"/a~1b/~0c", "/"}, input),
+            (std::vector<std::string>{"0=true", "1=null"}));
+  EXPECT_EQ(Matches({"/user/*"}, input),
+            (std::vector<std::string>{"0=42", "0=\"x\""}));
+  EXPECT_EQ(Matches({"/missing", "/user/id/deeper", "/events/7"}, input),
+            std::vector<std::string>{});
+
+  // Nested matches are reported before the values that contain them.
+  EXPECT_EQ(Matches({"/user", "/user/name"}, input),
+            (std::vector<std::string>{"1=\"x\"",
+                                      "0={\"id\": 42, \"name\": \"x\"}"}));
+
+  // The empty pointer refers to the whole document.
+  EXPECT_EQ(Matches({""}, "[1, 2]"), std::vector<std::string>{"0=[1, 2]"});
+
+  // Keys are compared after unescaping.
+  EXPECT_EQ(Matches({"/ab"}, R"({"a\u0062": 1})"),
+            std::vector<std::string>{"0=1"});
+  EXPECT_EQ(Matches({"/a", "/abc", "/a\"b"},
+                    R"({"a\u0062": 1, "a\"b": 2, "a\"": 3})"),
+            std::vector<std::string>{"2=2"});
+  EXPECT_EQ(Matches({"/caf\xc3\xa9\xf0\x9f\x98\x80"},
+                    R"({"caf\u00e9\ud83d\ude00": 1})"),
+            std::vector<std::string>{"0=1"});
+}
+
+TEST(PathQueryTest, MatchesTape) {
+  const std::string input = LoadTestData("/hittop/json/test-data.json");
+  const json::PathQuery query = {"/web-app/servlet/*/servlet-name",
+                                 "/web-app/taglib/taglib-location"};
+  const json::Document doc = [&input]() {
+    json::Document doc;
+    json::StructuralParser().Parse(input, &doc);
+    return doc;
+  }();
+
+  std::vector<std::string> expected;
+  const json::ValueRef app = *doc.root().find("web-app");
+  for (json::ValueRef servlet : app.find("servlet")->elements()) {
+    expected.push_back("0=\"" + servlet.find("servlet-name")->get_string()
+                                    .to_string() +
+                       "\"");
+  }
+  expected.push_back(
+      "1=\"" +
+      app.find("taglib")->find("taglib-location")->get_string().to_string() +
+      "\"");
+  EXPECT_EQ(Matches(query, input), expected);
+}
+
+TEST(PathQueryTest, StopsWhenAllPathsMatched) {
+  // Nothing after the last match is looked at.
+  EXPECT_EQ(Matches({"/b", "/a"}, R"({"a": 1, "b": [2], "c": !!!)"),
+            (std::vector<std::string>{"1=1", "0=[2]"}));
+  // Also with more paths than fit in one word of match bits.
+  std::vector<std::string> paths;
+  std::string input = "{";
+  std::vector<std::string> expected;
+  for (int i = 0; i < 100; ++i) {
+    paths.push_back("/k" + std::to_string(i));
+    input += "\"k" + std::to_string(i) + "\": " + std::to_string(i) + ", ";
+    expected.push_back(std::to_string(i) + "=" + std::to_string(i));
+  }
+  input += "\"c\": !!!";
+  EXPECT_EQ(Matches(json::PathQuery(paths), input), expected);
+
+  // With a wildcard, the whole document is scanned.
+  EXPECT_THROW(Matches({"/b/*"}, R"({"a": 1, "b": [2], "c": !!!)"),
+               std::runtime_error);
+}
+
+TEST(PathQueryTest, DuplicateKeys) {
+  // A path that matches twice still counts once towards stopping early.
+  EXPECT_EQ(Matches({"/a", "/b"}, R"({"a": 1, "a": 2, "b": 3})"),
+            (std::vector<std::string>{"0=1", "0=2", "1=3"}));
+  EXPECT_EQ(Matches({"/a/x", "/b"},
+                    R"({"a": {"x": 1, "x": 2}, "a": {"x": 3}, "b": 4})"),
+            (std::vector<std::string>{"0=1", "0=2", "0=3", "1=4"}));
+}
+
+TEST(PathQueryTest, Errors) {
+  EXPECT_THROW(json::PathQuery({"user"}), std::invalid_argument);
+  EXPECT_THROW(json::PathQuery({"/a~2"}), std::invalid_argument);
+  EXPECT_THROW(Matches({"/a/b"}, R"({"a": {"b" 1}})"), std::runtime_error);
+  EXPECT_THROW(Matches({"/a/1"}, R"({"a": [1 2]})"), std::runtime_error);
+  EXPECT_THROW(Matches({"/a/c"}, R"({"a": {"b": 1)"), std::runtime_error);
+}
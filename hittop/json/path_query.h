@@ -0,0 +1,323 @@
+// Extraction of values at a set of paths from JSON text, without parsing the
+// rest of the document.
+//
+// A PathQuery is compiled once from a list of JSON Pointers (RFC 6901), e.g.
+// "/user/id", in which a "*" segment matches every member of an object or
+// element of an array, e.g. "/events/*/type".  The paths are merged into a
+// trie, and Run() walks a document along the trie: a member or element that
+// no path continues into is passed over with the same bitmask skip as
+// OnDemandValue, and each value at the end of a path is reported as the span
+// of its raw text.  Nothing is converted while matching, and nothing is
+// allocated either unless the query has more than 64 paths; a span can be
+// read with OnDemandValue(span.begin(), span.end()).
+//
+// Like OnDemandValue, Run() validates only what it has to look at, and throws
+// std::runtime_error if that is malformed.
+//
+#ifndef HITTOP_JSON_PATH_QUERY_H
+#define HITTOP_JSON_PATH_QUERY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hittop/json/on_demand.h"
+#include "hittop/json/tape.h"
+
+namespace hittop {
+namespace json {
+
+class PathQuery {
+public:
+  // Throws std::invalid_argument if a path is not a valid JSON Pointer.
+  explicit PathQuery(const std::vector<std::string> &paths) : nodes_(1) {
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+      Add(paths[i], i);
+    }
+    for (const Node &node : nodes_) {
+      has_wildcards_ = has_wildcards_ || node.wildcard != kNone;
+    }
+    num_paths_ = paths.size();
+  }
+
+  PathQuery(std::initializer_list<std::string> paths)
+      : PathQuery(std::vector<std::string>(paths)) {}
+
+  std::size_t size() const { return num_paths_; }
+
+  // Calls on_match(path, span) for each value in [first, last) at one of the
+  // paths, where path is its index in the list the query was compiled from
+  // and span is a StringView of the value's text.  A value is reported after
+  // any values nested within it.  If no path has a wildcard, the scan stops
+  // as soon as every path has been matched.
+  template <typename Callback>
+  void Run(const char *first, const char *last, Callback on_match) const {
+    first = internal::SkipWhitespace(first, last);
+    MatchState state;
+    if (!has_wildcards_) {
+      if (num_paths_ > 64) {
+        state.more_matched.reset(new std::uint64_t[(num_paths_ + 63) / 64]());
+        state.matched = state.more_matched.get();
+      }
+      state.unmatched = num_paths_;
+    }
+    MatchValue(0, first, last, on_match, &state);
+  }
+
+  template <typename Callback>
+  void Run(const std::string &input, Callback on_match) const {
+    Run(input.data(), input.data() + input.size(), on_match);
+  }
+
+private:
+  static constexpr std::size_t kNone = std::numeric_limits<std::size_t>::max();
+
+  struct Child {
+    // The unescaped segment.
+    std::string key;
+    // The segment as an array index, or kNone.
+    std::size_t index;
+    std::size_t node;
+  };
+
+  // Tracks which paths have been matched, to stop early; unused (unmatched is
+  // kNone) if any path has a wildcard.  With duplicate keys a path can match
+  // more than once, so only its first match counts.
+  struct MatchState {
+    // Bit i % 64 of matched[i / 64] is set once path i has matched.  The bits
+    // of up to 64 paths are kept in inline_matched; more are allocated.
+    std::uint64_t inline_matched = 0;
+    std::unique_ptr<std::uint64_t[]> more_matched;
+    std::uint64_t *matched = &inline_matched;
+    std::size_t unmatched = kNone;
+  };
+
+  struct Node {
+    std::vector<Child> children;
+    // The node for a "*" segment, or kNone.
+    std::size_t wildcard = kNone;
+    // The paths that end here.
+    std::vector<std::size_t> paths;
+  };
+
+  static std::string Unescape(const std::string &segment) {
+    std::string out;
+    for (std::size_t i = 0; i < segment.size(); ++i) {
+      if (segment[i] != '~') {
+        out += segment[i];
+      } else if (i + 1 < segment.size() && segment[i + 1] == '0') {
+        out += '~';
+        ++i;
+      } else if (i + 1 < segment.size() && segment[i + 1] == '1') {
+        out += '/';
+        ++i;
+      } else {
+        throw std::invalid_argument("bad escape in json pointer: " + segment);
+      }
+    }
+    return out;
+  }
+
+  // Returns the array index a segment denotes, or kNone.
+  static std::size_t ToIndex(const std::string &segment) {
+    if (segment.empty() || segment.size() > 18 ||
+        (segment[0] == '0' && segment.size() > 1)) {
+      return kNone;
+    }
+    std::size_t index = 0;
+    for (char ch : segment) {
+      if (!internal::IsDigit(ch)) {
+        return kNone;
+      }
+      index = index * 10 + (ch - '0');
+    }
+    return index;
+  }
+
+  void Add(const std::string &path, std::size_t id) {
+    if (!path.empty() && path[0] != '/') {
+      throw std::invalid_argument("json pointer must start with '/': " + path);
+    }
+    std::size_t node = 0;
+    std::size_t pos = 0;
+    while (pos < path.size()) {
+      const std::size_t end = std::min(path.find('/', pos + 1), path.size());
+      const std::string segment = path.substr(pos + 1, end - pos - 1);
+      pos = end;
+      if (segment == "*") {
+        if (nodes_[node].wildcard == kNone) {
+          nodes_[node].wildcard = nodes_.size();
+          nodes_.emplace_back();
+        }
+        node = nodes_[node].wildcard;
+        continue;
+      }
+      const std::string key = Unescape(segment);
+      std::size_t next = kNone;
+      for (const Child &child : nodes_[node].children) {
+        if (child.key == key) {
+          next = child.node;
+        }
+      }
+      if (next == kNone) {
+        next = nodes_.size();
+        nodes_[node].children.push_back({key, ToIndex(key), next});
+        nodes_.emplace_back();
+      }
+      node = next;
+    }
+    nodes_[node].paths.push_back(id);
+  }
+
+  // Matches the value at first against node, and returns the position just
+  // past it, or nullptr once every path has been matched.
+  template <typename Callback>
+  const char *MatchValue(std::size_t node, const char *first, const char *last,
+                         Callback &on_match, MatchState *state) const {
+    const Node &n = nodes_[node];
+    const char *end;
+    if (first == last) {
+      internal::ThrowMalformed();
+    }
+    if (n.children.empty() && n.wildcard == kNone) {
+      end = internal::SkipValue(first, last);
+    } else if (*first == '{') {
+      end = MatchObject(n, first + 1, last, on_match, state);
+    } else if (*first == '[') {
+      end = MatchArray(n, first + 1, last, on_match, state);
+    } else {
+      end = internal::SkipValue(first, last);
+    }
+    if (end == nullptr) {
+      return nullptr;
+    }
+    for (std::size_t path : n.paths) {
+      on_match(path, StringView(first, end - first));
+      if (state->unmatched == kNone) {
+        continue;
+      }
+      std::uint64_t &word = state->matched[path / 64];
+      const std::uint64_t bit = std::uint64_t{1} << (path % 64);
+      if ((word & bit) == 0) {
+        word |= bit;
+        if (--state->unmatched == 0) {
+          return nullptr;
+        }
+      }
+    }
+    return end;
+  }
+
+  // Matches the member or element at first against the child of n (if any)
+  // and its wildcard (if any).
+  template <typename Callback>
+  const char *MatchChild(const Node &n, std::size_t child, const char *first,
+                         const char *last, Callback &on_match,
+                         MatchState *state) const {
+    if (child == kNone && n.wildcard == kNone) {
+      return internal::SkipValue(first, last);
+    }
+    const char *end = first;
+    if (child != kNone) {
+      end = MatchValue(child, first, last, on_match, state);
+    }
+    if (end != nullptr && n.wildcard != kNone) {
+      end = MatchValue(n.wildcard, first, last, on_match, state);
+    }
+    return end;
+  }
+
+  // first is just after the '{'.
+  template <typename Callback>
+  const char *MatchObject(const Node &n, const char *first, const char *last,
+                          Callback &on_match, MatchState *state) const {
+    const char *p = internal::SkipWhitespace(first, last);
+    if (p != last && *p == '}') {
+      return p + 1;
+    }
+    for (;;) {
+      if (p == last || *p != '"') {
+        internal::ThrowMalformed();
+      }
+      const char *const key_first = p + 1;
+      const char *const key_last = internal::SkipString(key_first, last) - 1;
+      p = internal::SkipWhitespace(key_last + 1, last);
+      if (p == last || *p != ':') {
+        internal::ThrowMalformed();
+      }
+      p = internal::SkipWhitespace(p + 1, last);
+      std::size_t child = kNone;
+      for (const Child &c : n.children) {
+        if (internal::RawStringEquals(key_first, key_last, c.key)) {
+          child = c.node;
+          break;
+        }
+      }
+      p = MatchChild(n, child, p, last, on_match, state);
+      if (p == nullptr) {
+        return nullptr;
+      }
+      p = internal::SkipWhitespace(p, last);
+      if (p == last) {
+        internal::ThrowMalformed();
+      }
+      if (*p == '}') {
+        return p + 1;
+      }
+      if (*p != ',') {
+        internal::ThrowMalformed();
+      }
+      p = internal::SkipWhitespace(p + 1, last);
+    }
+  }
+
+  // first is just after the '['.
+  template <typename Callback>
+  const char *MatchArray(const Node &n, const char *first, const char *last,
+                         Callback &on_match, MatchState *state) const {
+    const char *p = internal::SkipWhitespace(first, last);
+    if (p != last && *p == ']') {
+      return p + 1;
+    }
+    for (std::size_t index = 0;; ++index) {
+      std::size_t child = kNone;
+      for (const Child &c : n.children) {
+        if (c.index == index) {
+          child = c.node;
+          break;
+        }
+      }
+      p = MatchChild(n, child, p, last, on_match, state);
+      if (p == nullptr) {
+        return nullptr;
+      }
+      p = internal::SkipWhitespace(p, last);
+      if (p == last) {
+        internal::ThrowMalformed();
+      }
+      if (*p == ']') {
+        return p + 1;
+      }
+      if (*p != ',') {
+        internal::ThrowMalformed();
+      }
+      p = internal::SkipWhitespace(p + 1, last);
+    }
+  }
+
+  // nodes_[0] is the root.
+  std::vector<Node> nodes_;
+  std::size_t num_paths_ = 0;
+  bool has_wildcards_ = false;
+};
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_PATH_QUERY_H
@@ -0,0 +1,94 @@
+// Compares extracting two paths, one of them with a wildcard, from a
+// generated ~1MB document with a compiled PathQuery against fully parsing it
+// with ParseValue and walking the tree.
+//
+// usage: path_query_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/parser.h"
+#include "hittop/json/path_query.h"
+#include "hittop/json/types.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+std::string MakeDocument(std::size_t target_size) {
+  std::string doc = "{\"id\": 1234567, \"events\": [";
+  for (std::size_t i = 0; doc.size() < target_size; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    const std::string n = std::to_string(i);
+    doc += "{\"index\": " + n + ", \"name\": \"event " + n +
+           "\", \"payload\": {\"values\": [1, 2, 3, 4.5], \"text\": \"some "
+           "\\\"quoted\\\" text\", \"flags\": [true, false, null]}, "
+           "\"type\": \"" +
+           (i % 3 ? "click" : "view") + "\"}";
+  }
+  doc += "]}";
+  return doc;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100;
+  const std::string doc = MakeDocument(1 << 20);
+  const json::PathQuery query = {"/id", "/events/*/type"};
+
+  std::size_t checksum = 0;
+  for (int j = 0; j < 5; ++j) {
+    Report("path_query",
+           TimeUsec(count,
+                    [&]() {
+                      query.Run(doc, [&checksum](std::size_t path,
+                                                 json::StringView span) {
+                        checksum += path + span.size();
+                      });
+                    }),
+           count, doc.size());
+  }
+
+  const unsigned parse_count = count / 10 + 1;
+  for (int j = 0; j < 5; ++j) {
+    Report("parse_value",
+           TimeUsec(parse_count,
+                    [&]() {
+                      auto result = json::ParseValue(doc);
+                      if (!result.ok()) {
+                        std::cerr << "Fail!" << std::endl;
+                        std::exit(1);
+                      }
+                      const auto &root = static_cast<const json::Object &>(
+                          std::get<0>(result.get()));
+                      checksum += static_cast<const json::Number &>(
+                          root.at("id"));
+                      for (const json::Value &event :
+                           static_cast<const json::Array &>(
+                               root.at("events"))) {
+                        checksum += static_cast<const json::String &>(
+                                        static_cast<const json::Object &>(
+                                            event)
+                                            .at("type"))
+                                        .size();
+                      }
+                    }),
+           parse_count, doc.size());
+  }
+  std::cout << "doc size: " << doc.size() << " checksum: " << checksum
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,257 @@
+#include "hittop/json/sax_parser.h"
+#include "hittop/json/sax_parser.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "boost/asio/buffers_iterator.hpp"
+
+#include "hittop/io/async_circular_buffer_stream.h"
+#include "hittop/json/async_parse.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/util/test_data.h"
+
+using hittop::parser::ParseError;
+using hittop::util::LoadTestData;
+
+namespace io = hittop::io;
+namespace json = hittop::json;
+
+namespace {
+
+// Records events as a compact string.
+class RecordingHandler {
+public:
+  void Null() { events += "n"; }
+  void Bool(bool value) { events += value ? "t" : "f"; }
+  void Number(const char *first, const char *last) {
+    events += "#" + std::string(first, last);
+  }
+  void String(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "S" : "s") + std::string(first, last);
+    last_string = first;
+  }
+  void Key(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "K" : "k") + std::string(first, last);
+  }
+  std::size_t StartArray() {
+    events += "[";
+    return ++next_start;
+  }
+  void EndArray(std::size_t start, std::size_t count) {
+    events += "]" + std::to_string(start) + "/" + std::to_string(count);
+  }
+  std::size_t StartObject() {
+    events += "{";
+    return ++next_start;
+  }
+  void EndObject(std::size_t start, std::size_t count) {
+    events += "}" + std::to_string(start) + "/" + std::to_string(count);
+  }
+
+  std::string events;
+  std::size_t next_start = 0;
+  const char *last_string = nullptr;
+};
+
+std::string ExpectedEvents(const std::string &input) {
+  json::StructuralParser parser;
+  RecordingHandler handler;
+  EXPECT_TRUE(
+      parser.Parse(input.data(), input.data() + input.size(), &handler).ok());
+  return handler.events;
+}
+
+// Feeds input to a new parser in chunks of the given size.
+std::string ChunkedEvents(const std::string &input, std::size_t chunk_size) {
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  for (std::size_t i = 0; i < input.size(); i += chunk_size) {
+    const char *first = input.data() + i;
+    const char *last = first + std::min(chunk_size, input.size() - i);
+    auto result = parser.Feed(first, last);
+    EXPECT_TRUE(result.ok()) << "chunk size " << chunk_size << " offset " << i;
+  }
+  EXPECT_EQ(parser.Finish(), ParseError::NONE);
+  return handler.events;
+}
+
+} // namespace
+
+TEST(SaxParserTest, MatchesStructuralParserInAnyChunks) {
+  const std::string document =
+      "[" + LoadTestData("/hittop/json/test-data.json") +
+      R"(, " \"x\" \u00e9\\", -1.5e-3, 0, true, false, null, [], {}, "", 12])";
+  const std::string expected = ExpectedEvents(document);
+  for (std::size_t chunk_size : {1, 2, 3, 5, 7, 16, 64, 1000, 100000}) {
+    EXPECT_EQ(ChunkedEvents(document, chunk_size), expected);
+  }
+}
+
+TEST(SaxParserTest, ZeroCopyStrings) {
+  const std::string input = R"({"key": "value"})";
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  auto result = parser.Feed(input.data(), input.data() + input.size());
+  EXPECT_TRUE(result.ok());
+  EXPECT_TRUE(parser.done());
+  EXPECT_EQ(handler.last_string, input.data() + 9);
+}
+
+TEST(SaxParserTest, StopsAtEndOfValue) {
+  const std::string input = "[1] [2]";
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  auto result = parser.Feed(input.data(), input.data() + input.size());
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(result.get(), input.data() + 3);
+
+  parser.Reset();
+  result = parser.Feed(result.get(), input.data() + input.size());
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(result.get(), input.data() + input.size());
+  EXPECT_EQ(handler.events, "[#1]1/1[#2]2/1");
+}
+
+TEST(SaxParserTest, TopLevelScalarEndsWithInput) {
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  const std::string input = "-12";
+  EXPECT_TRUE(parser.Feed(input.data(), input.data() + 2).ok());
+  EXPECT_TRUE(parser.Feed(input.data() + 2, input.data() + 3).ok());
+  EXPECT_FALSE(parser.done());
+  EXPECT_EQ(parser.Finish(), ParseError::NONE);
+  EXPECT_EQ(handler.events, "#-12");
+}
+
+TEST(SaxParserTest, Errors) {
+  auto error_at = [](const std::string &input) {
+    RecordingHandler handler;
+    json::SaxParser<RecordingHandler> parser(&handler);
+    auto result = parser.Feed(input.data(), input.data() + input.size());
+    if (result.ok()) {
+      return std::make_pair(parser.Finish(), -1L);
+    }
+    return std::make_pair(result.error(), result.get() - input.data());
+  };
+  EXPECT_EQ(error_at("[1, 2"), std::make_pair(ParseError::INCOMPLETE, -1L));
+  EXPECT_EQ(error_at("\"abc"), std::make_pair(ParseError::INCOMPLETE, -1L));
+  EXPECT_EQ(error_at("[1 2]"), std::make_pair(ParseError::BAD_CHAR, 3L));
+  EXPECT_EQ(error_at("[01]"), std::make_pair(ParseError::BAD_CHAR, 1L));
+  EXPECT_EQ(error_at("[tru]"), std::make_pair(ParseError::BAD_CHAR, 1L));
+  EXPECT_EQ(error_at("{\"a\" 1}"), std::make_pair(ParseError::BAD_CHAR, 5L));
+  EXPECT_EQ(error_at("{1: 1}"), std::make_pair(ParseError::BAD_CHAR, 1L));
+  EXPECT_EQ(error_at("[1,]"), std::make_pair(ParseError::BAD_CHAR, 3L));
+  EXPECT_EQ(error_at("[1}"), std::make_pair(ParseError::BAD_CHAR, 2L));
+  EXPECT_EQ(error_at("\"a\tb\""), std::make_pair(ParseError::BAD_CHAR, 2L));
+  EXPECT_EQ(error_at("\"\\x\""), std::make_pair(ParseError::BAD_CHAR, 2L));
+  EXPECT_EQ(error_at("\"\\u12g4\""), std::make_pair(ParseError::BAD_CHAR, 5L));
+  EXPECT_EQ(error_at("[1x]"), std::make_pair(ParseError::BAD_CHAR, 2L));
+}
+
+TEST(SaxParserTest, AsyncParseFromStream) {
+  const std::string input = LoadTestData("/hittop/json/test-data.json");
+  const std::string expected = ExpectedEvents(input);
+
+  // A stream much smaller than the document.
+  io::AsyncCircularBufferStream stream(5);
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  bool called = false;
+  json::AsyncParse(&stream, &parser, [&called](const io::error_code &ec,
+                                               ParseError error) {
+    called = true;
+    EXPECT_FALSE(ec);
+    EXPECT_EQ(error, ParseError::NONE);
+  });
+
+  // Write the document in uneven pieces; each commit runs the parser.
+  std::size_t written = 0;
+  for (std::size_t piece = 1; written < input.size(); piece = piece % 13 + 1) {
+    stream.async_prepare(
+        1, [&](const io::error_code &ec,
+               const io::AsyncCircularBufferStream::mutable_buffers_type
+                   &buffers) {
+          ASSERT_FALSE(ec);
+          const std::size_t size =
+              std::min({piece, input.size() - written,
+                        boost::asio::buffer_size(buffers)});
+          std::copy(input.data() + written, input.data() + written + size,
+                    boost::asio::buffers_begin(buffers));
+          written += size;
+          stream.commit(size);
+        });
+  }
+  stream.close_for_write();
+  EXPECT_TRUE(called);
+  EXPECT_EQ(handler.events, expected);
+}
+
+namespace {
+
+// Memory for one handler at a time, which counts its uses.
+struct Arena {
+  alignas(std::max_align_t) char bytes[256];
+  bool in_use = false;
+  int allocations = 0;
+};
+
+// A callback too large for the fetch handler that holds it to be stored
+// inline, with hooks that draw from an Arena.
+struct ArenaCallback {
+  Arena *arena;
+  bool *called;
+  char padding[32];
+
+  void operator()(const io::error_code &ec, ParseError error) {
+    *called = true;
+    EXPECT_FALSE(ec);
+    EXPECT_EQ(error, ParseError::NONE);
+  }
+};
+
+void *hittop_handler_allocate(std::size_t size, ArenaCallback *callback) {
+  Arena *const arena = callback->arena;
+  EXPECT_FALSE(arena->in_use);
+  EXPECT_LE(size, sizeof(arena->bytes));
+  arena->in_use = true;
+  ++arena->allocations;
+  return arena->bytes;
+}
+
+void hittop_handler_deallocate(void *p, std::size_t, ArenaCallback *callback) {
+  EXPECT_EQ(p, callback->arena->bytes);
+  callback->arena->in_use = false;
+}
+
+} // namespace
+
+TEST(SaxParserTest, AsyncParseUsesCallbackHooks) {
+  const std::string input = "[1, \"two\", {\"three\": [true, null]}]";
+  io::AsyncCircularBufferStream stream(4);
+  RecordingHandler handler;
+  json::SaxParser<RecordingHandler> parser(&handler);
+  Arena arena;
+  bool called = false;
+  json::AsyncParse(&stream, &parser, ArenaCallback{&arena, &called, {}});
+
+  // One byte at a time, so that every fetch waits for the next commit.
+  for (char ch : input) {
+    stream.async_prepare(
+        1, [&](const io::error_code &ec,
+               const io::AsyncCircularBufferStream::mutable_buffers_type
+                   &buffers) {
+          ASSERT_FALSE(ec);
+          *boost::asio::buffers_begin(buffers) = ch;
+          stream.commit(1);
+        });
+  }
+  EXPECT_TRUE(called);
+  EXPECT_EQ(handler.events, ExpectedEvents(input));
+  // Every parked fetch handler was placed in the arena.
+  EXPECT_EQ(arena.allocations, static_cast<int>(input.size()));
+  EXPECT_FALSE(arena.in_use);
+}
@@ -0,0 +1,399 @@
+// Incremental, event-based (SAX-style) JSON parser.
+//
+// SaxParser accepts a JSON value in chunks of any size, in the order they
+// arrive, and reports it to a handler as a sequence of events, without
+// building a DOM.  Memory use is independent of the size of the document:
+// apart from the container stack, the only state kept between chunks is the
+// part of a string, number or literal that is split across chunks.
+//
+// The handler interface is the same as for StructuralParser:
+//
+//   void Null();
+//   void Bool(bool value);
+//   void Number(const char *first, const char *last);  // valid number text
+//   void String(const char *first, const char *last, bool has_escapes);
+//   void Key(const char *first, const char *last, bool has_escapes);
+//   std::size_t StartArray();
+//   void EndArray(std::size_t start, std::size_t count);
+//   std::size_t StartObject();
+//   void EndObject(std::size_t start, std::size_t count);
+//
+// String and Key receive the raw (still escaped) contents between the quotes.
+// When a token lies entirely within one chunk, the pointers passed to the
+// handler point into that chunk; otherwise they point into an internal buffer.
+// Either way, they are only valid for the duration of the call.
+//
+#ifndef HITTOP_JSON_SAX_PARSER_H
+#define HITTOP_JSON_SAX_PARSER_H
+
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/structural_parser.h"
+
+namespace hittop {
+namespace json {
+
+template <typename Handler> class SaxParser {
+public:
+  explicit SaxParser(Handler *handler) : handler_(handler) {}
+
+  SaxParser(const SaxParser &) = delete;
+  SaxParser &operator=(const SaxParser &) = delete;
+
+  // Prepares to parse a new value.
+  void Reset() {
+    state_ = State::kValue;
+    escape_ = 0;
+    has_escapes_ = false;
+    error_ = parser::ParseError::NONE;
+    token_.clear();
+    stack_.clear();
+  }
+
+  // Parses the next chunk of input.  Returns the position just past the end
+  // of the value if it ends within this chunk (and ignores the rest of the
+  // chunk), last if more input is needed, or the position of an invalid
+  // character with error BAD_CHAR.  Once an error has been reported, the
+  // parser must be Reset() before it is fed again.
+  parser::ParseResult<const char *> Feed(const char *first, const char *last);
+
+  // Signals the end of the input.  Returns NONE if a complete value has been
+  // parsed, and otherwise INCOMPLETE (or the error that stopped the parse).
+  parser::ParseError Finish() {
+    if (error_ != parser::ParseError::NONE) {
+      return error_;
+    }
+    if (state_ == State::kNumber || state_ == State::kLiteral) {
+      // A top-level scalar is terminated by the end of the input.
+      if (!EmitScalar(token_.data(), token_.data() + token_.size()).ok()) {
+        return error_ = parser::ParseError::BAD_CHAR;
+      }
+    }
+    if (state_ != State::kDone) {
+      return error_ = parser::ParseError::INCOMPLETE;
+    }
+    return parser::ParseError::NONE;
+  }
+
+  // True once a complete value has been parsed.
+  bool done() const { return state_ == State::kDone; }
+
+  // The current nesting depth.
+  std::size_t depth() const { return stack_.size(); }
+
+private:
+  enum struct State {
+    kValue,      // expecting a value
+    kFirstValue, // after '[': expecting a value or ']'
+    kFirstKey,   // after '{': expecting a key or '}'
+    kKey,        // expecting a key
+    kColon,      // after a key: expecting ':'
+    kString,     // inside a string value
+    kKeyString,  // inside a key
+    kNumber,     // inside a number
+    kLiteral,    // inside true, false or null
+    kAfterValue, // expecting ',' or the end of the enclosing container
+    kDone,
+  };
+
+  struct Frame {
+    bool is_object;
+    std::size_t start;
+    std::size_t count;
+  };
+
+  static bool IsWhitespace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+  }
+
+  static bool IsNumberChar(char ch) {
+    return internal::IsDigit(ch) || ch == '-' || ch == '+' || ch == '.' ||
+           ch == 'e' || ch == 'E';
+  }
+
+  static bool IsLiteralChar(char ch) { return 'a' <= ch && ch <= 'z'; }
+
+  parser::ParseResult<const char *> Fail(const char *pos) {
+    error_ = parser::ParseError::BAD_CHAR;
+    return {pos, error_};
+  }
+
+  // Called when a value is complete.
+  void EndValue() {
+    if (stack_.empty()) {
+      state_ = State::kDone;
+    } else {
+      ++stack_.back().count;
+      state_ = State::kAfterValue;
+    }
+  }
+
+  // Validates and reports the number or literal [first, last).
+  parser::ParseResult<const char *> EmitScalar(const char *first,
+                                               const char *last) {
+    if (state_ == State::kNumber) {
+      auto result = internal::ScanNumber(first, last);
+      if (!result.ok() || result.get() != last) {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+      handler_->Number(first, last);
+    } else {
+      const std::size_t size = last - first;
+      if (size == 4 && std::memcmp(first, "true", 4) == 0) {
+        handler_->Bool(true);
+      } else if (size == 5 && std::memcmp(first, "false", 5) == 0) {
+        handler_->Bool(false);
+      } else if (size == 4 && std::memcmp(first, "null", 4) == 0) {
+        handler_->Null();
+      } else {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+    }
+    EndValue();
+    return last;
+  }
+
+  Handler *const handler_;
+  State state_ = State::kValue;
+  // Within a string: 0 normally, 1 after a backslash, and 2-5 within the hex
+  // digits of a \u escape.
+  int escape_ = 0;
+  bool has_escapes_ = false;
+  parser::ParseError error_ = parser::ParseError::NONE;
+  // The beginning of a token split across chunks.
+  std::string token_;
+  std::vector<Frame> stack_;
+};
+
+template <typename Handler>
+parser::ParseResult<const char *>
+SaxParser<Handler>::Feed(const char *first, const char *last) {
+  if (error_ != parser::ParseError::NONE) {
+    return {first, error_};
+  }
+  const char *p = first;
+  // The start of the current token within this chunk.
+  const char *token_start = first;
+
+  while (p != last) {
+    switch (state_) {
+    case State::kDone:
+      return p;
+
+    case State::kFirstValue:
+    case State::kFirstKey:
+    case State::kKey:
+    case State::kColon:
+    case State::kAfterValue:
+    case State::kValue:
+      if (IsWhitespace(*p)) {
+        ++p;
+        continue;
+      }
+      break;
+
+    case State::kString:
+    case State::kKeyString: {
+      for (; p != last; ++p) {
+        const unsigned char ch = *p;
+        if (escape_ == 0) {
+          if (ch == '"') {
+            break;
+          } else if (ch == '\\') {
+            escape_ = 1;
+            has_escapes_ = true;
+          } else if (ch < 0x20) {
+            return Fail(p);
+          }
+        } else if (escape_ == 1) {
+          switch (ch) {
+          case '"':
+          case '\\':
+          case '/':
+          case 'b':
+          case 'f':
+          case 'n':
+          case 'r':
+          case 't':
+            escape_ = 0;
+            break;
+          case 'u':
+            escape_ = 2;
+            break;
+          default:
+            return Fail(p);
+          }
+        } else {
+          if (!std::isxdigit(ch)) {
+            return Fail(p);
+          }
+          escape_ = escape_ == 5 ? 0 : escape_ + 1;
+        }
+      }
+      if (p == last) {
+        token_.append(token_start, last);
+        return last;
+      }
+      const char *contents_first = token_start;
+      const char *contents_last = p;
+      if (!token_.empty()) {
+        token_.append(token_start, p);
+        contents_first = token_.data();
+        contents_last = token_.data() + token_.size();
+      }
+      ++p;
+      if (state_ == State::kKeyString) {
+        handler_->Key(contents_first, contents_last, has_escapes_);
+        state_ = State::kColon;
+      } else {
+        handler_->String(contents_first, contents_last, has_escapes_);
+        EndValue();
+      }
+      token_.clear();
+      continue;
+    }
+
+    case State::kNumber:
+    case State::kLiteral: {
+      if (state_ == State::kNumber) {
+        while (p != last && IsNumberChar(*p)) {
+          ++p;
+        }
+      } else {
+        while (p != last && IsLiteralChar(*p)) {
+          ++p;
+        }
+      }
+      if (p == last) {
+        token_.append(token_start, last);
+        return last;
+      }
+      if (!internal::IsScalarEnd(*p)) {
+        return Fail(p);
+      }
+      if (token_.empty()) {
+        if (!EmitScalar(token_start, p).ok()) {
+          return Fail(token_start);
+        }
+      } else {
+        token_.append(token_start, p);
+        const bool ok =
+            EmitScalar(token_.data(), token_.data() + token_.size()).ok();
+        token_.clear();
+        if (!ok) {
+          return Fail(p);
+        }
+      }
+      continue;
+    }
+    }
+
+    // A non-whitespace character between tokens.
+    const char ch = *p;
+    switch (state_) {
+    case State::kFirstValue:
+      if (ch == ']') {
+        ++p;
+        handler_->EndArray(stack_.back().start, 0);
+        stack_.pop_back();
+        EndValue();
+        continue;
+      }
+    // Fall through.
+    case State::kValue:
+      token_start = p;
+      switch (ch) {
+      case '{':
+        ++p;
+        stack_.push_back({true, handler_->StartObject(), 0});
+        state_ = State::kFirstKey;
+        break;
+      case '[':
+        ++p;
+        stack_.push_back({false, handler_->StartArray(), 0});
+        state_ = State::kFirstValue;
+        break;
+      case '"':
+        token_start = ++p;
+        has_escapes_ = false;
+        state_ = State::kString;
+        break;
+      case 't':
+      case 'f':
+      case 'n':
+        state_ = State::kLiteral;
+        break;
+      default:
+        if (ch != '-' && !internal::IsDigit(ch)) {
+          return Fail(p);
+        }
+        state_ = State::kNumber;
+        break;
+      }
+      continue;
+
+    case State::kFirstKey:
+      if (ch == '}') {
+        ++p;
+        handler_->EndObject(stack_.back().start, 0);
+        stack_.pop_back();
+        EndValue();
+        continue;
+      }
+    // Fall through.
+    case State::kKey:
+      if (ch != '"') {
+        return Fail(p);
+      }
+      token_start = ++p;
+      has_escapes_ = false;
+      state_ = State::kKeyString;
+      continue;
+
+    case State::kColon:
+      if (ch != ':') {
+        return Fail(p);
+      }
+      ++p;
+      state_ = State::kValue;
+      continue;
+
+    case State::kAfterValue: {
+      Frame &top = stack_.back();
+      if (ch == ',') {
+        ++p;
+        state_ = top.is_object ? State::kKey : State::kValue;
+        continue;
+      }
+      if (ch != (top.is_object ? '}' : ']')) {
+        return Fail(p);
+      }
+      ++p;
+      if (top.is_object) {
+        handler_->EndObject(top.start, top.count);
+      } else {
+        handler_->EndArray(top.start, top.count);
+      }
+      stack_.pop_back();
+      EndValue();
+      continue;
+    }
+
+    default:
+      return Fail(p);
+    }
+  }
+  return state_ == State::kDone ? p : last;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_SAX_PARSER_H
@@ -0,0 +1,111 @@
+#include "hittop/json/shared_value.h"
+#include "hittop/json/shared_value.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/types.h"
+#include "hittop/json/writer.h"
+#include "hittop/util/test_data.h"
+
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+json::Value MustParse(const std::string &input) {
+  auto result = json::ParseValue(input);
+  EXPECT_TRUE(result.ok());
+  return std::get<0>(result.consume());
+}
+
+} // namespace
+
+TEST(SharedValueTest, Freeze) {
+  const json::Value value =
+      MustParse(LoadTestData("/hittop/json/test-data.json"));
+  const json::SharedValue shared(value);
+  EXPECT_TRUE(shared.ToValue() == value);
+  EXPECT_EQ(json::ToJson(shared), json::ToJson(value));
+
+  json::Value moved = value;
+  EXPECT_TRUE(json::SharedValue(std::move(moved)) == shared);
+
+  const json::SharedValue doc(MustParse(R"({"a": [1, true, null, "x"]})"));
+  EXPECT_EQ(doc.type(), json::Value::Type::kObject);
+  const json::SharedValue &a = *doc.find("a");
+  EXPECT_EQ(a.array().size(), 4u);
+  EXPECT_EQ(a[0].get_number(), 1);
+  EXPECT_TRUE(a[1].get_bool());
+  EXPECT_EQ(a[2].type(), json::Value::Type::kNull);
+  EXPECT_EQ(a[3].get_string(), "x");
+  EXPECT_TRUE(doc.find("b") == nullptr);
+  EXPECT_THROW(a.get_string(), boost::bad_get);
+  EXPECT_THROW(json::SharedValue().object(), boost::bad_get);
+}
+
+TEST(SharedValueTest, CopiesShare) {
+  const json::SharedValue original(MustParse(R"({"a": {"b": [1, 2]}})"));
+  EXPECT_TRUE(original.unique());
+  json::SharedValue copy = original;
+  EXPECT_FALSE(original.unique());
+  EXPECT_EQ(&copy.object(), &original.object());
+  EXPECT_EQ(sizeof(json::SharedValue), sizeof(void *));
+}
+
+TEST(SharedValueTest, CopyOnWrite) {
+  const json::SharedValue original(
+      MustParse(R"({"a": {"b": [1, 2]}, "c": ["big", "subtree"]})"));
+  json::SharedValue copy = original;
+
+  // Path copying: a and its array are copied, c stays shared.
+  json::SharedValue &b = copy.mutable_object()["a"].mutable_object()["b"];
+  b.mutable_array().emplace_back(json::Value(json::Number(3)));
+  EXPECT_EQ(json::ToJson(copy),
+            R"({"a":{"b":[1.0,2.0,3.0]},"c":["big","subtree"]})");
+  EXPECT_EQ(json::ToJson(original),
+            R"({"a":{"b":[1.0,2.0]},"c":["big","subtree"]})");
+  EXPECT_NE(&copy.object(), &original.object());
+  EXPECT_EQ(&copy.find("c")->array(), &original.find("c")->array());
+  EXPECT_EQ(&copy.find("a")->find("b")->array()[0],
+            &copy.find("a")->find("b")->array()[0]);
+
+  // A unique value is modified in place.
+  const json::SharedObject *const members = &copy.object();
+  copy.mutable_object().erase("c");
+  EXPECT_EQ(&copy.object(), members);
+  EXPECT_TRUE(original.find("c") != nullptr);
+  EXPECT_THROW(copy.mutable_array(), boost::bad_get);
+}
+
+TEST(SharedValueTest, Threads) {
+  const json::SharedValue doc(
+      MustParse(LoadTestData("/hittop/json/test-data.json")));
+  const std::string expected = json::ToJson(doc);
+  std::vector<std::string> results(4);
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    threads.emplace_back([&doc, &results, i]() {
+      for (int j = 0; j < 1000; ++j) {
+        json::SharedValue copy = doc;
+        if (j % 100 == 0) {
+          copy.mutable_object().erase("web-app");
+        }
+      }
+      results[i] = json::ToJson(json::SharedValue(doc));
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (const std::string &result : results) {
+    EXPECT_EQ(result, expected);
+  }
+  EXPECT_TRUE(doc.unique());
+}
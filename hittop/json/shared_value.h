@@ -0,0 +1,310 @@
+// Immutable JSON values with shared, reference-counted subtrees.
+//
+// Copying a json::Value copies the whole tree.  A SharedValue is instead a
+// pointer to an immutable node, with an atomic reference count: copies take
+// constant time and share the node, so a document that is loaded once (e.g.
+// configuration or a cached response) can be handed to any number of threads
+// without copying it.  Every array element and object member is itself a
+// SharedValue, so subtrees are shared as well.
+//
+// A SharedValue is made from a Value (moving its strings and keys if the
+// Value is an rvalue), and ToValue() makes a mutable deep copy.  It can also
+// be modified in place, copy-on-write: mutable_array() and mutable_object()
+// first copy the node if it is shared with another SharedValue.  The copy
+// shares the children of the original, so changing one member of a large
+// document copies only the nodes on the path to it.
+//
+// As for std::shared_ptr, distinct SharedValues may be used from different
+// threads even if they share nodes, but one SharedValue must not be modified
+// while another thread uses it.
+//
+#ifndef HITTOP_JSON_SHARED_VALUE_H
+#define HITTOP_JSON_SHARED_VALUE_H
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "boost/smart_ptr/intrusive_ptr.hpp"
+#include "boost/smart_ptr/intrusive_ref_counter.hpp"
+#include "boost/variant.hpp"
+
+#include "hittop/json/flat_object.h"
+#include "hittop/json/types.h"
+#include "hittop/json/writer.h"
+
+namespace hittop {
+namespace json {
+
+class SharedValue;
+
+using SharedArray = std::vector<SharedValue>;
+using SharedObject = FlatObject<SharedValue>;
+
+namespace internal {
+
+using SharedVariant =
+    boost::variant<Null, Boolean, Number, String, SharedArray, SharedObject>;
+
+struct SharedNode;
+
+} // namespace internal
+
+class SharedValue {
+public:
+  using Type = Value::Type;
+
+  // A null value; no node is allocated for null.
+  SharedValue() = default;
+
+  explicit SharedValue(const Value &value);
+
+  explicit SharedValue(Value &&value);
+
+  Type type() const;
+
+  // These throw boost::bad_get if the value is of another type.
+  bool get_bool() const;
+  double get_number() const;
+  const std::string &get_string() const;
+  const SharedArray &array() const;
+  const SharedObject &object() const;
+
+  // The element at index of an array.
+  const SharedValue &operator[](std::size_t index) const {
+    return array()[index];
+  }
+
+  // The member of an object with the given key, or nullptr.
+  const SharedValue *find(StringView key) const {
+    const SharedObject &members = object();
+    auto it = members.find(key);
+    return it == members.end() ? nullptr : &it->second;
+  }
+
+  // Copy-on-write access to an array or object: if the node is shared, it is
+  // first replaced by a copy (whose children are still shared).
+  SharedArray &mutable_array();
+  SharedObject &mutable_object();
+
+  // True if no other SharedValue refers to the same node.
+  bool unique() const;
+
+  // Returns a deep, mutable copy.
+  Value ToValue() const;
+
+  friend bool operator==(const SharedValue &lhs, const SharedValue &rhs);
+
+  friend bool operator!=(const SharedValue &lhs, const SharedValue &rhs) {
+    return !(lhs == rhs);
+  }
+
+private:
+  template <bool kMove> class FreezeVisitor;
+  class ThawVisitor;
+
+  const internal::SharedVariant &variant() const;
+
+  // Makes node_ unique, copying it if necessary.
+  void Detach();
+
+  boost::intrusive_ptr<internal::SharedNode> node_;
+};
+
+namespace internal {
+
+struct SharedNode
+    : boost::intrusive_ref_counter<SharedNode, boost::thread_safe_counter> {
+  explicit SharedNode(SharedVariant value) : value(std::move(value)) {}
+
+  // (The reference count of a copy starts at zero.)
+  SharedNode(const SharedNode &) = default;
+
+  SharedVariant value;
+};
+
+} // namespace internal
+
+// Converts a Value (a const reference, or an rvalue whose strings and keys
+// are moved) into a new node, or nullptr for null.
+template <bool kMove>
+class SharedValue::FreezeVisitor
+    : public boost::static_visitor<internal::SharedNode *> {
+public:
+  template <typename T>
+  using Ref = typename std::conditional<kMove, T &, const T &>::type;
+
+  internal::SharedNode *operator()(Ref<Null>) const { return nullptr; }
+
+  internal::SharedNode *operator()(Ref<Boolean> value) const {
+    return new internal::SharedNode(value);
+  }
+
+  internal::SharedNode *operator()(Ref<Number> value) const {
+    return new internal::SharedNode(value);
+  }
+
+  internal::SharedNode *operator()(Ref<String> value) const {
+    return new internal::SharedNode(Take(value));
+  }
+
+  internal::SharedNode *operator()(Ref<Array> value) const {
+    SharedArray array;
+    array.reserve(value.size());
+    for (Ref<Value> element : value) {
+      array.emplace_back(Take(element));
+    }
+    return new internal::SharedNode(std::move(array));
+  }
+
+  internal::SharedNode *operator()(Ref<Object> value) const {
+    SharedObject object;
+    object.reserve(value.size());
+    for (auto &&member : value) {
+      object.emplace(member.first, SharedValue(Take(member.second)));
+    }
+    return new internal::SharedNode(std::move(object));
+  }
+
+private:
+  // Moves value if kMove (T is then not const).
+  template <typename T>
+  static typename std::conditional<kMove, T &&, T &>::type Take(T &value) {
+    return static_cast<typename std::conditional<kMove, T &&, T &>::type>(
+        value);
+  }
+};
+
+class SharedValue::ThawVisitor : public boost::static_visitor<Value> {
+public:
+  Value operator()(const Null &) const { return Null{}; }
+
+  Value operator()(const Boolean &value) const { return Boolean{value}; }
+
+  Value operator()(const Number &value) const { return Number{value}; }
+
+  Value operator()(const String &value) const { return value; }
+
+  Value operator()(const SharedArray &value) const {
+    Array array;
+    array.reserve(value.size());
+    for (const SharedValue &element : value) {
+      array.emplace_back(element.ToValue());
+    }
+    return Value(std::move(array));
+  }
+
+  Value operator()(const SharedObject &value) const {
+    Object object;
+    object.reserve(value.size());
+    for (const auto &member : value) {
+      object.emplace(member.first, member.second.ToValue());
+    }
+    return Value(std::move(object));
+  }
+};
+
+inline SharedValue::SharedValue(const Value &value)
+    : node_(value.Visit(FreezeVisitor<false>())) {}
+
+inline SharedValue::SharedValue(Value &&value)
+    : node_(value.Visit(FreezeVisitor<true>())) {}
+
+inline const internal::SharedVariant &SharedValue::variant() const {
+  static const internal::SharedVariant kNull;
+  return node_ ? node_->value : kNull;
+}
+
+inline SharedValue::Type SharedValue::type() const {
+  return static_cast<Type>(variant().which());
+}
+
+inline bool SharedValue::get_bool() const {
+  return boost::get<Boolean>(variant());
+}
+
+inline double SharedValue::get_number() const {
+  return boost::get<Number>(variant());
+}
+
+inline const std::string &SharedValue::get_string() const {
+  return boost::get<String>(variant());
+}
+
+inline const SharedArray &SharedValue::array() const {
+  return boost::get<SharedArray>(variant());
+}
+
+inline const SharedObject &SharedValue::object() const {
+  return boost::get<SharedObject>(variant());
+}
+
+inline bool SharedValue::unique() const {
+  return !node_ || node_->use_count() == 1;
+}
+
+inline void SharedValue::Detach() {
+  if (!unique()) {
+    node_.reset(new internal::SharedNode(*node_));
+  }
+}
+
+inline SharedArray &SharedValue::mutable_array() {
+  array(); // Checks the type before copying.
+  Detach();
+  return boost::get<SharedArray>(node_->value);
+}
+
+inline SharedObject &SharedValue::mutable_object() {
+  object(); // Checks the type before copying.
+  Detach();
+  return boost::get<SharedObject>(node_->value);
+}
+
+inline Value SharedValue::ToValue() const {
+  return boost::apply_visitor(ThawVisitor(), variant());
+}
+
+inline bool operator==(const SharedValue &lhs, const SharedValue &rhs) {
+  return lhs.node_ == rhs.node_ || lhs.variant() == rhs.variant();
+}
+
+// Writes a SharedValue with a Writer, like a Value.
+inline void Write(const SharedValue &value, Writer *writer) {
+  switch (value.type()) {
+  case Value::Type::kNull:
+    writer->Null();
+    break;
+  case Value::Type::kBoolean:
+    writer->Bool(value.get_bool());
+    break;
+  case Value::Type::kNumber:
+    writer->Double(value.get_number());
+    break;
+  case Value::Type::kString:
+    writer->String(value.get_string());
+    break;
+  case Value::Type::kArray:
+    writer->StartArray();
+    for (const SharedValue &element : value.array()) {
+      Write(element, writer);
+    }
+    writer->EndArray();
+    break;
+  case Value::Type::kObject:
+    writer->StartObject();
+    for (const auto &member : value.object()) {
+      writer->Key(member.first);
+      Write(member.second, writer);
+    }
+    writer->EndObject();
+    break;
+  }
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_SHARED_VALUE_H
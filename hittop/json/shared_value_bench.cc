@@ -0,0 +1,79 @@
+// Compares handing a generated ~1MB document to request handlers as copies of
+// a json::Value with handing out copies of a SharedValue, and the cost of a
+// copy-on-write change to one member of a shared copy.
+//
+// usage: shared_value_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <tuple>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/parser.h"
+#include "hittop/json/shared_value.h"
+#include "hittop/json/types.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+namespace {
+
+std::string MakeDocument(std::size_t target_size) {
+  std::string doc = "{\"settings\": {\"version\": 1}, \"items\": [";
+  for (std::size_t i = 0; doc.size() < target_size; ++i) {
+    if (i != 0) {
+      doc += ", ";
+    }
+    const std::string n = std::to_string(i);
+    doc += "{\"index\": " + n + ", \"name\": \"item " + n +
+           "\", \"tags\": [\"a\", \"b\"], \"price\": " + n + ".25}";
+  }
+  doc += "]}";
+  return doc;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100;
+  auto result = json::ParseValue(MakeDocument(1 << 20));
+  if (!result.ok()) {
+    std::cerr << "Fail!" << std::endl;
+    return 1;
+  }
+  const json::Value value = std::get<0>(result.consume());
+  const json::SharedValue shared(value);
+
+  std::size_t checksum = 0;
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::Value copy = value;
+      checksum += copy.type() == json::Value::Type::kObject;
+    });
+    Report("copy_value", usec, count);
+  }
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::SharedValue copy = shared;
+      checksum += copy.unique();
+    });
+    Report("copy_shared", usec, count);
+  }
+  for (int j = 0; j < 5; ++j) {
+    const double usec = TimeUsec(count, [&]() {
+      json::SharedValue copy = shared;
+      copy.mutable_object()["settings"].mutable_object().erase("version");
+      checksum += copy.object().size();
+    });
+    Report("copy_shared_and_modify", usec, count);
+  }
+
+  std::cout << "checksum: " << checksum << std::endl;
+  return 0;
+}
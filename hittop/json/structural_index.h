@@ -0,0 +1,269 @@
+// Stage one of the two-stage JSON parser (see structural_parser.h).
+//
+// The input is classified 64 bytes at a time into bitmasks (one bit per byte)
+// of backslashes, quotes, structural characters ({}[]:,) and whitespace, using
+// SSE2 compares where available.  Escaped characters, the extent of each
+// string and the start of each scalar are then computed with a handful of
+// integer operations per block, carrying state from one block to the next:
+//
+//  - A character is escaped if it follows an odd-length run of backslashes.
+//  - Unescaped quotes delimit strings; a prefix XOR of the quote mask gives
+//    the bytes inside strings.
+//  - A structural is a structural character outside any string, the opening
+//    quote of a string, or the first byte of any other scalar (a number or
+//    literal).
+//
+// The result is the list of offsets of all structurals, in order, which stage
+// two walks without looking at any other byte between tokens.
+//
+// Optionally, each block is also checked for valid UTF-8 (see util/utf8.h)
+// while it is in cache, rather than in a separate pass.
+// Outside strings only ASCII is valid JSON anyway, so this validates the
+// contents of the strings.
+//
+#ifndef HITTOP_JSON_STRUCTURAL_INDEX_H
+#define HITTOP_JSON_STRUCTURAL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hittop/util/utf8.h"
+
+namespace hittop {
+namespace json {
+namespace internal {
+
+// Bits of one 64-byte block; bit i corresponds to byte i.
+struct BlockMasks {
+  std::uint64_t backslash;
+  std::uint64_t quote;
+  std::uint64_t op;
+  std::uint64_t whitespace;
+};
+
+#if defined(__SSE2__)
+
+inline BlockMasks ClassifyBlock(const char *block) {
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i quote = _mm_set1_epi8('"');
+  // '[' and ']' differ from '{' and '}' only in bit 5, so setting it folds
+  // the four brackets into two compares.
+  const __m128i bit5 = _mm_set1_epi8(0x20);
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+  const __m128i colon = _mm_set1_epi8(':');
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i newline = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+
+  BlockMasks masks = {0, 0, 0, 0};
+  for (int i = 0; i < 4; ++i) {
+    const __m128i v = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(block + 16 * i));
+    const __m128i folded = _mm_or_si128(v, bit5);
+    const int shift = 16 * i;
+    masks.backslash |=
+        std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)))
+        << shift;
+    masks.quote |= std::uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))
+                   << shift;
+    masks.op |=
+        std::uint64_t(_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(folded, open),
+                         _mm_cmpeq_epi8(folded, close)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, colon),
+                         _mm_cmpeq_epi8(v, comma)))))
+        << shift;
+    masks.whitespace |=
+        std::uint64_t(_mm_movemask_epi8(_mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, newline),
+                         _mm_cmpeq_epi8(v, cr)))))
+        << shift;
+  }
+  return masks;
+}
+
+#else // !defined(__SSE2__)
+
+inline BlockMasks ClassifyBlock(const char *block) {
+  BlockMasks masks = {0, 0, 0, 0};
+  for (int i = 0; i < 64; ++i) {
+    const std::uint64_t bit = std::uint64_t{1} << i;
+    switch (block[i]) {
+    case '\\':
+      masks.backslash |= bit;
+      break;
+    case '"':
+      masks.quote |= bit;
+      break;
+    case '{':
+    case '}':
+    case '[':
+    case ']':
+    case ':':
+    case ',':
+      masks.op |= bit;
+      break;
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+      masks.whitespace |= bit;
+      break;
+    default:
+      break;
+    }
+  }
+  return masks;
+}
+
+#endif // defined(__SSE2__)
+
+// Returns x with each bit replaced by the XOR of itself and all lower bits.
+inline std::uint64_t PrefixXor(std::uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+inline int CountTrailingZeros(std::uint64_t x) { return __builtin_ctzll(x); }
+
+// Returns the mask of the characters in a block that are preceded by an odd
+// number of backslashes.  *next_is_escaped carries a trailing odd run from
+// one block to the next; it must start at zero.
+inline std::uint64_t EscapedMask(std::uint64_t backslash,
+                                 std::uint64_t *next_is_escaped) {
+  std::uint64_t escaped = *next_is_escaped;
+  if (backslash == 0) {
+    *next_is_escaped = 0;
+    return escaped;
+  }
+  // Subtracting the start of each run of backslashes (that is not itself
+  // escaped) from a mask of odd bits flips the parity pattern exactly at the
+  // end of each odd-length run.
+  constexpr std::uint64_t kOddBits = 0xAAAAAAAAAAAAAAAAULL;
+  const std::uint64_t potential_escape = backslash & ~escaped;
+  const std::uint64_t escape_and_terminal =
+      (((potential_escape << 1) | kOddBits) - potential_escape) ^ kOddBits;
+  escaped = escape_and_terminal ^ (backslash | escaped);
+  *next_is_escaped = (escape_and_terminal & backslash) >> 63;
+  return escaped;
+}
+
+} // namespace internal
+
+class StructuralIndex {
+public:
+  StructuralIndex() = default;
+
+  StructuralIndex(const StructuralIndex &) = delete;
+  StructuralIndex &operator=(const StructuralIndex &) = delete;
+
+  // Indexes [first, last), replacing the previous contents, and checks that
+  // it is valid UTF-8 if validate_utf8.  The input must be less than 4GB.
+  void Build(const char *first, const char *last,
+             bool validate_utf8 = false) {
+    const std::size_t input_size = last - first;
+    if (input_size >= UINT32_MAX) {
+      throw std::length_error("json input too large to index");
+    }
+    if (capacity_ < input_size + 1) {
+      positions_.reset(new std::uint32_t[input_size + 1]);
+      capacity_ = input_size + 1;
+    }
+    size_ = 0;
+    util::WithUtf8Checker([&](auto utf8) {
+      this->Index(first, input_size, validate_utf8 ? &utf8 : nullptr);
+    });
+  }
+
+  // The offsets of the structurals, in order.
+  const std::uint32_t *begin() const { return positions_.get(); }
+
+  const std::uint32_t *end() const { return positions_.get() + size_; }
+
+  std::size_t size() const { return size_; }
+
+  std::uint32_t operator[](std::size_t i) const { return positions_[i]; }
+
+  // True if the input ended inside a string.
+  bool unclosed_string() const { return unclosed_string_; }
+
+  // True if the input was checked and is not valid UTF-8.
+  bool invalid_utf8() const { return invalid_utf8_; }
+
+private:
+  // Appends the structurals of [first, first + input_size) to positions_,
+  // checking each block with utf8 unless it is null.
+  template <typename Utf8Checker>
+  void Index(const char *first, std::size_t input_size, Utf8Checker *utf8) {
+    // Carried from one block to the next.
+    std::uint64_t next_is_escaped = 0;
+    std::uint64_t prev_in_string = 0;
+    std::uint64_t prev_scalar = 0;
+
+    for (std::size_t offset = 0; offset < input_size; offset += 64) {
+      const char *block = first + offset;
+      char padded[64];
+      if (input_size - offset < 64) {
+        std::memset(padded, ' ', sizeof(padded));
+        std::memcpy(padded, block, input_size - offset);
+        block = padded;
+      }
+      const internal::BlockMasks masks = internal::ClassifyBlock(block);
+      if (utf8 != nullptr) {
+        utf8->Check64(block);
+      }
+
+      const std::uint64_t escaped =
+          internal::EscapedMask(masks.backslash, &next_is_escaped);
+      const std::uint64_t quote = masks.quote & ~escaped;
+      // Set from each opening quote up to (not including) its closing quote.
+      const std::uint64_t in_string =
+          internal::PrefixXor(quote) ^ prev_in_string;
+      prev_in_string = 0 - (in_string >> 63);
+      // String contents and closing quotes.
+      const std::uint64_t string_tail = in_string ^ quote;
+
+      const std::uint64_t scalar = ~(masks.op | masks.whitespace);
+      const std::uint64_t nonquote_scalar = scalar & ~quote;
+      const std::uint64_t follows_scalar = (nonquote_scalar << 1) | prev_scalar;
+      prev_scalar = nonquote_scalar >> 63;
+      const std::uint64_t scalar_start = scalar & ~follows_scalar;
+
+      std::uint64_t structurals = (masks.op | scalar_start) & ~string_tail;
+      while (structurals != 0) {
+        positions_[size_++] = static_cast<std::uint32_t>(
+            offset + internal::CountTrailingZeros(structurals));
+        structurals &= structurals - 1;
+      }
+    }
+    unclosed_string_ = prev_in_string != 0;
+    invalid_utf8_ = utf8 != nullptr && !utf8->Finish();
+  }
+
+  std::unique_ptr<std::uint32_t[]> positions_;
+  std::size_t capacity_ = 0;
+  std::size_t size_ = 0;
+  bool unclosed_string_ = false;
+  bool invalid_utf8_ = false;
+};
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_STRUCTURAL_INDEX_H
@@ -0,0 +1,233 @@
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/structural_parser.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/tape_parse_visitor.h"
+#include "hittop/util/test_data.h"
+
+using hittop::parser::ParseError;
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+// Records events as a compact string.
+class RecordingHandler {
+public:
+  void Null() { events += "n"; }
+  void Bool(bool value) { events += value ? "t" : "f"; }
+  void Number(const char *first, const char *last) {
+    events += "#" + std::string(first, last);
+  }
+  void String(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "S" : "s") + std::string(first, last);
+  }
+  void Key(const char *first, const char *last, bool has_escapes) {
+    events += (has_escapes ? "K" : "k") + std::string(first, last);
+  }
+  std::size_t StartArray() {
+    events += "[";
+    return ++next_start;
+  }
+  void EndArray(std::size_t start, std::size_t count) {
+    events += "]" + std::to_string(start) + "/" + std::to_string(count);
+  }
+  std::size_t StartObject() {
+    events += "{";
+    return ++next_start;
+  }
+  void EndObject(std::size_t start, std::size_t count) {
+    events += "}" + std::to_string(start) + "/" + std::to_string(count);
+  }
+
+  std::string events;
+  std::size_t next_start = 0;
+};
+
+std::vector<std::uint32_t> Structurals(const std::string &input) {
+  json::StructuralIndex index;
+  index.Build(input.data(), input.data() + input.size());
+  return std::vector<std::uint32_t>(index.begin(), index.end());
+}
+
+} // namespace
+
+TEST(StructuralIndexTest, FindsTokens) {
+  EXPECT_EQ(Structurals(R"( {"a": [1, true]} )"),
+            (std::vector<std::uint32_t>{1, 2, 5, 7, 8, 9, 11, 15, 16}));
+  // Structural characters, whitespace and escaped quotes inside strings.
+  EXPECT_EQ(Structurals(R"(["{a, b}\" \\", -2e5])"),
+            (std::vector<std::uint32_t>{0, 1, 14, 16, 20}));
+}
+
+TEST(StructuralIndexTest, UnclosedString) {
+  json::StructuralIndex index;
+  const std::string input = "[\"abc\\\"]";
+  index.Build(input.data(), input.data() + input.size());
+  EXPECT_TRUE(index.unclosed_string());
+}
+
+TEST(StructuralParserTest, Events) {
+  json::StructuralParser parser;
+  RecordingHandler handler;
+  const std::string input =
+      R"({"a": [1, -0.5e+3, true, false, null], "b\"": "x\ny", "c": {}})";
+  auto result =
+      parser.Parse(input.data(), input.data() + input.size(), &handler);
+  EXPECT_TRUE(result.ok());
+  EXPECT_EQ(result.get(), input.data() + input.size());
+  EXPECT_EQ(handler.events, "{ka[#1#-0.5e+3tfn]2/5Kb\\\"Sx\\nykc{}3/0}1/3");
+}
+
+TEST(StructuralParserTest, MatchesGrammar) {
+  auto input = LoadTestData("/hittop/json/test-data.json");
+  json::StructuralParser parser;
+  json::Document doc;
+  auto result = parser.Parse(input, &doc);
+  ASSERT_TRUE(result.ok());
+
+  json::Document expected;
+  ASSERT_TRUE(json::ParseDocument(input, &expected).ok());
+  EXPECT_EQ(doc.tape().size(), expected.tape().size());
+  EXPECT_TRUE(doc.root().ToValue() == expected.root().ToValue());
+}
+
+TEST(StructuralParserTest, EscapesAcrossBlocks) {
+  json::StructuralParser parser;
+  json::Document doc;
+  for (std::size_t pad = 0; pad < 140; ++pad) {
+    for (const char *s : {"\\\\", "\\\"", "\\\\\\\"", "a\\\\\\\\", "\\/"}) {
+      const std::string contents = std::string(pad, 'x') + s + "y";
+      const std::string input = "[\"" + contents + "\", \"" + s + "\"]";
+      auto result = parser.Parse(input, &doc);
+      ASSERT_TRUE(result.ok()) << input;
+      json::Document expected;
+      ASSERT_TRUE(json::ParseDocument(input, &expected).ok()) << input;
+      EXPECT_TRUE(doc.root().ToValue() == expected.root().ToValue()) << input;
+    }
+  }
+}
+
+TEST(StructuralParserTest, ZeroCopy) {
+  const std::string input = R"({"plain": "abc", "escaped": "a\nb"})";
+  json::StructuralParser parser;
+  json::Document doc;
+  ASSERT_TRUE(
+      parser.ParseZeroCopy(input.data(), input.data() + input.size(), &doc)
+          .ok());
+  const json::StringView plain = doc.root().find("plain")->get_string();
+  EXPECT_EQ(plain, "abc");
+  EXPECT_EQ(plain.data(), input.data() + 11);
+  // Keys refer to the input too.
+  EXPECT_EQ(doc.root().members().begin().key().data(), input.data() + 2);
+  EXPECT_EQ(doc.root().find("escaped")->get_string(), "a\nb");
+
+  ASSERT_TRUE(parser.Parse(input, &doc).ok());
+  EXPECT_EQ(doc.root().find("plain")->get_string(), "abc");
+  EXPECT_NE(doc.root().find("plain")->get_string().data(), input.data() + 11);
+}
+
+TEST(StructuralParserTest, RawNumbers) {
+  const std::string input = "[1.25, 12345678901234567890, -3]";
+  json::StructuralParser parser;
+  json::Document doc;
+  ASSERT_TRUE(parser
+                  .ParseZeroCopy(input.data(), input.data() + input.size(),
+                                 &doc, true)
+                  .ok());
+  EXPECT_EQ(json::tape::GetTag(doc.tape()[2]), json::tape::kSourceNumber);
+  EXPECT_EQ(doc.root()[0].get_number(), 1.25);
+  EXPECT_EQ(doc.root()[1].get_uint64(), 12345678901234567890ULL);
+  EXPECT_EQ(doc.root()[2].get_int64(), -3);
+  EXPECT_TRUE(doc.root().ToValue() ==
+              json::Value(json::Array{1.25, 12345678901234567890.0, -3.0}));
+}
+
+TEST(StructuralParserTest, Errors) {
+  json::StructuralParser parser;
+  json::Document doc;
+  auto error_at = [&parser, &doc](const std::string &input) {
+    auto result = parser.Parse(input, &doc);
+    EXPECT_TRUE(doc.empty());
+    return std::make_pair(result.error(), result.get() - input.data());
+  };
+  const auto incomplete = ParseError::INCOMPLETE;
+  const auto bad_char = ParseError::BAD_CHAR;
+
+  EXPECT_EQ(error_at(""), std::make_pair(incomplete, 0L));
+  EXPECT_EQ(error_at("[1, 2"), std::make_pair(incomplete, 5L));
+  EXPECT_EQ(error_at("{\"a\": \"b"), std::make_pair(incomplete, 8L));
+  EXPECT_EQ(error_at("tru"), std::make_pair(incomplete, 3L));
+  EXPECT_EQ(error_at("[1 2]"), std::make_pair(bad_char, 3L));
+  EXPECT_EQ(error_at("[01]"), std::make_pair(bad_char, 2L));
+  EXPECT_EQ(error_at("[1.]"), std::make_pair(bad_char, 3L));
+  EXPECT_EQ(error_at("[truex]"), std::make_pair(bad_char, 5L));
+  EXPECT_EQ(error_at("{\"a\" 1}"), std::make_pair(bad_char, 5L));
+  EXPECT_EQ(error_at("{1: 1}"), std::make_pair(bad_char, 1L));
+  EXPECT_EQ(error_at("[1,]"), std::make_pair(bad_char, 3L));
+  EXPECT_EQ(error_at("[1}"), std::make_pair(bad_char, 2L));
+  EXPECT_EQ(error_at("\"a\tb\""), std::make_pair(bad_char, 2L));
+  EXPECT_EQ(error_at("\"\\x\""), std::make_pair(bad_char, 2L));
+  EXPECT_EQ(error_at("\"\\u12g4\""), std::make_pair(bad_char, 5L));
+  EXPECT_EQ(error_at("1 2"), std::make_pair(bad_char, 2L));
+  EXPECT_EQ(error_at("\"a\"b"), std::make_pair(bad_char, 3L));
+}
+
+TEST(StructuralParserTest, ValidateUtf8) {
+  json::StructuralParser parser;
+  json::Document doc;
+  const std::string valid =
+      "{\"caf\xc3\xa9\": [\"\xe6\x97\xa5\xe6\x9c\xac\", \"\xf0\x9f\x98\x80\"]}";
+  const std::string invalid =
+      "[\"" + std::string(70, 'x') + "\", \"ab\xed\xa0\x80\"]";
+  const std::string truncated = "[\"" + std::string(62, 'x') + "\xe6\x97";
+  EXPECT_TRUE(parser.Parse(invalid, &doc).ok());
+
+  parser.set_validate_utf8(true);
+  EXPECT_TRUE(parser.Parse(valid, &doc).ok());
+  EXPECT_EQ((*doc.root().find("caf\xc3\xa9"))[0].get_string(),
+            "\xe6\x97\xa5\xe6\x9c\xac");
+  auto result = parser.Parse(invalid, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - invalid.data(), 78);
+  EXPECT_TRUE(doc.empty());
+  result = parser.Parse(truncated, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - truncated.data(), 64);
+}
+
+TEST(StructuralParserTest, ValidateUtf8RejectsUnpairedSurrogateEscapes) {
+  json::StructuralParser parser;
+  json::Document doc;
+  const std::string lone_high = "[\"\\ud800x\"]";
+  const std::string lone_high_at_end = "{\"\\ud800\": 1}";
+  const std::string high_high = "[\"\\ud800\\ud800\"]";
+  const std::string lone_low = "[\"a\\udc00\"]";
+  const std::string pair = "[\"\\ud83d\\ude00\"]";
+  EXPECT_TRUE(parser.Parse(lone_high, &doc).ok());
+  EXPECT_TRUE(parser.Parse(lone_low, &doc).ok());
+
+  parser.set_validate_utf8(true);
+  auto result = parser.Parse(lone_high, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - lone_high.data(), 8);
+  EXPECT_TRUE(doc.empty());
+  result = parser.Parse(lone_high_at_end, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - lone_high_at_end.data(), 8);
+  result = parser.Parse(high_high, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - high_high.data(), 8);
+  result = parser.Parse(lone_low, &doc);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - lone_low.data(), 3);
+
+  ASSERT_TRUE(parser.Parse(pair, &doc).ok());
+  EXPECT_EQ(doc.root()[0].get_string(), "\xf0\x9f\x98\x80");
+}
@@ -0,0 +1,537 @@
+// Two-stage JSON parser.
+//
+// Stage one (structural_index.h) finds the offsets of all tokens with SIMD
+// bitmask operations.  Stage two, here, walks those offsets with an explicit
+// stack instead of recursion, validating each token and reporting it to a
+// handler.  Strings are scanned only to find their end and check escapes;
+// number text is validated and handed over as is.
+//
+// A handler has the following interface (see TapeBuilder for an example):
+//
+//   void Null();
+//   void Bool(bool value);
+//   void Number(const char *first, const char *last);  // valid number text
+//   void String(const char *first, const char *last, bool has_escapes);
+//   void Key(const char *first, const char *last, bool has_escapes);
+//   std::size_t StartArray();
+//   void EndArray(std::size_t start, std::size_t count);
+//   std::size_t StartObject();
+//   void EndObject(std::size_t start, std::size_t count);
+//
+// String and Key receive the raw contents between the quotes.  The value
+// returned by StartArray (StartObject) is passed back to the matching
+// EndArray (EndObject), along with the number of elements (members).
+//
+// Unlike the grammar, the parser requires the whole input to be a single JSON
+// value, optionally surrounded by whitespace.  On failure, the handler may
+// have received some events already.
+//
+// Since the parser does not recurse, nesting depth is limited only by memory,
+// unless a limit is set with set_max_depth().
+//
+// Like the grammar, the parser accepts any bytes other than control
+// characters in strings, unless set_validate_utf8(true) is called; the input
+// is then also checked for valid UTF-8 in stage one, and the first invalid
+// sequence fails with BAD_CHAR.  So does a \u escape of a surrogate that is
+// not part of a high-low pair, which would otherwise decode to invalid UTF-8.
+//
+#ifndef HITTOP_JSON_STRUCTURAL_PARSER_H
+#define HITTOP_JSON_STRUCTURAL_PARSER_H
+
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/util/utf8.h"
+
+#include "hittop/json/number.h"
+#include "hittop/json/parse_visitor.h"
+#include "hittop/json/structural_index.h"
+#include "hittop/json/tape.h"
+
+namespace hittop {
+namespace json {
+
+namespace internal {
+
+inline bool IsDigit(char ch) { return '0' <= ch && ch <= '9'; }
+
+// Returns true if ch may follow a number or literal.
+inline bool IsScalarEnd(char ch) {
+  switch (ch) {
+  case ' ':
+  case '\t':
+  case '\n':
+  case '\r':
+  case ',':
+  case ':':
+  case ']':
+  case '}':
+  case '[':
+  case '{':
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Scans the contents of a string starting just after its opening quote, and
+// returns the position of the closing quote.  With check_surrogates, a \u
+// escape of a high surrogate must be immediately followed by a \u escape of
+// a low surrogate, and a low surrogate must not appear on its own.
+inline parser::ParseResult<const char *>
+ScanStringContents(const char *first, const char *last, bool *has_escapes,
+                   bool check_surrogates = false) {
+  *has_escapes = false;
+  bool expect_low = false;
+  while (first != last) {
+    const unsigned char ch = *first;
+    if (expect_low && ch != '\\') {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    if (ch == '"') {
+      return first;
+    }
+    if (ch < 0x20) {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    if (ch == '\\') {
+      *has_escapes = true;
+      if (++first == last) {
+        break;
+      }
+      switch (*first) {
+      case '"':
+      case '\\':
+      case '/':
+      case 'b':
+      case 'f':
+      case 'n':
+      case 'r':
+      case 't':
+        if (expect_low) {
+          return {first - 1, parser::ParseError::BAD_CHAR};
+        }
+        break;
+      case 'u': {
+        const char *const escape = first - 1;
+        unsigned long u16 = 0;
+        for (int i = 0; i < 4; ++i) {
+          if (++first == last) {
+            return {last, parser::ParseError::INCOMPLETE};
+          }
+          if (!std::isxdigit(static_cast<unsigned char>(*first))) {
+            return {first, parser::ParseError::BAD_CHAR};
+          }
+          u16 = (u16 << 4) | HexValue(*first);
+        }
+        if (check_surrogates) {
+          if (expect_low != IsLowSurrogate(u16)) {
+            return {escape, parser::ParseError::BAD_CHAR};
+          }
+          expect_low = IsHighSurrogate(u16);
+        }
+        break;
+      }
+      default:
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+    }
+    ++first;
+  }
+  return {last, parser::ParseError::INCOMPLETE};
+}
+
+// Scans a number (-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?) and returns
+// the position just past it.
+inline parser::ParseResult<const char *> ScanNumber(const char *first,
+                                                    const char *last) {
+  auto digits = [&first, last]() {
+    const char *start = first;
+    while (first != last && IsDigit(*first)) {
+      ++first;
+    }
+    return first != start;
+  };
+  auto fail = [&first, last]() -> parser::ParseResult<const char *> {
+    if (first == last) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    return {first, parser::ParseError::BAD_CHAR};
+  };
+
+  if (first != last && *first == '-') {
+    ++first;
+  }
+  if (first != last && *first == '0') {
+    ++first;
+  } else if (!digits()) {
+    return fail();
+  }
+  if (first != last && *first == '.') {
+    ++first;
+    if (!digits()) {
+      return fail();
+    }
+  }
+  if (first != last && (*first == 'e' || *first == 'E')) {
+    ++first;
+    if (first != last && (*first == '+' || *first == '-')) {
+      ++first;
+    }
+    if (!digits()) {
+      return fail();
+    }
+  }
+  if (first != last && !IsScalarEnd(*first)) {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  return first;
+}
+
+// Matches the literal [text, text + size) at first.
+inline parser::ParseResult<const char *> ScanLiteral(const char *first,
+                                                     const char *last,
+                                                     const char *text,
+                                                     std::size_t size) {
+  const std::size_t available = last - first;
+  if (available < size) {
+    if (std::memcmp(first, text, available) == 0) {
+      return {last, parser::ParseError::INCOMPLETE};
+    }
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  if (std::memcmp(first, text, size) != 0) {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  first += size;
+  if (first != last && !IsScalarEnd(*first)) {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  return first;
+}
+
+} // namespace internal
+
+// Handler that writes the parsed value to the tape of a Document.  Strings
+// without escapes are added with TapeWriter::SourceString, so they are only
+// copied if the writer has no source.  With raw_numbers, numbers are likewise
+// added with TapeWriter::SourceNumber, deferring their conversion.
+class TapeBuilder {
+public:
+  explicit TapeBuilder(TapeWriter *writer, bool raw_numbers = false)
+      : writer_(writer), raw_numbers_(raw_numbers) {}
+
+  void Null() { writer_->Null(); }
+
+  void Bool(bool value) { writer_->Bool(value); }
+
+  void Number(const char *first, const char *last) {
+    if (raw_numbers_) {
+      writer_->SourceNumber(first, last);
+      return;
+    }
+    NumberValue value;
+    ParseNumber(first, last, &value);
+    writer_->Number(value);
+  }
+
+  // For decoders of binary formats, which have numbers rather than text.
+  void Number(const NumberValue &value) { writer_->Number(value); }
+
+  void String(const char *first, const char *last, bool has_escapes) {
+    if (!has_escapes) {
+      writer_->SourceString(first, last);
+      return;
+    }
+    char *const dest = writer_->BeginString(last - first);
+    writer_->EndString(internal::UnescapeUnsafe(first, last, dest) - dest);
+  }
+
+  void Key(const char *first, const char *last, bool has_escapes) {
+    String(first, last, has_escapes);
+  }
+
+  std::size_t StartArray() { return writer_->BeginArray(); }
+
+  void EndArray(std::size_t start, std::size_t count) {
+    writer_->EndArray(start, count);
+  }
+
+  std::size_t StartObject() { return writer_->BeginObject(); }
+
+  void EndObject(std::size_t start, std::size_t count) {
+    writer_->EndObject(start, count);
+  }
+
+private:
+  TapeWriter *const writer_;
+  const bool raw_numbers_;
+};
+
+// A reusable two-stage parser.  The structural index and container stack are
+// kept between calls, so parsing many documents with one StructuralParser
+// allocates only when a document is larger or deeper than any before it.
+class StructuralParser {
+public:
+  StructuralParser() = default;
+
+  StructuralParser(const StructuralParser &) = delete;
+  StructuralParser &operator=(const StructuralParser &) = delete;
+
+  // Limits the number of containers that may be nested within each other; a
+  // '[' or '{' beyond the limit fails with BAD_CHAR.
+  void set_max_depth(std::size_t max_depth) { max_depth_ = max_depth; }
+
+  std::size_t max_depth() const { return max_depth_; }
+
+  // Whether the input must be valid UTF-8, including the code points of \u
+  // escapes in strings; it is not checked by default.
+  void set_validate_utf8(bool validate_utf8) {
+    validate_utf8_ = validate_utf8;
+  }
+
+  bool validate_utf8() const { return validate_utf8_; }
+
+  // Parses [first, last) as a single JSON value, reporting it to handler.
+  // Returns last on success.
+  template <typename Handler>
+  parser::ParseResult<const char *> Parse(const char *first, const char *last,
+                                          Handler *handler);
+
+  // Parses [first, last) into doc, replacing its previous contents.  On
+  // failure, doc is left empty.
+  parser::ParseResult<const char *> Parse(const char *first, const char *last,
+                                          Document *doc) {
+    return ParseDocument(first, last, doc, false, false);
+  }
+
+  parser::ParseResult<const char *> Parse(const std::string &input,
+                                          Document *doc) {
+    return Parse(input.data(), input.data() + input.size(), doc);
+  }
+
+  // As Parse, but strings without escapes are not copied: doc refers to them
+  // in [first, last), which must outlive doc (or its next parse).  With
+  // raw_numbers, the same goes for numbers, which are then only converted
+  // when they are accessed.
+  parser::ParseResult<const char *> ParseZeroCopy(const char *first,
+                                                  const char *last,
+                                                  Document *doc,
+                                                  bool raw_numbers = false) {
+    return ParseDocument(first, last, doc, true, raw_numbers);
+  }
+
+private:
+  struct Frame {
+    bool is_object;
+    std::size_t start;
+    std::size_t count;
+  };
+
+  parser::ParseResult<const char *> ParseDocument(const char *first,
+                                                  const char *last,
+                                                  Document *doc,
+                                                  bool zero_copy,
+                                                  bool raw_numbers) {
+    doc->reserve(last - first);
+    TapeWriter writer(doc);
+    if (zero_copy) {
+      writer.set_source(first);
+    }
+    TapeBuilder builder(&writer, raw_numbers);
+    auto result = Parse(first, last, &builder);
+    if (result.ok()) {
+      writer.Finish();
+    } else {
+      doc->clear();
+    }
+    return result;
+  }
+
+  // Parses an object key and the following ':' at structural i.
+  template <typename Handler>
+  parser::ParseResult<const char *> ParseKey(const char *first,
+                                             const char *last, std::size_t *i,
+                                             Handler *handler);
+
+  StructuralIndex index_;
+  std::vector<Frame> stack_;
+  std::size_t max_depth_ = std::numeric_limits<std::size_t>::max();
+  bool validate_utf8_ = false;
+};
+
+template <typename Handler>
+parser::ParseResult<const char *>
+StructuralParser::ParseKey(const char *first, const char *last, std::size_t *i,
+                           Handler *handler) {
+  if (*i == index_.size()) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  const char *const key = first + index_[(*i)++];
+  if (*key != '"') {
+    return {key, parser::ParseError::BAD_CHAR};
+  }
+  bool has_escapes;
+  auto result = internal::ScanStringContents(key + 1, last, &has_escapes,
+                                             validate_utf8_);
+  if (!result.ok()) {
+    return result;
+  }
+  handler->Key(key + 1, result.get(), has_escapes);
+  if (*i == index_.size()) {
+    return {last, parser::ParseError::INCOMPLETE};
+  }
+  const char *const colon = first + index_[(*i)++];
+  if (*colon != ':') {
+    return {colon, parser::ParseError::BAD_CHAR};
+  }
+  return colon;
+}
+
+template <typename Handler>
+parser::ParseResult<const char *>
+StructuralParser::Parse(const char *first, const char *last,
+                        Handler *handler) {
+  using parser::ParseError;
+
+  index_.Build(first, last, validate_utf8_);
+  if (index_.invalid_utf8()) {
+    return {util::FindInvalidUtf8(first, last), ParseError::BAD_CHAR};
+  }
+  stack_.clear();
+  const std::size_t n = index_.size();
+  std::size_t i = 0;
+
+  for (;;) {
+    // Parse the value at structural i.
+    if (i == n) {
+      return {last, ParseError::INCOMPLETE};
+    }
+    const char *const token = first + index_[i++];
+    switch (*token) {
+    case '{':
+      if (stack_.size() >= max_depth_) {
+        return {token, ParseError::BAD_CHAR};
+      }
+      if (i == n) {
+        return {last, ParseError::INCOMPLETE};
+      }
+      if (first[index_[i]] == '}') {
+        ++i;
+        handler->EndObject(handler->StartObject(), 0);
+        break;
+      }
+      stack_.push_back({true, handler->StartObject(), 0});
+      {
+        auto result = ParseKey(first, last, &i, handler);
+        if (!result.ok()) {
+          return result;
+        }
+      }
+      continue;
+    case '[':
+      if (stack_.size() >= max_depth_) {
+        return {token, ParseError::BAD_CHAR};
+      }
+      if (i == n) {
+        return {last, ParseError::INCOMPLETE};
+      }
+      if (first[index_[i]] == ']') {
+        ++i;
+        handler->EndArray(handler->StartArray(), 0);
+        break;
+      }
+      stack_.push_back({false, handler->StartArray(), 0});
+      continue;
+    case '"': {
+      bool has_escapes;
+      auto result = internal::ScanStringContents(token + 1, last, &has_escapes,
+                                                 validate_utf8_);
+      if (!result.ok()) {
+        return result;
+      }
+      handler->String(token + 1, result.get(), has_escapes);
+      break;
+    }
+    case 't': {
+      auto result = internal::ScanLiteral(token, last, "true", 4);
+      if (!result.ok()) {
+        return result;
+      }
+      handler->Bool(true);
+      break;
+    }
+    case 'f': {
+      auto result = internal::ScanLiteral(token, last, "false", 5);
+      if (!result.ok()) {
+        return result;
+      }
+      handler->Bool(false);
+      break;
+    }
+    case 'n': {
+      auto result = internal::ScanLiteral(token, last, "null", 4);
+      if (!result.ok()) {
+        return result;
+      }
+      handler->Null();
+      break;
+    }
+    default: {
+      auto result = internal::ScanNumber(token, last);
+      if (!result.ok()) {
+        return result;
+      }
+      handler->Number(token, result.get());
+      break;
+    }
+    }
+
+    // A value is complete; close containers until one expects another value.
+    for (;;) {
+      if (stack_.empty()) {
+        if (i != n) {
+          return {first + index_[i], ParseError::BAD_CHAR};
+        }
+        return last;
+      }
+      Frame &top = stack_.back();
+      ++top.count;
+      if (i == n) {
+        return {last, ParseError::INCOMPLETE};
+      }
+      const char *const delim = first + index_[i++];
+      if (*delim == ',') {
+        if (top.is_object) {
+          auto result = ParseKey(first, last, &i, handler);
+          if (!result.ok()) {
+            return result;
+          }
+        }
+        break;
+      }
+      if (*delim == (top.is_object ? '}' : ']')) {
+        if (top.is_object) {
+          handler->EndObject(top.start, top.count);
+        } else {
+          handler->EndArray(top.start, top.count);
+        }
+        stack_.pop_back();
+        continue;
+      }
+      return {delim, ParseError::BAD_CHAR};
+    }
+  }
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_STRUCTURAL_PARSER_H
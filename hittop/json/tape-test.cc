@@ -0,0 +1,141 @@
+#include "hittop/json/tape.h"
+#include "hittop/json/tape.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/tape_parse_visitor.h"
+#include "hittop/util/test_data.h"
+
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+json::ValueRef MustParse(const std::string &input, json::Document *doc) {
+  auto result = json::ParseDocument(input, doc);
+  EXPECT_TRUE(result.ok()) << "Actual error: "
+                           << make_error_condition(result.error()).message();
+  EXPECT_EQ(result.get(), input.end());
+  return doc->root();
+}
+
+} // namespace
+
+TEST(JsonTapeTest, Scalars) {
+  json::Document doc;
+  EXPECT_TRUE(MustParse("null", &doc).is_null());
+  EXPECT_TRUE(MustParse(" true ", &doc).get_bool());
+  EXPECT_FALSE(MustParse("false", &doc).get_bool());
+  EXPECT_EQ(MustParse("-12.5e1 ", &doc).get_number(), -125.0);
+  EXPECT_EQ(MustParse("\"abc\"", &doc).get_string(), "abc");
+  EXPECT_THROW(MustParse("\"abc\"", &doc).get_number(), std::runtime_error);
+}
+
+TEST(JsonTapeTest, Layout) {
+  json::Document doc;
+  MustParse("[1.5, {\"a\": 2}]", &doc);
+  std::string tags;
+  for (std::uint64_t word : doc.tape()) {
+    tags += json::tape::GetTag(word);
+  }
+  // The second word of a number is the raw double or integer, which has no
+  // tag.
+  tags[3] = '.';
+  tags[7] = '.';
+  EXPECT_EQ(tags, "r[d.{\"l.}]r");
+  EXPECT_EQ(json::tape::GetPayload(doc.tape()[0]), doc.tape().size() - 1);
+}
+
+TEST(JsonTapeTest, Integers) {
+  json::Document doc;
+  MustParse("[9007199254740993, -5, 18446744073709551615, 2.5]", &doc);
+  const json::ValueRef root = doc.root();
+  EXPECT_EQ(root[0].get_int64(), 9007199254740993LL);
+  EXPECT_EQ(root[0].get_uint64(), 9007199254740993ULL);
+  EXPECT_EQ(root[1].get_int64(), -5);
+  EXPECT_THROW(root[1].get_uint64(), std::runtime_error);
+  EXPECT_EQ(root[2].get_uint64(), 18446744073709551615ULL);
+  EXPECT_THROW(root[2].get_int64(), std::runtime_error);
+  EXPECT_EQ(root[2].get_number(), 18446744073709551615.0);
+  EXPECT_THROW(root[3].get_int64(), std::runtime_error);
+  EXPECT_EQ(root[3].get_number(), 2.5);
+}
+
+TEST(JsonTapeTest, Navigation) {
+  json::Document doc;
+  const std::string input = R"({
+    "name": "hittop",
+    "skip": {"deep": [[1, 2, [3]], {"x": "y"}]},
+    "tags": ["a", "b\n", "é"],
+    "count": 3,
+    "empty": []
+  })";
+  json::ValueRef root = MustParse(input, &doc);
+  ASSERT_TRUE(root.is_object());
+  EXPECT_EQ(root.size(), 5);
+
+  EXPECT_EQ(root.find("name")->get_string(), "hittop");
+  EXPECT_EQ(root.find("count")->get_number(), 3.0);
+  EXPECT_FALSE(root.find("missing"));
+
+  json::ValueRef tags = *root.find("tags");
+  ASSERT_TRUE(tags.is_array());
+  EXPECT_EQ(tags.size(), 3);
+  EXPECT_EQ(tags[0].get_string(), "a");
+  EXPECT_EQ(tags[1].get_string(), "b\n");
+  EXPECT_EQ(tags[2].get_string(), "\xc3\xa9");
+  EXPECT_THROW(tags[3], std::out_of_range);
+
+  std::vector<std::string> elements;
+  for (json::ValueRef tag : tags.elements()) {
+    elements.emplace_back(tag.get_string().to_string());
+  }
+  EXPECT_EQ(elements, (std::vector<std::string>{"a", "b\n", "\xc3\xa9"}));
+
+  std::vector<std::string> keys;
+  for (auto member : root.members()) {
+    keys.emplace_back(member.first.to_string());
+  }
+  EXPECT_EQ(keys, (std::vector<std::string>{"name", "skip", "tags", "count",
+                                            "empty"}));
+
+  EXPECT_TRUE(root.find("empty")->empty());
+  EXPECT_EQ(root.find("empty")->size(), 0);
+  EXPECT_EQ((*root.find("skip")->find("deep"))[0][2][0].get_number(), 3.0);
+}
+
+TEST(JsonTapeTest, MatchesValue) {
+  auto input = LoadTestData("/hittop/json/test-data.json");
+  json::Document doc;
+  auto result = json::ParseDocument(input, &doc);
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(result.get(), input.end());
+
+  auto expected = json::ParseValue(input);
+  ASSERT_TRUE(expected.ok());
+  EXPECT_TRUE(doc.root().ToValue() == std::get<0>(expected.get()));
+}
+
+TEST(JsonTapeTest, ReuseDoesNotAllocate) {
+  json::Document doc;
+  const std::string input = "{\"a\": [\"x\", \"y\", 1, 2, 3], \"b\": \"zzz\"}";
+  MustParse(input, &doc);
+  const std::uint64_t *const tape = doc.tape().data();
+  const std::size_t tape_size = doc.tape().size();
+  MustParse(input, &doc);
+  EXPECT_EQ(doc.tape().data(), tape);
+  EXPECT_EQ(doc.tape().size(), tape_size);
+}
+
+TEST(JsonTapeTest, FailureLeavesDocumentEmpty) {
+  json::Document doc;
+  const std::string input = "{\"a\": [1, 2,, 3]}";
+  auto result = json::ParseDocument(input, &doc);
+  EXPECT_FALSE(result.ok());
+  EXPECT_TRUE(doc.empty());
+}
@@ -0,0 +1,653 @@
+// A flat, read-only JSON document representation.
+//
+// Instead of a tree of separately allocated nodes (see types.h), a Document
+// stores a parsed value as a "tape": a contiguous sequence of 64-bit words,
+// one per scalar (two for numbers) and two per array or object, in document
+// order.  Each word holds a tag character in its top byte and a 56-bit
+// payload:
+//
+//   'r'  root; payload of the first word is the index of the last word
+//   'n'  null
+//   't'  true
+//   'f'  false
+//   'd'  number; the next word holds the bits of the double
+//   'l'  integer; the next word holds the int64 value
+//   'u'  integer above INT64_MAX; the next word holds the uint64 value
+//   'N'  number in the parsed text (zero-copy documents with raw numbers
+//        only); payload is as for 's', and the text is converted on every
+//        access (see ValueRef::get_number_value)
+//   '"'  string; payload is the offset of the string in the string buffer
+//   's'  string in the parsed text (zero-copy documents only); payload is
+//        (size << 32) | offset of the string's first byte in the text
+//   '['  array start; payload is (element count << 32) | index past the ']'
+//   ']'  array end; payload is the index of the '['
+//   '{'  object start; as for '[', with the count of key/value pairs
+//   '}'  object end; payload is the index of the '{'
+//
+// Object members are stored as a key string followed by its value.  String
+// bytes (unescaped, each prefixed with its 32-bit length and followed by a
+// NUL) are kept in a separate buffer.  A Document therefore owns exactly two
+// blocks of memory, which are reused when it is parsed into again.
+//
+// A zero-copy document (see StructuralParser::ParseZeroCopy) instead refers
+// to strings without escapes where they appear in the parsed text, which
+// must then outlive the document.
+//
+// ValueRef provides navigation: skipping over a nested array or object is a
+// single tape lookup, so it is cheap to find a value without looking at its
+// siblings' contents.
+//
+#ifndef HITTOP_JSON_TAPE_H
+#define HITTOP_JSON_TAPE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "boost/iterator/iterator_facade.hpp"
+#include "boost/optional.hpp"
+#include "boost/range/distance.hpp"
+#include "boost/range/iterator_range.hpp"
+#include "boost/utility/string_ref.hpp"
+
+#include "hittop/json/number.h"
+#include "hittop/json/types.h"
+
+namespace hittop {
+namespace json {
+
+namespace tape {
+
+enum Tag : char {
+  kRoot = 'r',
+  kNull = 'n',
+  kTrue = 't',
+  kFalse = 'f',
+  kDouble = 'd',
+  kInt64 = 'l',
+  kUint64 = 'u',
+  kSourceNumber = 'N',
+  kString = '"',
+  kSourceString = 's',
+  kStartArray = '[',
+  kEndArray = ']',
+  kStartObject = '{',
+  kEndObject = '}',
+};
+
+constexpr std::uint64_t kPayloadMask = (std::uint64_t{1} << 56) - 1;
+
+// Container counts saturate at this value; see ValueRef::size().
+constexpr std::uint32_t kMaxCount = 0xFFFFFF;
+
+// Longer strings are copied even in zero-copy documents.
+constexpr std::uint32_t kMaxSourceStringSize = 0xFFFFFF;
+
+// So are strings that start further into the source than this, since the
+// offset is stored in 32 bits.
+constexpr std::uint64_t kMaxSourceOffset = 0xFFFFFFFF;
+
+inline std::uint64_t MakeWord(Tag tag, std::uint64_t payload) {
+  return (std::uint64_t(static_cast<unsigned char>(tag)) << 56) | payload;
+}
+
+inline Tag GetTag(std::uint64_t word) { return static_cast<Tag>(word >> 56); }
+
+inline std::uint64_t GetPayload(std::uint64_t word) {
+  return word & kPayloadMask;
+}
+
+} // namespace tape
+
+class ValueRef;
+
+class Document {
+public:
+  Document() = default;
+
+  Document(Document &&) = default;
+  Document &operator=(Document &&) = default;
+
+  Document(const Document &) = delete;
+  Document &operator=(const Document &) = delete;
+
+  // Returns true if nothing has been parsed into this document.
+  bool empty() const { return tape_.empty(); }
+
+  void clear() {
+    tape_.clear();
+    strings_.clear();
+    source_ = nullptr;
+  }
+
+  // Preallocates enough space for any document whose JSON text is at most
+  // input_size bytes long, so that parsing it does not allocate.
+  void reserve(std::size_t input_size) {
+    // Every word is produced by at least one byte of input, except for a
+    // number's second word (numbers are separated from each other by commas)
+    // and the root words.  Every string adds at most three bytes for its
+    // length prefix and NUL to the two bytes of its quotes.
+    tape_.reserve(input_size + 3);
+    strings_.reserve(input_size * 2 + 8);
+  }
+
+  // The top-level value.  The document must not be empty.
+  ValueRef root() const;
+
+  const std::vector<std::uint64_t> &tape() const { return tape_; }
+
+private:
+  friend class ValueRef;
+  friend class TapeWriter;
+
+  std::uint64_t word(std::size_t index) const { return tape_[index]; }
+
+  StringView string_at(std::size_t offset) const {
+    std::uint32_t size;
+    std::memcpy(&size, &strings_[offset], sizeof(size));
+    return StringView(&strings_[offset + sizeof(size)], size);
+  }
+
+  StringView source_string_at(std::uint64_t payload) const {
+    return StringView(source_ + (payload & 0xFFFFFFFF), payload >> 32);
+  }
+
+  std::vector<std::uint64_t> tape_;
+  std::vector<char> strings_;
+  // The parsed text, for zero-copy documents.
+  const char *source_ = nullptr;
+};
+
+// Appends values to the tape of a Document.  Producers (parse visitors and
+// scanners) call the scalar methods and bracket the contents of each array or
+// object with Begin/End calls, then call Finish once the top-level value is
+// complete.  Nothing is checked here; producers are expected to emit
+// well-formed sequences.
+class TapeWriter {
+public:
+  // Saved state for rolling back a partially written value.
+  struct Mark {
+    std::size_t tape_size;
+    std::size_t strings_size;
+  };
+
+  // Clears doc and writes the first root word.
+  explicit TapeWriter(Document *doc) : doc_(doc) {
+    doc_->clear();
+    doc_->tape_.push_back(0);
+  }
+
+  TapeWriter(const TapeWriter &) = delete;
+  TapeWriter &operator=(const TapeWriter &) = delete;
+
+  Mark mark() const { return {doc_->tape_.size(), doc_->strings_.size()}; }
+
+  void rollback(const Mark &m) {
+    doc_->tape_.resize(m.tape_size);
+    doc_->strings_.resize(m.strings_size);
+  }
+
+  void Null() { Append(tape::kNull, 0); }
+
+  void Bool(bool value) { Append(value ? tape::kTrue : tape::kFalse, 0); }
+
+  void Double(double value) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Append(tape::kDouble, 0);
+    doc_->tape_.push_back(bits);
+  }
+
+  void Int64(std::int64_t value) {
+    Append(tape::kInt64, 0);
+    doc_->tape_.push_back(static_cast<std::uint64_t>(value));
+  }
+
+  void Uint64(std::uint64_t value) {
+    Append(tape::kUint64, 0);
+    doc_->tape_.push_back(value);
+  }
+
+  void Number(const NumberValue &value) {
+    switch (value.kind) {
+    case NumberValue::Kind::kInt64:
+      Int64(value.int64);
+      break;
+    case NumberValue::Kind::kUint64:
+      Uint64(value.uint64);
+      break;
+    default:
+      Double(value.real);
+      break;
+    }
+  }
+
+  // Appends the text of a valid number within the source text, to be
+  // converted when it is accessed.  Without a source (or if the text is
+  // implausibly long or too far into the source), the number is converted
+  // now.
+  void SourceNumber(const char *first, const char *last) {
+    const std::size_t size = last - first;
+    if (!CanReferToSource(first, size)) {
+      NumberValue value;
+      ParseNumber(first, last, &value);
+      Number(value);
+      return;
+    }
+    Append(tape::kSourceNumber,
+           (std::uint64_t(size) << 32) | std::uint64_t(first - doc_->source_));
+  }
+
+  // Appends a string whose (already unescaped) bytes are [first, last).
+  void String(const char *first, const char *last) {
+    char *dest = BeginString(last - first);
+    std::memcpy(dest, first, last - first);
+  }
+
+  // Makes the document refer to strings in source, the text being parsed;
+  // see SourceString.
+  void set_source(const char *source) { doc_->source_ = source; }
+
+  // Appends a string without escapes that lies within the source text, by
+  // reference if a source has been set (and the string is neither too long
+  // nor too far into the source), or else by copying it.
+  void SourceString(const char *first, const char *last) {
+    const std::size_t size = last - first;
+    if (!CanReferToSource(first, size)) {
+      String(first, last);
+      return;
+    }
+    Append(tape::kSourceString,
+           (std::uint64_t(size) << 32) | std::uint64_t(first - doc_->source_));
+  }
+
+  // Starts a string of at most max_size bytes and returns a pointer to where
+  // its bytes should be written.  If fewer bytes are written, EndString must
+  // be called with the actual size before anything else is appended.
+  char *BeginString(std::size_t max_size) {
+    auto &strings = doc_->strings_;
+    Append(tape::kString, strings.size());
+    const std::size_t offset = strings.size();
+    strings.resize(offset + sizeof(std::uint32_t) + max_size + 1);
+    const std::uint32_t size = static_cast<std::uint32_t>(max_size);
+    std::memcpy(&strings[offset], &size, sizeof(size));
+    strings.back() = '\0';
+    return &strings[offset + sizeof(size)];
+  }
+
+  void EndString(std::size_t size) {
+    auto &strings = doc_->strings_;
+    const std::size_t offset = tape::GetPayload(doc_->tape_.back());
+    const std::uint32_t size32 = static_cast<std::uint32_t>(size);
+    std::memcpy(&strings[offset], &size32, sizeof(size32));
+    strings.resize(offset + sizeof(size32) + size + 1);
+    strings.back() = '\0';
+  }
+
+  // Returns the index of the start word, to be passed to EndArray.
+  std::size_t BeginArray() { return Begin(tape::kStartArray); }
+
+  void EndArray(std::size_t start, std::size_t count) {
+    End(start, tape::kEndArray, count);
+  }
+
+  // Returns the index of the start word, to be passed to EndObject.
+  std::size_t BeginObject() { return Begin(tape::kStartObject); }
+
+  // count is the number of key/value pairs.
+  void EndObject(std::size_t start, std::size_t count) {
+    End(start, tape::kEndObject, count);
+  }
+
+  void Finish() {
+    auto &tape = doc_->tape_;
+    tape[0] = tape::MakeWord(tape::kRoot, tape.size());
+    tape.push_back(tape::MakeWord(tape::kRoot, 0));
+  }
+
+private:
+  bool CanReferToSource(const char *first, std::size_t size) const {
+    return doc_->source_ != nullptr && size <= tape::kMaxSourceStringSize &&
+           std::uint64_t(first - doc_->source_) <= tape::kMaxSourceOffset;
+  }
+
+  void Append(tape::Tag tag, std::uint64_t payload) {
+    doc_->tape_.push_back(tape::MakeWord(tag, payload));
+  }
+
+  std::size_t Begin(tape::Tag tag) {
+    const std::size_t start = doc_->tape_.size();
+    Append(tag, 0);
+    return start;
+  }
+
+  void End(std::size_t start, tape::Tag tag, std::size_t count) {
+    auto &tape = doc_->tape_;
+    Append(tag, start);
+    const std::uint64_t saturated =
+        count < tape::kMaxCount ? count : tape::kMaxCount;
+    tape[start] = tape::MakeWord(tape::GetTag(tape[start]),
+                                 (saturated << 32) | tape.size());
+  }
+
+  Document *doc_;
+};
+
+// A lightweight, read-only reference to a value in a Document.  It is only
+// valid as long as the Document is not modified or destroyed.
+class ValueRef {
+public:
+  using Type = Value::Type;
+
+  class ArrayIterator;
+  class ObjectIterator;
+
+  ValueRef(const Document *doc, std::size_t index) : doc_(doc), index_(index) {}
+
+  Type type() const {
+    switch (tag()) {
+    case tape::kTrue:
+    case tape::kFalse:
+      return Type::kBoolean;
+    case tape::kDouble:
+    case tape::kInt64:
+    case tape::kUint64:
+    case tape::kSourceNumber:
+      return Type::kNumber;
+    case tape::kString:
+    case tape::kSourceString:
+      return Type::kString;
+    case tape::kStartArray:
+      return Type::kArray;
+    case tape::kStartObject:
+      return Type::kObject;
+    default:
+      return Type::kNull;
+    }
+  }
+
+  bool is_null() const { return tag() == tape::kNull; }
+
+  bool is_bool() const { return type() == Type::kBoolean; }
+
+  bool is_number() const { return type() == Type::kNumber; }
+
+  bool is_string() const { return type() == Type::kString; }
+
+  bool is_array() const { return tag() == tape::kStartArray; }
+
+  bool is_object() const { return tag() == tape::kStartObject; }
+
+  // The accessors below throw std::runtime_error if the value does not have
+  // the requested type.
+
+  bool get_bool() const {
+    Check(is_bool(), "json value is not a boolean");
+    return tag() == tape::kTrue;
+  }
+
+  // Returns any number as a double (which may round large integers).
+  double get_number() const { return get_number_value().ToDouble(); }
+
+  // Returns an integer that fits in an int64.
+  std::int64_t get_int64() const {
+    const NumberValue value = get_number_value();
+    Check(value.kind == NumberValue::Kind::kInt64,
+          "json number is not an int64");
+    return value.int64;
+  }
+
+  // Returns a non-negative integer that fits in a uint64.
+  std::uint64_t get_uint64() const {
+    const NumberValue value = get_number_value();
+    Check(value.kind == NumberValue::Kind::kUint64 ||
+              (value.kind == NumberValue::Kind::kInt64 && value.int64 >= 0),
+          "json number is not a uint64");
+    return value.uint64;
+  }
+
+  // Returns the number as stored.  A number in the parsed text (a zero-copy
+  // document with raw numbers) is converted again on each call, and the
+  // result is not cached: that would make reading a document write to it,
+  // so const Documents could no longer be read from several threads.  A
+  // caller that reads such a number repeatedly should keep the NumberValue.
+  NumberValue get_number_value() const {
+    NumberValue value;
+    switch (tag()) {
+    case tape::kDouble: {
+      const std::uint64_t bits = doc_->word(index_ + 1);
+      value.kind = NumberValue::Kind::kDouble;
+      std::memcpy(&value.real, &bits, sizeof(value.real));
+      break;
+    }
+    case tape::kInt64:
+      value.kind = NumberValue::Kind::kInt64;
+      value.int64 = static_cast<std::int64_t>(doc_->word(index_ + 1));
+      break;
+    case tape::kUint64:
+      value.kind = NumberValue::Kind::kUint64;
+      value.uint64 = doc_->word(index_ + 1);
+      break;
+    case tape::kSourceNumber: {
+      const StringView text = doc_->source_string_at(payload());
+      ParseNumber(text.begin(), text.end(), &value);
+      break;
+    }
+    default:
+      Check(false, "json value is not a number");
+    }
+    return value;
+  }
+
+  // Returns a view of the unescaped string.  Copied strings are also
+  // NUL-terminated; those that refer to the source text of a zero-copy
+  // document are not.
+  StringView get_string() const {
+    Check(is_string(), "json value is not a string");
+    if (tag() == tape::kSourceString) {
+      return doc_->source_string_at(payload());
+    }
+    return doc_->string_at(payload());
+  }
+
+  // The number of elements of an array or members of an object.  This is
+  // constant time unless the container has more than tape::kMaxCount
+  // elements.
+  std::size_t size() const;
+
+  bool empty() const { return ContentsBegin() == ContentsEnd(); }
+
+  boost::iterator_range<ArrayIterator> elements() const;
+
+  boost::iterator_range<ObjectIterator> members() const;
+
+  // Returns the element of an array at the given index; linear in index, but
+  // nested containers are skipped in constant time.
+  ValueRef operator[](std::size_t index) const;
+
+  // Returns the value of the first member of an object with the given key.
+  boost::optional<ValueRef> find(StringView key) const;
+
+  // Copies this value into a json::Value tree.
+  Value ToValue() const {
+    KeyTable keys;
+    return ToValue(&keys);
+  }
+
+  // As above, interning object keys in keys.
+  Value ToValue(KeyTable *keys) const;
+
+  std::size_t index() const { return index_; }
+
+  // The index of the word following this value.
+  std::size_t next_index() const {
+    switch (tag()) {
+    case tape::kDouble:
+    case tape::kInt64:
+    case tape::kUint64:
+      return index_ + 2;
+    case tape::kStartArray:
+    case tape::kStartObject:
+      return payload() & 0xFFFFFFFF;
+    default:
+      return index_ + 1;
+    }
+  }
+
+private:
+  static void Check(bool condition, const char *message) {
+    if (!condition) {
+      throw std::runtime_error(message);
+    }
+  }
+
+  tape::Tag tag() const { return tape::GetTag(doc_->word(index_)); }
+
+  std::uint64_t payload() const { return tape::GetPayload(doc_->word(index_)); }
+
+  std::size_t ContentsBegin() const { return index_ + 1; }
+
+  // The index of the end word of a container.
+  std::size_t ContentsEnd() const { return (payload() & 0xFFFFFFFF) - 1; }
+
+  const Document *doc_;
+  std::size_t index_;
+};
+
+class ValueRef::ArrayIterator
+    : public boost::iterator_facade<ArrayIterator, ValueRef,
+                                    std::forward_iterator_tag, ValueRef> {
+public:
+  ArrayIterator() = default;
+
+  ArrayIterator(const Document *doc, std::size_t index)
+      : doc_(doc), index_(index) {}
+
+private:
+  friend class boost::iterator_core_access;
+
+  ValueRef dereference() const { return ValueRef(doc_, index_); }
+
+  bool equal(const ArrayIterator &that) const { return index_ == that.index_; }
+
+  void increment() { index_ = ValueRef(doc_, index_).next_index(); }
+
+  const Document *doc_ = nullptr;
+  std::size_t index_ = 0;
+};
+
+class ValueRef::ObjectIterator
+    : public boost::iterator_facade<ObjectIterator,
+                                    std::pair<StringView, ValueRef>,
+                                    std::forward_iterator_tag,
+                                    std::pair<StringView, ValueRef>> {
+public:
+  ObjectIterator() = default;
+
+  ObjectIterator(const Document *doc, std::size_t index)
+      : doc_(doc), index_(index) {}
+
+  StringView key() const { return ValueRef(doc_, index_).get_string(); }
+
+  ValueRef value() const { return ValueRef(doc_, index_ + 1); }
+
+private:
+  friend class boost::iterator_core_access;
+
+  std::pair<StringView, ValueRef> dereference() const {
+    return {key(), value()};
+  }
+
+  bool equal(const ObjectIterator &that) const {
+    return index_ == that.index_;
+  }
+
+  void increment() { index_ = value().next_index(); }
+
+  const Document *doc_ = nullptr;
+  std::size_t index_ = 0;
+};
+
+inline ValueRef Document::root() const { return ValueRef(this, 1); }
+
+inline std::size_t ValueRef::size() const {
+  Check(is_array() || is_object(), "json value is not a container");
+  const std::size_t count = payload() >> 32;
+  if (count < tape::kMaxCount) {
+    return count;
+  }
+  return is_array() ? boost::distance(elements()) : boost::distance(members());
+}
+
+inline boost::iterator_range<ValueRef::ArrayIterator>
+ValueRef::elements() const {
+  Check(is_array(), "json value is not an array");
+  return {ArrayIterator(doc_, ContentsBegin()),
+          ArrayIterator(doc_, ContentsEnd())};
+}
+
+inline boost::iterator_range<ValueRef::ObjectIterator>
+ValueRef::members() const {
+  Check(is_object(), "json value is not an object");
+  return {ObjectIterator(doc_, ContentsBegin()),
+          ObjectIterator(doc_, ContentsEnd())};
+}
+
+inline ValueRef ValueRef::operator[](std::size_t index) const {
+  auto elements = this->elements();
+  for (auto it = elements.begin(); it != elements.end(); ++it, --index) {
+    if (index == 0) {
+      return *it;
+    }
+  }
+  throw std::out_of_range("json array index out of range");
+}
+
+inline boost::optional<ValueRef> ValueRef::find(StringView key) const {
+  auto members = this->members();
+  for (auto it = members.begin(); it != members.end(); ++it) {
+    if (it.key() == key) {
+      return it.value();
+    }
+  }
+  return boost::none;
+}
+
+inline Value ValueRef::ToValue(KeyTable *keys) const {
+  switch (type()) {
+  case Type::kNull:
+    return Null{};
+  case Type::kBoolean:
+    return Boolean{get_bool()};
+  case Type::kNumber:
+    return Number{get_number()};
+  case Type::kString:
+    return String(get_string().begin(), get_string().end());
+  case Type::kArray: {
+    Array array;
+    array.reserve(size());
+    for (ValueRef element : elements()) {
+      array.emplace_back(element.ToValue(keys));
+    }
+    return array;
+  }
+  case Type::kObject: {
+    Object object;
+    object.reserve(size());
+    for (auto it = members().begin(); it != members().end(); ++it) {
+      object.emplace(keys->Intern(it.key()), it.value().ToValue(keys));
+    }
+    return object;
+  }
+  }
+  return Null{};
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_TAPE_H
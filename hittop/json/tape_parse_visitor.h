@@ -0,0 +1,126 @@
+// Parse visitor that writes a JSON value to the tape of a json::Document.
+//
+// This walks the same grammar as ValueParseVisitor, but strings are unescaped
+// straight into the document's string buffer and containers are delimited on
+// the tape rather than built up in local vectors and maps, so (given a
+// Document that was parsed into before, or reserve()d) parsing does not
+// allocate.
+//
+#ifndef HITTOP_JSON_TAPE_PARSE_VISITOR_H
+#define HITTOP_JSON_TAPE_PARSE_VISITOR_H
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iterator>
+#include <string>
+
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/grammar.h"
+#include "hittop/json/number.h"
+#include "hittop/json/parse_visitor.h"
+#include "hittop/json/tape.h"
+
+namespace hittop {
+namespace json {
+
+class TapeParseVisitor {
+public:
+  explicit TapeParseVisitor(TapeWriter *writer) : writer_(writer) {}
+
+  template <typename F>
+  void operator()(grammar::StringContents, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      const auto &contents = result.get();
+      char *const first = writer_->BeginString(
+          std::distance(std::begin(contents), std::end(contents)));
+      writer_->EndString(internal::UnescapeUnsafe(contents, first) - first);
+    }
+  }
+
+  template <typename F>
+  void operator()(grammar::Boolean, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      writer_->Bool(*std::find_if(std::begin(result.get()),
+                                  std::end(result.get()), [](char ch) {
+                                    return !std::isspace(
+                                        static_cast<unsigned char>(ch));
+                                  }) == 't');
+    }
+  }
+
+  template <typename F> void operator()(grammar::Number, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      writer_->Number(internal::RangeToNumber(result.get()));
+    }
+  }
+
+  template <typename F> void operator()(grammar::Null, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      writer_->Null();
+    }
+  }
+
+  template <typename F> void operator()(grammar::Array, F &&run_parser) const {
+    const TapeWriter::Mark mark = writer_->mark();
+    const std::size_t start = writer_->BeginArray();
+    std::size_t count = 0;
+    auto result = run_parser([this, &count](grammar::Value, auto &&run_item) {
+      if (run_item(*this).ok()) {
+        ++count;
+      }
+    });
+    if (result.ok()) {
+      writer_->EndArray(start, count);
+    } else {
+      writer_->rollback(mark);
+    }
+  }
+
+  template <typename F> void operator()(grammar::Object, F &&run_parser) const {
+    const TapeWriter::Mark mark = writer_->mark();
+    const std::size_t start = writer_->BeginObject();
+    std::size_t count = 0;
+    auto result =
+        run_parser([this, &count](grammar::Property, auto &&run_property) {
+          if (run_property(*this).ok()) {
+            ++count;
+          }
+        });
+    if (result.ok()) {
+      writer_->EndObject(start, count);
+    } else {
+      writer_->rollback(mark);
+    }
+  }
+
+private:
+  TapeWriter *const writer_;
+};
+
+// Parses a JSON value from input into doc, replacing its previous contents.
+// On failure, doc is left empty.
+template <typename Range>
+auto ParseDocument(const Range &input, Document *doc)
+    -> parser::ParseResult<decltype(std::begin(input))> {
+  doc->reserve(std::distance(std::begin(input), std::end(input)));
+  TapeWriter writer(doc);
+  auto result =
+      parser::Parse<grammar::Value>(input, TapeParseVisitor{&writer});
+  if (result.ok()) {
+    writer.Finish();
+  } else {
+    doc->clear();
+  }
+  return result;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_TAPE_PARSE_VISITOR_H
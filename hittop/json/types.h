@@ -4,12 +4,13 @@
 #include <string>
 #include <tuple>
 #include <type_traits>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "boost/variant.hpp"
 
+#include "hittop/json/flat_object.h"
+
 namespace hittop {
 namespace json {
 
@@ -20,7 +21,7 @@ using Boolean = bool;
 using Null = std::tuple<>;
 using Number = double;
 using String = std::string;
-using Object = std::unordered_map<String, Value>;
+using Object = FlatObject<Value>;
 
 class Value {
 private:
@@ -0,0 +1,94 @@
+#include "hittop/json/value_builder.h"
+#include "hittop/json/value_builder.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+#include <tuple>
+
+#include "hittop/json/parser.h"
+#include "hittop/json/types.h"
+#include "hittop/util/test_data.h"
+
+using hittop::parser::ParseError;
+using hittop::util::LoadTestData;
+
+namespace json = hittop::json;
+
+namespace {
+
+std::string Nested(std::size_t depth) {
+  return std::string(depth, '[') + std::string(depth, ']');
+}
+
+} // namespace
+
+TEST(ValueBuilderTest, MatchesParseValue) {
+  const std::string inputs[] = {
+      LoadTestData("/hittop/json/test-data.json"),
+      R"({"a": [1, -2.5e3, "xé\n", true, false, null, [], {}],
+          "b": {"c": [[{"d": [0]}]]}, "": ""})",
+      "\"top\"",
+  };
+  for (const std::string &input : inputs) {
+    auto expected = json::ParseValue(input);
+    ASSERT_TRUE(expected.ok()) << input;
+    json::Value value;
+    EXPECT_TRUE(json::ParseValueIterative(input, &value).ok());
+    EXPECT_TRUE(value == std::get<0>(expected.get())) << input;
+  }
+
+  // Unlike the grammar, a number may end the input.
+  json::Value value;
+  EXPECT_TRUE(json::ParseValueIterative(" 17 ", &value).ok());
+  EXPECT_TRUE(value == json::Number(17));
+}
+
+TEST(ValueBuilderTest, Keys) {
+  json::KeyTable keys;
+  json::Value value;
+  ASSERT_TRUE(json::ParseValueIterative(
+                  R"([{"id": 1, "id": {"x": [2]}, "n": 3}, {"id": 4}])",
+                  &value, json::kDefaultMaxDepth, &keys)
+                  .ok());
+  EXPECT_EQ(keys.size(), 3u);
+  const auto &array = static_cast<const json::Array &>(value);
+  const auto &first = static_cast<const json::Object &>(array[0]);
+  const auto &second = static_cast<const json::Object &>(array[1]);
+  // The first of duplicate keys is kept.
+  EXPECT_EQ(first.size(), 2u);
+  EXPECT_TRUE(first.at("id") == json::Number(1));
+  EXPECT_TRUE(first.at("n") == json::Number(3));
+  EXPECT_TRUE(first.begin()->first.shares_string(second.begin()->first));
+}
+
+TEST(ValueBuilderTest, MaxDepth) {
+  json::Value value;
+  EXPECT_TRUE(json::ParseValueIterative(Nested(3), &value, 3).ok());
+  EXPECT_TRUE(json::ParseValueIterative("[{\"a\": []}]", &value, 3).ok());
+
+  const std::string too_deep = "[{\"a\": [{}]}]";
+  auto result = json::ParseValueIterative(too_deep, &value, 3);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - too_deep.data(), 8);
+  EXPECT_TRUE(value == json::Null());
+
+  // Hostile nesting fails at the default limit instead of exhausting the
+  // stack.
+  const std::string hostile = Nested(1000000);
+  result = json::ParseValueIterative(hostile, &value);
+  EXPECT_EQ(result.error(), ParseError::BAD_CHAR);
+  EXPECT_EQ(result.get() - hostile.data(),
+            static_cast<std::ptrdiff_t>(json::kDefaultMaxDepth));
+
+  // Deep documents within the limit are fine.
+  EXPECT_TRUE(json::ParseValueIterative(Nested(10000), &value, 10000).ok());
+}
+
+TEST(ValueBuilderTest, Errors) {
+  for (const std::string input : {"[1, 2", "{\"a\" 1}", "[1,]", "tru", ""}) {
+    json::Value value = json::Number(5);
+    EXPECT_FALSE(json::ParseValueIterative(input, &value).ok()) << input;
+    EXPECT_TRUE(value == json::Null());
+  }
+}
@@ -0,0 +1,172 @@
+// Iterative construction of json::Value trees.
+//
+// ParseValue runs the recursive grammar: each level of nesting costs several
+// native stack frames, and each array or object is built in a local and then
+// moved into its parent.  ValueBuilder is instead a StructuralParser handler
+// that builds the tree in place.  It keeps a stack of pointers to the open
+// containers, and adds each value directly to the innermost one; since only
+// that container grows until it is closed, the pointers stay valid.
+//
+// ParseValueIterative combines the two with a limit on the nesting depth, so
+// that neither parsing nor destroying the result can exhaust the native stack
+// however deeply the input is nested.
+//
+#ifndef HITTOP_JSON_VALUE_BUILDER_H
+#define HITTOP_JSON_VALUE_BUILDER_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "hittop/parser/parse_error.h"
+#include "hittop/parser/parser.h"
+
+#include "hittop/json/number.h"
+#include "hittop/json/parse_visitor.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/types.h"
+
+namespace hittop {
+namespace json {
+
+// The default limit on nesting depth for ParseValueIterative.
+constexpr std::size_t kDefaultMaxDepth = 1024;
+
+class ValueBuilder {
+public:
+  // Builds the value in *root.  Object keys are interned in keys, if it is not
+  // null.  As with ParseValue, the first of several members with the same key
+  // is kept.
+  explicit ValueBuilder(Value *root, KeyTable *keys = nullptr)
+      : root_(root), keys_(keys) {}
+
+  ValueBuilder(const ValueBuilder &) = delete;
+  ValueBuilder &operator=(const ValueBuilder &) = delete;
+
+  void Null() { *Next() = json::Null{}; }
+
+  void Bool(bool value) { *Next() = Boolean{value}; }
+
+  void Number(const char *first, const char *last) {
+    NumberValue value;
+    ParseNumber(first, last, &value);
+    Number(value);
+  }
+
+  // For decoders of binary formats, which have numbers rather than text.
+  void Number(const NumberValue &value) {
+    *Next() = json::Number{value.ToDouble()};
+  }
+
+  void String(const char *first, const char *last, bool has_escapes) {
+    Value *const slot = Next();
+    *slot = json::String();
+    std::string &out = static_cast<std::string &>(*slot);
+    Unescape(first, last, has_escapes, &out);
+  }
+
+  void Key(const char *first, const char *last, bool has_escapes) {
+    Unescape(first, last, has_escapes, &key_);
+    Object &object = *stack_.back().object;
+    auto inserted =
+        object.emplace(keys_ ? keys_->Intern(key_) : json::Key(key_));
+    if (inserted.second) {
+      next_ = &inserted.first->second;
+    } else {
+      discarded_.emplace_back();
+      next_ = &discarded_.back();
+    }
+  }
+
+  std::size_t StartArray() {
+    Value *const slot = Next();
+    *slot = Array();
+    stack_.push_back({&static_cast<Array &>(*slot), nullptr});
+    return stack_.size();
+  }
+
+  void EndArray(std::size_t, std::size_t) { stack_.pop_back(); }
+
+  std::size_t StartObject() {
+    Value *const slot = Next();
+    *slot = Object();
+    stack_.push_back({nullptr, &static_cast<Object &>(*slot)});
+    return stack_.size();
+  }
+
+  void EndObject(std::size_t, std::size_t) { stack_.pop_back(); }
+
+private:
+  // An open container; exactly one of the pointers is set.
+  struct Frame {
+    Array *array;
+    Object *object;
+  };
+
+  static void Unescape(const char *first, const char *last, bool has_escapes,
+                       std::string *out) {
+    if (!has_escapes) {
+      out->assign(first, last);
+      return;
+    }
+    // Unescaping never makes a string longer.
+    out->resize(last - first);
+    out->resize(internal::UnescapeUnsafe(first, last, &(*out)[0]) -
+                &(*out)[0]);
+  }
+
+  // Returns the place for the next value: the root, a new element of the
+  // innermost array, or the member of the innermost object whose key was
+  // just read.
+  Value *Next() {
+    if (stack_.empty()) {
+      return root_;
+    }
+    if (stack_.back().array != nullptr) {
+      stack_.back().array->emplace_back();
+      return &stack_.back().array->back();
+    }
+    return next_;
+  }
+
+  Value *const root_;
+  KeyTable *const keys_;
+  std::vector<Frame> stack_;
+  Value *next_ = nullptr;
+  std::string key_;
+  // Values of duplicate keys; a deque, so that they do not move while they
+  // are being built.
+  std::deque<Value> discarded_;
+};
+
+// Parses [first, last) as a single JSON value into *out, with containers
+// nested at most max_depth deep.  Returns last, or the position of an invalid
+// character (or of the first container beyond max_depth) with error
+// BAD_CHAR; on failure, *out is null.
+inline parser::ParseResult<const char *>
+ParseValueIterative(const char *first, const char *last, Value *out,
+                    std::size_t max_depth = kDefaultMaxDepth,
+                    KeyTable *keys = nullptr) {
+  StructuralParser parser;
+  parser.set_max_depth(max_depth);
+  ValueBuilder builder(out, keys);
+  auto result = parser.Parse(first, last, &builder);
+  if (!result.ok()) {
+    *out = Null{};
+  }
+  return result;
+}
+
+inline parser::ParseResult<const char *>
+ParseValueIterative(const std::string &input, Value *out,
+                    std::size_t max_depth = kDefaultMaxDepth,
+                    KeyTable *keys = nullptr) {
+  return ParseValueIterative(input.data(), input.data() + input.size(), out,
+                             max_depth, keys);
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_VALUE_BUILDER_H
@@ -0,0 +1,183 @@
+#include "hittop/json/writer.h"
+#include "hittop/json/writer.h"
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <tuple>
+
+#include "hittop/io/async_circular_buffer_stream.h"
+#include "hittop/json/async_write.h"
+#include "hittop/json/parser.h"
+#include "hittop/json/tape_parse_visitor.h"
+#include "hittop/util/test_data.h"
+
+using hittop::util::LoadTestData;
+
+namespace io = hittop::io;
+namespace json = hittop::json;
+
+namespace {
+
+std::string FormatDouble(double value) {
+  char buf[json::kMaxDoubleSize];
+  return std::string(buf, json::FormatDouble(value, buf));
+}
+
+} // namespace
+
+TEST(JsonWriterTest, Builder) {
+  std::string out;
+  json::Writer writer(&out);
+  writer.StartObject();
+  writer.Key("a");
+  writer.StartArray();
+  writer.Int64(-12);
+  writer.Uint64(std::numeric_limits<std::uint64_t>::max());
+  writer.Double(0.5);
+  writer.Bool(true);
+  writer.Null();
+  writer.StartArray();
+  writer.EndArray();
+  writer.EndArray();
+  writer.Key("b");
+  writer.StartObject();
+  writer.EndObject();
+  writer.EndObject();
+  EXPECT_EQ(writer.depth(), 0u);
+  EXPECT_EQ(out, R"({"a":[-12,18446744073709551615,0.5,true,null,[]],"b":{}})");
+}
+
+TEST(JsonWriterTest, Pretty) {
+  json::Document doc;
+  ASSERT_TRUE(
+      json::ParseDocument(std::string(R"({"a": [1, {}], "b": {"c": []}})"),
+                          &doc)
+          .ok());
+  EXPECT_EQ(json::ToJson(doc.root(), true), "{\n"
+                                            "  \"a\": [\n"
+                                            "    1,\n"
+                                            "    {}\n"
+                                            "  ],\n"
+                                            "  \"b\": {\n"
+                                            "    \"c\": []\n"
+                                            "  }\n"
+                                            "}");
+}
+
+TEST(JsonWriterTest, Escapes) {
+  std::string out;
+  json::Writer writer(&out);
+  const std::string s("quote\" backslash\\ \b\f\n\r\t \x01\x1f\x7f \xc3\xa9 "
+                      "and a long tail without escapes");
+  writer.String(s);
+  EXPECT_EQ(out, "\"quote\\\" backslash\\\\ \\b\\f\\n\\r\\t \\u0001\\u001f\x7f "
+                 "\xc3\xa9 and a long tail without escapes\"");
+
+  // An escape at every position relative to the 16-byte blocks.
+  for (std::size_t i = 0; i < 40; ++i) {
+    std::string input(40, 'x');
+    input[i] = '\n';
+    std::string expected = "\"" + input + "\"";
+    expected.replace(i + 1, 1, "\\n");
+    out.clear();
+    json::Writer w(&out);
+    w.String(input);
+    EXPECT_EQ(out, expected);
+  }
+}
+
+TEST(JsonWriterTest, Doubles) {
+  EXPECT_EQ(FormatDouble(0.0), "0.0");
+  EXPECT_EQ(FormatDouble(-0.0), "-0.0");
+  EXPECT_EQ(FormatDouble(1.0), "1.0");
+  EXPECT_EQ(FormatDouble(0.1), "0.1");
+  EXPECT_EQ(FormatDouble(-2.5), "-2.5");
+  EXPECT_EQ(FormatDouble(1e-5), "1e-5");
+  EXPECT_EQ(FormatDouble(123456789012345680.0), "1.2345678901234568e+17");
+  EXPECT_EQ(FormatDouble(5e-324), "5e-324");
+  EXPECT_EQ(FormatDouble(1.7976931348623157e308), "1.7976931348623157e+308");
+  EXPECT_EQ(FormatDouble(std::numeric_limits<double>::infinity()), "null");
+
+  // Every finite double reads back exactly.
+  std::mt19937_64 rng(17);
+  for (int i = 0; i < 200000; ++i) {
+    const std::uint64_t bits = rng();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    if (!std::isfinite(value)) {
+      continue;
+    }
+    const std::string text = FormatDouble(value);
+    json::NumberValue parsed;
+    ASSERT_TRUE(json::ParseNumber(text.data(), text.data() + text.size(),
+                                  &parsed)
+                    .ok())
+        << text;
+    EXPECT_EQ(parsed.ToDouble(), value) << text;
+  }
+}
+
+TEST(JsonWriterTest, RoundTrip) {
+  const std::string input = LoadTestData("/hittop/json/test-data.json");
+  json::Document doc;
+  ASSERT_TRUE(json::ParseDocument(input, &doc).ok());
+
+  for (bool pretty : {false, true}) {
+    const std::string text = json::ToJson(doc.root(), pretty);
+    json::Document reparsed;
+    ASSERT_TRUE(json::ParseDocument(text, &reparsed).ok());
+    EXPECT_EQ(reparsed.root().ToValue(), doc.root().ToValue());
+    EXPECT_EQ(json::ToJson(reparsed.root(), pretty), text);
+  }
+
+  const json::Value value = doc.root().ToValue();
+  auto result = json::ParseValue(json::ToJson(value));
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ(std::get<0>(result.get()), value);
+}
+
+TEST(JsonWriterTest, AsyncWriteToStream) {
+  std::string text;
+  json::Writer writer(&text);
+  writer.StartArray();
+  for (int i = 0; i < 100; ++i) {
+    writer.String("element " + std::to_string(i));
+  }
+  writer.EndArray();
+
+  // A stream much smaller than the output.
+  io::AsyncCircularBufferStream stream(5);
+  bool called = false;
+  json::AsyncWrite(&stream, text, [&called](const io::error_code &ec) {
+    called = true;
+    EXPECT_FALSE(ec);
+  });
+
+  // Each consume makes room for the writer to continue; the last piece is
+  // still in the stream when the writer finishes.
+  std::string received;
+  auto drain = [&stream, &received]() {
+    stream.async_fetch(
+        1, [&](const io::error_code &ec,
+               const io::AsyncCircularBufferStream::const_buffers_type
+                   &buffers) {
+          ASSERT_FALSE(ec);
+          for (const auto &buffer : buffers) {
+            received.append(boost::asio::buffer_cast<const char *>(buffer),
+                            boost::asio::buffer_size(buffer));
+          }
+          stream.consume(boost::asio::buffer_size(buffers));
+        });
+  };
+  while (!called) {
+    drain();
+  }
+  drain();
+  EXPECT_EQ(received, text);
+}
@@ -0,0 +1,405 @@
+// Serialization of JSON values to text.
+//
+// Writer is a streaming builder: a sequence of calls such as StartObject(),
+// Key("a"), Int64(1), EndObject() appends the corresponding JSON text to a
+// std::string, in compact form or pretty-printed with indentation.  Strings
+// are scanned for characters that need escaping sixteen bytes at a time and
+// copied in runs; integers are formatted two digits at a time and doubles with
+// the shortest representation that reads back exactly (see format_double.h).
+//
+// Write() serializes a json::Value tree or a tape ValueRef with a Writer, and
+// ToJson() returns the text of a value as a string.  To send the output to an
+// AsyncMutableBufferStream, see async_write.h.
+//
+#ifndef HITTOP_JSON_WRITER_H
+#define HITTOP_JSON_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "hittop/json/format_double.h"
+#include "hittop/json/number.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/types.h"
+
+namespace hittop {
+namespace json {
+namespace internal {
+
+// Returns the first position in [first, last) of a character that must be
+// escaped in a JSON string ('"', '\\' or a control character), or last.
+inline const char *FindCharToEscape(const char *first, const char *last) {
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i max_control = _mm_set1_epi8(0x1F);
+  for (; last - first >= 16; first += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    // v <= 0x1F (unsigned) exactly when max(v, 0x1F) == 0x1F.
+    const __m128i control =
+        _mm_cmpeq_epi8(_mm_max_epu8(v, max_control), max_control);
+    const __m128i match =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                  _mm_cmpeq_epi8(v, backslash)),
+                     control);
+    const int mask = _mm_movemask_epi8(match);
+    if (mask != 0) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+#endif // defined(__SSE2__)
+  for (; first != last; ++first) {
+    const unsigned char ch = *first;
+    if (ch == '"' || ch == '\\' || ch < 0x20) {
+      return first;
+    }
+  }
+  return last;
+}
+
+// The two-digit decimal representations of 0 through 99.
+constexpr char kDigitPairs[] = "00010203040506070809"
+                               "10111213141516171819"
+                               "20212223242526272829"
+                               "30313233343536373839"
+                               "40414243444546474849"
+                               "50515253545556575859"
+                               "60616263646566676869"
+                               "70717273747576777879"
+                               "80818283848586878889"
+                               "90919293949596979899";
+
+// The most characters FormatUint64/FormatInt64 write.
+constexpr int kMaxIntegerSize = 20;
+
+inline int CountDigits(std::uint64_t n) {
+  int digits = 1;
+  for (;;) {
+    if (n < 10) {
+      return digits;
+    }
+    if (n < 100) {
+      return digits + 1;
+    }
+    if (n < 1000) {
+      return digits + 2;
+    }
+    if (n < 10000) {
+      return digits + 3;
+    }
+    n /= 10000;
+    digits += 4;
+  }
+}
+
+// Writes the decimal digits of n to buf and returns the end of the output.
+inline char *FormatUint64(std::uint64_t n, char *buf) {
+  char *const end = buf + CountDigits(n);
+  char *p = end;
+  while (n >= 100) {
+    const std::size_t pair = static_cast<std::size_t>(n % 100) * 2;
+    n /= 100;
+    *--p = kDigitPairs[pair + 1];
+    *--p = kDigitPairs[pair];
+  }
+  if (n >= 10) {
+    *--p = kDigitPairs[n * 2 + 1];
+    *--p = kDigitPairs[n * 2];
+  } else {
+    *--p = static_cast<char>('0' + n);
+  }
+  return end;
+}
+
+inline char *FormatInt64(std::int64_t n, char *buf) {
+  std::uint64_t magnitude = static_cast<std::uint64_t>(n);
+  if (n < 0) {
+    *buf++ = '-';
+    magnitude = 0 - magnitude;
+  }
+  return FormatUint64(magnitude, buf);
+}
+
+} // namespace internal
+
+class Writer {
+public:
+  // Appends to *out.  If pretty is true, each array element and object member
+  // is written on its own line, indented by indent spaces per level.
+  explicit Writer(std::string *out, bool pretty = false, int indent = 2)
+      : out_(out), pretty_(pretty), indent_(indent) {}
+
+  Writer(const Writer &) = delete;
+  Writer &operator=(const Writer &) = delete;
+
+  void Null() {
+    BeginValue();
+    out_->append("null", 4);
+  }
+
+  void Bool(bool value) {
+    BeginValue();
+    if (value) {
+      out_->append("true", 4);
+    } else {
+      out_->append("false", 5);
+    }
+  }
+
+  // Non-finite values, which JSON cannot represent, are written as null.
+  void Double(double value) {
+    BeginValue();
+    char buf[kMaxDoubleSize];
+    out_->append(buf, FormatDouble(value, buf));
+  }
+
+  void Int64(std::int64_t value) {
+    BeginValue();
+    char buf[internal::kMaxIntegerSize];
+    out_->append(buf, internal::FormatInt64(value, buf));
+  }
+
+  void Uint64(std::uint64_t value) {
+    BeginValue();
+    char buf[internal::kMaxIntegerSize];
+    out_->append(buf, internal::FormatUint64(value, buf));
+  }
+
+  void Number(const NumberValue &value) {
+    switch (value.kind) {
+    case NumberValue::Kind::kInt64:
+      Int64(value.int64);
+      break;
+    case NumberValue::Kind::kUint64:
+      Uint64(value.uint64);
+      break;
+    case NumberValue::Kind::kDouble:
+      Double(value.real);
+      break;
+    }
+  }
+
+  // Writes a string, escaping '"', '\\' and control characters.  Other bytes,
+  // including non-ASCII UTF-8, are copied unchanged.
+  void String(StringView value) {
+    BeginValue();
+    AppendString(value);
+  }
+
+  // Writes the key of the next member of an object.
+  void Key(StringView key) {
+    BeginValue();
+    AppendString(key);
+    if (pretty_) {
+      out_->append(": ", 2);
+    } else {
+      out_->push_back(':');
+    }
+    after_key_ = true;
+  }
+
+  void StartArray() {
+    BeginValue();
+    out_->push_back('[');
+    counts_.push_back(0);
+  }
+
+  void EndArray() { EndContainer(']'); }
+
+  void StartObject() {
+    BeginValue();
+    out_->push_back('{');
+    counts_.push_back(0);
+  }
+
+  void EndObject() { EndContainer('}'); }
+
+  // The number of containers started but not yet ended.
+  std::size_t depth() const { return counts_.size(); }
+
+private:
+  // Writes the separator and indentation that precede a value or key.
+  void BeginValue() {
+    if (after_key_) {
+      after_key_ = false;
+      return;
+    }
+    if (counts_.empty()) {
+      return;
+    }
+    if (counts_.back()++ != 0) {
+      out_->push_back(',');
+    }
+    if (pretty_) {
+      NewLine(counts_.size());
+    }
+  }
+
+  void EndContainer(char close) {
+    const bool empty = counts_.back() == 0;
+    counts_.pop_back();
+    if (pretty_ && !empty) {
+      NewLine(counts_.size());
+    }
+    out_->push_back(close);
+  }
+
+  void NewLine(std::size_t level) {
+    out_->push_back('\n');
+    out_->append(level * indent_, ' ');
+  }
+
+  void AppendString(StringView value) {
+    static constexpr char kHex[] = "0123456789abcdef";
+    const char *first = value.begin();
+    const char *const last = value.end();
+    out_->push_back('"');
+    for (;;) {
+      const char *p = internal::FindCharToEscape(first, last);
+      out_->append(first, p);
+      if (p == last) {
+        break;
+      }
+      const unsigned char ch = *p;
+      char escape[6] = {'\\', 0, '0', '0', 0, 0};
+      std::size_t size = 2;
+      switch (ch) {
+      case '"':
+      case '\\':
+        escape[1] = ch;
+        break;
+      case '\b':
+        escape[1] = 'b';
+        break;
+      case '\f':
+        escape[1] = 'f';
+        break;
+      case '\n':
+        escape[1] = 'n';
+        break;
+      case '\r':
+        escape[1] = 'r';
+        break;
+      case '\t':
+        escape[1] = 't';
+        break;
+      default:
+        escape[1] = 'u';
+        escape[4] = kHex[ch >> 4];
+        escape[5] = kHex[ch & 0xF];
+        size = 6;
+        break;
+      }
+      out_->append(escape, size);
+      first = p + 1;
+    }
+    out_->push_back('"');
+  }
+
+  std::string *const out_;
+  const bool pretty_;
+  const int indent_;
+  // The number of values written so far in each open container.
+  std::vector<std::size_t> counts_;
+  bool after_key_ = false;
+};
+
+namespace internal {
+
+class WriteVisitor : public boost::static_visitor<void> {
+public:
+  explicit WriteVisitor(Writer *writer) : writer_(writer) {}
+
+  void operator()(const Null &) const { writer_->Null(); }
+
+  void operator()(Boolean value) const { writer_->Bool(value); }
+
+  void operator()(Number value) const { writer_->Double(value); }
+
+  void operator()(const String &value) const { writer_->String(value); }
+
+  void operator()(const Array &value) const {
+    writer_->StartArray();
+    for (const Value &element : value) {
+      element.Visit(*this);
+    }
+    writer_->EndArray();
+  }
+
+  void operator()(const Object &value) const {
+    writer_->StartObject();
+    for (const auto &member : value) {
+      writer_->Key(member.first);
+      member.second.Visit(*this);
+    }
+    writer_->EndObject();
+  }
+
+private:
+  Writer *writer_;
+};
+
+} // namespace internal
+
+// Writes a json::Value tree.  Numbers, which a Value stores as doubles, are
+// written as doubles (e.g. 1.0); object members are written in the order in
+// which they were inserted (see FlatObject), which for a parsed Value is
+// document order.
+inline void Write(const Value &value, Writer *writer) {
+  value.Visit(internal::WriteVisitor(writer));
+}
+
+// Writes a value parsed into a tape Document.  Integers are written exactly
+// and object members are written in document order.
+inline void Write(ValueRef value, Writer *writer) {
+  switch (value.type()) {
+  case Value::Type::kNull:
+    writer->Null();
+    break;
+  case Value::Type::kBoolean:
+    writer->Bool(value.get_bool());
+    break;
+  case Value::Type::kNumber:
+    writer->Number(value.get_number_value());
+    break;
+  case Value::Type::kString:
+    writer->String(value.get_string());
+    break;
+  case Value::Type::kArray:
+    writer->StartArray();
+    for (ValueRef element : value.elements()) {
+      Write(element, writer);
+    }
+    writer->EndArray();
+    break;
+  case Value::Type::kObject:
+    writer->StartObject();
+    for (const auto &member : value.members()) {
+      writer->Key(member.first);
+      Write(member.second, writer);
+    }
+    writer->EndObject();
+    break;
+  }
+}
+
+// Returns the JSON text of a json::Value or ValueRef.
+template <typename T> std::string ToJson(const T &value, bool pretty = false) {
+  std::string out;
+  Writer writer(&out, pretty);
+  Write(value, &writer);
+  return out;
+}
+
+} // namespace json
+} // namespace hittop
+
+#endif // HITTOP_JSON_WRITER_H
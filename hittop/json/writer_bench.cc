@@ -0,0 +1,67 @@
+// Measures serialization throughput with Writer alongside parsing throughput
+// with the structural parser, on a generated ~1MB document of strings,
+// integers and doubles.
+//
+// usage: writer_bench [ITERATIONS]
+//
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/json/bench_util.h"
+#include "hittop/json/structural_parser.h"
+#include "hittop/json/tape.h"
+#include "hittop/json/writer.h"
+#include "hittop/util/bench_util.h"
+
+namespace json = hittop::json;
+
+using hittop::util::bench::Report;
+using hittop::util::bench::TimeUsec;
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? boost::lexical_cast<unsigned>(argv[1]) : 100;
+  const std::string input = json::bench::MakeItemsDocument(1 << 20);
+
+  json::StructuralParser parser;
+  json::Document doc;
+  if (!parser.Parse(input.data(), input.data() + input.size(), &doc).ok()) {
+    std::cerr << "Fail!" << std::endl;
+    return 1;
+  }
+
+  std::size_t checksum = 0;
+  for (int j = 0; j < 5; ++j) {
+    Report("parse",
+           TimeUsec(count,
+                    [&]() {
+                      parser.Parse(input.data(), input.data() + input.size(),
+                                   &doc);
+                      checksum += doc.tape().size();
+                    }),
+           count, input.size());
+  }
+
+  std::string out;
+  for (bool pretty : {false, true}) {
+    for (int j = 0; j < 5; ++j) {
+      std::size_t size = 0;
+      const double usec = TimeUsec(count, [&]() {
+        out.clear();
+        json::Writer writer(&out, pretty);
+        json::Write(doc.root(), &writer);
+        size = out.size();
+      });
+      Report(pretty ? "write_pretty" : "write_compact", usec, count, size);
+      checksum += size;
+    }
+  }
+
+  std::cout << "doc size: " << input.size() << " checksum: " << checksum
+            << std::endl;
+  return 0;
+}
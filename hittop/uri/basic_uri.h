@@ -14,6 +14,7 @@
 
 #include "third_party/short_alloc/short_alloc.h"
 
+#include "hittop/uri/ip_address.h"
 #include "hittop/util/in_place_alloc_factory.h"
 
 namespace hittop {
@@ -74,6 +75,8 @@ public:
     scheme_ = builder_.template in_place<SubRange>(std::forward<Args>(args)...);
   }
 
+  void reset_scheme() { scheme_ = boost::none; }
+
   const boost::optional<SubRange> &user() const { return user_; }
 
   template <typename... Args> void assign_user(Args &&... args) {
@@ -88,6 +91,13 @@ public:
     host_ = builder_.template in_place<SubRange>(std::forward<Args>(args)...);
   }
 
+  // The binary address of the host, if it is an IP address.
+  const boost::optional<IpAddress> &host_address() const {
+    return host_address_;
+  }
+
+  void assign_host_address(const IpAddress &addr) { host_address_ = addr; }
+
   const boost::optional<unsigned> &port() const { return port_; }
 
   void assign_port(unsigned p) { port_ = p; }
@@ -139,6 +149,7 @@ private:
   boost::optional<SubRange> scheme_;
   boost::optional<SubRange> user_;
   boost::optional<SubRange> host_;
+  boost::optional<IpAddress> host_address_;
   boost::optional<unsigned> port_;
   boost::optional<SubRange> path_;
   boost::optional<SubRange> query_;
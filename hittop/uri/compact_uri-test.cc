@@ -0,0 +1,153 @@
+#include "hittop/uri/compact_uri.h"
+#include "hittop/uri/compact_uri.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hittop/parser/parser.h"
+#include "hittop/uri/grammar.h"
+#include "hittop/uri/normalize.h"
+#include "hittop/uri/rfc3986_parse_visitor.h"
+#include "hittop/uri/route_table.h"
+#include "hittop/uri/uri_parse_visitor.h"
+#include "hittop/util/range_to_string.h"
+
+namespace {
+
+using ::hittop::parser::Parse;
+using ::hittop::uri::IpAddress;
+using ::hittop::uri::MakeRfc3986ParseVisitor;
+using ::hittop::uri::MakeUriParseVisitor;
+using ::hittop::util::RangeToString;
+
+using CompactUri = ::hittop::uri::CompactUri<std::string::const_iterator>;
+
+TEST(CompactUriTest, FitsInACacheLine) {
+  EXPECT_LE(sizeof(CompactUri), 64u);
+  EXPECT_TRUE(std::is_trivially_copyable<CompactUri>::value);
+}
+
+TEST(CompactUriTest, ParseRfc2396) {
+  const std::string input =
+      "https://user@example.org:8080/a/b;p/c?x=1&y&z=3#frag\n";
+  CompactUri uri;
+  auto result = Parse<::hittop::uri::grammar::URI_reference>(
+      input, MakeUriParseVisitor(&uri));
+  ASSERT_TRUE(result.ok());
+
+  EXPECT_EQ(input.begin(), uri.begin());
+  EXPECT_EQ(std::prev(input.end()), uri.end());
+  ASSERT_TRUE(uri.scheme());
+  EXPECT_EQ("https", RangeToString(*uri.scheme()));
+  ASSERT_TRUE(uri.user());
+  EXPECT_EQ("user", RangeToString(*uri.user()));
+  ASSERT_TRUE(uri.host());
+  EXPECT_EQ("example.org", RangeToString(*uri.host()));
+  ASSERT_TRUE(uri.port());
+  EXPECT_EQ(8080u, *uri.port());
+  ASSERT_TRUE(uri.path());
+  EXPECT_EQ("/a/b;p/c", RangeToString(*uri.path()));
+  ASSERT_TRUE(uri.query());
+  EXPECT_EQ("x=1&y&z=3", RangeToString(*uri.query()));
+  ASSERT_TRUE(uri.fragment());
+  EXPECT_EQ("frag", RangeToString(*uri.fragment()));
+
+  const auto segments = uri.path_segments();
+  ASSERT_TRUE(segments);
+  ASSERT_EQ(3u, segments->size());
+  EXPECT_EQ("a", RangeToString((*segments)[0]));
+  EXPECT_EQ("b;p", RangeToString((*segments)[1]));
+  EXPECT_EQ("c", RangeToString((*segments)[2]));
+
+  // Accessors return by value, so bind the view before iterating over it.
+  const auto query_params = uri.query_params();
+  ASSERT_TRUE(query_params);
+  std::vector<std::string> params;
+  for (const auto &param : *query_params) {
+    params.push_back(RangeToString(param.first) + "=" +
+                     RangeToString(param.second));
+  }
+  EXPECT_EQ((std::vector<std::string>{"x=1", "y=", "z=3"}), params);
+  const auto z = query_params->find(std::string("z"));
+  ASSERT_NE(query_params->end(), z);
+  EXPECT_EQ("3", RangeToString(z->second));
+  EXPECT_EQ(query_params->end(), query_params->find(std::string("w")));
+
+  // Copies refer to the same input.
+  const CompactUri copy = uri;
+  EXPECT_EQ(uri.host()->begin(), copy.host()->begin());
+  EXPECT_EQ(uri.fragment()->end(), copy.fragment()->end());
+}
+
+TEST(CompactUriTest, ParseRfc3986) {
+  const std::string input = "http://[::1]:80/../x/./y\n";
+  CompactUri uri;
+  ASSERT_TRUE(Parse<::hittop::uri::rfc3986::URI_reference>(
+                  input, MakeRfc3986ParseVisitor(&uri))
+                  .ok());
+  EXPECT_EQ("[::1]", RangeToString(*uri.host()));
+  ASSERT_TRUE(uri.host_address());
+  EXPECT_TRUE(uri.host_address()->is_v6());
+  EXPECT_FALSE(uri.user());
+
+  // Works with the generic URI algorithms.
+  std::string normalized;
+  ::hittop::uri::NormalizeUri(uri, std::back_inserter(normalized));
+  EXPECT_EQ("http://[::1]/x/y", normalized);
+
+  ::hittop::uri::RouteTable<int> routes;
+  routes.add("/../x/*rest", 1);
+  auto match = routes.match(uri);
+  ASSERT_TRUE(match);
+  EXPECT_EQ("./y", RangeToString(match.param(0)));
+}
+
+TEST(CompactUriTest, RelativeWithoutScheme) {
+  const std::string input = "/path?q\n";
+  CompactUri uri;
+  ASSERT_TRUE(Parse<::hittop::uri::grammar::URI_reference>(
+                  input, MakeUriParseVisitor(&uri))
+                  .ok());
+  EXPECT_EQ(input.begin(), uri.begin());
+  EXPECT_FALSE(uri.scheme());
+  EXPECT_FALSE(uri.host());
+  EXPECT_FALSE(uri.port());
+  EXPECT_EQ("/path", RangeToString(*uri.path()));
+  EXPECT_EQ("q", RangeToString(*uri.query()));
+  EXPECT_FALSE(uri.fragment());
+}
+
+TEST(CompactUriTest, AssignRebases) {
+  const std::string input = "xx//host/path";
+  CompactUri uri;
+  // Components are assigned first, as by a parse visitor...
+  uri.assign_host(input.begin() + 4, input.begin() + 8);
+  uri.assign_path(input.begin() + 8, input.end());
+  // ...then a component starting before all of them...
+  uri.assign_scheme(input.begin(), input.begin() + 2);
+  EXPECT_EQ("host", RangeToString(*uri.host()));
+  EXPECT_EQ("xx", RangeToString(*uri.scheme()));
+  uri.reset_scheme();
+  EXPECT_FALSE(uri.scheme());
+  // ...and finally the URI as a whole.
+  uri.assign(input.begin() + 2, input.end());
+  EXPECT_EQ("//host/path", RangeToString(uri));
+  EXPECT_EQ("host", RangeToString(*uri.host()));
+  EXPECT_EQ("/path", RangeToString(*uri.path()));
+  uri.assign_host_address(IpAddress::v4(1));
+  EXPECT_EQ(IpAddress::v4(1), *uri.host_address());
+}
+
+TEST(CompactUriTest, TooLong) {
+  const std::string input(CompactUri::kMaxLength + 2, 'a');
+  CompactUri uri;
+  uri.assign_path(input.begin(), input.begin() + CompactUri::kMaxLength);
+  EXPECT_THROW(uri.assign_path(input.begin(), input.end()), std::length_error);
+  EXPECT_THROW(uri.assign_query(input.end() - 1, input.end()),
+               std::length_error);
+}
+
+} // namespace
@@ -0,0 +1,363 @@
+// A compact alternative to BasicUri for zero-copy parsing.
+//
+// Rather than one boost::optional<iterator_range> per component (plus an
+// arena and containers), CompactUri stores a single base iterator and a
+// (uint16 offset, uint16 length) pair per component, with presence bits, so
+// that a parsed URI fits in one cache line and is trivially copyable.  The
+// accessors mirror BasicUri's, except that they return by value (so bind the
+// result to a local before iterating over it); path segments and query
+// parameters are computed on demand from the path and query instead of being
+// stored.
+//
+// Parse visitors assign the components of a URI before the URI as a whole
+// (see MakeUriParseVisitor), so offsets are first taken relative to the first
+// component assigned, and rebased when assign() supplies the real start.
+// Components must lie within 64K of the start of the URI; otherwise the
+// mutators throw std::length_error.
+//
+#ifndef HITTOP_URI_COMPACT_URI_H
+#define HITTOP_URI_COMPACT_URI_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "boost/iterator/iterator_facade.hpp"
+#include "boost/optional.hpp"
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/uri/ip_address.h"
+
+namespace hittop {
+namespace uri {
+
+// A read-only sequence of the sub-ranges of [first, last) separated by Delim.
+// A leading delimiter is skipped, so "/a/b" and "a/b" both split into "a" and
+// "b", while "/" is a single empty element.
+template <typename Iterator, char Delim> class SplitView {
+public:
+  using value_type = boost::iterator_range<Iterator>;
+
+  class iterator
+      : public boost::iterator_facade<iterator, value_type,
+                                      std::forward_iterator_tag, value_type> {
+  public:
+    iterator() = default;
+
+    iterator(Iterator first, Iterator last)
+        : first_(first), next_(std::find(first, last, Delim)), last_(last),
+          at_end_(false) {}
+
+  private:
+    friend class boost::iterator_core_access;
+
+    value_type dereference() const { return {first_, next_}; }
+
+    bool equal(const iterator &that) const {
+      return at_end_ == that.at_end_ && (at_end_ || first_ == that.first_);
+    }
+
+    void increment() {
+      if (next_ == last_) {
+        at_end_ = true;
+        return;
+      }
+      first_ = std::next(next_);
+      next_ = std::find(first_, last_, Delim);
+    }
+
+    Iterator first_;
+    Iterator next_;
+    Iterator last_;
+    bool at_end_ = true;
+  };
+
+  SplitView(Iterator first, Iterator last) : first_(first), last_(last) {
+    if (first_ != last_ && *first_ == Delim) {
+      ++first_;
+    }
+  }
+
+  iterator begin() const { return iterator(first_, last_); }
+
+  iterator end() const { return iterator(); }
+
+  std::size_t size() const { return std::count(first_, last_, Delim) + 1; }
+
+  value_type operator[](std::size_t index) const {
+    return *std::next(begin(), index);
+  }
+
+private:
+  Iterator first_;
+  Iterator last_;
+};
+
+// A read-only view of the "name=value" pairs of a query string separated by
+// '&'.  A pair without '=' has an empty value.
+template <typename Iterator> class QueryParamView {
+public:
+  using part_type = boost::iterator_range<Iterator>;
+  using value_type = std::pair<part_type, part_type>;
+
+  class iterator
+      : public boost::iterator_facade<iterator, value_type,
+                                      std::forward_iterator_tag, value_type> {
+  public:
+    iterator() = default;
+
+    explicit iterator(typename SplitView<Iterator, '&'>::iterator it)
+        : it_(it) {}
+
+  private:
+    friend class boost::iterator_core_access;
+
+    value_type dereference() const {
+      const part_type param = *it_;
+      const auto eq = std::find(param.begin(), param.end(), '=');
+      return {{param.begin(), eq},
+              {eq == param.end() ? eq : std::next(eq), param.end()}};
+    }
+
+    bool equal(const iterator &that) const { return it_ == that.it_; }
+
+    void increment() { ++it_; }
+
+    typename SplitView<Iterator, '&'>::iterator it_;
+  };
+
+  QueryParamView(Iterator first, Iterator last) : params_(first, last) {}
+
+  iterator begin() const { return iterator(params_.begin()); }
+
+  iterator end() const { return iterator(params_.end()); }
+
+  // Returns the first parameter with the given name, or end().
+  template <typename Range> iterator find(const Range &name) const {
+    return std::find_if(begin(), end(), [&name](const value_type &param) {
+      return std::equal(param.first.begin(), param.first.end(),
+                        std::begin(name), std::end(name));
+    });
+  }
+
+private:
+  SplitView<Iterator, '&'> params_;
+};
+
+namespace internal {
+
+// Stands in for the path segment sequence filled in by parse visitors; the
+// segments of a CompactUri are computed from its path instead.
+template <typename T> struct DiscardingSequence {
+  template <typename... Args> void emplace_back(Args &&...) const {}
+};
+
+} // namespace internal
+
+template <typename Iterator> class CompactUri {
+  static_assert(
+      std::is_base_of<
+          std::random_access_iterator_tag,
+          typename std::iterator_traits<Iterator>::iterator_category>::value,
+      "CompactUri requires random access iterators");
+
+public:
+  using part_type = boost::iterator_range<Iterator>;
+  using sequence_type = internal::DiscardingSequence<part_type>;
+  using segments_type = SplitView<Iterator, '/'>;
+  using query_params_type = QueryParamView<Iterator>;
+
+  // The maximum length of a URI, and the maximum offset of any component.
+  static constexpr std::size_t kMaxLength =
+      std::numeric_limits<std::uint16_t>::max();
+
+  CompactUri() = default;
+
+  void assign(Iterator first, Iterator last) {
+    Rebase(first);
+    length_ = ToOffset(last - base_);
+  }
+
+  Iterator begin() const { return base_; }
+
+  Iterator cbegin() const { return base_; }
+
+  Iterator end() const { return base_ + length_; }
+
+  Iterator cend() const { return base_ + length_; }
+
+  boost::optional<part_type> scheme() const { return Get(kScheme); }
+
+  void assign_scheme(Iterator first, Iterator last) {
+    Set(kScheme, first, last);
+  }
+
+  void reset_scheme() { Reset(kScheme); }
+
+  boost::optional<part_type> user() const { return Get(kUser); }
+
+  void assign_user(Iterator first, Iterator last) { Set(kUser, first, last); }
+
+  void reset_user() { Reset(kUser); }
+
+  boost::optional<part_type> host() const { return Get(kHost); }
+
+  void assign_host(Iterator first, Iterator last) { Set(kHost, first, last); }
+
+  // The binary address of the host, if it is an IP address.
+  boost::optional<IpAddress> host_address() const {
+    if (!Has(kHostAddress)) {
+      return boost::none;
+    }
+    return host_address_;
+  }
+
+  void assign_host_address(const IpAddress &addr) {
+    host_address_ = addr;
+    present_ |= Bit(kHostAddress);
+  }
+
+  boost::optional<unsigned> port() const {
+    if (!Has(kPort)) {
+      return boost::none;
+    }
+    return port_;
+  }
+
+  void assign_port(unsigned p) {
+    port_ = p;
+    present_ |= Bit(kPort);
+  }
+
+  boost::optional<part_type> path() const { return Get(kPath); }
+
+  void assign_path(Iterator first, Iterator last) { Set(kPath, first, last); }
+
+  boost::optional<part_type> query() const { return Get(kQuery); }
+
+  void assign_query(Iterator first, Iterator last) { Set(kQuery, first, last); }
+
+  boost::optional<part_type> fragment() const { return Get(kFragment); }
+
+  void assign_fragment(Iterator first, Iterator last) {
+    Set(kFragment, first, last);
+  }
+
+  boost::optional<segments_type> path_segments() const {
+    if (!Has(kPath)) {
+      return boost::none;
+    }
+    return segments_type(Begin(kPath), End(kPath));
+  }
+
+  // Segments are derived from the path, so anything added here is ignored.
+  sequence_type *mutable_path_segments() {
+    static sequence_type discard;
+    return &discard;
+  }
+
+  boost::optional<query_params_type> query_params() const {
+    if (!Has(kQuery)) {
+      return boost::none;
+    }
+    return query_params_type(Begin(kQuery), End(kQuery));
+  }
+
+private:
+  enum Part : std::uint8_t {
+    kScheme,
+    kUser,
+    kHost,
+    kPath,
+    kQuery,
+    kFragment,
+    kNumParts,
+    kPort = kNumParts,
+    kHostAddress,
+    kBase,
+  };
+
+  struct Span {
+    std::uint16_t offset;
+    std::uint16_t length;
+  };
+
+  static constexpr std::uint16_t Bit(int part) {
+    return static_cast<std::uint16_t>(1u << part);
+  }
+
+  static std::uint16_t ToOffset(std::ptrdiff_t n) {
+    if (n < 0 || static_cast<std::size_t>(n) > kMaxLength) {
+      throw std::length_error("CompactUri component out of range");
+    }
+    return static_cast<std::uint16_t>(n);
+  }
+
+  bool Has(int part) const { return (present_ & Bit(part)) != 0; }
+
+  Iterator Begin(Part part) const { return base_ + spans_[part].offset; }
+
+  Iterator End(Part part) const {
+    return base_ + spans_[part].offset + spans_[part].length;
+  }
+
+  boost::optional<part_type> Get(Part part) const {
+    if (!Has(part)) {
+      return boost::none;
+    }
+    return part_type(Begin(part), End(part));
+  }
+
+  void Set(Part part, Iterator first, Iterator last) {
+    if (!Has(kBase)) {
+      base_ = first;
+      present_ |= Bit(kBase);
+    } else if (first < base_) {
+      Rebase(first);
+    }
+    spans_[part] = {ToOffset(first - base_), ToOffset(last - first)};
+    present_ |= Bit(part);
+  }
+
+  void Reset(Part part) { present_ &= ~Bit(part); }
+
+  // Makes offsets relative to new_base, which must not follow any component.
+  void Rebase(Iterator new_base) {
+    if (Has(kBase)) {
+      const std::ptrdiff_t shift = base_ - new_base;
+      for (int part = 0; part < kNumParts; ++part) {
+        if (Has(part)) {
+          spans_[part].offset = ToOffset(spans_[part].offset + shift);
+        }
+      }
+    }
+    base_ = new_base;
+    present_ |= Bit(kBase);
+  }
+
+  Iterator base_{};
+  Span spans_[kNumParts] = {};
+  std::uint32_t port_ = 0;
+  std::uint16_t length_ = 0;
+  std::uint16_t present_ = 0;
+  IpAddress host_address_;
+};
+
+template <typename Iterator>
+constexpr std::size_t CompactUri<Iterator>::kMaxLength;
+
+// With 64-bit pointers this is exactly 64 bytes: 57 bytes of members (the
+// base pointer 8, the six spans 24, the port 4, the length and presence bits
+// 4, and the host address 17), padded to a multiple of 8.
+static_assert(sizeof(CompactUri<const char *>) <= 64,
+              "CompactUri should fit in a cache line");
+
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_COMPACT_URI_H
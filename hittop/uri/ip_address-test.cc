@@ -0,0 +1,89 @@
+#include "hittop/uri/ip_address.h"
+#include "hittop/uri/ip_address.h"
+
+#include "gtest/gtest.h"
+
+#include <sstream>
+#include <string>
+
+#include "boost/optional.hpp"
+#include "boost/optional/optional_io.hpp"
+
+namespace {
+
+using ::hittop::uri::IpAddress;
+using ::hittop::uri::ParseHostAddress;
+
+boost::optional<IpAddress> V4(const std::string &s) {
+  return ::hittop::uri::ParseIPv4Address(s.begin(), s.end());
+}
+
+boost::optional<IpAddress> V6(const std::string &s) {
+  return ::hittop::uri::ParseIPv6Address(s.begin(), s.end());
+}
+
+std::string ToString(const IpAddress &addr) {
+  std::ostringstream oss;
+  oss << addr;
+  return oss.str();
+}
+
+TEST(IpAddressTest, ParseIPv4) {
+  ASSERT_TRUE(V4("127.0.0.1"));
+  EXPECT_TRUE(V4("127.0.0.1")->is_v4());
+  EXPECT_EQ(0x7f000001u, V4("127.0.0.1")->to_v4());
+  EXPECT_EQ(0xffffffffu, V4("255.255.255.255")->to_v4());
+  EXPECT_EQ(IpAddress::v4(0x0a000102), V4("10.0.1.2").get());
+
+  EXPECT_FALSE(V4(""));
+  EXPECT_FALSE(V4("1.2.3"));
+  EXPECT_FALSE(V4("1.2.3.4."));
+  EXPECT_FALSE(V4("1.2.3.256"));
+  EXPECT_FALSE(V4("1.2.3.04"));
+  EXPECT_FALSE(V4("1.2.3.1000"));
+  EXPECT_FALSE(V4("1.2..3"));
+}
+
+TEST(IpAddressTest, ParseIPv6) {
+  ASSERT_TRUE(V6("::"));
+  EXPECT_TRUE(V6("::")->is_v6());
+  EXPECT_EQ("::", ToString(V6("::").get()));
+  EXPECT_EQ("::1", ToString(V6("::1").get()));
+  EXPECT_EQ("1::", ToString(V6("1::").get()));
+  EXPECT_EQ("2001:db8::ff00:42:8329",
+            ToString(V6("2001:0DB8:0000:0000:0000:ff00:0042:8329").get()));
+  EXPECT_EQ(V6("2001:db8::ff00:42:8329"),
+            V6("2001:0DB8:0000:0000:0000:ff00:0042:8329"));
+  EXPECT_EQ("1:2:3:4:5:6:7:8", ToString(V6("1:2:3:4:5:6:7:8").get()));
+  EXPECT_EQ("1:0:2::3", ToString(V6("1:0:2:0:0:0:0:3").get()));
+
+  const auto mapped = V6("::ffff:192.168.0.1");
+  ASSERT_TRUE(mapped);
+  EXPECT_EQ(0xffff, mapped->group(5));
+  EXPECT_EQ(0xc0a8, mapped->group(6));
+  EXPECT_EQ(0x0001, mapped->group(7));
+  EXPECT_TRUE(V6("1:2:3:4:5:6:1.2.3.4"));
+
+  EXPECT_FALSE(V6(""));
+  EXPECT_FALSE(V6(":"));
+  EXPECT_FALSE(V6(":1"));
+  EXPECT_FALSE(V6("1:2:3:4:5:6:7"));
+  EXPECT_FALSE(V6("1:2:3:4:5:6:7:8:9"));
+  EXPECT_FALSE(V6("1::2:3:4:5:6:7:8"));
+  EXPECT_FALSE(V6("1::2::3"));
+  EXPECT_FALSE(V6("12345::"));
+  EXPECT_FALSE(V6("1:2:3:4:5:6:7:1.2.3.4"));
+  EXPECT_FALSE(V6("::ffff:1.2.3"));
+  EXPECT_FALSE(V6("g::"));
+}
+
+TEST(IpAddressTest, ParseHostAddress) {
+  EXPECT_EQ(V4("1.2.3.4"), ParseHostAddress(std::string("1.2.3.4")));
+  EXPECT_EQ(V6("::1"), ParseHostAddress(std::string("[::1]")));
+  EXPECT_FALSE(ParseHostAddress(std::string("example.com")));
+  EXPECT_FALSE(ParseHostAddress(std::string("[v1.x]")));
+  EXPECT_FALSE(ParseHostAddress(std::string("[::1")));
+  EXPECT_FALSE(ParseHostAddress(std::string("[::1]x")));
+}
+
+} // namespace
@@ -0,0 +1,303 @@
+// Binary IPv4 and IPv6 addresses, and allocation-free parsers for their
+// textual forms as they appear in URIs (RFC 3986, section 3.2.2).
+//
+#ifndef HITTOP_URI_IP_ADDRESS_H
+#define HITTOP_URI_IP_ADDRESS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+
+#include "boost/optional.hpp"
+
+#include "hittop/parser/parser.h"
+#include "hittop/util/hex.h"
+
+namespace hittop {
+namespace uri {
+
+class IpAddress {
+public:
+  enum struct Family : std::uint8_t { V4, V6 };
+
+  using bytes_type = std::array<std::uint8_t, 16>;
+
+  // The IPv4 address 0.0.0.0.
+  IpAddress() : family_(Family::V4), bytes_{} {}
+
+  // Constructs an IPv4 address from its value in host byte order; e.g.,
+  // 127.0.0.1 is 0x7f000001.
+  static IpAddress v4(std::uint32_t value) {
+    IpAddress addr;
+    addr.bytes_[0] = static_cast<std::uint8_t>(value >> 24);
+    addr.bytes_[1] = static_cast<std::uint8_t>(value >> 16);
+    addr.bytes_[2] = static_cast<std::uint8_t>(value >> 8);
+    addr.bytes_[3] = static_cast<std::uint8_t>(value);
+    return addr;
+  }
+
+  // Constructs an IPv6 address from its 16 bytes in network byte order.
+  static IpAddress v6(const bytes_type &bytes) {
+    IpAddress addr;
+    addr.family_ = Family::V6;
+    addr.bytes_ = bytes;
+    return addr;
+  }
+
+  Family family() const { return family_; }
+
+  bool is_v4() const { return family_ == Family::V4; }
+
+  bool is_v6() const { return family_ == Family::V6; }
+
+  // The address in network byte order; size() is 4 for IPv4, 16 for IPv6.
+  const std::uint8_t *data() const { return bytes_.data(); }
+
+  std::size_t size() const { return is_v4() ? 4 : 16; }
+
+  // The value of an IPv4 address in host byte order.
+  std::uint32_t to_v4() const {
+    return (std::uint32_t{bytes_[0]} << 24) | (std::uint32_t{bytes_[1]} << 16) |
+           (std::uint32_t{bytes_[2]} << 8) | std::uint32_t{bytes_[3]};
+  }
+
+  // The 16-bit group of an IPv6 address at the given index (0..7).
+  std::uint16_t group(std::size_t i) const {
+    return static_cast<std::uint16_t>((bytes_[2 * i] << 8) | bytes_[2 * i + 1]);
+  }
+
+  friend bool operator==(const IpAddress &a, const IpAddress &b) {
+    return a.family_ == b.family_ && a.bytes_ == b.bytes_;
+  }
+
+  friend bool operator!=(const IpAddress &a, const IpAddress &b) {
+    return !(a == b);
+  }
+
+private:
+  Family family_;
+  bytes_type bytes_;
+};
+
+// Writes the address in its canonical textual form: dotted-decimal for IPv4,
+// RFC 5952 form (lower case, longest run of zero groups compressed) for IPv6.
+inline std::ostream &operator<<(std::ostream &out, const IpAddress &addr) {
+  if (addr.is_v4()) {
+    return out << int{addr.data()[0]} << '.' << int{addr.data()[1]} << '.'
+               << int{addr.data()[2]} << '.' << int{addr.data()[3]};
+  }
+  std::size_t best_first = 8;
+  std::size_t best_size = 1;
+  for (std::size_t i = 0; i < 8;) {
+    if (addr.group(i) != 0) {
+      ++i;
+      continue;
+    }
+    std::size_t j = i;
+    while (j < 8 && addr.group(j) == 0) {
+      ++j;
+    }
+    if (j - i > best_size) {
+      best_first = i;
+      best_size = j - i;
+    }
+    i = j;
+  }
+  const auto flags = out.flags();
+  out << std::hex;
+  for (std::size_t i = 0; i < 8; ++i) {
+    if (i == best_first) {
+      out << "::";
+      i += best_size - 1;
+      continue;
+    }
+    if (i != 0 && i != best_first + best_size) {
+      out << ':';
+    }
+    out << addr.group(i);
+  }
+  out.flags(flags);
+  return out;
+}
+
+namespace internal {
+
+// The scanners below consume the longest prefix of [first, last) that is a
+// valid address and return the position just past it, or the position of the
+// first offending character with error BAD_CHAR.  They never report
+// INCOMPLETE; callers that need streaming semantics check whether the scan
+// stopped at last.
+
+// IPv4address = dec-octet "." dec-octet "." dec-octet "." dec-octet
+//
+// dec-octet values are 0-255, without leading zeros.  If out is non-null, the
+// address is stored there in network byte order.
+template <typename Iterator>
+parser::ParseResult<Iterator> ScanIPv4Address(Iterator first, Iterator last,
+                                              std::uint8_t *out) {
+  for (int octet = 0; octet < 4; ++octet) {
+    if (octet != 0) {
+      if (first == last || *first != '.') {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+      ++first;
+    }
+    if (first == last || *first < '0' || *first > '9') {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    unsigned value = *first - '0';
+    ++first;
+    for (int digits = 1; first != last && '0' <= *first && *first <= '9';
+         ++digits) {
+      if (digits == 3 || value == 0) {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+      value = value * 10 + (*first - '0');
+      if (value > 255) {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+      ++first;
+    }
+    if (out) {
+      out[octet] = static_cast<std::uint8_t>(value);
+    }
+  }
+  return first;
+}
+
+// IPv6address = 6( h16 ":" ) ls32 / "::" 5( h16 ":" ) ls32 / ...
+//
+// That is, eight 16-bit groups of one to four hex digits separated by ':'; at
+// most one run of zero groups may be elided as "::", and the last two groups
+// may be written as an embedded IPv4 address.  If out is non-null, the address
+// is stored there in network byte order.
+template <typename Iterator>
+parser::ParseResult<Iterator> ScanIPv6Address(Iterator first, Iterator last,
+                                              std::uint8_t *out) {
+  std::uint8_t bytes[16] = {};
+  int size = 0; // bytes parsed so far
+  int gap = -1; // byte offset of the "::", if any
+
+  if (first != last && *first == ':') {
+    ++first;
+    if (first == last || *first != ':') {
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    ++first;
+    gap = 0;
+  }
+  while (size < 16) {
+    const Iterator group_first = first;
+    unsigned value = 0;
+    int digits = 0;
+    for (; digits < 4 && first != last && util::HexDigitValue(*first) >= 0; ++digits) {
+      value = (value << 4) | util::HexDigitValue(*first);
+      ++first;
+    }
+    if (digits == 0) {
+      if (gap == size) {
+        // Nothing after "::".
+        break;
+      }
+      return {first, parser::ParseError::BAD_CHAR};
+    }
+    if (first != last && *first == '.') {
+      // The group was really the beginning of an embedded IPv4 address.
+      if (size > 12) {
+        return {first, parser::ParseError::BAD_CHAR};
+      }
+      auto result = ScanIPv4Address(group_first, last, bytes + size);
+      if (!result.ok()) {
+        return result;
+      }
+      first = result.get();
+      size += 4;
+      break;
+    }
+    bytes[size++] = static_cast<std::uint8_t>(value >> 8);
+    bytes[size++] = static_cast<std::uint8_t>(value);
+    if (size == 16 || first == last || *first != ':') {
+      break;
+    }
+    auto next = std::next(first);
+    if (next != last && *next == ':') {
+      if (gap >= 0) {
+        // Only one "::" is allowed; stop before the second one.
+        break;
+      }
+      gap = size;
+      first = std::next(next);
+    } else {
+      first = next;
+    }
+  }
+  if (gap < 0 ? size != 16 : size > 14) {
+    return {first, parser::ParseError::BAD_CHAR};
+  }
+  if (out) {
+    const int tail = size - std::max(gap, 0);
+    std::fill(out, out + 16, 0);
+    if (gap >= 0) {
+      std::copy(bytes, bytes + gap, out);
+      std::copy(bytes + gap, bytes + size, out + 16 - tail);
+    } else {
+      std::copy(bytes, bytes + 16, out);
+    }
+  }
+  return first;
+}
+
+} // namespace internal
+
+// Parses the whole of [first, last) as a dotted-decimal IPv4 address.
+template <typename Iterator>
+boost::optional<IpAddress> ParseIPv4Address(Iterator first, Iterator last) {
+  IpAddress::bytes_type bytes{};
+  auto result = internal::ScanIPv4Address(first, last, bytes.data());
+  if (!result.ok() || result.get() != last) {
+    return boost::none;
+  }
+  return IpAddress::v4((std::uint32_t{bytes[0]} << 24) |
+                       (std::uint32_t{bytes[1]} << 16) |
+                       (std::uint32_t{bytes[2]} << 8) | bytes[3]);
+}
+
+// Parses the whole of [first, last) as an IPv6 address (without brackets).
+template <typename Iterator>
+boost::optional<IpAddress> ParseIPv6Address(Iterator first, Iterator last) {
+  IpAddress::bytes_type bytes;
+  auto result = internal::ScanIPv6Address(first, last, bytes.data());
+  if (!result.ok() || result.get() != last) {
+    return boost::none;
+  }
+  return IpAddress::v6(bytes);
+}
+
+// Parses the host part of a URI as an IP address: an IPv4 address, or an IPv6
+// address enclosed in brackets.  Returns none if the host is a registered name
+// or an IPvFuture literal.
+template <typename Range>
+boost::optional<IpAddress> ParseHostAddress(const Range &host) {
+  auto first = std::begin(host);
+  auto last = std::end(host);
+  if (first != last && *first == '[') {
+    const auto inner_first = std::next(first);
+    auto inner_last = inner_first;
+    while (inner_last != last && *inner_last != ']') {
+      ++inner_last;
+    }
+    if (inner_last == last || std::next(inner_last) != last) {
+      return boost::none;
+    }
+    return ParseIPv6Address(inner_first, inner_last);
+  }
+  return ParseIPv4Address(first, last);
+}
+
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_IP_ADDRESS_H
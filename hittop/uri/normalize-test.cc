@@ -0,0 +1,142 @@
+#include "hittop/uri/normalize.h"
+#include "hittop/uri/normalize.h"
+
+#include "gtest/gtest.h"
+
+#include <iterator>
+#include <string>
+
+#include "hittop/parser/parser.h"
+#include "hittop/uri/basic_uri.h"
+#include "hittop/uri/grammar.h"
+#include "hittop/uri/uri_parse_visitor.h"
+#include "hittop/util/hash.h"
+
+namespace {
+
+using ::hittop::parser::Parse;
+using ::hittop::uri::HashNormalizedUri;
+using ::hittop::uri::MakeUriParseVisitor;
+using ::hittop::uri::NormalizeUri;
+using ::hittop::uri::Uri;
+using ::hittop::util::StreamingHash64;
+
+class NormalizeUriTest : public ::testing::Test {
+protected:
+  // Parses input (which must be terminated by a character that is not part of
+  // the URI grammar) into uri_.
+  void ParseUri(const std::string &input) {
+    input_ = input;
+    auto result = Parse<::hittop::uri::grammar::URI_reference>(
+        input_, MakeUriParseVisitor(&uri_));
+    ASSERT_TRUE(result.ok());
+  }
+
+  std::string Normalized() const {
+    std::string out;
+    NormalizeUri(uri_, std::back_inserter(out));
+    return out;
+  }
+
+  std::string Normalize(const std::string &input) {
+    Uri uri;
+    auto result = Parse<::hittop::uri::grammar::URI_reference>(
+        input, MakeUriParseVisitor(&uri));
+    EXPECT_TRUE(result.ok()) << input;
+    std::string out;
+    NormalizeUri(uri, std::back_inserter(out));
+    return out;
+  }
+
+  std::string input_;
+  Uri uri_;
+};
+
+TEST_F(NormalizeUriTest, CaseAndDefaultPort) {
+  ParseUri("HTTP://User@Example.COM:80/Path?Q=1#Frag\n");
+  EXPECT_EQ("http://User@example.com/Path?Q=1#Frag", Normalized());
+}
+
+TEST_F(NormalizeUriTest, NonDefaultPortIsKept) {
+  EXPECT_EQ("https://example.com:8443/",
+            Normalize("https://example.com:8443\n"));
+  EXPECT_EQ("https://example.com/", Normalize("https://example.com:443/\n"));
+  EXPECT_EQ("http://example.com:443/", Normalize("http://example.com:443/\n"));
+}
+
+TEST_F(NormalizeUriTest, Escapes) {
+  EXPECT_EQ("http://example.com/~user/a%2Fb?q=%3DA",
+            Normalize("http://example.com/%7euser/a%2fb?q=%3d%41\n"));
+}
+
+TEST_F(NormalizeUriTest, DotSegments) {
+  EXPECT_EQ("http://a/b/c/g", Normalize("http://a/b/c/./g\n"));
+  EXPECT_EQ("http://a/b/g", Normalize("http://a/b/c/../g\n"));
+  EXPECT_EQ("http://a/g", Normalize("http://a/b/c/../../../g\n"));
+  EXPECT_EQ("http://a/b/", Normalize("http://a/b/c/..\n"));
+  EXPECT_EQ("http://a/b/c/", Normalize("http://a/b/c/.\n"));
+  EXPECT_EQ("http://a/", Normalize("http://a/..\n"));
+  EXPECT_EQ("http://a/b//c", Normalize("http://a/b//c\n"));
+  EXPECT_EQ("http://a/b/", Normalize("http://a/b/c/%2E%2e\n"));
+  EXPECT_EQ("http://a/b/..c/.d", Normalize("http://a/b/..c/.d\n"));
+  EXPECT_EQ("/mid/6", Normalize("/mid/content=5/../6\n"));
+}
+
+TEST_F(NormalizeUriTest, EquivalentUrisHaveEqualHashes) {
+  Uri a;
+  Uri b;
+  Uri c;
+  const std::string input_a = "HTTP://Example.com:80/a/./b/../c/%7Eu?x=1\n";
+  const std::string input_b = "http://example.com/a/c/~u?x=1\n";
+  const std::string input_c = "http://example.com/a/c/~u?x=2\n";
+  ASSERT_TRUE(Parse<::hittop::uri::grammar::URI_reference>(
+                  input_a, MakeUriParseVisitor(&a))
+                  .ok());
+  ASSERT_TRUE(Parse<::hittop::uri::grammar::URI_reference>(
+                  input_b, MakeUriParseVisitor(&b))
+                  .ok());
+  ASSERT_TRUE(Parse<::hittop::uri::grammar::URI_reference>(
+                  input_c, MakeUriParseVisitor(&c))
+                  .ok());
+  EXPECT_EQ(HashNormalizedUri(a), HashNormalizedUri(b));
+  EXPECT_NE(HashNormalizedUri(a), HashNormalizedUri(c));
+  EXPECT_NE(HashNormalizedUri(a), HashNormalizedUri(a, /*seed=*/1));
+
+  // The streaming hash must agree with hashing the materialized form.
+  const std::string normalized = "http://example.com/a/c/~u?x=1";
+  StreamingHash64 hash;
+  hash.update(normalized.data(), normalized.size());
+  EXPECT_EQ(hash.digest(), HashNormalizedUri(a));
+}
+
+TEST_F(NormalizeUriTest, FixedSizeBuffer) {
+  ParseUri("http://example.com/abc\n");
+  char buffer[64];
+  auto result = NormalizeUri(uri_, buffer, sizeof(buffer));
+  EXPECT_FALSE(result.error());
+  EXPECT_EQ("http://example.com/abc", std::string(buffer, result.get()));
+
+  auto truncated = NormalizeUri(uri_, buffer, 10);
+  EXPECT_TRUE(truncated.error());
+  EXPECT_EQ(result.get(), truncated.get());
+  EXPECT_EQ("http://exa", std::string(buffer, 10));
+}
+
+TEST(StreamingHash64Test, SplitInvariance) {
+  const std::string data = "The quick brown fox jumps over the lazy dog";
+  StreamingHash64 whole;
+  whole.update(data.data(), data.size());
+  for (std::size_t split = 0; split <= data.size(); ++split) {
+    StreamingHash64 parts;
+    for (std::size_t i = 0; i < split; ++i) {
+      parts(data[i]);
+    }
+    parts.update(data.data() + split, data.size() - split);
+    EXPECT_EQ(whole.digest(), parts.digest()) << split;
+  }
+  StreamingHash64 shorter;
+  shorter.update(data.data(), data.size() - 1);
+  EXPECT_NE(whole.digest(), shorter.digest());
+}
+
+} // namespace
@@ -0,0 +1,325 @@
+// Syntax-based URI normalization (RFC 3986, section 6.2.2) for use as cache and
+// rate-limiter keys.
+//
+// The canonical form is generated in a single pass directly from the parts of a
+// parsed URI (BasicUri or anything with the same accessors); it can be written
+// into caller-owned storage or fed straight into a StreamingHash64, so looking
+// up a key requires no allocation.  The following rules are applied:
+//
+//  - scheme and host are lower-cased
+//  - percent-encoded unreserved characters are decoded; the hex digits of all
+//    other percent-encodings are upper-cased
+//  - "." and ".." path segments are removed
+//  - the port is dropped when it is the default port for the scheme
+//  - an empty path with an authority becomes "/"
+//
+#ifndef HITTOP_URI_NORMALIZE_H
+#define HITTOP_URI_NORMALIZE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <system_error>
+
+#include "hittop/util/fallible.h"
+#include "hittop/util/hash.h"
+#include "hittop/util/hex.h"
+
+namespace hittop {
+namespace uri {
+
+namespace internal {
+
+inline bool IsUnreservedChar(int ch) {
+  return ('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z') ||
+         ('0' <= ch && ch <= '9') || ch == '-' || ch == '.' || ch == '_' ||
+         ch == '~';
+}
+
+inline char ToLowerAscii(char ch) {
+  return ('A' <= ch && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+// Writes [first, last) to sink, normalizing percent-encodings along the way.
+// If lower_case is true, ASCII letters (including decoded ones) are lowered.
+template <typename Iterator, typename Sink>
+void EmitNormalizedEscapes(Iterator first, Iterator last, bool lower_case,
+                           Sink &sink) {
+  static const char kHexDigits[] = "0123456789ABCDEF";
+  while (first != last) {
+    const char ch = *first;
+    ++first;
+    if (ch != '%') {
+      sink(lower_case ? ToLowerAscii(ch) : ch);
+      continue;
+    }
+    // Malformed escapes (not followed by two hex digits) are passed through
+    // unchanged.
+    if (first == last) {
+      sink(ch);
+      break;
+    }
+    const auto hi_pos = first;
+    const int hi = util::HexDigitValue(*first);
+    ++first;
+    if (hi < 0 || first == last || util::HexDigitValue(*first) < 0) {
+      sink(ch);
+      first = hi_pos;
+      continue;
+    }
+    const int lo = util::HexDigitValue(*first);
+    ++first;
+    const char decoded = static_cast<char>((hi << 4) | lo);
+    if (IsUnreservedChar(decoded)) {
+      sink(lower_case ? ToLowerAscii(decoded) : decoded);
+    } else {
+      sink('%');
+      sink(kHexDigits[hi]);
+      sink(kHexDigits[lo]);
+    }
+  }
+}
+
+enum struct SegmentKind { kNormal, kDot, kDotDot };
+
+// Returns the next character of a path segment with a percent-encoded '.'
+// decoded, advancing first past it.
+template <typename Iterator>
+char NextSegmentChar(Iterator &first, const Iterator &last) {
+  const char ch = *first;
+  ++first;
+  if (ch == '%' && first != last && *first == '2') {
+    auto next = std::next(first);
+    if (next != last && (*next == 'e' || *next == 'E')) {
+      first = std::next(next);
+      return '.';
+    }
+  }
+  return ch;
+}
+
+template <typename Iterator>
+SegmentKind ClassifySegment(Iterator first, const Iterator &last) {
+  if (first == last || NextSegmentChar(first, last) != '.') {
+    return SegmentKind::kNormal;
+  }
+  if (first == last) {
+    return SegmentKind::kDot;
+  }
+  if (NextSegmentChar(first, last) != '.' || first != last) {
+    return SegmentKind::kNormal;
+  }
+  return SegmentKind::kDotDot;
+}
+
+// Returns true iff the segment ending at seg_end is not removed by a ".."
+// segment later in the path.
+template <typename Iterator>
+bool SegmentSurvives(Iterator seg_end, const Iterator &last) {
+  int depth = 0;
+  while (seg_end != last) {
+    const auto seg = std::next(seg_end);
+    seg_end = std::find(seg, last, '/');
+    switch (ClassifySegment(seg, seg_end)) {
+    case SegmentKind::kNormal:
+      ++depth;
+      break;
+    case SegmentKind::kDot:
+      break;
+    case SegmentKind::kDotDot:
+      if (depth == 0) {
+        return false;
+      }
+      --depth;
+      break;
+    }
+  }
+  return true;
+}
+
+// Writes the path [first, last) to sink with dot-segments removed (RFC 3986,
+// section 5.2.4) and percent-encodings normalized.  Paths without ".."
+// segments are written in a single pass; otherwise, each segment is checked
+// against the rest of the path to see whether it is removed.
+template <typename Iterator, typename Sink>
+void EmitNormalizedPath(Iterator first, const Iterator &last, Sink &sink) {
+  const bool absolute = (first != last && *first == '/');
+  if (absolute) {
+    ++first;
+  }
+  bool has_dot_dot = false;
+  for (auto seg = first;;) {
+    const auto seg_end = std::find(seg, last, '/');
+    if (ClassifySegment(seg, seg_end) == SegmentKind::kDotDot) {
+      has_dot_dot = true;
+      break;
+    }
+    if (seg_end == last) {
+      break;
+    }
+    seg = std::next(seg_end);
+  }
+
+  bool emitted_any = false;
+  bool last_was_dot = false;
+  for (auto seg = first;;) {
+    const auto seg_end = std::find(seg, last, '/');
+    if (ClassifySegment(seg, seg_end) == SegmentKind::kNormal) {
+      if (!has_dot_dot || SegmentSurvives(seg_end, last)) {
+        if (absolute || emitted_any) {
+          sink('/');
+        }
+        EmitNormalizedEscapes(seg, seg_end, false, sink);
+        emitted_any = true;
+      }
+      last_was_dot = false;
+    } else {
+      last_was_dot = true;
+    }
+    if (seg_end == last) {
+      break;
+    }
+    seg = std::next(seg_end);
+  }
+  // A path ending in a dot-segment keeps its trailing slash ("/a/b/.." is
+  // "/a/"); an absolute path never becomes empty.
+  if ((last_was_dot && emitted_any) || (absolute && !emitted_any)) {
+    sink('/');
+  }
+}
+
+template <typename Range>
+bool EqualsIgnoreCase(const Range &range, const char *lower_case_str) {
+  auto first = std::begin(range);
+  const auto last = std::end(range);
+  for (; first != last && *lower_case_str; ++first, ++lower_case_str) {
+    if (ToLowerAscii(*first) != *lower_case_str) {
+      return false;
+    }
+  }
+  return first == last && !*lower_case_str;
+}
+
+} // namespace internal
+
+// Returns the port number implied by the given scheme, or 0 if unknown.
+template <typename Range> unsigned DefaultPortForScheme(const Range &scheme) {
+  if (internal::EqualsIgnoreCase(scheme, "http") ||
+      internal::EqualsIgnoreCase(scheme, "ws")) {
+    return 80;
+  }
+  if (internal::EqualsIgnoreCase(scheme, "https") ||
+      internal::EqualsIgnoreCase(scheme, "wss")) {
+    return 443;
+  }
+  if (internal::EqualsIgnoreCase(scheme, "ftp")) {
+    return 21;
+  }
+  return 0;
+}
+
+// Passes each character of the normalized form of uri to sink, which must be
+// callable as sink(char).  Uri may be a BasicUri or a CompactUri.
+template <typename Uri, typename Sink>
+void EmitNormalizedUri(const Uri &uri, Sink &sink) {
+  // Accessors may return by value (e.g., CompactUri), so parts are bound to a
+  // local before iterating over them.
+  const auto &scheme = uri.scheme();
+  if (scheme) {
+    for (const char ch : scheme.get()) {
+      sink(internal::ToLowerAscii(ch));
+    }
+    sink(':');
+  }
+  if (uri.host()) {
+    sink('/');
+    sink('/');
+    if (uri.user()) {
+      internal::EmitNormalizedEscapes(std::begin(uri.user().get()),
+                                      std::end(uri.user().get()), false, sink);
+      sink('@');
+    }
+    internal::EmitNormalizedEscapes(std::begin(uri.host().get()),
+                                    std::end(uri.host().get()), true, sink);
+    if (uri.port() &&
+        (!scheme || uri.port().get() != DefaultPortForScheme(scheme.get()))) {
+      char digits[10];
+      char *first = std::end(digits);
+      unsigned port = uri.port().get();
+      do {
+        *--first = static_cast<char>('0' + port % 10);
+        port /= 10;
+      } while (port != 0);
+      sink(':');
+      for (; first != std::end(digits); ++first) {
+        sink(*first);
+      }
+    }
+  }
+  if (uri.path() &&
+      std::begin(uri.path().get()) != std::end(uri.path().get())) {
+    internal::EmitNormalizedPath(std::begin(uri.path().get()),
+                                 std::end(uri.path().get()), sink);
+  } else if (uri.host()) {
+    sink('/');
+  }
+  if (uri.query()) {
+    sink('?');
+    internal::EmitNormalizedEscapes(std::begin(uri.query().get()),
+                                    std::end(uri.query().get()), false, sink);
+  }
+  if (uri.fragment()) {
+    sink('#');
+    internal::EmitNormalizedEscapes(std::begin(uri.fragment().get()),
+                                    std::end(uri.fragment().get()), false,
+                                    sink);
+  }
+}
+
+// Writes the normalized form of uri to out, which may be a plain char* or e.g.
+// a back_inserter into an arena-allocated string.  Returns the output iterator
+// one past the last character written.
+template <typename Uri, typename OutputIterator>
+OutputIterator NormalizeUri(const Uri &uri, OutputIterator out) {
+  auto sink = [&out](char ch) {
+    *out = ch;
+    ++out;
+  };
+  EmitNormalizedUri(uri, sink);
+  return out;
+}
+
+// Writes the normalized form of uri into the given buffer, truncating it if it
+// does not fit.  Returns the full length of the normalized form; the error is
+// set to no_buffer_space if the output was truncated.
+template <typename Uri>
+util::Fallible<std::size_t> NormalizeUri(const Uri &uri, char *buffer,
+                                         std::size_t buffer_size) {
+  std::size_t length = 0;
+  auto sink = [&](char ch) {
+    if (length < buffer_size) {
+      buffer[length] = ch;
+    }
+    ++length;
+  };
+  EmitNormalizedUri(uri, sink);
+  if (length > buffer_size) {
+    return {length, std::make_error_condition(std::errc::no_buffer_space)};
+  }
+  return length;
+}
+
+// Returns the 64-bit StreamingHash64 digest of the normalized form of uri,
+// without materializing it.
+template <typename Uri>
+std::uint64_t HashNormalizedUri(const Uri &uri, std::uint64_t seed = 0) {
+  util::StreamingHash64 hash{seed};
+  EmitNormalizedUri(uri, hash);
+  return hash.digest();
+}
+
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_NORMALIZE_H
@@ -1,8 +1,10 @@
 #include "hittop/uri/uri_parse_visitor.h"
-#include "hittop/uri/uri_parse_visitor.h"
 
 #include "gtest/gtest.h"
 
+#include <stdexcept>
+#include <string>
+
 #include "hittop/parser/parser.h"
 #include "hittop/uri/basic_uri.h"
 #include "hittop/uri/grammar.h"
@@ -37,4 +39,21 @@ TEST_F(UriParseVisitorTest, Example1) {
   EXPECT_FALSE(uri.query());
 }
 
+TEST_F(UriParseVisitorTest, PortRange) {
+  Uri uri;
+  auto result = Parse<::hittop::uri::grammar::URI_reference>(
+      std::string("http://h:65535/\n"), MakeUriParseVisitor(&uri));
+  EXPECT_TRUE(result.ok());
+  ASSERT_FALSE(!uri.port());
+  EXPECT_EQ(uri.port().get(), 65535u);
+
+  for (const char *input : {"http://h:65536/\n", "http://h:99999999999/\n"}) {
+    Uri out_of_range;
+    EXPECT_THROW(Parse<::hittop::uri::grammar::URI_reference>(
+                     std::string(input), MakeUriParseVisitor(&out_of_range)),
+                 std::out_of_range)
+        << input;
+  }
+}
+
 } // namespace
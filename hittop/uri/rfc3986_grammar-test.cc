@@ -0,0 +1,91 @@
+#include "hittop/uri/rfc3986_grammar.h"
+#include "hittop/uri/rfc3986_grammar.h"
+
+#include "gtest/gtest.h"
+
+#include <iterator>
+#include <string>
+
+#include "hittop/parser/parser.h"
+
+using ::hittop::parser::Parse;
+using ::hittop::parser::ParseError;
+
+namespace uri = ::hittop::uri::rfc3986;
+
+namespace {
+
+// Returns true iff Rule accepts all of input up to (not including) the final
+// character, which must be a delimiter the rule does not accept.
+template <typename Rule> bool AcceptsAll(const std::string &input) {
+  auto result = Parse<Rule>(input);
+  return result.ok() && result.get() == std::prev(input.end());
+}
+
+TEST(Rfc3986GrammarTest, DecOctet) {
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("0/"));
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("9/"));
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("42/"));
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("199/"));
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("249/"));
+  EXPECT_TRUE(AcceptsAll<uri::dec_octet>("255/"));
+  EXPECT_FALSE(AcceptsAll<uri::dec_octet>("256/"));
+  EXPECT_FALSE(AcceptsAll<uri::dec_octet>("01/"));
+}
+
+TEST(Rfc3986GrammarTest, IPv4address) {
+  EXPECT_TRUE(AcceptsAll<uri::IPv4address>("192.168.0.1/"));
+  EXPECT_TRUE(AcceptsAll<uri::IPv4address>("0.0.0.0/"));
+  EXPECT_FALSE(AcceptsAll<uri::IPv4address>("192.168.0/"));
+  EXPECT_FALSE(AcceptsAll<uri::IPv4address>("192.168.0.256/"));
+}
+
+TEST(Rfc3986GrammarTest, IPv6address) {
+  EXPECT_TRUE(AcceptsAll<uri::IPv6address>("::]"));
+  EXPECT_TRUE(AcceptsAll<uri::IPv6address>("::1]"));
+  EXPECT_TRUE(AcceptsAll<uri::IPv6address>("fe80::1:2]"));
+  EXPECT_TRUE(AcceptsAll<uri::IPv6address>("1:2:3:4:5:6:7:8]"));
+  EXPECT_TRUE(AcceptsAll<uri::IPv6address>("::ffff:10.0.0.1]"));
+  EXPECT_FALSE(AcceptsAll<uri::IPv6address>("1:2:3]"));
+  EXPECT_FALSE(AcceptsAll<uri::IPv6address>("1::2::3]"));
+  EXPECT_FALSE(AcceptsAll<uri::IPv6address>("v1.x]"));
+
+  // Running out of input is never an outright failure.
+  EXPECT_EQ(ParseError::INCOMPLETE, Parse<uri::IPv6address>("::1").error());
+  EXPECT_EQ(ParseError::INCOMPLETE, Parse<uri::IPv6address>("1:2:").error());
+  EXPECT_EQ(ParseError::BAD_CHAR, Parse<uri::IPv6address>("1:2:x").error());
+}
+
+TEST(Rfc3986GrammarTest, Host) {
+  EXPECT_TRUE(AcceptsAll<uri::host>("[::1]:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("[v7.fe80::a+en1]:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("10.0.0.1:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("10.0.0.1.example.com:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("10.0.0.256:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("example.com:"));
+  EXPECT_TRUE(AcceptsAll<uri::host>("ex%41mple.com:"));
+  EXPECT_FALSE(AcceptsAll<uri::host>("[::1:"));
+}
+
+TEST(Rfc3986GrammarTest, UriReference) {
+  for (const char *input : {
+           "http://[2001:db8::7]:8080/c=GB?objectClass?one#frag\n",
+           "ftp://ftp.is.co.za/rfc/rfc1808.txt\n",
+           "ldap://[2001:db8::7]/c=GB?objectClass?one\n",
+           "mailto:John.Doe@example.com\n",
+           "news:comp.infosystems.www.servers.unix\n",
+           "tel:+1-816-555-1212\n",
+           "telnet://192.0.2.16:80/\n",
+           "urn:oasis:names:specification:docbook:dtd:xml:4.1.2\n",
+           "//example.com/path\n",
+           "/absolute/path\n",
+           "relative/path\n",
+           "?query\n",
+           "#fragment\n",
+           "\n",
+       }) {
+    EXPECT_TRUE(AcceptsAll<uri::URI_reference>(input)) << input;
+  }
+}
+
+} // namespace
@@ -0,0 +1,352 @@
+// Uniform Resource Identifier (URI): Generic Syntax grammar as defined by RFC
+// 3986:
+//  https://www.ietf.org/rfc/rfc3986.txt
+//
+// Unlike the RFC 2396 grammar in grammar.h, this accepts IP-literal hosts
+// (bracketed IPv6 addresses and IPvFuture) and the RFC 3986 path rules.  Rule
+// names follow the RFC, with '-' replaced by '_'.
+//
+// The ABNF in the RFC relies on backtracking in two places that a PEG parser
+// cannot express directly:
+//
+//  - IPv6address enumerates every position of the "::" elision; it is
+//    implemented by a hand-written Parser specialization instead.
+//  - host = IP-literal / IPv4address / reg-name, where "1.2.3.4.example" is a
+//    reg-name; the IPv4address alternative is only taken when the address is
+//    not followed by another reg-name character (see IPv4host).
+//
+#ifndef HITTOP_URI_RFC3986_GRAMMAR_H
+#define HITTOP_URI_RFC3986_GRAMMAR_H
+
+#include <cctype>
+#include <iterator>
+
+#include "hittop/parser/at_least.h"
+#include "hittop/parser/char_filter.h"
+#include "hittop/parser/concat.h"
+#include "hittop/parser/either.h"
+#include "hittop/parser/forward_ref.h"
+#include "hittop/parser/literal.h"
+#include "hittop/parser/opt.h"
+#include "hittop/parser/parser.h"
+#include "hittop/parser/repeat.h"
+#include "hittop/parser/success.h"
+#include "hittop/parser/unless.h"
+
+#include "hittop/uri/ip_address.h"
+
+namespace hittop {
+namespace uri {
+namespace rfc3986 {
+
+// IPv6address; see the Parser specialization below.
+struct IPv6address {};
+
+} // namespace rfc3986
+} // namespace uri
+
+namespace parser {
+
+template <> class Parser<uri::rfc3986::IPv6address> {
+public:
+  template <typename Range, typename... Args>
+  auto operator()(const Range &input, Args &&...) const
+      -> ParseResult<decltype(std::begin(input))> {
+    const auto last = std::end(input);
+    auto result =
+        uri::internal::ScanIPv6Address(std::begin(input), last, nullptr);
+    // The scan stops at the end of the input either because the address is
+    // cut short or because more groups might follow; either way, we can't
+    // tell yet.
+    if (result.get() == last) {
+      return {result.consume(), ParseError::INCOMPLETE};
+    }
+    return result;
+  }
+};
+
+} // namespace parser
+
+namespace uri {
+namespace rfc3986 {
+
+// standard char classes
+using ALPHA = parser::CharFilter<&std::isalpha>;
+using DIGIT = parser::CharFilter<&std::isdigit>;
+using HEXDIG = parser::CharFilter<&std::isxdigit>;
+
+// pct-encoded   = "%" HEXDIG HEXDIG
+//
+using pct_encoded = parser::Concat<parser::Literal<'%'>, HEXDIG, HEXDIG>;
+
+// unreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~"
+//
+using unreserved =
+    parser::Either<ALPHA, DIGIT, parser::Literal<'-'>, parser::Literal<'.'>,
+                   parser::Literal<'_'>, parser::Literal<'~'>>;
+
+// gen-delims    = ":" / "/" / "?" / "#" / "[" / "]" / "@"
+//
+using gen_delims =
+    parser::Either<parser::Literal<':'>, parser::Literal<'/'>,
+                   parser::Literal<'?'>, parser::Literal<'#'>,
+                   parser::Literal<'['>, parser::Literal<']'>,
+                   parser::Literal<'@'>>;
+
+// sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
+//               / "*" / "+" / "," / ";" / "="
+//
+using sub_delims = parser::Either<
+    parser::Literal<'!'>, parser::Literal<'$'>, parser::Literal<'&'>,
+    parser::Literal<'\''>, parser::Literal<'('>, parser::Literal<')'>,
+    parser::Literal<'*'>, parser::Literal<'+'>, parser::Literal<','>,
+    parser::Literal<';'>, parser::Literal<'='>>;
+
+// reserved      = gen-delims / sub-delims
+//
+using reserved = parser::Either<gen_delims, sub_delims>;
+
+// pchar         = unreserved / pct-encoded / sub-delims / ":" / "@"
+//
+using pchar = parser::Either<unreserved, pct_encoded, sub_delims,
+                             parser::Literal<':'>, parser::Literal<'@'>>;
+
+// scheme        = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+//
+DEF_PARSE_RULE(scheme,
+               (parser::Concat<
+                   ALPHA, parser::Repeat<parser::Either<
+                              ALPHA, DIGIT, parser::Literal<'+'>,
+                              parser::Literal<'-'>, parser::Literal<'.'>>>>));
+
+// scheme_colon  = scheme ":"
+//
+// Not part of the RFC; lets a visitor discard the scheme if what looked like
+// one turns out to be the first segment of a relative reference.
+using scheme_colon = parser::Concat<scheme, parser::Literal<':'>>;
+
+// userinfo      = *( unreserved / pct-encoded / sub-delims / ":" )
+//
+DEF_PARSE_RULE(userinfo,
+               (parser::Repeat<parser::Either<unreserved, pct_encoded,
+                                              sub_delims,
+                                              parser::Literal<':'>>>));
+
+// userinfo_at   = userinfo "@"
+//
+using userinfo_at = parser::Concat<userinfo, parser::Literal<'@'>>;
+
+// IPvFuture     = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
+//
+using IPvFuture = parser::Concat<
+    parser::Either<parser::Literal<'v'>, parser::Literal<'V'>>,
+    parser::AtLeast<1, HEXDIG>, parser::Literal<'.'>,
+    parser::AtLeast<1, parser::Either<unreserved, sub_delims,
+                                      parser::Literal<':'>>>>;
+
+// IP-literal    = "[" ( IPv6address / IPvFuture  ) "]"
+//
+DEF_PARSE_RULE(IP_literal,
+               (parser::Concat<parser::Literal<'['>,
+                               parser::Either<IPv6address, IPvFuture>,
+                               parser::Literal<']'>>));
+
+// dec-octet     = DIGIT                 ; 0-9
+//               / %x31-39 DIGIT         ; 10-99
+//               / "1" 2DIGIT            ; 100-199
+//               / "2" %x30-34 DIGIT     ; 200-249
+//               / "25" %x30-35          ; 250-255
+//
+// The alternatives are tried longest first, as PEG choice is ordered.
+//
+using digit_0_5 =
+    parser::Either<parser::Literal<'0'>, parser::Literal<'1'>,
+                   parser::Literal<'2'>, parser::Literal<'3'>,
+                   parser::Literal<'4'>, parser::Literal<'5'>>;
+
+using digit_1_9 = parser::Unless<parser::Literal<'0'>, DIGIT>;
+
+using dec_octet =
+    parser::Either<parser::Concat<parser::Literal<'2', '5'>, digit_0_5>,
+                   parser::Concat<parser::Literal<'2'>,
+                                  parser::Unless<parser::Literal<'5'>,
+                                                 digit_0_5>,
+                                  DIGIT>,
+                   parser::Concat<parser::Literal<'1'>, DIGIT, DIGIT>,
+                   parser::Concat<digit_1_9, DIGIT>, DIGIT>;
+
+// IPv4address   = dec-octet "." dec-octet "." dec-octet "." dec-octet
+//
+DEF_PARSE_RULE(IPv4address,
+               (parser::Concat<dec_octet, parser::Literal<'.'>, dec_octet,
+                               parser::Literal<'.'>, dec_octet,
+                               parser::Literal<'.'>, dec_octet>));
+
+// reg-name      = *( unreserved / pct-encoded / sub-delims )
+//
+using reg_name_char = parser::Either<unreserved, pct_encoded, sub_delims>;
+
+DEF_PARSE_RULE(reg_name, (parser::Repeat<reg_name_char>));
+
+// IPv4host      = IPv4address, not followed by a reg-name character
+//
+DEF_PARSE_RULE(IPv4host,
+               (parser::Concat<IPv4address,
+                               parser::Unless<reg_name_char,
+                                              parser::Success>>));
+
+// host          = IP-literal / IPv4address / reg-name
+//
+DEF_PARSE_RULE(host, (parser::Either<IP_literal, IPv4host, reg_name>));
+
+// port          = *DIGIT
+//
+DEF_PARSE_RULE(port, (parser::Repeat<DIGIT>));
+
+// authority     = [ userinfo "@" ] host [ ":" port ]
+//
+using authority =
+    parser::Concat<parser::Opt<userinfo_at>, host,
+                   parser::Opt<parser::Concat<parser::Literal<':'>, port>>>;
+
+// segment       = *pchar
+//
+DEF_PARSE_RULE(segment, (parser::Repeat<pchar>));
+
+// segment-nz    = 1*pchar
+//
+DEF_PARSE_RULE(segment_nz, (parser::AtLeast<1, pchar>));
+
+// segment-nz-nc = 1*( unreserved / pct-encoded / sub-delims / "@" )
+//               ; non-zero-length segment without any colon ":"
+//
+DEF_PARSE_RULE(segment_nz_nc,
+               (parser::AtLeast<1, parser::Either<unreserved, pct_encoded,
+                                                  sub_delims,
+                                                  parser::Literal<'@'>>>));
+
+using slash_segments =
+    parser::Repeat<parser::Concat<parser::Literal<'/'>, segment>>;
+
+// path-abempty  = *( "/" segment )
+//
+DEF_PARSE_RULE(path_abempty, (slash_segments));
+
+// path-absolute = "/" [ segment-nz *( "/" segment ) ]
+//
+DEF_PARSE_RULE(path_absolute,
+               (parser::Concat<parser::Literal<'/'>,
+                               parser::Opt<parser::Concat<segment_nz,
+                                                          slash_segments>>>));
+
+// path-noscheme = segment-nz-nc *( "/" segment )
+//
+DEF_PARSE_RULE(path_noscheme, (parser::Concat<segment_nz_nc, slash_segments>));
+
+// path-rootless = segment-nz *( "/" segment )
+//
+DEF_PARSE_RULE(path_rootless, (parser::Concat<segment_nz, slash_segments>));
+
+// path-empty    = 0<pchar>
+//
+using path_empty = parser::Success;
+
+// query         = *( pchar / "/" / "?" )
+//
+DEF_PARSE_RULE(query,
+               (parser::Repeat<parser::Either<pchar, parser::Literal<'/'>,
+                                              parser::Literal<'?'>>>));
+
+// fragment      = *( pchar / "/" / "?" )
+//
+DEF_PARSE_RULE(fragment,
+               (parser::Repeat<parser::Either<pchar, parser::Literal<'/'>,
+                                              parser::Literal<'?'>>>));
+
+using opt_query = parser::Opt<parser::Concat<parser::Literal<'?'>, query>>;
+
+using opt_fragment =
+    parser::Opt<parser::Concat<parser::Literal<'#'>, fragment>>;
+
+// hier-part     = "//" authority path-abempty
+//               / path-absolute
+//               / path-rootless
+//               / path-empty
+//
+using hier_part =
+    parser::Either<parser::Concat<parser::Literal<'/', '/'>, authority,
+                                  path_abempty>,
+                   path_absolute, path_rootless, path_empty>;
+
+// URI           = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+//
+using URI = parser::Concat<scheme_colon, hier_part, opt_query, opt_fragment>;
+
+// absolute-URI  = scheme ":" hier-part [ "?" query ]
+//
+using absolute_URI = parser::Concat<scheme_colon, hier_part, opt_query>;
+
+// relative-part = "//" authority path-abempty
+//               / path-absolute
+//               / path-noscheme
+//               / path-empty
+//
+using relative_part =
+    parser::Either<parser::Concat<parser::Literal<'/', '/'>, authority,
+                                  path_abempty>,
+                   path_absolute, path_noscheme, path_empty>;
+
+// relative-ref  = relative-part [ "?" query ] [ "#" fragment ]
+//
+using relative_ref = parser::Concat<relative_part, opt_query, opt_fragment>;
+
+// URI-reference = URI / relative-ref
+//
+DEF_PARSE_RULE(URI_reference, (parser::Either<URI, relative_ref>));
+
+template <typename Map> void RegisterRuleNames(Map &names) {
+  REGISTER_PARSE_RULE(ALPHA);
+  REGISTER_PARSE_RULE(DIGIT);
+  REGISTER_PARSE_RULE(HEXDIG);
+  REGISTER_PARSE_RULE(pct_encoded);
+  REGISTER_PARSE_RULE(unreserved);
+  REGISTER_PARSE_RULE(gen_delims);
+  REGISTER_PARSE_RULE(sub_delims);
+  REGISTER_PARSE_RULE(reserved);
+  REGISTER_PARSE_RULE(pchar);
+  REGISTER_PARSE_RULE(scheme);
+  REGISTER_PARSE_RULE(scheme_colon);
+  REGISTER_PARSE_RULE(userinfo);
+  REGISTER_PARSE_RULE(userinfo_at);
+  REGISTER_PARSE_RULE(IPv6address);
+  REGISTER_PARSE_RULE(IPvFuture);
+  REGISTER_PARSE_RULE(IP_literal);
+  REGISTER_PARSE_RULE(dec_octet);
+  REGISTER_PARSE_RULE(IPv4address);
+  REGISTER_PARSE_RULE(reg_name);
+  REGISTER_PARSE_RULE(IPv4host);
+  REGISTER_PARSE_RULE(host);
+  REGISTER_PARSE_RULE(port);
+  REGISTER_PARSE_RULE(authority);
+  REGISTER_PARSE_RULE(segment);
+  REGISTER_PARSE_RULE(segment_nz);
+  REGISTER_PARSE_RULE(segment_nz_nc);
+  REGISTER_PARSE_RULE(path_abempty);
+  REGISTER_PARSE_RULE(path_absolute);
+  REGISTER_PARSE_RULE(path_noscheme);
+  REGISTER_PARSE_RULE(path_rootless);
+  REGISTER_PARSE_RULE(query);
+  REGISTER_PARSE_RULE(fragment);
+  REGISTER_PARSE_RULE(hier_part);
+  REGISTER_PARSE_RULE(URI);
+  REGISTER_PARSE_RULE(absolute_URI);
+  REGISTER_PARSE_RULE(relative_part);
+  REGISTER_PARSE_RULE(relative_ref);
+  REGISTER_PARSE_RULE(URI_reference);
+}
+
+} // namespace rfc3986
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_RFC3986_GRAMMAR_H
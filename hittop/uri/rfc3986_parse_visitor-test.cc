@@ -0,0 +1,126 @@
+#include "hittop/uri/rfc3986_parse_visitor.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "hittop/parser/parser.h"
+#include "hittop/uri/basic_uri.h"
+#include "hittop/uri/ip_address.h"
+#include "hittop/uri/rfc3986_grammar.h"
+#include "hittop/util/range_to_string.h"
+
+namespace {
+
+using ::hittop::parser::Parse;
+using ::hittop::uri::IpAddress;
+using ::hittop::uri::MakeRfc3986ParseVisitor;
+using ::hittop::uri::Rfc3986FieldParseVisitor;
+using ::hittop::uri::Uri;
+using ::hittop::util::RangeToString;
+
+namespace rfc3986 = ::hittop::uri::rfc3986;
+
+class Rfc3986ParseVisitorTest : public ::testing::Test {
+protected:
+  void ParseUri(const std::string &input) {
+    input_ = input;
+    auto result = Parse<rfc3986::URI_reference>(input_,
+                                                MakeRfc3986ParseVisitor(&uri_));
+    ASSERT_TRUE(result.ok());
+    ASSERT_EQ(std::prev(input_.end()), result.get());
+  }
+
+  std::string input_;
+  Uri uri_;
+};
+
+TEST_F(Rfc3986ParseVisitorTest, PortRange) {
+  ParseUri("http://h:65535/\n");
+  ASSERT_TRUE(uri_.port());
+  EXPECT_EQ(65535u, uri_.port().get());
+  EXPECT_THROW(ParseUri("http://h:65536/\n"), std::out_of_range);
+  EXPECT_THROW(ParseUri("http://h:99999999999/\n"), std::out_of_range);
+}
+
+TEST_F(Rfc3986ParseVisitorTest, IPv6Literal) {
+  ParseUri("https://user@[2001:DB8::1]:8443/a/b?x=1#top\n");
+  ASSERT_TRUE(uri_.scheme());
+  EXPECT_EQ("https", uri_.scheme().get());
+  ASSERT_TRUE(uri_.user());
+  EXPECT_EQ("user", uri_.user().get());
+  ASSERT_TRUE(uri_.host());
+  EXPECT_EQ("[2001:DB8::1]", uri_.host().get());
+  ASSERT_TRUE(uri_.host_address());
+  EXPECT_TRUE(uri_.host_address()->is_v6());
+  EXPECT_EQ(0x2001, uri_.host_address()->group(0));
+  EXPECT_EQ(0x0db8, uri_.host_address()->group(1));
+  EXPECT_EQ(0x0001, uri_.host_address()->group(7));
+  ASSERT_TRUE(uri_.port());
+  EXPECT_EQ(8443u, uri_.port().get());
+  ASSERT_TRUE(uri_.path());
+  EXPECT_EQ("/a/b", uri_.path().get());
+  ASSERT_TRUE(uri_.path_segments());
+  ASSERT_EQ(2u, uri_.path_segments()->size());
+  EXPECT_EQ("a", RangeToString((*uri_.path_segments())[0]));
+  EXPECT_EQ("b", RangeToString((*uri_.path_segments())[1]));
+  ASSERT_TRUE(uri_.query());
+  EXPECT_EQ("x=1", uri_.query().get());
+  ASSERT_TRUE(uri_.fragment());
+  EXPECT_EQ("top", uri_.fragment().get());
+}
+
+TEST_F(Rfc3986ParseVisitorTest, IPv4Host) {
+  ParseUri("http://10.1.2.3/\n");
+  ASSERT_TRUE(uri_.host_address());
+  EXPECT_EQ(IpAddress::v4(0x0a010203), uri_.host_address().get());
+  EXPECT_FALSE(uri_.port());
+}
+
+TEST_F(Rfc3986ParseVisitorTest, RegisteredNames) {
+  ParseUri("http://10.1.2.3.example.com/\n");
+  EXPECT_EQ("10.1.2.3.example.com", uri_.host().get());
+  EXPECT_FALSE(uri_.host_address());
+
+  Uri future;
+  const std::string input = "http://[v1.foo]/\n";
+  ASSERT_TRUE(
+      Parse<rfc3986::URI_reference>(input, MakeRfc3986ParseVisitor(&future))
+          .ok());
+  EXPECT_EQ("[v1.foo]", future.host().get());
+  EXPECT_FALSE(future.host_address());
+}
+
+TEST_F(Rfc3986ParseVisitorTest, EmptyPort) {
+  ParseUri("http://example.com:/\n");
+  EXPECT_EQ("example.com", uri_.host().get());
+  EXPECT_FALSE(uri_.port());
+}
+
+TEST_F(Rfc3986ParseVisitorTest, RelativeReference) {
+  // "foo" looks like the start of a scheme until the '/'.
+  ParseUri("foo/bar?q\n");
+  EXPECT_FALSE(uri_.scheme());
+  EXPECT_FALSE(uri_.host());
+  ASSERT_TRUE(uri_.path());
+  EXPECT_EQ("foo/bar", uri_.path().get());
+  EXPECT_EQ(2u, uri_.path_segments()->size());
+  EXPECT_EQ("q", uri_.query().get());
+}
+
+TEST_F(Rfc3986ParseVisitorTest, HostHeader) {
+  // A Host header value is an authority without userinfo.
+  const std::string input = "[::1]:8080\r\n";
+  Uri uri;
+  auto result = Parse<rfc3986::authority>(
+      input, Rfc3986FieldParseVisitor<Uri>{&uri});
+  ASSERT_TRUE(result.ok());
+  EXPECT_EQ("[::1]", uri.host().get());
+  ASSERT_TRUE(uri.host_address());
+  EXPECT_EQ(IpAddress::v6({{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1}}),
+            uri.host_address().get());
+  EXPECT_EQ(8080u, uri.port().get());
+}
+
+} // namespace
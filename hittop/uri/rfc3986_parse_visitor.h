@@ -0,0 +1,170 @@
+// Parse visitor that fills in a BasicUri (or anything with the same mutators)
+// from the RFC 3986 grammar in rfc3986_grammar.h.
+//
+// In addition to the sub-ranges filled in by UriFieldParseVisitor, this stores
+// the host as a binary address (assign_host_address) when it is an IPv4
+// address or a bracketed IPv6 address.  The port is parsed with
+// util::ParseDecimal; an empty port (e.g., "http://host:/") leaves the port
+// unset, and one above 65535 throws std::out_of_range, as with
+// UriFieldParseVisitor.  Nothing is allocated beyond what the Uri itself
+// allocates.
+//
+#ifndef HITTOP_URI_RFC3986_PARSE_VISITOR_H
+#define HITTOP_URI_RFC3986_PARSE_VISITOR_H
+
+#include <iterator>
+#include <utility>
+
+#include "boost/optional.hpp"
+
+#include "hittop/uri/ip_address.h"
+#include "hittop/uri/rfc3986_grammar.h"
+#include "hittop/uri/uri_parse_visitor.h"
+#include "hittop/util/first_match.h"
+
+namespace hittop {
+namespace uri {
+
+template <typename Uri> class Rfc3986FieldParseVisitor {
+public:
+  explicit Rfc3986FieldParseVisitor(Uri *uri) : uri_(uri) {}
+
+  template <typename F>
+  void operator()(rfc3986::scheme_colon, F &&run_parser) const {
+    auto result = run_parser([this](rfc3986::scheme, auto &&run_parser) {
+      auto result = run_parser();
+      if (result.ok()) {
+        uri_->assign_scheme(std::begin(result.get()), std::end(result.get()));
+      }
+    });
+    if (!result.ok()) {
+      uri_->reset_scheme();
+    }
+  }
+
+  template <typename F>
+  void operator()(rfc3986::userinfo_at, F &&run_parser) const {
+    auto result = run_parser([this](rfc3986::userinfo, auto &&run_parser) {
+      auto result = run_parser();
+      if (result.ok()) {
+        uri_->assign_user(std::begin(result.get()), std::end(result.get()));
+      }
+    });
+    if (!result.ok()) {
+      uri_->reset_user();
+    }
+  }
+
+  template <typename F>
+  void operator()(rfc3986::host, F &&run_parser) const {
+    boost::optional<IpAddress> address;
+    auto result = run_parser(util::FirstMatchRef(
+        [&address](rfc3986::IPv4host, auto &&run_parser) {
+          auto result = run_parser();
+          if (result.ok()) {
+            address = ParseIPv4Address(std::begin(result.get()),
+                                       std::end(result.get()));
+          }
+        },
+        [&address](rfc3986::IP_literal, auto &&run_parser) {
+          auto result = run_parser();
+          if (result.ok()) {
+            // IPvFuture literals have no binary form and are left as none.
+            address = ParseHostAddress(result.get());
+          }
+        }));
+    if (result.ok()) {
+      uri_->assign_host(std::begin(result.get()), std::end(result.get()));
+      if (address) {
+        uri_->assign_host_address(*address);
+      }
+    }
+  }
+
+  template <typename F>
+  void operator()(rfc3986::port, F &&run_parser) const {
+    auto result = run_parser();
+    unsigned port;
+    if (result.ok() && internal::ParsePort(std::begin(result.get()),
+                                           std::end(result.get()), &port)) {
+      uri_->assign_port(port);
+    }
+  }
+
+  template <typename F>
+  void operator()(rfc3986::path_abempty, F &&run_parser) const {
+    visit_path(std::forward<F>(run_parser));
+  }
+
+  template <typename F>
+  void operator()(rfc3986::path_absolute, F &&run_parser) const {
+    visit_path(std::forward<F>(run_parser));
+  }
+
+  template <typename F>
+  void operator()(rfc3986::path_noscheme, F &&run_parser) const {
+    visit_path(std::forward<F>(run_parser));
+  }
+
+  template <typename F>
+  void operator()(rfc3986::path_rootless, F &&run_parser) const {
+    visit_path(std::forward<F>(run_parser));
+  }
+
+  template <typename F>
+  void operator()(rfc3986::query, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      uri_->assign_query(std::begin(result.get()), std::end(result.get()));
+    }
+  }
+
+  template <typename F>
+  void operator()(rfc3986::fragment, F &&run_parser) const {
+    auto result = run_parser();
+    if (result.ok()) {
+      uri_->assign_fragment(std::begin(result.get()), std::end(result.get()));
+    }
+  }
+
+private:
+  // Only non-empty paths are assigned, as with the RFC 2396 grammar, where an
+  // authority need not be followed by a path.
+  template <typename F> void visit_path(F &&run_parser) const {
+    typename Uri::sequence_type *segments = uri_->mutable_path_segments();
+    auto visit_segment = [segments](auto &&run_parser) {
+      auto result = run_parser();
+      if (result.ok()) {
+        segments->emplace_back(std::begin(result.get()),
+                               std::end(result.get()));
+      }
+    };
+    auto result = run_parser(util::FirstMatchRef(
+        [&](rfc3986::segment, auto &&run_parser) { visit_segment(run_parser); },
+        [&](rfc3986::segment_nz, auto &&run_parser) {
+          visit_segment(run_parser);
+        },
+        [&](rfc3986::segment_nz_nc, auto &&run_parser) {
+          visit_segment(run_parser);
+        }));
+    if (result.ok() && std::begin(result.get()) != std::end(result.get())) {
+      uri_->assign_path(std::begin(result.get()), std::end(result.get()));
+    }
+  }
+
+  Uri *uri_;
+};
+
+template <typename T> auto MakeRfc3986ParseVisitor(T *uri) {
+  return [uri](rfc3986::URI_reference, auto &&run_parser) {
+    auto result = run_parser(Rfc3986FieldParseVisitor<T>{uri});
+    if (result.ok()) {
+      uri->assign(std::begin(result.get()), std::end(result.get()));
+    }
+  };
+}
+
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_RFC3986_PARSE_VISITOR_H
@@ -0,0 +1,142 @@
+#include "hittop/uri/route_table.h"
+#include "hittop/uri/route_table.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "hittop/parser/parser.h"
+#include "hittop/uri/basic_uri.h"
+#include "hittop/uri/grammar.h"
+#include "hittop/uri/uri_parse_visitor.h"
+#include "hittop/util/range_to_string.h"
+
+namespace {
+
+using ::hittop::parser::Parse;
+using ::hittop::uri::MakeUriParseVisitor;
+using ::hittop::uri::RouteTable;
+using ::hittop::uri::Uri;
+using ::hittop::util::RangeToString;
+
+class RouteTableTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    routes_.add("/", 0);
+    routes_.add("/users", 1);
+    routes_.add("/users/new", 2);
+    routes_.add("/users/:id", 3);
+    routes_.add("/users/:id/posts/:post", 4);
+    routes_.add("/static/*file", 5);
+    routes_.add("/users/:id/files/*path", 6);
+    routes_.add("/users/admin/files/x", 7);
+  }
+
+  int MatchValue(const std::string &path) const {
+    auto match = routes_.match_path(path);
+    return match ? match.value() : -1;
+  }
+
+  RouteTable<int> routes_;
+};
+
+TEST_F(RouteTableTest, Literals) {
+  EXPECT_EQ(8u, routes_.size());
+  EXPECT_EQ(0, MatchValue("/"));
+  EXPECT_EQ(1, MatchValue("/users"));
+  EXPECT_EQ(2, MatchValue("/users/new"));
+  EXPECT_EQ(-1, MatchValue(""));
+  EXPECT_EQ(-1, MatchValue("users"));
+  EXPECT_EQ(-1, MatchValue("/user"));
+  EXPECT_EQ(-1, MatchValue("/users/"));
+  EXPECT_EQ(-1, MatchValue("/nowhere"));
+}
+
+TEST_F(RouteTableTest, Captures) {
+  const std::string path = "/users/42/posts/hello-world";
+  auto match = routes_.match_path(path);
+  ASSERT_TRUE(match);
+  EXPECT_EQ(4, match.value());
+  EXPECT_EQ("/users/:id/posts/:post", match.route().pattern);
+  ASSERT_EQ(2u, match.param_count());
+  EXPECT_EQ("42", RangeToString(match.param(0)));
+  EXPECT_EQ("hello-world", RangeToString(match.param("post").get()));
+  EXPECT_FALSE(match.param("missing"));
+
+  // Captures are sub-ranges of the input, not copies.
+  EXPECT_EQ(path.begin() + 7, match.param(0).begin());
+
+  EXPECT_EQ(3, MatchValue("/users/newer"));
+  EXPECT_EQ(-1, MatchValue("/users/42/posts"));
+  EXPECT_EQ(-1, MatchValue("/users/42/posts/"));
+}
+
+TEST_F(RouteTableTest, Wildcards) {
+  const std::string path = "/static/css/site.css";
+  auto match = routes_.match_path(path);
+  ASSERT_TRUE(match);
+  EXPECT_EQ(5, match.value());
+  EXPECT_EQ("css/site.css", RangeToString(match.param("file").get()));
+
+  EXPECT_EQ(5, MatchValue("/static/"));
+  EXPECT_EQ(-1, MatchValue("/static"));
+}
+
+TEST_F(RouteTableTest, BacktracksToLessSpecificRoutes) {
+  // "admin" first follows the literal branch, which has no wildcard, then
+  // falls back to the ":id" capture.
+  const std::string path = "/users/admin/files/a/b";
+  auto match = routes_.match_path(path);
+  ASSERT_TRUE(match);
+  EXPECT_EQ(6, match.value());
+  ASSERT_EQ(2u, match.param_count());
+  EXPECT_EQ("admin", RangeToString(match.param("id").get()));
+  EXPECT_EQ("a/b", RangeToString(match.param("path").get()));
+
+  EXPECT_EQ(7, MatchValue("/users/admin/files/x"));
+}
+
+TEST_F(RouteTableTest, MatchParsedUri) {
+  const std::string input = "http://example.com/users/7/posts/9?x=1\n";
+  Uri uri;
+  ASSERT_TRUE(Parse<::hittop::uri::grammar::URI_reference>(
+                  input, MakeUriParseVisitor(&uri))
+                  .ok());
+  auto match = routes_.match(uri);
+  ASSERT_TRUE(match);
+  EXPECT_EQ(4, match.value());
+  EXPECT_EQ("9", RangeToString(match.param("post").get()));
+
+  Uri no_path;
+  EXPECT_FALSE(routes_.match(no_path));
+}
+
+TEST(RouteTableAddTest, InvalidPatterns) {
+  RouteTable<int> routes;
+  routes.add("/a/:b", 1);
+  EXPECT_THROW(routes.add("", 0), std::invalid_argument);
+  EXPECT_THROW(routes.add("a/b", 0), std::invalid_argument);
+  EXPECT_THROW(routes.add("/a/:", 0), std::invalid_argument);
+  EXPECT_THROW(routes.add("/a/*rest/b", 0), std::invalid_argument);
+  EXPECT_THROW(routes.add("/a/:b", 2), std::invalid_argument);
+  // Capture names do not distinguish patterns.
+  EXPECT_THROW(routes.add("/a/:c", 2), std::invalid_argument);
+  EXPECT_EQ(1u, routes.size());
+}
+
+// Adding many children grows the node array many times over; each new child
+// must still be linked to the right node.
+TEST(RouteTableAddTest, ManyLiteralChildren) {
+  RouteTable<int> routes;
+  for (int i = 0; i < 200; ++i) {
+    routes.add("/n" + std::to_string(i) + "/leaf", i);
+  }
+  for (int i = 0; i < 200; ++i) {
+    auto match = routes.match_path("/n" + std::to_string(i) + "/leaf");
+    ASSERT_TRUE(match);
+    EXPECT_EQ(i, match.value());
+  }
+}
+
+} // namespace
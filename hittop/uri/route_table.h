@@ -0,0 +1,240 @@
+// A table of URI path patterns, compiled into a trie of path segments.
+//
+// Patterns are absolute paths ("/users/:id/posts/*rest") whose segments are
+// one of:
+//
+//   literal   - matches one path segment exactly (no percent-decoding)
+//   :name     - matches any single non-empty segment, captured as "name"
+//   *name     - last segment only; matches the rest of the path, including
+//               any further '/' characters, captured as "name"
+//
+// Each trie node holds a container::Trie of its literal child segments, so a
+// segment is dispatched in O(segment length) regardless of how many routes
+// share the node.  At every node, literal segments are preferred over
+// captures, which are preferred over wildcards; the matcher only falls back to
+// the next alternative when the preferred one fails to match the rest of the
+// path, so matching is linear in the path length unless patterns overlap.
+//
+#ifndef HITTOP_URI_ROUTE_TABLE_H
+#define HITTOP_URI_ROUTE_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boost/container/static_vector.hpp"
+#include "boost/optional.hpp"
+#include "boost/range/iterator_range.hpp"
+
+#include "hittop/container/trie.h"
+
+namespace hittop {
+namespace uri {
+
+template <typename Value> class RouteTable {
+public:
+  // The maximum number of captures (":name" and "*name") in one pattern.
+  static constexpr std::size_t kMaxParams = 16;
+
+  struct Route {
+    std::string pattern;
+    std::vector<std::string> param_names;
+    Value value;
+  };
+
+  // The result of matching a path against the table.  Captured parameters are
+  // sub-ranges of the matched path, in the order they appear in the pattern.
+  template <typename Iterator> class Match {
+  public:
+    using param_type = boost::iterator_range<Iterator>;
+
+    explicit operator bool() const { return route_ != nullptr; }
+
+    const Route &route() const { return *route_; }
+
+    const Value &value() const { return route_->value; }
+
+    std::size_t param_count() const { return params_.size(); }
+
+    const param_type &param(std::size_t index) const { return params_[index]; }
+
+    boost::optional<param_type> param(const std::string &name) const {
+      const auto &names = route_->param_names;
+      const auto found = std::find(names.begin(), names.end(), name);
+      if (found == names.end()) {
+        return boost::none;
+      }
+      return params_[found - names.begin()];
+    }
+
+  private:
+    friend class RouteTable;
+
+    const Route *route_ = nullptr;
+    boost::container::static_vector<param_type, kMaxParams> params_;
+  };
+
+  RouteTable() : nodes_(1) {}
+
+  std::size_t size() const { return routes_.size(); }
+
+  // Adds a route to the table.  Throws std::invalid_argument if the pattern is
+  // malformed or there is already a route with an equivalent pattern.
+  void add(const std::string &pattern, Value value) {
+    if (pattern.empty() || pattern[0] != '/') {
+      throw std::invalid_argument("route pattern must begin with '/': " +
+                                  pattern);
+    }
+    Route route{pattern, {}, std::move(value)};
+    std::size_t node = 0;
+    std::size_t *terminal = nullptr;
+    auto seg = std::next(pattern.begin());
+    for (;;) {
+      const auto seg_end = std::find(seg, pattern.end(), '/');
+      const bool last_segment = (seg_end == pattern.end());
+      if (seg != seg_end && (*seg == ':' || *seg == '*')) {
+        if (seg + 1 == seg_end) {
+          throw std::invalid_argument("unnamed capture in route pattern: " +
+                                      pattern);
+        }
+        if (route.param_names.size() == kMaxParams) {
+          throw std::invalid_argument("too many captures in route pattern: " +
+                                      pattern);
+        }
+        route.param_names.emplace_back(seg + 1, seg_end);
+      }
+      if (seg != seg_end && *seg == '*') {
+        if (!last_segment) {
+          throw std::invalid_argument(
+              "wildcard must be the last segment of route pattern: " +
+              pattern);
+        }
+        terminal = &nodes_[node].wildcard_route;
+        break;
+      }
+      node = ChildFor(node, seg, seg_end);
+      if (last_segment) {
+        terminal = &nodes_[node].route;
+        break;
+      }
+      seg = std::next(seg_end);
+    }
+    if (*terminal != kNone) {
+      throw std::invalid_argument("duplicate route pattern: " + pattern);
+    }
+    *terminal = routes_.size();
+    routes_.emplace_back(std::move(route));
+  }
+
+  // Matches an absolute path (without query or fragment).
+  template <typename Range>
+  auto match_path(const Range &path) const
+      -> Match<decltype(std::begin(path))> {
+    Match<decltype(std::begin(path))> result;
+    auto first = std::begin(path);
+    const auto last = std::end(path);
+    if (first != last && *first == '/') {
+      result.route_ =
+          MatchNode(nodes_[0], std::next(first), last, &result.params_);
+    }
+    return result;
+  }
+
+  // Matches the path of a parsed URI (BasicUri or compatible).
+  template <typename Uri>
+  auto match(const Uri &uri) const
+      -> decltype(this->match_path(uri.path().get())) {
+    if (!uri.path()) {
+      return {};
+    }
+    return match_path(uri.path().get());
+  }
+
+private:
+  static constexpr std::size_t kNone = ~std::size_t{0};
+
+  struct Node {
+    container::Trie<char, std::size_t> literal_children;
+    std::size_t param_child = kNone;
+    std::size_t route = kNone;
+    std::size_t wildcard_route = kNone;
+  };
+
+  // Returns the index of the child of nodes_[node] for the pattern segment
+  // [seg, seg_end), creating it if necessary.
+  template <typename Iterator>
+  std::size_t ChildFor(std::size_t node, Iterator seg, Iterator seg_end) {
+    const std::size_t new_index = nodes_.size();
+    if (seg != seg_end && *seg == ':') {
+      if (nodes_[node].param_child == kNone) {
+        nodes_[node].param_child = new_index;
+        nodes_.emplace_back();
+      }
+      return nodes_[node].param_child;
+    }
+    auto inserted =
+        nodes_[node].literal_children.insert(seg, seg_end, new_index);
+    // Read the index before emplace_back, which may move the map it is in.
+    const std::size_t child = *inserted.first;
+    if (inserted.second) {
+      nodes_.emplace_back();
+    }
+    return child;
+  }
+
+  // Matches the path segments beginning at seg against the sub-trie rooted at
+  // node, appending captures to params.
+  template <typename Iterator, typename Params>
+  const Route *MatchNode(const Node &node, Iterator seg, const Iterator &last,
+                         Params *params) const {
+    const Iterator seg_end = std::find(seg, last, '/');
+    const bool last_segment = (seg_end == last);
+    const Iterator next = last_segment ? last : std::next(seg_end);
+
+    if (const std::size_t *child = node.literal_children.find(seg, seg_end)) {
+      if (const Route *route =
+              MatchChild(nodes_[*child], last_segment, next, last, params)) {
+        return route;
+      }
+    }
+    if (node.param_child != kNone && seg != seg_end) {
+      params->emplace_back(seg, seg_end);
+      if (const Route *route = MatchChild(nodes_[node.param_child],
+                                          last_segment, next, last, params)) {
+        return route;
+      }
+      params->pop_back();
+    }
+    if (node.wildcard_route != kNone) {
+      params->emplace_back(seg, last);
+      return &routes_[node.wildcard_route];
+    }
+    return nullptr;
+  }
+
+  template <typename Iterator, typename Params>
+  const Route *MatchChild(const Node &child, bool last_segment,
+                          const Iterator &next, const Iterator &last,
+                          Params *params) const {
+    if (last_segment) {
+      return child.route == kNone ? nullptr : &routes_[child.route];
+    }
+    return MatchNode(child, next, last, params);
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<Route> routes_;
+};
+
+template <typename Value> constexpr std::size_t RouteTable<Value>::kMaxParams;
+
+template <typename Value> constexpr std::size_t RouteTable<Value>::kNone;
+
+} // namespace uri
+} // namespace hittop
+
+#endif // HITTOP_URI_ROUTE_TABLE_H
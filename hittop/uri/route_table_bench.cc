@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "boost/lexical_cast.hpp"
+
+#include "hittop/uri/route_table.h"
+
+namespace {
+
+// Generates count distinct route patterns shaped like a typical REST API:
+// "/api/v<n>/<resource>/:id/<sub-resource>" and friends.
+std::vector<std::string> MakePatterns(std::size_t count, std::mt19937 *rng) {
+  static const char *const kWords[] = {
+      "users",    "posts",  "comments", "photos", "albums", "orders",
+      "invoices", "items",  "carts",    "tags",   "events", "sessions",
+      "settings", "groups", "members",  "files"};
+  constexpr std::size_t kNumWords = sizeof(kWords) / sizeof(kWords[0]);
+  std::uniform_int_distribution<std::size_t> word(0, kNumWords - 1);
+  std::uniform_int_distribution<int> shape(0, 3);
+
+  std::vector<std::string> patterns;
+  for (std::size_t i = 0; patterns.size() < count; ++i) {
+    std::string pattern = "/api/v" + std::to_string(i % 100) + "/" +
+                          kWords[word(*rng)] + std::to_string(i / 100);
+    switch (shape(*rng)) {
+    case 0:
+      break;
+    case 1:
+      pattern += "/:id";
+      break;
+    case 2:
+      pattern += std::string("/:id/") + kWords[word(*rng)];
+      break;
+    case 3:
+      pattern += "/*rest";
+      break;
+    }
+    patterns.push_back(std::move(pattern));
+  }
+  return patterns;
+}
+
+// Turns a pattern into a concrete path that it matches.
+std::string MakePath(const std::string &pattern) {
+  std::string path;
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    if (pattern[i] == ':') {
+      path += "12345";
+      while (i + 1 < pattern.size() && pattern[i + 1] != '/') {
+        ++i;
+      }
+    } else if (pattern[i] == '*') {
+      path += "a/b/c.txt";
+      break;
+    } else {
+      path += pattern[i];
+    }
+  }
+  return path;
+}
+
+int RunBenchmark(std::size_t num_routes, unsigned count) {
+  std::mt19937 rng(num_routes);
+  const std::vector<std::string> patterns = MakePatterns(num_routes, &rng);
+  hittop::uri::RouteTable<std::size_t> routes;
+  for (std::size_t i = 0; i < patterns.size(); ++i) {
+    routes.add(patterns[i], i);
+  }
+  std::vector<std::string> paths;
+  std::vector<std::size_t> expected;
+  std::uniform_int_distribution<std::size_t> pick(0, patterns.size() - 1);
+  for (unsigned i = 0; i < 1024; ++i) {
+    expected.push_back(pick(rng));
+    paths.push_back(MakePath(patterns[expected.back()]));
+  }
+
+  std::cout << "routes: " << num_routes << std::endl;
+  for (int j = 0; j < 10; ++j) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned i = 0; i < count; ++i) {
+      const std::size_t k = i % paths.size();
+      auto match = routes.match_path(paths[k]);
+      if (!match || match.value() != expected[k]) {
+        std::cerr << "Fail! " << paths[k] << std::endl;
+        return 1;
+      }
+    }
+    auto stop = std::chrono::high_resolution_clock::now();
+    double usec =
+        std::chrono::duration_cast<std::chrono::microseconds>(stop - start)
+            .count();
+    std::cout << "Ok "
+              << "total: " << usec << "usec "
+              << "mps: " << static_cast<double>(count) * 1000.0 * 1000.0 / usec
+              << " "
+              << "usec/m: " << usec / static_cast<double>(count) << std::endl;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " TIMES_TO_MATCH" << std::endl;
+    return 1;
+  }
+  const unsigned count = boost::lexical_cast<unsigned>(argv[1]);
+  for (std::size_t num_routes : {1000, 10000}) {
+    if (RunBenchmark(num_routes, count) != 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -1,15 +1,33 @@
 #ifndef HITTOP_URI_URI_PARSE_VISITOR_H
 #define HITTOP_URI_URI_PARSE_VISITOR_H
 
-#include <string>
-
-#include "hittop/util/range_to_string.h"
+#include <iterator>
+#include <stdexcept>
 
 #include "hittop/uri/grammar.h"
+#include "hittop/util/swar.h"
 
 namespace hittop {
 namespace uri {
 
+namespace internal {
+
+// Parses the digits of a port into *port.  Returns false if there are none;
+// throws std::out_of_range if the port is above 65535, since dropping it would
+// make the URI refer to the default port instead.
+template <typename Iterator>
+bool ParsePort(Iterator first, Iterator last, unsigned *port) {
+  if (first == last) {
+    return false;
+  }
+  if (!util::ParseDecimal(first, last, port) || *port > 65535) {
+    throw std::out_of_range("URI port out of range");
+  }
+  return true;
+}
+
+} // namespace internal
+
 template <typename Uri> class UriFieldParseVisitor {
 public:
   explicit UriFieldParseVisitor(Uri *uri) : uri_(uri) {}
@@ -43,8 +61,10 @@ public:
 
   template <typename F> void operator()(grammar::port, F &&run_parser) const {
     auto result = run_parser();
-    if (result.ok()) {
-      uri_->assign_port(std::stoul(util::RangeToString(result.get())));
+    unsigned port;
+    if (result.ok() && internal::ParsePort(std::begin(result.get()),
+                                           std::end(result.get()), &port)) {
+      uri_->assign_port(port);
     }
   }
 
@@ -0,0 +1,49 @@
+// Timing and reporting shared by the benchmarks.
+//
+#ifndef HITTOP_UTIL_BENCH_UTIL_H
+#define HITTOP_UTIL_BENCH_UTIL_H
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+namespace hittop {
+namespace util {
+namespace bench {
+
+// Returns the time in microseconds that f takes to run once.
+template <typename F> double TimeUsec(F &&f) {
+  auto start = std::chrono::high_resolution_clock::now();
+  f();
+  auto stop = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(stop - start)
+      .count();
+}
+
+// Returns the time in microseconds that f takes to run count times.
+template <typename F> double TimeUsec(unsigned count, F &&f) {
+  return TimeUsec([count, &f]() {
+    for (unsigned i = 0; i < count; ++i) {
+      f();
+    }
+  });
+}
+
+// Prints the total and per-run time of count runs that took usec in all and,
+// if each run processed size bytes, the throughput.
+inline void Report(const std::string &name, double usec, unsigned count,
+                   std::size_t size = 0) {
+  std::cout << "Ok " << name << " total: " << usec << "usec "
+            << "usec/run: " << usec / count;
+  if (size != 0) {
+    std::cout << " MB/s: " << size * static_cast<double>(count) / usec;
+  }
+  std::cout << std::endl;
+}
+
+} // namespace bench
+} // namespace util
+} // namespace hittop
+
+#endif // HITTOP_UTIL_BENCH_UTIL_H
@@ -0,0 +1,47 @@
+// Searching a character range for the first of a small set of bytes.
+//
+// With SSE2, sixteen bytes are compared against every byte of the set at once,
+// so long runs that contain none of them are skipped quickly.
+//
+#ifndef HITTOP_UTIL_FIND_ANY_OF_H
+#define HITTOP_UTIL_FIND_ANY_OF_H
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hittop {
+namespace util {
+
+// Returns the first position in [first, last) whose byte equals any of Chars,
+// or last if there is none.
+template <char... Chars>
+inline const char *FindAnyOf(const char *first, const char *last) {
+#if defined(__SSE2__)
+  for (; last - first >= 16; first += 16) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+    __m128i match = _mm_setzero_si128();
+    for (char ch : {Chars...}) {
+      match = _mm_or_si128(match, _mm_cmpeq_epi8(v, _mm_set1_epi8(ch)));
+    }
+    const int mask = _mm_movemask_epi8(match);
+    if (mask != 0) {
+      return first + __builtin_ctz(mask);
+    }
+  }
+#endif // defined(__SSE2__)
+  for (; first != last; ++first) {
+    for (char ch : {Chars...}) {
+      if (*first == ch) {
+        return first;
+      }
+    }
+  }
+  return last;
+}
+
+} // namespace util
+} // namespace hittop
+
+#endif // HITTOP_UTIL_FIND_ANY_OF_H
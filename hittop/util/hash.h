@@ -1,6 +1,9 @@
 #ifndef HITTOP_UTIL_HASH_H
 #define HITTOP_UTIL_HASH_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iterator>
 #include <numeric>
@@ -21,6 +24,96 @@ template <typename Range> struct RangeHash {
   }
 };
 
+// Incremental 64-bit hash of a byte sequence.  Bytes may be fed one at a time
+// or in blocks of any size; the digest depends only on the sequence of bytes,
+// not on how it was split up.  This makes it possible to hash a value that is
+// generated on the fly (e.g., a normalized URI) without materializing it.
+//
+// Bytes are packed little-endian into 64-bit words which are mixed into the
+// state MurmurHash3-style; the final partial word and the total length are
+// folded in by digest().
+//
+class StreamingHash64 {
+public:
+  explicit StreamingHash64(std::uint64_t seed = 0) : state_(seed) {}
+
+  void update(char ch) {
+    pending_ |= std::uint64_t{static_cast<unsigned char>(ch)}
+                << (8 * pending_size_);
+    ++length_;
+    if (++pending_size_ == 8) {
+      MixWord(pending_);
+      pending_ = 0;
+      pending_size_ = 0;
+    }
+  }
+
+  void update(const char *data, std::size_t size) {
+    // Finish off any partially filled word one byte at a time.
+    while (pending_size_ != 0 && size != 0) {
+      update(*data);
+      ++data;
+      --size;
+    }
+    // Then consume whole words directly from the input.
+    length_ += size & ~std::size_t{7};
+    for (; size >= 8; data += 8, size -= 8) {
+      MixWord(LoadWord(data));
+    }
+    for (; size != 0; ++data, --size) {
+      update(*data);
+    }
+  }
+
+  void operator()(char ch) { update(ch); }
+
+  std::uint64_t digest() const {
+    std::uint64_t h = state_;
+    if (pending_size_ != 0) {
+      h ^= MixKey(pending_);
+    }
+    h ^= length_;
+    // fmix64 finalizer from MurmurHash3.
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+private:
+  static std::uint64_t Rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  }
+
+  static std::uint64_t MixKey(std::uint64_t k) {
+    k *= 0x87c37b91114253d5ULL;
+    k = Rotl(k, 31);
+    k *= 0x4cf5ad432745937fULL;
+    return k;
+  }
+
+  static std::uint64_t LoadWord(const char *p) {
+    std::uint64_t word;
+    std::memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+  }
+
+  void MixWord(std::uint64_t word) {
+    state_ ^= MixKey(word);
+    state_ = Rotl(state_, 27) * 5 + 0x52dce729;
+  }
+
+  std::uint64_t state_;
+  std::uint64_t pending_ = 0;
+  std::uint64_t length_ = 0;
+  int pending_size_ = 0;
+};
+
 } // namespace util
 } // namespace hittop
 
@@ -0,0 +1,25 @@
+// Hexadecimal digit conversion.
+//
+#ifndef HITTOP_UTIL_HEX_H
+#define HITTOP_UTIL_HEX_H
+
+namespace hittop {
+namespace util {
+
+// Returns the value of the hexadecimal digit ch (in either case), or -1 if ch
+// is not one.
+inline int HexDigitValue(int ch) {
+  if ('0' <= ch && ch <= '9') {
+    return ch - '0';
+  } else if ('a' <= ch && ch <= 'f') {
+    return ch - 'a' + 10;
+  } else if ('A' <= ch && ch <= 'F') {
+    return ch - 'A' + 10;
+  }
+  return -1;
+}
+
+} // namespace util
+} // namespace hittop
+
+#endif // HITTOP_UTIL_HEX_H
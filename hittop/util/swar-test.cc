@@ -0,0 +1,70 @@
+#include "hittop/util/swar.h"
+#include "hittop/util/swar.h"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+namespace {
+
+using ::hittop::util::AllDigits8;
+using ::hittop::util::ParseDecimal;
+using ::hittop::util::ParseDigits8;
+
+template <typename T> bool Parse(const std::string &s, T *value) {
+  return ParseDecimal(s.begin(), s.end(), value);
+}
+
+TEST(SwarTest, AllDigits8) {
+  EXPECT_TRUE(AllDigits8(0x3031323334353639ULL));
+  EXPECT_FALSE(AllDigits8(0x303132333435363aULL)); // ':'
+  EXPECT_FALSE(AllDigits8(0x2f31323334353637ULL)); // '/'
+  EXPECT_FALSE(AllDigits8(0x3031323334353637ULL | 0x80));
+}
+
+TEST(SwarTest, ParseDigits8) {
+  // "12345678", most significant digit first.
+  EXPECT_EQ(12345678u, ParseDigits8(0x3132333435363738ULL));
+  EXPECT_EQ(99999999u, ParseDigits8(0x3939393939393939ULL));
+  EXPECT_EQ(0u, ParseDigits8(0x3030303030303030ULL));
+}
+
+TEST(SwarTest, ParseDecimal) {
+  unsigned value = 7;
+  EXPECT_TRUE(Parse("0", &value));
+  EXPECT_EQ(0u, value);
+  EXPECT_TRUE(Parse("8080", &value));
+  EXPECT_EQ(8080u, value);
+  EXPECT_TRUE(Parse("00065535", &value));
+  EXPECT_EQ(65535u, value);
+  EXPECT_TRUE(Parse("123456789", &value));
+  EXPECT_EQ(123456789u, value);
+  EXPECT_TRUE(Parse("4294967295", &value));
+  EXPECT_EQ(4294967295u, value);
+
+  value = 7;
+  EXPECT_FALSE(Parse("", &value));
+  EXPECT_FALSE(Parse("12a4", &value));
+  EXPECT_FALSE(Parse("-1", &value));
+  EXPECT_FALSE(Parse("4294967296", &value));
+  EXPECT_EQ(7u, value);
+}
+
+TEST(SwarTest, ParseDecimalLimits) {
+  std::uint16_t port;
+  EXPECT_TRUE(Parse("65535", &port));
+  EXPECT_EQ(65535, port);
+  EXPECT_FALSE(Parse("65536", &port));
+  EXPECT_FALSE(Parse("100000000", &port));
+
+  std::uint64_t big;
+  EXPECT_TRUE(Parse("18446744073709551615", &big));
+  EXPECT_EQ(std::numeric_limits<std::uint64_t>::max(), big);
+  EXPECT_FALSE(Parse("18446744073709551616", &big));
+  EXPECT_TRUE(Parse("000000000000000000000000001", &big));
+  EXPECT_EQ(1u, big);
+}
+
+} // namespace
@@ -0,0 +1,87 @@
+// SIMD-within-a-register (SWAR) routines for parsing ASCII decimal numbers.
+//
+// Up to eight digits are packed into a single 64-bit word, validated with a
+// couple of mask operations, and combined pairwise (1+1, 2+2, 4+4 digits) with
+// three multiplies, rather than one multiply-add and range check per digit.
+//
+#ifndef HITTOP_UTIL_SWAR_H
+#define HITTOP_UTIL_SWAR_H
+
+#include <cstdint>
+#include <limits>
+
+namespace hittop {
+namespace util {
+
+// Eight ASCII '0' characters.
+constexpr std::uint64_t kSwarZeros = 0x3030303030303030ULL;
+
+// Returns true iff every byte of word is an ASCII decimal digit.
+inline bool AllDigits8(std::uint64_t word) {
+  // Digits are exactly the bytes in [0x30, 0x39]: the high nibble must be 3
+  // both before and after adding 6 to the low nibble.
+  constexpr std::uint64_t kHighNibbles = 0xF0F0F0F0F0F0F0F0ULL;
+  constexpr std::uint64_t kSixes = 0x0606060606060606ULL;
+  return (word & kHighNibbles) == kSwarZeros &&
+         ((word + kSixes) & kHighNibbles) == kSwarZeros;
+}
+
+// Returns the value of the eight ASCII digits packed into word, with the most
+// significant digit in the most significant byte.  The result is undefined if
+// AllDigits8(word) is false.
+inline std::uint32_t ParseDigits8(std::uint64_t word) {
+  std::uint64_t v = word - kSwarZeros;
+  // Each 16-bit lane now holds two digits; combine them into a value < 100.
+  v = ((v >> 8) & 0x00FF00FF00FF00FFULL) * 10 + (v & 0x00FF00FF00FF00FFULL);
+  // Each 32-bit lane holds two values < 100; combine them into one < 10^4.
+  v = ((v >> 16) & 0x0000FFFF0000FFFFULL) * 100 +
+      (v & 0x0000FFFF0000FFFFULL);
+  // Finally, combine the two halves into a value < 10^8.
+  return static_cast<std::uint32_t>((v >> 32) * 10000 + (v & 0xFFFFFFFFULL));
+}
+
+// Parses [first, last), which must consist entirely of ASCII decimal digits,
+// as an unsigned integer of type T.  Returns false (leaving *value unmodified)
+// if the range is empty, contains a non-digit, or its value does not fit in T.
+// Does not allocate.
+template <typename Iterator, typename T>
+bool ParseDecimal(Iterator first, Iterator last, T *value) {
+  static_assert(std::numeric_limits<T>::is_integer &&
+                    !std::numeric_limits<T>::is_signed &&
+                    std::numeric_limits<T>::digits <= 64,
+                "ParseDecimal requires an unsigned integer type");
+  static constexpr std::uint32_t kPowersOf10[] = {
+      1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+  if (first == last) {
+    return false;
+  }
+  constexpr std::uint64_t kMax = std::numeric_limits<T>::max();
+  std::uint64_t result = 0;
+  while (first != last) {
+    // Gather up to eight characters, first character in the highest byte.
+    std::uint64_t word = 0;
+    int count = 0;
+    for (; count < 8 && first != last; ++count, ++first) {
+      word = (word << 8) | static_cast<unsigned char>(*first);
+    }
+    // Left-pad short chunks with '0's so they have the same value.
+    if (count < 8) {
+      word |= kSwarZeros << (8 * count);
+    }
+    if (!AllDigits8(word)) {
+      return false;
+    }
+    const std::uint64_t chunk = ParseDigits8(word);
+    if (chunk > kMax || result > (kMax - chunk) / kPowersOf10[count]) {
+      return false;
+    }
+    result = result * kPowersOf10[count] + chunk;
+  }
+  *value = static_cast<T>(result);
+  return true;
+}
+
+} // namespace util
+} // namespace hittop
+
+#endif // HITTOP_UTIL_SWAR_H
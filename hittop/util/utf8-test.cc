@@ -0,0 +1,165 @@
+#include "hittop/util/utf8.h"
+#include "hittop/util/utf8.h"
+
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using ::hittop::util::FindInvalidUtf8;
+using ::hittop::util::HasSsse3;
+using ::hittop::util::IsValidUtf8;
+using ::hittop::util::Utf8CheckerScalar;
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+using ::hittop::util::Utf8CheckerSsse3;
+#endif
+
+// Returns the offset of the first invalid sequence in s, or s.size(), after
+// checking that both checkers (where the CPU has SSSE3) agree on it.
+std::size_t Find(const std::string &s) {
+  const char *const first = s.data();
+  const char *const last = first + s.size();
+  const std::size_t offset = FindInvalidUtf8(first, last) - first;
+  EXPECT_EQ(::hittop::util::internal::FindInvalidUtf8(Utf8CheckerScalar(),
+                                                     first, last) -
+                first,
+            offset);
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+  if (HasSsse3()) {
+    EXPECT_EQ(::hittop::util::internal::FindInvalidUtf8(Utf8CheckerSsse3(),
+                                                       first, last) -
+                  first,
+              offset);
+  }
+#endif
+  return offset;
+}
+
+bool Valid(const std::string &s) {
+  return IsValidUtf8(s.data(), s.data() + s.size());
+}
+
+// Checks s (padded with spaces to a multiple of 64 bytes) with checker.
+template <typename Checker> bool CheckBlocks(Checker checker, std::string s) {
+  s.resize((s.size() + 63) / 64 * 64, ' ');
+  for (std::size_t i = 0; i < s.size(); i += 64) {
+    checker.Check64(s.data() + i);
+  }
+  return checker.Finish();
+}
+
+// Checks s with both checkers (where the CPU has SSSE3), which must agree.
+bool CheckBlocks(const std::string &s) {
+  const bool valid = CheckBlocks(Utf8CheckerScalar(), s);
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+  if (HasSsse3()) {
+    EXPECT_EQ(CheckBlocks(Utf8CheckerSsse3(), s), valid) << s;
+  }
+#endif
+  return valid;
+}
+
+// Well-formed sequences at the edges of each range of table 3-7.
+const char *const kValid[] = {
+    "\x00",         "\x7f",         "\xc2\x80",     "\xdf\xbf",
+    "\xe0\xa0\x80", "\xe0\xbf\xbf", "\xe1\x80\x80", "\xec\xbf\xbf",
+    "\xed\x80\x80", "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf",
+    "\xf0\x90\x80\x80", "\xf0\xbf\xbf\xbf", "\xf1\x80\x80\x80",
+    "\xf3\xbf\xbf\xbf", "\xf4\x80\x80\x80", "\xf4\x8f\xbf\xbf",
+};
+
+// Ill-formed sequences, each invalid from its first byte.
+const char *const kInvalid[] = {
+    "\x80",         "\xbf",         "\xc0\x80",     "\xc1\xbf",
+    "\xc2",         "\xc2\x41",     "\xc2\xc0",     "\xe0\x80\x80",
+    "\xe0\x9f\xbf", "\xe1\x80",     "\xe1\x80\x41", "\xed\xa0\x80",
+    "\xed\xbf\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf",
+    "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xf8\x88\x80\x80\x80",
+    "\xff",         "\xf1\x80\x80", "\xf1\x80\x80\x41",
+};
+
+std::string Bytes(const char *s) {
+  // Some of the sequences are a single NUL.
+  return *s == '\0' ? std::string(1, '\0') : std::string(s);
+}
+
+TEST(Utf8Test, Sequences) {
+  for (const char *s : kValid) {
+    const std::string bytes = Bytes(s);
+    EXPECT_TRUE(Valid(bytes)) << bytes;
+    EXPECT_TRUE(Valid("ab" + bytes + "cd")) << bytes;
+    EXPECT_TRUE(CheckBlocks(bytes)) << bytes;
+  }
+  for (const char *s : kInvalid) {
+    const std::string bytes = Bytes(s);
+    EXPECT_EQ(Find(bytes), 0u) << bytes;
+    EXPECT_EQ(Find("ab" + bytes + "cd"), 2u) << bytes;
+    EXPECT_FALSE(CheckBlocks("ab" + bytes + "cd")) << bytes;
+  }
+  EXPECT_TRUE(Valid(""));
+  EXPECT_TRUE(Valid("caf\xc3\xa9 \xe6\x97\xa5\xe6\x9c\xac \xf0\x9f\x98\x80"));
+  // Truncated at the end.
+  EXPECT_EQ(Find("caf\xc3\xa9\xe6\x97"), 5u);
+  EXPECT_FALSE(CheckBlocks(std::string(63, 'x') + "\xe6"));
+  EXPECT_FALSE(CheckBlocks(std::string(64, 'x') + "\xe6\x97"));
+}
+
+// Compares the block validator with the byte-at-a-time one on random text,
+// with errors at every offset relative to the 64-byte blocks.
+TEST(Utf8Test, MatchesScalar) {
+  std::mt19937 rng(1);
+  for (int round = 0; round < 2000; ++round) {
+    std::string text;
+    const std::size_t size = rng() % 300;
+    while (text.size() < size) {
+      // Mostly ASCII runs, so that the fast path is taken too.
+      if (rng() % 3 == 0) {
+        text += Bytes(kValid[rng() % (sizeof(kValid) / sizeof(kValid[0]))]);
+      } else {
+        text.append(rng() % 80, 'a' + rng() % 26);
+      }
+    }
+    ASSERT_TRUE(Valid(text));
+    ASSERT_TRUE(CheckBlocks(text));
+    if (text.empty()) {
+      continue;
+    }
+    std::string bad = text;
+    switch (rng() % 3) {
+    case 0:
+      bad[rng() % bad.size()] = static_cast<char>(0x80 + rng() % 0x80);
+      break;
+    case 1:
+      bad.insert(rng() % bad.size(),
+                 Bytes(kInvalid[rng() % (sizeof(kInvalid) /
+                                          sizeof(kInvalid[0]))]));
+      break;
+    default:
+      bad.resize(rng() % bad.size());
+      break;
+    }
+    const std::size_t expected =
+        ::hittop::util::internal::ScanUtf8(bad.data(),
+                                           bad.data() + bad.size()) -
+        bad.data();
+    ASSERT_EQ(Find(bad), expected);
+    ASSERT_EQ(CheckBlocks(bad), expected == bad.size());
+  }
+}
+
+#if defined(__x86_64__)
+// The vector checker is built on x86-64 whatever the compiler flags, and
+// chosen whenever the CPU allows.
+TEST(Utf8Test, VectorCheckerBuilt) {
+#if !defined(HITTOP_UTIL_UTF8_SSSE3)
+  ADD_FAILURE() << "Utf8CheckerSsse3 is not compiled";
+#endif
+  EXPECT_EQ(HasSsse3(), __builtin_cpu_supports("ssse3") != 0);
+}
+#endif
+
+} // namespace
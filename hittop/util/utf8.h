@@ -0,0 +1,360 @@
+// UTF-8 validation.
+//
+// A byte string is valid UTF-8 if it is a sequence of the well-formed byte
+// sequences of the Unicode standard (table 3-7): no overlong encodings, no
+// surrogates (U+D800-U+DFFF), nothing above U+10FFFF, and no truncated or
+// stray continuation bytes.
+//
+// Utf8CheckerSsse3 validates 16 bytes per step with the lookup-table technique
+// of Keiser and Lemire ("Validating UTF-8 in less than one instruction per
+// byte"): almost every error is determined by the high nibble of a byte and
+// both nibbles of the byte before it, so three table lookups (PSHUFB) classify
+// all of them at once, and a saturating subtraction finds the bytes that must
+// be the third or fourth of a sequence.  Blocks of 64 ASCII bytes, by far the
+// most common case, are accepted after a single OR and compare.
+// Utf8CheckerScalar is a byte-at-a-time state machine that skips ASCII eight
+// bytes at a time.
+//
+// On x86-64 the SSSE3 checker is always compiled, with the ssse3 target
+// attribute unless the whole build already targets SSSE3 (-mssse3,
+// -march=native, ...), and WithUtf8Checker chooses between the two by asking
+// the CPU once.  Elsewhere only the scalar checker exists.
+//
+// The checkers accept their input 64 bytes at a time, so that they can be
+// fused into another pass over the same blocks (see json::StructuralIndex).
+// They only tell whether there was an error; FindInvalidUtf8 also finds it.
+//
+#ifndef HITTOP_UTIL_UTF8_H
+#define HITTOP_UTIL_UTF8_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#define HITTOP_UTIL_UTF8_SSSE3 1
+#define HITTOP_UTIL_UTF8_TARGET_SSSE3
+#elif defined(__x86_64__) && defined(__GNUC__)
+#define HITTOP_UTIL_UTF8_SSSE3 1
+#define HITTOP_UTIL_UTF8_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+#include <tmmintrin.h>
+#endif
+
+namespace hittop {
+namespace util {
+namespace internal {
+
+// Returns true if none of the eight bytes at p has its high bit set.
+inline bool IsAscii8(const char *p) {
+  std::uint64_t word;
+  std::memcpy(&word, p, sizeof(word));
+  return (word & 0x8080808080808080ULL) == 0;
+}
+
+// The state of the byte-at-a-time validator between bytes: the number of
+// continuation bytes still expected, and the range allowed for the next one
+// (which is narrower than [0x80, 0xbf] just after some lead bytes).
+struct Utf8State {
+  unsigned needed = 0;
+  unsigned char lo = 0x80;
+  unsigned char hi = 0xbf;
+
+  // Consumes one byte; returns false if it cannot occur here.
+  bool Step(unsigned char ch) {
+    if (needed != 0) {
+      if (ch < lo || ch > hi) {
+        return false;
+      }
+      --needed;
+      lo = 0x80;
+      hi = 0xbf;
+      return true;
+    }
+    if (ch < 0x80) {
+      return true;
+    }
+    if (ch < 0xc2) { // A continuation byte, or an overlong two-byte lead.
+      return false;
+    }
+    if (ch < 0xe0) {
+      needed = 1;
+    } else if (ch < 0xf0) {
+      needed = 2;
+      if (ch == 0xe0) {
+        lo = 0xa0; // Overlong below U+0800.
+      } else if (ch == 0xed) {
+        hi = 0x9f; // Surrogates.
+      }
+    } else if (ch < 0xf5) {
+      needed = 3;
+      if (ch == 0xf0) {
+        lo = 0x90; // Overlong below U+10000.
+      } else if (ch == 0xf4) {
+        hi = 0x8f; // Above U+10FFFF.
+      }
+    } else {
+      return false;
+    }
+    return true;
+  }
+};
+
+// Validates [first, last) a byte at a time, starting at the beginning of a
+// character.  Returns the start of the first sequence that is invalid or
+// truncated, or last.
+inline const char *ScanUtf8(const char *first, const char *last) {
+  Utf8State state;
+  const char *start = first;
+  while (first != last) {
+    if (state.needed == 0) {
+      while (last - first >= 8 && IsAscii8(first)) {
+        first += 8;
+      }
+      if (first == last) {
+        break;
+      }
+      start = first;
+    }
+    if (!state.Step(static_cast<unsigned char>(*first))) {
+      return state.needed == 0 ? first : start;
+    }
+    ++first;
+  }
+  return state.needed == 0 ? last : start;
+}
+
+} // namespace internal
+
+class Utf8CheckerScalar {
+public:
+  // Checks the next 64 bytes of the input.
+  void Check64(const char *block) {
+    for (int i = 0; i < 64 && !error_; i += 8) {
+      if (state_.needed == 0 && internal::IsAscii8(block + i)) {
+        continue;
+      }
+      for (int j = i; j < i + 8; ++j) {
+        if (!state_.Step(static_cast<unsigned char>(block[j]))) {
+          error_ = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // Returns true if some error has been found so far.
+  bool error() const { return error_; }
+
+  // Returns true if all of the input checked was valid, and did not end
+  // within a sequence.
+  bool Finish() const { return !error_ && state_.needed == 0; }
+
+private:
+  internal::Utf8State state_;
+  bool error_ = false;
+};
+
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+
+// Every member that uses SSSE3 carries the target attribute, so that the
+// class can be compiled for CPUs without it; only call it where HasSsse3().
+class Utf8CheckerSsse3 {
+public:
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 Utf8CheckerSsse3()
+      : prev_(_mm_setzero_si128()), prev_incomplete_(_mm_setzero_si128()),
+        error_(_mm_setzero_si128()) {}
+
+  // Checks the next 64 bytes of the input.
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 void Check64(const char *block) {
+    __m128i v[4];
+    for (int i = 0; i < 4; ++i) {
+      v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + 16 * i));
+    }
+    const __m128i any = _mm_or_si128(_mm_or_si128(v[0], v[1]),
+                                     _mm_or_si128(v[2], v[3]));
+    if (_mm_movemask_epi8(any) == 0) {
+      // All ASCII: only a sequence left open by the previous block can fail.
+      error_ = _mm_or_si128(error_, prev_incomplete_);
+      prev_ = v[3];
+      prev_incomplete_ = _mm_setzero_si128();
+      return;
+    }
+    for (int i = 0; i < 4; ++i) {
+      CheckVector(v[i]);
+    }
+    // Lead bytes in the last three positions that need more bytes than
+    // remain in the block.
+    const __m128i max_lead =
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                      char(0xf0 - 1), char(0xe0 - 1), char(0xc0 - 1));
+    prev_incomplete_ = _mm_subs_epu8(prev_, max_lead);
+  }
+
+  // Returns true if some error has been found so far.
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 bool error() const { return !IsZero(error_); }
+
+  // Returns true if all of the input checked was valid, and did not end
+  // within a sequence.
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 bool Finish() const {
+    return IsZero(_mm_or_si128(error_, prev_incomplete_));
+  }
+
+private:
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 static bool IsZero(__m128i v) {
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) ==
+           0xffff;
+  }
+
+  // Flags (as in simdjson) for the errors that two consecutive bytes can
+  // show; a pair is an error if its three lookups have a flag in common.
+  enum : unsigned char {
+    kTooShort = 1 << 0,     // A lead, then no continuation.
+    kTooLong = 1 << 1,      // ASCII, then a continuation.
+    kOverlong3 = 1 << 2,    // E0 80-9F
+    kTooLarge = 1 << 3,     // F4 90-BF, or F5-FF
+    kSurrogate = 1 << 4,    // ED A0-BF
+    kOverlong2 = 1 << 5,    // C0-C1
+    kTooLarge1000 = 1 << 6, // F5-FF 80-8F
+    kOverlong4 = 1 << 6,    // F0 80-8F
+    kTwoConts = 1 << 7,     // Two continuations: valid only within a three
+                            // or four byte sequence.
+    kCarry = kTooShort | kTooLong | kTwoConts,
+  };
+
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 static __m128i HighNibbles(__m128i v) {
+    return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+  }
+
+  HITTOP_UTIL_UTF8_TARGET_SSSE3 void CheckVector(__m128i input) {
+    const __m128i prev1 = _mm_alignr_epi8(input, prev_, 15);
+    const __m128i byte_1_high = _mm_shuffle_epi8(
+        _mm_setr_epi8(kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+                      kTooLong, kTooLong, kTooLong, char(kTwoConts),
+                      char(kTwoConts), char(kTwoConts), char(kTwoConts),
+                      kTooShort | kOverlong2, kTooShort,
+                      kTooShort | kOverlong3 | kSurrogate,
+                      kTooShort | kTooLarge | kTooLarge1000 | kOverlong4),
+        HighNibbles(prev1));
+    const __m128i byte_1_low = _mm_shuffle_epi8(
+        _mm_setr_epi8(char(kCarry | kOverlong3 | kOverlong2 | kOverlong4),
+                      char(kCarry | kOverlong2), char(kCarry), char(kCarry),
+                      char(kCarry | kTooLarge),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000 | kSurrogate),
+                      char(kCarry | kTooLarge | kTooLarge1000),
+                      char(kCarry | kTooLarge | kTooLarge1000)),
+        _mm_and_si128(prev1, _mm_set1_epi8(0x0f)));
+    const char kCont8 = char(kTooLong | kOverlong2 | kTwoConts | kOverlong3 |
+                             kTooLarge1000 | kOverlong4);
+    const char kCont9 =
+        char(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge);
+    const char kContAB =
+        char(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge);
+    const __m128i byte_2_high = _mm_shuffle_epi8(
+        _mm_setr_epi8(kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+                      kTooShort, kTooShort, kTooShort, kCont8, kCont9, kContAB,
+                      kContAB, kTooShort, kTooShort, kTooShort, kTooShort),
+        HighNibbles(input));
+    const __m128i special =
+        _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+    // Two continuations in a row are an error unless the byte two (three)
+    // before is a three (four) byte lead, i.e. at least 0xe0 (0xf0).
+    const __m128i prev2 = _mm_alignr_epi8(input, prev_, 14);
+    const __m128i prev3 = _mm_alignr_epi8(input, prev_, 13);
+    const __m128i is_third = _mm_subs_epu8(prev2, _mm_set1_epi8(0xe0 - 0x80));
+    const __m128i is_fourth =
+        _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xf0 - 0x80)));
+    const __m128i must_be_continuation = _mm_and_si128(
+        _mm_or_si128(is_third, is_fourth), _mm_set1_epi8(char(0x80)));
+    error_ =
+        _mm_or_si128(error_, _mm_xor_si128(must_be_continuation, special));
+    prev_ = input;
+  }
+
+  __m128i prev_;
+  __m128i prev_incomplete_;
+  __m128i error_;
+};
+
+#endif // defined(HITTOP_UTIL_UTF8_SSSE3)
+
+// Returns true if Utf8CheckerSsse3 exists and the CPU supports it.
+inline bool HasSsse3() {
+#if defined(__SSSE3__)
+  return true;
+#elif defined(HITTOP_UTIL_UTF8_SSSE3)
+  static const bool has_ssse3 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+  }();
+  return has_ssse3;
+#else
+  return false;
+#endif
+}
+
+// Returns f(Utf8CheckerSsse3()) if HasSsse3(), else f(Utf8CheckerScalar()).
+template <typename Function> auto WithUtf8Checker(Function &&f) {
+#if defined(HITTOP_UTIL_UTF8_SSSE3)
+  if (HasSsse3()) {
+    return f(Utf8CheckerSsse3());
+  }
+#endif
+  return f(Utf8CheckerScalar());
+}
+
+namespace internal {
+
+template <typename Checker>
+const char *FindInvalidUtf8(Checker checker, const char *first,
+                            const char *last) {
+  // Find the first 64-byte block with an error, then locate it byte by byte
+  // from the start of the character that the block begins in.
+  const char *p = first;
+  for (; last - p >= 64; p += 64) {
+    checker.Check64(p);
+    if (checker.error()) {
+      break;
+    }
+  }
+  const char *start = p;
+  for (int i = 1; i <= 3 && p - i >= first; ++i) {
+    const unsigned char ch = p[-i];
+    if ((ch & 0xc0) != 0x80) {
+      if (ch >= 0xc0) {
+        start = p - i;
+      }
+      break;
+    }
+  }
+  return ScanUtf8(start, last);
+}
+
+} // namespace internal
+
+// Returns the start of the first byte sequence in [first, last) that is not
+// valid UTF-8 (or that is cut short by last), or last if there is none.
+inline const char *FindInvalidUtf8(const char *first, const char *last) {
+  return WithUtf8Checker([first, last](auto checker) {
+    return internal::FindInvalidUtf8(checker, first, last);
+  });
+}
+
+inline bool IsValidUtf8(const char *first, const char *last) {
+  return FindInvalidUtf8(first, last) == last;
+}
+
+} // namespace util
+} // namespace hittop
+
+#endif // HITTOP_UTIL_UTF8_H